@@ -25,6 +25,8 @@
  * Optimization: to avoid performing a write on each bind,
  * a precision for this timestamp may be configured, causing it to
  * only be updated if it is older than a given number of seconds.
+ * Alternatively the updates may be queued in a write-behind store
+ * and written out periodically, many entries per transaction.
  */
 
 #ifdef SLAPD_OVER_LASTBIND
@@ -43,6 +45,9 @@ typedef struct lastbind_info {
 	/* precision to update timestamp in authTimestamp attribute */
 	int timestamp_precision;
 	int forward_updates;	/* use frontend for authTimestamp updates */
+	int wb_interval;	/* seconds between write-behind flushes, 0 = off */
+	int db_open;
+	slap_wb *wb;
 } lastbind_info;
 
 /* Operational attributes */
@@ -66,6 +71,8 @@ static struct schema_info {
 	{ NULL, NULL }
 };
 
+static ConfigDriver lastbind_cf_wb;
+
 /* configuration attribute and objectclass */
 static ConfigTable lastbindcfg[] = {
 	{ "lastbind-precision", "seconds", 2, 2, 0,
@@ -83,6 +90,13 @@ static ConfigTable lastbindcfg[] = {
 	  "DESC 'Allow authTimestamp updates to be forwarded via updateref' "
 	  "EQUALITY booleanMatch "
 	  "SYNTAX OMsBoolean SINGLE-VALUE )", NULL, NULL },
+	{ "lastbind_write_behind", "seconds", 2, 2, 0,
+	  ARG_INT|ARG_MAGIC,
+	  lastbind_cf_wb,
+	  "( OLcfgCtAt:5.3 NAME 'olcLastBindWriteBehind' "
+	  "DESC 'Seconds between deferred authTimestamp writes, 0 to disable' "
+	  "EQUALITY integerMatch "
+	  "SYNTAX OMsInteger SINGLE-VALUE )", NULL, NULL },
 	{ NULL, NULL, 0, 0, 0, ARG_IGNORED }
 };
 
@@ -91,11 +105,52 @@ static ConfigOCs lastbindocs[] = {
 	  "NAME 'olcLastBindConfig' "
 	  "DESC 'Last Bind configuration' "
 	  "SUP olcOverlayConfig "
-	  "MAY ( olcLastBindPrecision $ olcLastBindForwardUpdates) )",
+	  "MAY ( olcLastBindPrecision $ olcLastBindForwardUpdates $ "
+	  "olcLastBindWriteBehind ) )",
 	  Cft_Overlay, lastbindcfg, NULL, NULL },
 	{ NULL, 0, NULL }
 };
 
+static void lastbind_wb_start( slap_overinst *on );
+
+static int
+lastbind_cf_wb( ConfigArgs *c )
+{
+	slap_overinst *on = (slap_overinst *)c->bi;
+	lastbind_info *lbi = (lastbind_info *)on->on_bi.bi_private;
+
+	switch ( c->op ) {
+	case SLAP_CONFIG_EMIT:
+		c->value_int = lbi->wb_interval;
+		return 0;
+	case LDAP_MOD_DELETE:
+		lbi->wb_interval = 0;
+		break;
+	case SLAP_CONFIG_ADD:
+	case LDAP_MOD_ADD:
+		if ( c->value_int < 0 ) {
+			snprintf( c->cr_msg, sizeof( c->cr_msg ),
+				"<%s> invalid value \"%d\"", c->argv[0], c->value_int );
+			Debug( LDAP_DEBUG_ANY, "%s: %s\n", c->log, c->cr_msg );
+			return ARG_BAD_CONF;
+		}
+		lbi->wb_interval = c->value_int;
+		break;
+	default:
+		abort ();
+	}
+
+	/* restart the store with the new setting */
+	if ( lbi->db_open ) {
+		if ( lbi->wb ) {
+			slap_wb_free( lbi->wb );
+			lbi->wb = NULL;
+		}
+		lastbind_wb_start( on );
+	}
+	return 0;
+}
+
 static time_t
 parse_time( char *atm )
 {
@@ -110,13 +165,87 @@ parse_time( char *atm )
 	return ret;
 }
 
+/* Write the authTimestamp change in mod to the target of op */
+static int
+lastbind_update( Operation *op, lastbind_info *lbi, Modifications *mod )
+{
+	Operation op2 = *op;
+	SlapReply r2 = { REP_RESULT };
+	slap_callback cb = { NULL, slap_null_cb, NULL, NULL };
+	LDAPControl c, *ca[2];
+	BackendInfo *bi = op->o_bd->bd_info;
+	int rc;
+
+	/* This is a DSA-specific opattr, it never gets replicated. */
+	op2.o_tag = LDAP_REQ_MODIFY;
+	op2.o_callback = &cb;
+	op2.orm_modlist = mod;
+	op2.orm_no_opattrs = 0;
+	op2.o_dn = op->o_bd->be_rootdn;
+	op2.o_ndn = op->o_bd->be_rootndn;
+
+	/*
+	 * Code for forwarding of updates adapted from ppolicy.c of slapo-ppolicy
+	 *
+	 * If this server is a shadow and forward_updates is true,
+	 * use the frontend to perform this modify. That will trigger
+	 * the update referral, which can then be forwarded by the
+	 * chain overlay. Obviously the updateref and chain overlay
+	 * must be configured appropriately for this to be useful.
+	 */
+	if ( SLAP_SHADOW( op->o_bd ) && lbi->forward_updates ) {
+		op2.o_bd = frontendDB;
+
+		/* Must use Relax control since these are no-user-mod */
+		op2.o_relax = SLAP_CONTROL_CRITICAL;
+		op2.o_ctrls = ca;
+		ca[0] = &c;
+		ca[1] = NULL;
+		BER_BVZERO( &c.ldctl_value );
+		c.ldctl_iscritical = 1;
+		c.ldctl_oid = LDAP_CONTROL_RELAX;
+	} else {
+		/* If not forwarding, don't update opattrs and don't replicate */
+		if ( SLAP_SINGLE_SHADOW( op->o_bd )) {
+			op2.orm_no_opattrs = 1;
+			op2.o_dont_replicate = 1;
+		}
+		/* TODO: not sure what this does in slapo-ppolicy */
+		/*
+		op2.o_bd->bd_info = (BackendInfo *)on->on_info;
+		*/
+	}
+
+	rc = op->o_bd->be_modify( &op2, &r2 );
+	op->o_bd->bd_info = bi;
+	return rc;
+}
+
+/* slap_wb_write_f for deferred authTimestamp updates */
+static int
+lastbind_wb_write( Operation *op, Modifications *ml, void *arg )
+{
+	return lastbind_update( op, (lastbind_info *)arg, ml );
+}
+
+static void
+lastbind_wb_start( slap_overinst *on )
+{
+	lastbind_info *lbi = on->on_bi.bi_private;
+
+	if ( lbi->wb_interval > 0 && ( slapMode & SLAP_SERVER_MODE ))
+		lbi->wb = slap_wb_new( on->on_info->oi_origdb, lbi->wb_interval, 0,
+			lastbind_wb_write, lbi );
+}
+
 static int
 lastbind_bind_response( Operation *op, SlapReply *rs )
 {
 	Modifications *mod = NULL;
 	BackendInfo *bi = op->o_bd->bd_info;
+	lastbind_info *lbi = (lastbind_info *) op->o_callback->sc_private;
 	Entry *e;
-	int rc;
+	int rc, e_dup = 0;
 
 	/* we're only interested if the bind was successful */
 	if ( rs->sr_err != LDAP_SUCCESS )
@@ -129,9 +258,18 @@ lastbind_bind_response( Operation *op, SlapReply *rs )
 		return SLAP_CB_CONTINUE;
 	}
 
-	{
-		lastbind_info *lbi = (lastbind_info *) op->o_callback->sc_private;
+	/* judge the precision against a timestamp still waiting to be written */
+	if ( lbi->wb && slap_wb_pending( lbi->wb, &e->e_nname )) {
+		Entry *dup = entry_dup( e );
+
+		be_entry_release_r( op, e );
+		op->o_bd->bd_info = bi;
+		e = dup;
+		e_dup = 1;
+		slap_wb_apply( lbi->wb, e );
+	}
 
+	{
 		time_t now, bindtime = (time_t)-1;
 		Attribute *a;
 		Modifications *m;
@@ -175,58 +313,20 @@ lastbind_bind_response( Operation *op, SlapReply *rs )
 	}
 
 done:
-	be_entry_release_r( op, e );
+	if ( e_dup )
+		entry_free( e );
+	else
+		be_entry_release_r( op, e );
 
 	/* perform the update, if necessary */
 	if ( mod ) {
-		Operation op2 = *op;
-		SlapReply r2 = { REP_RESULT };
-		slap_callback cb = { NULL, slap_null_cb, NULL, NULL };
-		LDAPControl c, *ca[2];
-		lastbind_info *lbi = (lastbind_info *) op->o_callback->sc_private;
-
-		/* This is a DSA-specific opattr, it never gets replicated. */
-		op2.o_tag = LDAP_REQ_MODIFY;
-		op2.o_callback = &cb;
-		op2.orm_modlist = mod;
-		op2.orm_no_opattrs = 0;
-		op2.o_dn = op->o_bd->be_rootdn;
-		op2.o_ndn = op->o_bd->be_rootndn;
-
-		/*
-		 * Code for forwarding of updates adapted from ppolicy.c of slapo-ppolicy
-		 *
-		 * If this server is a shadow and forward_updates is true,
-		 * use the frontend to perform this modify. That will trigger
-		 * the update referral, which can then be forwarded by the
-		 * chain overlay. Obviously the updateref and chain overlay
-		 * must be configured appropriately for this to be useful.
-		 */
-		if ( SLAP_SHADOW( op->o_bd ) && lbi->forward_updates ) {
-			op2.o_bd = frontendDB;
-
-			/* Must use Relax control since these are no-user-mod */
-			op2.o_relax = SLAP_CONTROL_CRITICAL;
-			op2.o_ctrls = ca;
-			ca[0] = &c;
-			ca[1] = NULL;
-			BER_BVZERO( &c.ldctl_value );
-			c.ldctl_iscritical = 1;
-			c.ldctl_oid = LDAP_CONTROL_RELAX;
+		if ( lbi->wb ) {
+			/* the store takes ownership of mod */
+			slap_wb_queue( lbi->wb, op, mod );
 		} else {
-			/* If not forwarding, don't update opattrs and don't replicate */
-			if ( SLAP_SINGLE_SHADOW( op->o_bd )) {
-				op2.orm_no_opattrs = 1;
-				op2.o_dont_replicate = 1;
-			}
-			/* TODO: not sure what this does in slapo-ppolicy */
-			/*
-			op2.o_bd->bd_info = (BackendInfo *)on->on_info;
-			*/
+			lastbind_update( op, lbi, mod );
+			slap_mods_free( mod, 1 );
 		}
-
-		rc = op->o_bd->be_modify( &op2, &r2 );
-		slap_mods_free( mod, 1 );
 	}
 
 	op->o_bd->bd_info = bi;
@@ -250,6 +350,52 @@ lastbind_bind( Operation *op, SlapReply *rs )
 	return SLAP_CB_CONTINUE;
 }
 
+static int
+lastbind_search_cleanup( Operation *op, SlapReply *rs )
+{
+	if ( rs->sr_type == REP_RESULT || rs->sr_err == SLAPD_ABANDON ) {
+		op->o_tmpfree( op->o_callback, op->o_tmpmemctx );
+		op->o_callback = NULL;
+	}
+	return SLAP_CB_CONTINUE;
+}
+
+/* Show deferred authTimestamp values in search results */
+static int
+lastbind_search_response( Operation *op, SlapReply *rs )
+{
+	slap_overinst *on = op->o_callback->sc_private;
+	lastbind_info *lbi = on->on_bi.bi_private;
+
+	if ( rs->sr_type == REP_SEARCH && lbi->wb &&
+		slap_wb_pending( lbi->wb, &rs->sr_entry->e_nname ))
+	{
+		rs_entry2modifiable( op, rs, on );
+		slap_wb_apply( lbi->wb, rs->sr_entry );
+	}
+	return SLAP_CB_CONTINUE;
+}
+
+static int
+lastbind_search( Operation *op, SlapReply *rs )
+{
+	slap_overinst *on = (slap_overinst *) op->o_bd->bd_info;
+	lastbind_info *lbi = (lastbind_info *) on->on_bi.bi_private;
+	slap_callback *cb;
+
+	if ( !lbi->wb )
+		return SLAP_CB_CONTINUE;
+
+	cb = op->o_tmpcalloc( sizeof(slap_callback), 1, op->o_tmpmemctx );
+	cb->sc_response = lastbind_search_response;
+	cb->sc_cleanup = lastbind_search_cleanup;
+	cb->sc_private = on;
+	cb->sc_next = op->o_callback->sc_next;
+	op->o_callback->sc_next = cb;
+
+	return SLAP_CB_CONTINUE;
+}
+
 static int
 lastbind_db_init(
 	BackendDB *be,
@@ -264,6 +410,21 @@ lastbind_db_init(
 	return 0;
 }
 
+static int
+lastbind_db_open(
+	BackendDB *be,
+	ConfigReply *cr
+)
+{
+	slap_overinst *on = (slap_overinst *) be->bd_info;
+	lastbind_info *lbi = (lastbind_info *) on->on_bi.bi_private;
+
+	lbi->db_open = 1;
+	lastbind_wb_start( on );
+
+	return 0;
+}
+
 static int
 lastbind_db_close(
 	BackendDB *be,
@@ -273,6 +434,12 @@ lastbind_db_close(
 	slap_overinst *on = (slap_overinst *) be->bd_info;
 	lastbind_info *lbi = (lastbind_info *) on->on_bi.bi_private;
 
+	/* write out any deferred timestamps */
+	if ( lbi->wb ) {
+		slap_wb_free( lbi->wb );
+		lbi->wb = NULL;
+	}
+
 	/* free private structure to store configuration */
 	free( lbi );
 
@@ -299,8 +466,10 @@ int lastbind_initialize()
 
 	lastbind.on_bi.bi_type = "lastbind";
 	lastbind.on_bi.bi_db_init = lastbind_db_init;
+	lastbind.on_bi.bi_db_open = lastbind_db_open;
 	lastbind.on_bi.bi_db_close = lastbind_db_close;
 	lastbind.on_bi.bi_op_bind = lastbind_bind;
+	lastbind.on_bi.bi_op_search = lastbind_search;
 
 	/* register configuration directives */
 	lastbind.on_bi.bi_cf_ocs = lastbindocs;
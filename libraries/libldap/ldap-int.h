@@ -287,7 +287,8 @@ struct ldapoptions {
    	int			ldo_tls_crlcheck;
 	char		*ldo_tls_pin_hashalg;
 	struct berval	ldo_tls_pin;
-#define LDAP_LDO_TLS_NULLARG ,0,0,0,{0,0,0,0,0,0,0,0,0},0,0,0,0,0,{0,0}
+	int			ldo_tls_sesscache;
+#define LDAP_LDO_TLS_NULLARG ,0,0,0,{0,0,0,0,0,0,0,0,0},0,0,0,0,0,{0,0},0
 #else
 #define LDAP_LDO_TLS_NULLARG
 #endif
@@ -45,6 +45,8 @@ typedef int (TI_session_unique)(tls_session *sess, struct berval *buf, int is_se
 typedef const char *(TI_session_name)(tls_session *s);
 typedef int (TI_session_peercert)(tls_session *s, struct berval *der);
 typedef int (TI_session_pinning)(LDAP *ld, tls_session *s, char *hashalg, struct berval *hash);
+typedef int (TI_session_resume)(tls_session *s, const char *key, struct berval *data);
+typedef int (TI_session_resumed)(tls_session *s);
 
 typedef void (TI_thr_init)(void);
 
@@ -73,6 +75,8 @@ typedef struct tls_impl {
 	TI_session_name *ti_session_cipher;
 	TI_session_peercert *ti_session_peercert;
 	TI_session_pinning *ti_session_pinning;
+	TI_session_resume *ti_session_resume;	/* client session cache */
+	TI_session_resumed *ti_session_resumed;
 
 	Sockbuf_IO *ti_sbio;
 
@@ -83,4 +87,8 @@ typedef struct tls_impl {
 
 extern tls_impl ldap_int_tls_impl;
 
+/* called by the implementation when a client session can be resumed */
+LDAP_F (void) ldap_int_tls_session_store LDAP_P((
+	tls_ctx *ctx, const char *key, struct berval *data ));
+
 #endif /* _LDAP_TLS_H */
@@ -101,6 +101,144 @@ tls_ctx_ref( tls_ctx *ctx )
 static ldap_pvt_thread_mutex_t tls_def_ctx_mutex;
 #endif
 
+/*
+ * Process-wide cache of client sessions, so that reconnecting to a
+ * server can resume the previous session instead of going through a
+ * full handshake.  Sessions are kept in the form the implementation
+ * serialized them to, keyed by the context they were made with and
+ * the server's host and port; each entry holds a reference on its
+ * context.  The most recently stored entries come first.
+ */
+#define TLS_SESS_CACHE_MAX	128
+
+typedef struct tls_sess {
+	struct tls_sess *ts_next;
+	tls_ctx *ts_ctx;
+	char *ts_key;
+	struct berval ts_data;
+} tls_sess;
+
+static tls_sess *tls_sess_cache;
+static unsigned long tls_handshakes_full, tls_handshakes_resumed;
+#ifdef LDAP_R_COMPILE
+static ldap_pvt_thread_mutex_t tls_sess_mutex;
+#endif
+
+static void
+tls_sess_free( tls_sess *ts )
+{
+	ldap_pvt_tls_ctx_free( ts->ts_ctx );
+	LDAP_FREE( ts->ts_data.bv_val );
+	LDAP_FREE( ts );
+}
+
+/* unlink the entry for ctx and key, if any; caller holds the mutex */
+static tls_sess *
+tls_sess_unlink( tls_ctx *ctx, const char *key )
+{
+	tls_sess **prev, *ts;
+
+	for ( prev = &tls_sess_cache; (ts = *prev); prev = &ts->ts_next ) {
+		if ( ts->ts_ctx == ctx && !strcmp( ts->ts_key, key )) {
+			*prev = ts->ts_next;
+			return ts;
+		}
+	}
+	return NULL;
+}
+
+void
+ldap_int_tls_session_store( tls_ctx *ctx, const char *key, struct berval *data )
+{
+	tls_sess *ts, *old, **prev;
+	int n;
+
+	ts = LDAP_MALLOC( sizeof( tls_sess ) + strlen( key ) + 1 );
+	if ( ts == NULL ) return;
+	ts->ts_data.bv_val = LDAP_MALLOC( data->bv_len );
+	if ( ts->ts_data.bv_val == NULL ) {
+		LDAP_FREE( ts );
+		return;
+	}
+	ts->ts_data.bv_len = data->bv_len;
+	AC_MEMCPY( ts->ts_data.bv_val, data->bv_val, data->bv_len );
+	ts->ts_key = (char *)(ts+1);
+	strcpy( ts->ts_key, key );
+	ts->ts_ctx = ctx;
+	tls_ctx_ref( ctx );
+
+	LDAP_MUTEX_LOCK( &tls_sess_mutex );
+	old = tls_sess_unlink( ctx, key );
+	ts->ts_next = tls_sess_cache;
+	tls_sess_cache = ts;
+	if ( !old ) {
+		/* drop the oldest if there are too many */
+		for ( n = 1, prev = &tls_sess_cache; (*prev)->ts_next;
+				prev = &(*prev)->ts_next )
+			n++;
+		if ( n > TLS_SESS_CACHE_MAX ) {
+			old = *prev;
+			*prev = NULL;
+		}
+	}
+	LDAP_MUTEX_UNLOCK( &tls_sess_mutex );
+
+	if ( old )
+		tls_sess_free( old );
+}
+
+/* copy the cached session for ctx and key into data */
+static int
+tls_sess_get( tls_ctx *ctx, const char *key, struct berval *data )
+{
+	tls_sess *ts;
+	int rc = -1;
+
+	LDAP_MUTEX_LOCK( &tls_sess_mutex );
+	for ( ts = tls_sess_cache; ts; ts = ts->ts_next ) {
+		if ( ts->ts_ctx == ctx && !strcmp( ts->ts_key, key )) {
+			data->bv_val = LDAP_MALLOC( ts->ts_data.bv_len );
+			if ( data->bv_val ) {
+				data->bv_len = ts->ts_data.bv_len;
+				AC_MEMCPY( data->bv_val, ts->ts_data.bv_val, data->bv_len );
+				rc = 0;
+			}
+			break;
+		}
+	}
+	LDAP_MUTEX_UNLOCK( &tls_sess_mutex );
+	return rc;
+}
+
+static void
+tls_sess_drop( tls_ctx *ctx, const char *key )
+{
+	tls_sess *ts;
+
+	LDAP_MUTEX_LOCK( &tls_sess_mutex );
+	ts = tls_sess_unlink( ctx, key );
+	LDAP_MUTEX_UNLOCK( &tls_sess_mutex );
+	if ( ts )
+		tls_sess_free( ts );
+}
+
+static void
+tls_sess_flush( void )
+{
+	tls_sess *ts;
+
+	/* nothing was ever stored if TLS was never initialized */
+	if ( tls_sess_cache == NULL )
+		return;
+
+	LDAP_MUTEX_LOCK( &tls_sess_mutex );
+	while (( ts = tls_sess_cache )) {
+		tls_sess_cache = ts->ts_next;
+		tls_sess_free( ts );
+	}
+	LDAP_MUTEX_UNLOCK( &tls_sess_mutex );
+}
+
 void
 ldap_int_tls_destroy( struct ldapoptions *lo )
 {
@@ -160,6 +298,7 @@ ldap_pvt_tls_destroy( void )
 	struct ldapoptions *lo = LDAP_INT_GLOBAL_OPT();   
 
 	ldap_int_tls_destroy( lo );
+	tls_sess_flush();
 
 	tls_imp->ti_tls_destroy();
 }
@@ -176,6 +315,7 @@ tls_init(tls_impl *impl )
 	if ( !tls_initialized++ ) {
 #ifdef LDAP_R_COMPILE
 		ldap_pvt_thread_mutex_init( &tls_def_ctx_mutex );
+		ldap_pvt_thread_mutex_init( &tls_sess_mutex );
 #endif
 	}
 
@@ -341,19 +481,31 @@ update_flags( Sockbuf *sb, tls_session * ssl, int rc )
  */
 
 static int
-ldap_int_tls_connect( LDAP *ld, LDAPConn *conn, const char *host )
+ldap_int_tls_connect( LDAP *ld, LDAPConn *conn, const char *host, int port )
 {
 	Sockbuf *sb = conn->lconn_sb;
 	int	err;
 	tls_session	*ssl = NULL;
+	tls_ctx *ctx = NULL;
+	char key[MAXHOSTNAMELEN + sizeof(":65535")];
+
+	/* only connections made for a known server are cached */
+	key[0] = '\0';
+	if ( port && ld->ld_options.ldo_tls_sesscache &&
+		tls_imp->ti_session_resume &&
+		snprintf( key, sizeof( key ), "%s:%d", host, port ) >= sizeof( key ))
+		key[0] = '\0';
+
+	ctx = ld->ld_options.ldo_tls_ctx;
 
 	if ( HAS_TLS( sb )) {
 		ber_sockbuf_ctrl( sb, LBER_SB_OPT_GET_SSL, (void *)&ssl );
+		/* called again to finish the handshake: the handle was made
+		 * from the default context if ld had none, as below */
+		if ( ctx == NULL )
+			ctx = LDAP_INT_GLOBAL_OPT()->ldo_tls_ctx;
 	} else {
 		struct ldapoptions *lo;
-		tls_ctx *ctx;
-
-		ctx = ld->ld_options.ldo_tls_ctx;
 
 		ssl = alloc_handle( ctx, 0 );
 
@@ -378,6 +530,17 @@ ldap_int_tls_connect( LDAP *ld, LDAPConn *conn, const char *host )
 		if ( lo && lo->ldo_tls_connect_cb && lo->ldo_tls_connect_cb !=
 			ld->ld_options.ldo_tls_connect_cb )
 			lo->ldo_tls_connect_cb( ld, ssl, ctx, lo->ldo_tls_connect_arg );
+
+		if ( key[0] ) {
+			struct berval data = BER_BVNULL;
+
+			/* offer the last session with this server, and have
+			 * the new one stored under the same key */
+			(void)tls_sess_get( ctx, key, &data );
+			tls_imp->ti_session_resume( ssl, key,
+				data.bv_val ? &data : NULL );
+			LDAP_FREE( data.bv_val );
+		}
 	}
 
 	err = tls_imp->ti_session_connect( ld, ssl );
@@ -387,6 +550,18 @@ ldap_int_tls_connect( LDAP *ld, LDAPConn *conn, const char *host )
 #endif
 
 	if ( err == 0 ) {
+		int resumed = tls_imp->ti_session_resumed &&
+			tls_imp->ti_session_resumed( ssl );
+
+		LDAP_MUTEX_LOCK( &tls_sess_mutex );
+		if ( resumed )
+			tls_handshakes_resumed++;
+		else
+			tls_handshakes_full++;
+		LDAP_MUTEX_UNLOCK( &tls_sess_mutex );
+		Debug1( LDAP_DEBUG_TRACE, "TLS: %s handshake\n",
+			resumed ? "resumed" : "full" );
+
 		err = ldap_pvt_tls_check_hostname( ld, ssl, host );
 	}
 
@@ -411,6 +586,10 @@ ldap_int_tls_connect( LDAP *ld, LDAPConn *conn, const char *host )
 		Debug1( LDAP_DEBUG_ANY,"TLS: can't connect: %s.\n",
 			ld->ld_error ? ld->ld_error : "" );
 
+		/* don't offer the same session again */
+		if ( key[0] )
+			tls_sess_drop( ctx, key );
+
 		ber_sockbuf_remove_io( sb, tls_imp->ti_sbio,
 			LBER_SBIOD_LEVEL_TRANSPORT );
 #ifdef LDAP_DEBUG
@@ -427,7 +606,7 @@ int
 ldap_pvt_tls_connect( LDAP *ld, Sockbuf *sb, const char *host )
 {
 	LDAPConn conn = { .lconn_sb = sb };
-	return ldap_int_tls_connect( ld, &conn, host );
+	return ldap_int_tls_connect( ld, &conn, host, 0 );
 }
 
 /*
@@ -611,6 +790,23 @@ ldap_pvt_tls_config( LDAP *ld, int option, const char *arg )
 		}
 		return ldap_pvt_tls_set_option( ld, option, &i );
 		}
+	case LDAP_OPT_X_TLS_SESSION_CACHE:
+		i = -1;
+		if ( ( strcasecmp( arg, "on" ) == 0 ) ||
+			( strcasecmp( arg, "yes" ) == 0) ||
+			( strcasecmp( arg, "true" ) == 0 ) )
+		{
+			i = 1;
+		} else if ( ( strcasecmp( arg, "off" ) == 0 ) ||
+			( strcasecmp( arg, "no" ) == 0 ) ||
+			( strcasecmp( arg, "false" ) == 0 ) )
+		{
+			i = 0;
+		}
+		if (i >= 0) {
+			return ldap_pvt_tls_set_option( ld, option, &i );
+		}
+		return -1;
 #ifdef HAVE_OPENSSL_CRL
 	case LDAP_OPT_X_TLS_CRLCHECK:	/* OpenSSL only */
 		i = -1;
@@ -640,6 +836,14 @@ ldap_pvt_tls_get_option( LDAP *ld, int option, void *arg )
 		return 0;
 	}
 
+	/* process-wide counters */
+	if( option == LDAP_OPT_X_TLS_FULL_HANDSHAKES ||
+		option == LDAP_OPT_X_TLS_RESUMED_HANDSHAKES ) {
+		*(unsigned long *)arg = option == LDAP_OPT_X_TLS_FULL_HANDSHAKES ?
+			tls_handshakes_full : tls_handshakes_resumed;
+		return 0;
+	}
+
 	if( ld != NULL ) {
 		assert( LDAP_VALID( ld ) );
 
@@ -698,6 +902,9 @@ ldap_pvt_tls_get_option( LDAP *ld, int option, void *arg )
 	case LDAP_OPT_X_TLS_REQUIRE_CERT:
 		*(int *)arg = lo->ldo_tls_require_cert;
 		break;
+	case LDAP_OPT_X_TLS_SESSION_CACHE:
+		*(int *)arg = lo->ldo_tls_sesscache;
+		break;
 #ifdef HAVE_OPENSSL_CRL
 	case LDAP_OPT_X_TLS_CRLCHECK:	/* OpenSSL only */
 		*(int *)arg = lo->ldo_tls_crlcheck;
@@ -904,6 +1111,10 @@ ldap_pvt_tls_set_option( LDAP *ld, int option, void *arg )
 			return 0;
 		}
 		return -1;
+	case LDAP_OPT_X_TLS_SESSION_CACHE:
+		if ( !arg ) return -1;
+		lo->ldo_tls_sesscache = *(int *)arg ? 1 : 0;
+		return 0;
 #ifdef HAVE_OPENSSL_CRL
 	case LDAP_OPT_X_TLS_CRLCHECK:	/* OpenSSL only */
 		if ( !arg ) return -1;
@@ -1050,7 +1261,7 @@ ldap_int_tls_start ( LDAP *ld, LDAPConn *conn, LDAPURLDesc *srv )
 	Sockbuf *sb;
 	char *host;
 	void *ssl;
-	int ret, async;
+	int ret, async, port;
 #ifdef LDAP_USE_NON_BLOCKING_TLS
 	struct timeval start_time_tv, tv, tv0;
 	ber_socket_t	sd = AC_SOCKET_ERROR;
@@ -1060,11 +1271,12 @@ ldap_int_tls_start ( LDAP *ld, LDAPConn *conn, LDAPURLDesc *srv )
 		return LDAP_PARAM_ERROR;
 
 	sb = conn->lconn_sb;
-	if( srv ) {
-		host = srv->lud_host;
-	} else {
- 		host = conn->lconn_server->lud_host;
+	if( srv == NULL ) {
+		srv = conn->lconn_server;
 	}
+	host = srv->lud_host;
+	port = ldap_pvt_url_scheme_port( srv->lud_scheme, srv->lud_port );
+	if ( port < 0 ) port = 0;
 
 	/* avoid NULL host */
 	if( host == NULL ) {
@@ -1097,7 +1309,7 @@ ldap_int_tls_start ( LDAP *ld, LDAPConn *conn, LDAPURLDesc *srv )
 #endif /* LDAP_USE_NON_BLOCKING_TLS */
 
 	ld->ld_errno = LDAP_SUCCESS;
-	ret = ldap_int_tls_connect( ld, conn, host );
+	ret = ldap_int_tls_connect( ld, conn, host, port );
 
 #ifdef LDAP_USE_NON_BLOCKING_TLS
 	while ( ret > 0 ) { /* this should only happen for non-blocking io */
@@ -1120,7 +1332,7 @@ ldap_int_tls_start ( LDAP *ld, LDAPConn *conn, LDAPURLDesc *srv )
 			if ( !async ) {
 				ber_sockbuf_ctrl( sb, LBER_SB_OPT_SET_NONBLOCK, (void*)1 );
 			}
-			ret = ldap_int_tls_connect( ld, conn, host );
+			ret = ldap_int_tls_connect( ld, conn, host, port );
 			if ( ret > 0 ) { /* need to call tls_connect once more */
 				struct timeval curr_time_tv, delta_tv;
 
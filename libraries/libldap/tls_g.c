@@ -1066,6 +1066,8 @@ tls_impl ldap_int_tls_impl = {
 	tlsg_session_cipher,
 	tlsg_session_peercert,
 	tlsg_session_pinning,
+	NULL,
+	NULL,
 
 	&tlsg_sbio,
 
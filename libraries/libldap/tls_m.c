@@ -3381,6 +3381,8 @@ tls_impl ldap_int_tls_impl = {
 	tlsm_session_cipher,
 	tlsm_session_peercert,
 	NULL,
+	NULL,
+	NULL,
 
 	&tlsm_sbio,
 
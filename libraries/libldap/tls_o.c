@@ -62,12 +62,16 @@ static BIO_METHOD * tlso_bio_setup( void );
 
 static int  tlso_opt_trace = 1;
 
+/* ex_data index for the session cache key of a client SSL */
+static int tlso_sess_key_idx = -1;
+
 static void tlso_report_error( void );
 
 static void tlso_info_cb( const SSL *ssl, int where, int ret );
 static int tlso_verify_cb( int ok, X509_STORE_CTX *ctx );
 static int tlso_verify_ok( int ok, X509_STORE_CTX *ctx );
 static int tlso_seed_PRNG( const char *randfile );
+static int tlso_session_new_cb( SSL *ssl, SSL_SESSION *sess );
 #if OPENSSL_VERSION_NUMBER < 0x10100000
 /*
  * OpenSSL 1.1 API and later has new locking code
@@ -198,6 +202,13 @@ tlso_ca_list( char * bundle, char * dir, X509 *cert )
 	return ca_list;
 }
 
+static void
+tlso_sess_key_free( void *parent, void *ptr, CRYPTO_EX_DATA *ad,
+	int idx, long argl, void *argp )
+{
+	LDAP_FREE( ptr );
+}
+
 /*
  * Initialize TLS subsystem. Should be called only once.
  */
@@ -229,6 +240,9 @@ tlso_init( void )
 
 	tlso_bio_method = tlso_bio_setup();
 
+	tlso_sess_key_idx = SSL_get_ex_new_index( 0, NULL, NULL, NULL,
+		tlso_sess_key_free );
+
 	return 0;
 }
 
@@ -293,6 +307,11 @@ tlso_ctx_init( struct ldapoptions *lo, struct ldaptls *lt, int is_server )
 	if ( is_server ) {
 		SSL_CTX_set_session_id_context( ctx,
 			(const unsigned char *) "OpenLDAP", sizeof("OpenLDAP")-1 );
+	} else {
+		/* client sessions are kept by libldap, see tls2.c */
+		SSL_CTX_set_session_cache_mode( ctx,
+			SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE );
+		SSL_CTX_sess_set_new_cb( ctx, tlso_session_new_cb );
 	}
 
 #ifdef SSL_OP_NO_TLSv1
@@ -970,6 +989,72 @@ done:
 	return rc;
 }
 
+/*
+ * A client session was set up or a session ticket received: serialize
+ * it into the libldap session cache, under the key the connection was
+ * started with.
+ */
+static int
+tlso_session_new_cb( SSL *ssl, SSL_SESSION *sess )
+{
+	char *key = SSL_get_ex_data( ssl, tlso_sess_key_idx );
+	struct berval data;
+	unsigned char *ptr;
+	int len;
+
+	if ( key == NULL )
+		return 0;
+#if OPENSSL_VERSION_NUMBER >= 0x10101000
+	if ( !SSL_SESSION_is_resumable( sess ))
+		return 0;
+#endif
+
+	len = i2d_SSL_SESSION( sess, NULL );
+	if ( len <= 0 )
+		return 0;
+	data.bv_val = LDAP_MALLOC( len );
+	if ( !data.bv_val )
+		return 0;
+	ptr = (unsigned char *)data.bv_val;
+	data.bv_len = i2d_SSL_SESSION( sess, &ptr );
+	ldap_int_tls_session_store( (tls_ctx *)SSL_get_SSL_CTX( ssl ), key, &data );
+	LDAP_FREE( data.bv_val );
+
+	/* no reference to sess was kept */
+	return 0;
+}
+
+static int
+tlso_session_resume( tls_session *sess, const char *key, struct berval *data )
+{
+	tlso_session *s = (tlso_session *)sess;
+	char *k;
+
+	k = LDAP_STRDUP( key );
+	if ( !k || !SSL_set_ex_data( s, tlso_sess_key_idx, k )) {
+		LDAP_FREE( k );
+		return -1;
+	}
+
+	if ( data ) {
+		const unsigned char *ptr = (const unsigned char *)data->bv_val;
+		SSL_SESSION *ss = d2i_SSL_SESSION( NULL, &ptr, data->bv_len );
+
+		if ( ss ) {
+			SSL_set_session( s, ss );
+			SSL_SESSION_free( ss );
+		}
+	}
+	return 0;
+}
+
+static int
+tlso_session_resumed( tls_session *sess )
+{
+	tlso_session *s = (tlso_session *)sess;
+	return SSL_session_reused( s );
+}
+
 /*
  * TLS support for LBER Sockbufs
  */
@@ -1490,6 +1575,8 @@ tls_impl ldap_int_tls_impl = {
 	tlso_session_cipher,
 	tlso_session_peercert,
 	tlso_session_pinning,
+	tlso_session_resume,
+	tlso_session_resumed,
 
 	&tlso_sbio,
 
@@ -0,0 +1,198 @@
+/* ucbench.c - time UTF-8 normalization and matching */
+/* $OpenLDAP$ */
+/* This work is part of OpenLDAP Software <http://www.openldap.org/>.
+ *
+ * Copyright 1998-2020 The OpenLDAP Foundation.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted only as authorized by the OpenLDAP
+ * Public License.
+ *
+ * A copy of this license is available in the file LICENSE in the
+ * top-level directory of the distribution or, alternatively, at
+ * <http://www.OpenLDAP.org/license.html>.
+ */
+
+/*
+ * Usage: ucbench [-n iterations] [corpus ...]
+ *
+ * Runs UTF8bvnormalize() and UTF8bvnormcmp() over a few corpora of
+ * typical attribute values and reports the time per call.
+ */
+
+#include "portable.h"
+
+#include <stdio.h>
+
+#include <ac/stdlib.h>
+#include <ac/string.h>
+#include <ac/time.h>
+#include <ac/unistd.h>
+
+#include <lber.h>
+#include <ldap_utf8.h>
+#include <ldap_pvt_uc.h>
+
+static struct corpus {
+	const char *name;
+	const char *values[6];
+} corpora[] = {
+	{ "ascii", {
+		"cn=John Smith,ou=People,dc=example,dc=com",
+		"Barbara Jensen",
+		"jsmith@EXAMPLE.COM",
+		"+1 313 555 1212",
+		"The quick brown fox jumps over the lazy dog",
+		NULL } },
+	{ "latin", {
+		"J\xc3\xbcrgen M\xc3\xbcller-L\xc3\xbc" "denscheid",
+		"Fran\xc3\xa7ois Ch\xc3\xa2teauneuf",
+		"\xc3\x85sa \xc3\x98stergaard",
+		"Stra\xc3\x9f" "e der Einheit 12",
+		"Jos\xc3\xa9 Mar\xc3\xad" "a Pe\xc3\xb1" "a",
+		NULL } },
+	{ "cyrillic", {
+		"\xd0\x98\xd0\xb2\xd0\xb0\xd0\xbd \xd0\x9f\xd0\xb5\xd1\x82\xd1\x80"
+			"\xd0\xbe\xd0\xb2",
+		"\xd0\x9c\xd0\xbe\xd1\x81\xd0\xba\xd0\xb2\xd0\xb0, "
+			"\xd1\x83\xd0\xbb. \xd0\x9b\xd0\xb5\xd0\xbd\xd0\xb8\xd0\xbd\xd0\xb0 1",
+		"\xce\x91\xce\xbb\xce\xad\xce\xbe\xce\xb1\xce\xbd\xce\xb4\xcf\x81"
+			"\xce\xbf\xcf\x82",
+		NULL } },
+	{ "cjk", {
+		"\xe5\xb1\xb1\xe7\x94\xb0\xe5\xa4\xaa\xe9\x83\x8e",
+		"\xe6\x9d\xb1\xe4\xba\xac\xe9\x83\xbd\xe5\x8d\x83\xe4\xbb\xa3\xe7\x94"
+			"\xb0\xe5\x8c\xba",
+		"\xe7\x8e\x8b\xe5\xb0\x8f\xe6\x98\x8e",
+		"\xed\x99\x8d\xea\xb8\xb8\xeb\x8f\x99",
+		NULL } },
+	{ "decomposed", {
+		"Jo\x73\x65\xcc\x81 Mari\xcc\x81" "a Pen\xcc\x83" "a",
+		"Fran\x63\xcc\xa7ois Cha\xcc\x82teauneuf",
+		"\xe1\x84\x92\xe1\x85\xa9\xe1\x86\xbc\xe1\x84\x80\xe1\x85\xb5\xe1\x86"
+			"\xaf",
+		"\xef\xac\x81nance \xe2\x84\xab",
+		NULL } },
+	{ NULL }
+};
+
+static double
+now( void )
+{
+	struct timeval tv;
+
+	gettimeofday( &tv, NULL );
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static void
+report( const char *corpus, const char *what, int calls, ber_len_t bytes,
+	double secs )
+{
+	printf( "%-12s %-20s %10.1f ns/call %8.1f MB/s\n",
+		corpus, what, secs * 1e9 / calls, bytes / secs / 1e6 );
+}
+
+static void
+bench( struct corpus *c, int iterations )
+{
+	struct berval bv, out, *vals;
+	ber_len_t bytes = 0;
+	double start;
+	int i, j, n, res = 0;
+
+	for ( n = 0; c->values[n]; n++ )
+		/* empty */ ;
+
+	vals = ber_memcalloc( n, sizeof(struct berval) );
+	for ( i = 0; i < n; i++ ) {
+		ber_str2bv( c->values[i], 0, 0, &bv );
+		bytes += bv.bv_len;
+		/* normcmp is given values in normal form, as slapd does */
+		UTF8bvnormalize( &bv, &vals[i], 0, NULL );
+	}
+
+	start = now();
+	for ( j = 0; j < iterations; j++ ) {
+		for ( i = 0; i < n; i++ ) {
+			ber_str2bv( c->values[i], 0, 0, &bv );
+			UTF8bvnormalize( &bv, &out, 0, NULL );
+			ber_memfree( out.bv_val );
+		}
+	}
+	report( c->name, "normalize", n * iterations, bytes * iterations,
+		now() - start );
+
+	start = now();
+	for ( j = 0; j < iterations; j++ ) {
+		for ( i = 0; i < n; i++ ) {
+			ber_str2bv( c->values[i], 0, 0, &bv );
+			UTF8bvnormalize( &bv, &out, LDAP_UTF8_CASEFOLD, NULL );
+			ber_memfree( out.bv_val );
+		}
+	}
+	report( c->name, "normalize casefold", n * iterations, bytes * iterations,
+		now() - start );
+
+	start = now();
+	for ( j = 0; j < iterations; j++ ) {
+		for ( i = 0; i < n; i++ ) {
+			res += UTF8bvnormcmp( &vals[i], &vals[i], 0, NULL );
+		}
+	}
+	report( c->name, "normcmp", n * iterations, bytes * iterations,
+		now() - start );
+
+	start = now();
+	for ( j = 0; j < iterations; j++ ) {
+		for ( i = 0; i < n; i++ ) {
+			res += UTF8bvnormcmp( &vals[i], &vals[i], LDAP_UTF8_CASEFOLD,
+				NULL );
+		}
+	}
+	report( c->name, "normcmp casefold", n * iterations, bytes * iterations,
+		now() - start );
+
+	if ( res != 0 ) {
+		fprintf( stderr, "%s: values do not match themselves\n", c->name );
+	}
+
+	for ( i = 0; i < n; i++ ) {
+		ber_memfree( vals[i].bv_val );
+	}
+	ber_memfree( vals );
+}
+
+int
+main( int argc, char **argv )
+{
+	struct corpus *c;
+	int i, iterations = 100000;
+
+	while ( ( i = getopt( argc, argv, "n:" ) ) != EOF ) {
+		switch ( i ) {
+		case 'n':
+			iterations = atoi( optarg );
+			break;
+		default:
+			fprintf( stderr, "usage: %s [-n iterations] [corpus ...]\n",
+				argv[0] );
+			return EXIT_FAILURE;
+		}
+	}
+
+	for ( c = corpora; c->name; c++ ) {
+		if ( optind < argc ) {
+			for ( i = optind; i < argc; i++ ) {
+				if ( strcmp( argv[i], c->name ) == 0 )
+					break;
+			}
+			if ( i == argc )
+				continue;
+		}
+		bench( c, iterations );
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -617,6 +617,22 @@ uccomp(ac_uint4 node1, ac_uint4 node2, ac_uint4 *comp)
     return 0;
 }
 
+/*
+ * Return nonzero if code appears as the second character of any
+ * composition pair, i.e. if it may combine with the character before it.
+ */
+int
+uccomp_second(ac_uint4 code)
+{
+    ac_uint4 i;
+
+    for (i = 0; i < _uccomp_size; i += 4) {
+        if (_uccomp_data[i+3] == code)
+          return 1;
+    }
+    return 0;
+}
+
 int
 uccomp_hangul(ac_uint4 *str, int len)
 {
@@ -227,6 +227,13 @@ LDAP_LUNICODE_F (ac_uint4) uctotitle LDAP_P((ac_uint4 code));
 LDAP_LUNICODE_F (int) uccomp LDAP_P((ac_uint4 node1, ac_uint4 node2,
 		      ac_uint4 *comp));
 
+/*
+ * This routine determines if code is the second character of any
+ * composition.  If it returns 0, code never combines with a preceding
+ * character.
+ */
+LDAP_LUNICODE_F (int) uccomp_second LDAP_P((ac_uint4 code));
+
 /*
  * Does Hangul composition on the string str with length len, and returns
  * the length of the composed string.
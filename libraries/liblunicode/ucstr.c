@@ -102,16 +102,232 @@ void ucstr2upper(
 	}
 }
 
+/*
+ * Word-at-a-time helpers for the ASCII parts of a string.  Words are
+ * loaded with memcpy() so the strings need not be aligned.
+ */
+typedef unsigned long uc_word_t;
+
+#define UC_ONES		(((uc_word_t) ~0UL) / 0xff)
+#define UC_HIGHS	(UC_ONES * 0x80)
+
+/* return the number of leading ASCII octets of s */
+static int
+ucascii_span( const char *s, int len )
+{
+	int i = 0;
+	uc_word_t w;
+
+	for ( ; i + (int) sizeof(w) <= len; i += sizeof(w) ) {
+		memcpy( &w, s + i, sizeof(w) );
+		if ( w & UC_HIGHS ) {
+			break;
+		}
+	}
+	for ( ; i < len && LDAP_UTF8_ISASCII( s + i ); i++ ) {
+		/* empty */
+	}
+	return i;
+}
+
+/* lowercase the letters of a word of ASCII octets */
+static uc_word_t
+ucascii_lower( uc_word_t w )
+{
+	uc_word_t a = w + UC_ONES * ( 0x80 - 'A' );
+	uc_word_t z = w + UC_ONES * ( 0x80 - 'Z' - 1 );
+
+	return w | ( ( a & ~z & UC_HIGHS ) >> 2 );
+}
+
+/* copy n ASCII octets, lowercasing them if casefold is set */
+static void
+ucascii_copy( char *dst, const char *src, int n, unsigned casefold )
+{
+	int i = 0;
+	uc_word_t w;
+
+	if ( !casefold ) {
+		memcpy( dst, src, n );
+		return;
+	}
+	for ( ; i + (int) sizeof(w) <= n; i += sizeof(w) ) {
+		memcpy( &w, src + i, sizeof(w) );
+		w = ucascii_lower( w );
+		memcpy( dst + i, &w, sizeof(w) );
+	}
+	for ( ; i < n; i++ ) {
+		dst[i] = TOLOWER( src[i] );
+	}
+}
+
+/*
+ * return the length of the common prefix of s1 and s2 made of whole
+ * words of ASCII octets that are equal, ignoring case if casefold is set
+ */
+static int
+ucascii_common( const char *s1, const char *s2, int len, unsigned casefold )
+{
+	int i;
+	uc_word_t w1, w2;
+
+	for ( i = 0; i + (int) sizeof(w1) <= len; i += sizeof(w1) ) {
+		memcpy( &w1, s1 + i, sizeof(w1) );
+		memcpy( &w2, s2 + i, sizeof(w2) );
+		if ( ( w1 | w2 ) & UC_HIGHS ) {
+			break;
+		}
+		if ( casefold ) {
+			w1 = ucascii_lower( w1 );
+			w2 = ucascii_lower( w2 );
+		}
+		if ( w1 != w2 ) {
+			break;
+		}
+	}
+	return i;
+}
+
+/*
+ * A character is stable if any string made only of stable characters
+ * is its own normal form: it has combining class 0, never composes
+ * with the character before it, is not a Hangul jamo, and normalizes
+ * to itself from a decomposition that starts with such a character.
+ * Most characters of most scripts are stable, which lets us skip the
+ * round trip through UCS-4 decomposition and composition.  The answer
+ * is cached for the BMP, along with whether the character is its own
+ * lowercase; racing fills store the same value.
+ */
+#define UC_KNOWN	0x01
+#define UC_STABLE	0x02
+#define UC_LOWER	0x04
+
+static unsigned char ucstable_cache[0x10000];
+
+static int
+ucstable( ac_uint4 c )
+{
+	unsigned char v;
+	ac_uint4 *decomp;
+	int len;
+
+	if ( c > 0xffff ) {
+		return 0;
+	}
+	v = ucstable_cache[c];
+	if ( v == 0 ) {
+		v = UC_KNOWN;
+		if ( uctolower( c ) == c ) {
+			v |= UC_LOWER;
+		}
+		if ( uccombining_class( c ) == 0 && !uccomp_second( c ) &&
+			( c < 0x1100 || c > 0x11ff ) &&
+			uccompatdecomp( &c, 1, &decomp, &len, NULL ) > 0 )
+		{
+			if ( uccombining_class( decomp[0] ) == 0 &&
+				( decomp[0] == c || !uccomp_second( decomp[0] ) ) &&
+				uccanoncomp( decomp, len ) == 1 && decomp[0] == c )
+			{
+				v |= UC_STABLE;
+			}
+			ber_memfree( decomp );
+		}
+		ucstable_cache[c] = v;
+	}
+	return v;
+}
+
+/* lowercase c, given its ucstable() flags */
+#define UC_TOLOWER(c, v)	( ( (v) & UC_LOWER ) ? (c) : uctolower( c ) )
+
+/* make sure out has room for need more octets after outpos */
+static int
+ucout_reserve( char **out, int *outsize, int outpos, int need, void *ctx )
+{
+	char *outtmp;
+
+	if ( *outsize - outpos >= need ) {
+		return 0;
+	}
+	outtmp = (char *) ber_memrealloc_x( *out, outpos + need, ctx );
+	if ( outtmp == NULL ) {
+		return -1;
+	}
+	*out = outtmp;
+	*outsize = outpos + need;
+	return 0;
+}
+
+/*
+ * If the ASCII character at s[i], if any, and the run of non-ASCII
+ * characters following it are all stable, copy them to out and return
+ * the index of the character after the run.  Return -1 if the run has
+ * to be normalized the slow way.
+ */
+static int
+ucstable_run(
+	const char *s,
+	int i,
+	int len,
+	unsigned casefold,
+	char **out,
+	int *outpos,
+	int *outsize,
+	void *ctx )
+{
+	int j, v, clen, pos = *outpos;
+	ac_uint4 c;
+
+	static unsigned char mask[] = {
+		0, 0x7f, 0x1f, 0x0f };
+
+	if ( LDAP_UTF8_ISASCII( s + i ) ) {
+		(*out)[pos++] = casefold ? TOLOWER( s[i] ) : s[i];
+		i++;
+	}
+
+	while ( i < len && !LDAP_UTF8_ISASCII( s + i ) ) {
+		clen = LDAP_UTF8_CHARLEN2( s + i, clen );
+		if ( clen == 0 || clen > 3 || i + clen > len ) {
+			return -1;
+		}
+		c = s[i] & mask[clen];
+		for ( j = 1; j < clen; j++ ) {
+			if ( (s[i + j] & 0xc0) != 0x80 ) {
+				return -1;
+			}
+			c <<= 6;
+			c |= s[i + j] & 0x3f;
+		}
+		v = ucstable( c );
+		if ( casefold && !( v & UC_LOWER ) ) {
+			c = uctolower( c );
+			v = ucstable( c );
+		}
+		if ( !( v & UC_STABLE ) ) {
+			return -1;
+		}
+		if ( ucout_reserve( out, outsize, pos, len - i + 7, ctx ) ) {
+			return -1;
+		}
+		pos += ldap_x_ucs4_to_utf8( c, *out + pos );
+		i += clen;
+	}
+
+	*outpos = pos;
+	return i;
+}
+
 struct berval * UTF8bvnormalize(
 	struct berval *bv,
 	struct berval *newbv,
 	unsigned flags,
 	void *ctx )
 {
-	int i, j, len, clen, outpos, ucsoutlen, outsize, last;
+	int i, j, n, len, clen, outpos, ucsoutlen, outsize;
 	int didnewbv = 0;
-	char *out, *outtmp, *s;
-	ac_uint4 *ucs, *p, *ucsout;
+	char *out, *s;
+	ac_uint4 *ucs = NULL, *p, *ucsout;
 
 	static unsigned char mask[] = {
 		0, 0x7f, 0x1f, 0x0f, 0x07, 0x03, 0x01 };
@@ -136,83 +352,75 @@ struct berval * UTF8bvnormalize(
 		didnewbv = 1;
 	}
 
-	/* Should first check to see if string is already in proper
-	 * normalized form. This is almost as time consuming as
-	 * the normalization though.
-	 */
+	n = ucascii_span( s, len );
+	if ( n == len && !casefold ) {
+		return ber_str2bv_x( s, len, 1, newbv, ctx );
+	}
 
-	/* finish off everything up to character before first non-ascii */
-	if ( LDAP_UTF8_ISASCII( s ) ) {
-		if ( casefold ) {
-			outsize = len + 7;
-			out = (char *) ber_memalloc_x( outsize, ctx );
-			if ( out == NULL ) {
+	outsize = len + 7;
+	out = (char *) ber_memalloc_x( outsize, ctx );
+	if ( out == NULL ) {
 fail:
-				if ( didnewbv )
-					ber_memfree_x( newbv, ctx );
-				return NULL;
-			}
-			outpos = 0;
+		if ( didnewbv )
+			ber_memfree_x( newbv, ctx );
+		return NULL;
+	}
+	outpos = 0;
+	i = 0;
 
-			for ( i = 1; (i < len) && LDAP_UTF8_ISASCII(s + i); i++ ) {
-				out[outpos++] = TOLOWER( s[i-1] );
-			}
-			if ( i == len ) {
-				out[outpos++] = TOLOWER( s[len-1] );
-				out[outpos] = '\0';
-				newbv->bv_val = out;
-				newbv->bv_len = outpos;
-				return newbv;
+	for (;;) {
+		/* s[i] to s[i+n-1] are ascii, s[i+n] is not */
+		if ( i + n == len ) {
+			if ( ucout_reserve( &out, &outsize, outpos, n + 1, ctx ) ) {
+				goto nomem;
 			}
-		} else {
-			for ( i = 1; (i < len) && LDAP_UTF8_ISASCII(s + i); i++ ) {
-				/* empty */
+			ucascii_copy( out + outpos, s + i, n, casefold );
+			outpos += n;
+			break;
+		}
+
+		/* finish off everything up to character before next non-ascii */
+		if ( n > 1 ) {
+			if ( ucout_reserve( &out, &outsize, outpos, len - i + 7, ctx ) ) {
+				goto nomem;
 			}
+			ucascii_copy( out + outpos, s + i, n - 1, casefold );
+			outpos += n - 1;
+			i += n - 1;
+		}
 
+		/* nothing to normalize if the run is stable */
+		j = approx ? -1 : ucstable_run( s, i, len, casefold,
+			&out, &outpos, &outsize, ctx );
+		if ( j >= 0 ) {
+			i = j;
 			if ( i == len ) {
-				return ber_str2bv_x( s, len, 1, newbv, ctx );
-			}
-				
-			outsize = len + 7;
-			out = (char *) ber_memalloc_x( outsize, ctx );
-			if ( out == NULL ) {
-				goto fail;
+				break;
 			}
-			outpos = i - 1;
-			memcpy(out, s, outpos);
+			n = ucascii_span( s + i, len - i );
+			continue;
 		}
-	} else {
-		outsize = len + 7;
-		out = (char *) ber_memalloc_x( outsize, ctx );
-		if ( out == NULL ) {
-			goto fail;
-		}
-		outpos = 0;
-		i = 0;
-	}
 
-	p = ucs = ber_memalloc_x( len * sizeof(*ucs), ctx );
-	if ( ucs == NULL ) {
-		ber_memfree_x(out, ctx);
-		goto fail;
-	}
+		if ( ucs == NULL ) {
+			ucs = ber_memalloc_x( len * sizeof(*ucs), ctx );
+			if ( ucs == NULL ) {
+				goto nomem;
+			}
+		}
+		p = ucs;
 
-	/* convert character before first non-ascii to ucs-4 */
-	if ( i > 0 ) {
-		*p = casefold ? TOLOWER( s[i-1] ) : s[i-1];
-		p++;
-	}
+		/* convert character before first non-ascii to ucs-4 */
+		if ( LDAP_UTF8_ISASCII( s + i ) ) {
+			*p = casefold ? TOLOWER( s[i] ) : s[i];
+			p++;
+			i++;
+		}
 
-	/* s[i] is now first non-ascii character */
-	for (;;) {
-		/* s[i] is non-ascii */
 		/* convert everything up to next ascii to ucs-4 */
 		while ( i < len ) {
 			clen = LDAP_UTF8_CHARLEN2( s + i, clen );
 			if ( clen == 0 ) {
-				ber_memfree_x( ucs, ctx );
-				ber_memfree_x( out, ctx );
-				goto fail;
+				goto inval;
 			}
 			if ( clen == 1 ) {
 				/* ascii */
@@ -222,9 +430,7 @@ fail:
 			i++;
 			for( j = 1; j < clen; j++ ) {
 				if ( (s[i] & 0xc0) != 0x80 ) {
-					ber_memfree_x( ucs, ctx );
-					ber_memfree_x( out, ctx );
-					goto fail;
+					goto inval;
 				}
 				*p <<= 6;
 				*p |= s[i] & 0x3f;
@@ -238,6 +444,10 @@ fail:
 		/* normalize ucs of length p - ucs */
 		uccompatdecomp( ucs, p - ucs, &ucsout, &ucsoutlen, ctx );
 		if ( approx ) {
+			if ( ucout_reserve( &out, &outsize, outpos, ucsoutlen + 1, ctx ) ) {
+				ber_memfree_x( ucsout, ctx );
+				goto nomem;
+			}
 			for ( j = 0; j < ucsoutlen; j++ ) {
 				if ( ucsout[j] < 0x80 ) {
 					out[outpos++] = ucsout[j];
@@ -249,16 +459,11 @@ fail:
 			for ( j = 0; j < ucsoutlen; j++ ) {
 				/* allocate more space if not enough room for
 				   6 bytes and terminator */
-				if ( outsize - outpos < 7 ) {
-					outsize = ucsoutlen - j + outpos + 6;
-					outtmp = (char *) ber_memrealloc_x( out, outsize, ctx );
-					if ( outtmp == NULL ) {
-						ber_memfree_x( ucsout, ctx );
-						ber_memfree_x( ucs, ctx );
-						ber_memfree_x( out, ctx );
-						goto fail;
-					}
-					out = outtmp;
+				if ( ucout_reserve( &out, &outsize, outpos,
+					ucsoutlen - j + 6, ctx ) )
+				{
+					ber_memfree_x( ucsout, ctx );
+					goto nomem;
 				}
 				outpos += ldap_x_ucs4_to_utf8( ucsout[j], &out[outpos] );
 			}
@@ -266,49 +471,102 @@ fail:
 
 		ber_memfree_x( ucsout, ctx );
 		ucsout = NULL;
-		
+
 		if ( i == len ) {
 			break;
 		}
+		n = ucascii_span( s + i, len - i );
+	}
 
-		last = i;
+	if ( ucs != NULL ) {
+		ber_memfree_x( ucs, ctx );
+	}
+	out[outpos] = '\0';
+	newbv->bv_val = out;
+	newbv->bv_len = outpos;
+	return newbv;
+
+inval:
+nomem:
+	if ( ucs != NULL ) {
+		ber_memfree_x( ucs, ctx );
+	}
+	ber_memfree_x( out, ctx );
+	goto fail;
+}
+
+/*
+ * Compare two strings made only of stable characters (or flagged as
+ * already normalized) without normalizing them.  Returns 2 if either
+ * string has to be normalized first.
+ */
+static int
+ucstable_cmp(
+	const char *s1,
+	int l1,
+	const char *s2,
+	int l2,
+	unsigned flags )
+{
+	int i1 = 0, i2 = 0, n1 = 0, n2 = 0, v1 = 0, v2 = 0, res = 0, done = 0;
+	ac_uint4 c1 = 0, c2 = 0;
+
+	unsigned casefold = flags & LDAP_UTF8_CASEFOLD;
+	unsigned norm1 = flags & LDAP_UTF8_ARG1NFC;
+	unsigned norm2 = flags & LDAP_UTF8_ARG2NFC;
 
-		/* Allocate more space in out if necessary */
-		if (len - i >= outsize - outpos) {
-			outsize += 1 + ((len - i) - (outsize - outpos));
-			outtmp = (char *) ber_memrealloc_x(out, outsize, ctx);
-			if (outtmp == NULL) {
-				ber_memfree_x( ucs, ctx );
-				ber_memfree_x( out, ctx );
-				goto fail;
+	while ( i1 < l1 || i2 < l2 ) {
+		if ( i1 < l1 ) {
+			c1 = ldap_x_utf8_to_ucs4( s1 + i1 );
+			if ( c1 == LDAP_UCS4_INVALID ) {
+				return 2;
 			}
-			out = outtmp;
+			v1 = ucstable( c1 );
+			if ( !norm1 && !( v1 & UC_STABLE ) ) {
+				return 2;
+			}
+			i1 += LDAP_UTF8_CHARLEN( s1 + i1 );
+			n1++;
 		}
-
-		/* s[i] is ascii */
-		/* finish off everything up to char before next non-ascii */
-		for ( i++; (i < len) && LDAP_UTF8_ISASCII(s + i); i++ ) {
-			out[outpos++] = casefold ? TOLOWER( s[i-1] ) : s[i-1];
+		if ( i2 < l2 ) {
+			c2 = ldap_x_utf8_to_ucs4( s2 + i2 );
+			if ( c2 == LDAP_UCS4_INVALID ) {
+				return 2;
+			}
+			v2 = ucstable( c2 );
+			if ( !norm2 && !( v2 & UC_STABLE ) ) {
+				return 2;
+			}
+			i2 += LDAP_UTF8_CHARLEN( s2 + i2 );
+			n2++;
 		}
-		if ( i == len ) {
-			out[outpos++] = casefold ? TOLOWER( s[len-1] ) : s[len-1];
-			break;
+		if ( n1 == n2 && !res && !done ) {
+			if ( casefold && c1 != c2 ) {
+				c1 = UC_TOLOWER( c1, v1 );
+				c2 = UC_TOLOWER( c2, v2 );
+			}
+			if ( c1 != c2 ) {
+				res = c1 < c2 ? -1 : +1;
+			} else if ( c1 == 0 ) {
+				done = 1;
+			}
 		}
-
-		/* convert character before next non-ascii to ucs-4 */
-		*ucs = casefold ? TOLOWER( s[i-1] ) : s[i-1];
-		p = ucs + 1;
 	}
 
-	ber_memfree_x( ucs, ctx );
-	out[outpos] = '\0';
-	newbv->bv_val = out;
-	newbv->bv_len = outpos;
-	return newbv;
+	if ( i1 != l1 || i2 != l2 ) {
+		/* truncated character */
+		return 2;
+	}
+	if ( res != 0 ) {
+		return res;
+	}
+	if ( n1 == n2 ) {
+		return 0;
+	}
+	return n1 > n2 ? 1 : -1;
 }
 
 /* compare UTF8-strings, optionally ignore casing */
-/* slow, should be optimized */
 int UTF8bvnormcmp(
 	struct berval *bv1,
 	struct berval *bv2,
@@ -342,6 +600,11 @@ int UTF8bvnormcmp(
 	s2 = bv2->bv_val;
 	done = s1 + len;
 
+	/* skip the common ascii prefix a word at a time */
+	i = ucascii_common( s1, s2, len, casefold );
+	s1 += i;
+	s2 += i;
+
 	while ( (s1 < done) && LDAP_UTF8_ISASCII(s1) && LDAP_UTF8_ISASCII(s2) ) {
 		if (casefold) {
 			char c1 = TOLOWER(*s1);
@@ -387,9 +650,12 @@ int UTF8bvnormcmp(
 		l2 -= i - 1;
 	}
 			
-	/* Should first check to see if strings are already in
-	 * proper normalized form.
-	 */
+	/* Strings made of stable characters are already normalized */
+	res = ucstable_cmp( s1, l1, s2, l2, flags );
+	if ( res != 2 ) {
+		return res;
+	}
+
 	ucs = malloc( ( ( norm1 || l1 > l2 ) ? l1 : l2 ) * sizeof(*ucs) );
 	if ( ucs == NULL ) {
 		return l1 > l2 ? 1 : -1; /* what to do??? */
@@ -60,6 +60,10 @@ const char *style_strings[] = {
 #define ACLBUF_CHUNKSIZE	8192
 static struct berval aclbuf;
 
+/* bumped whenever an ACL is added or removed, for caches of
+ * results that were subject to access control */
+unsigned long slap_acl_gen;
+
 static void		split(char *line, int splitchar, char **left, char **right);
 static void		access_append(Access **l, Access *a);
 static void		access_free( Access *a );
@@ -2306,6 +2310,7 @@ acl_append( AccessControl **l, AccessControl *a, int pos )
 	if ( *l && a )
 		a->acl_next = *l;
 	*l = a;
+	slap_acl_gen++;
 }
 
 static void
@@ -2360,6 +2365,7 @@ acl_free( AccessControl *a )
 	Access *n;
 	AttributeName *an;
 
+	slap_acl_gen++;
 	if ( a->acl_filter ) {
 		filter_free( a->acl_filter );
 	}
@@ -254,6 +254,7 @@ void
 at_delete( AttributeType *at )
 {
 	at->sat_flags |= SLAP_AT_DELETED;
+	dn_cache_flush();
 
 	LDAP_STAILQ_REMOVE(&attr_list, at, AttributeType, sat_next);
 
@@ -582,6 +583,9 @@ at_insert(
 		LDAP_STAILQ_INSERT_TAIL( &attr_list, sat, sat_next );
 	}
 
+	/* DNs using these names may normalize differently now */
+	dn_cache_flush();
+
 	return 0;
 }
 
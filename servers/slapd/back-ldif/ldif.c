@@ -1353,9 +1353,11 @@ ldif_back_bind( Operation *op, SlapReply *rs )
 	}
 
 	/* authentication actually failed */
-	if(slap_passwd_check(op, entry, a, &op->oq_bind.rb_cred,
-			     &rs->sr_text) != 0) {
-		rs->sr_err = LDAP_INVALID_CREDENTIALS;
+	rs->sr_err = slap_passwd_check(op, entry, a, &op->oq_bind.rb_cred,
+			     &rs->sr_text);
+	if(rs->sr_err != 0) {
+		if(rs->sr_err != LDAP_BUSY)
+			rs->sr_err = LDAP_INVALID_CREDENTIALS;
 		return_val = 1;
 		goto return_result;
 	}
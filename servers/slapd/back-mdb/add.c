@@ -381,6 +381,8 @@ mdb_add(Operation *op, SlapReply *rs )
 		}
 	}
 
+	mdb_groupcache_update( moi, moi == &opinfo, &op->ora_e->e_nname, 0 );
+
 	Debug(LDAP_DEBUG_TRACE,
 		LDAP_XSTRING(mdb_add) ": added%s id=%08lx dn=\"%s\"\n",
 		op->o_noop ? " (no-op)" : "",
@@ -384,6 +384,7 @@ fail:
 #endif
 		a->ai_cursor = NULL;
 		a->ai_root = NULL;
+		a->ai_spool = NULL;
 		a->ai_desc = ad;
 		a->ai_dbi = 0;
 		a->ai_multi_hi = UINT_MAX;
@@ -83,12 +83,18 @@ struct mdb_info {
 	int			mi_readers;
 
 	uint32_t	mi_rtxn_size;
+	unsigned	mi_search_threads;	/* helpers for large searches */
+	unsigned	mi_search_helpers;	/* helpers queued or running */
+	ldap_pvt_thread_mutex_t	mi_search_mutex;
 	int			mi_txn_cp;
 	uint32_t	mi_txn_cp_min;
 	uint32_t	mi_txn_cp_kbyte;
 
 	struct re_s		*mi_txn_cp_task;
 	struct re_s		*mi_index_task;
+	ID			mi_index_next;	/* online indexing: next ID to index */
+	ID			mi_index_last;	/* online indexing: last ID at start */
+	unsigned long	mi_index_count;	/* online indexing: entries done */
 
 	mdb_monitor_t	mi_monitor;
 
@@ -132,6 +138,14 @@ typedef struct mdb_op_info {
 #define MOI_READER	0x01
 #define MOI_FREEIT	0x02
 #define MOI_KEEPER	0x04
+#define MOI_GCFLUSH	0x08	/* nested writes, flush the group cache on commit */
+
+/* Which attributes mdb_entry_decode_sel() materializes, by the
+ * index they are stored under; indexes past ms_nads are decoded */
+typedef struct mdb_attrsel {
+	int ms_nads;
+	unsigned char ms_want[1];
+} mdb_attrsel;
 
 LDAP_END_DECL
 
@@ -145,6 +159,7 @@ typedef struct mdb_attrinfo {
 #endif
 	TAvlnode *ai_root;		/* for tools */
 	MDB_cursor *ai_cursor;	/* for tools */
+	void *ai_spool;		/* for tools */
 	int ai_idx;	/* position in AI array */
 	MDB_dbi ai_dbi;
 	unsigned ai_multi_hi;
@@ -181,6 +196,10 @@ typedef struct AttrList {
 #define	ALIGNER	(sizeof(size_t)-1)
 #endif
 
+/* slapadd/slapindex -q -o index-sort=yes */
+#define MDB_TOOL_SORTING	(( slapMode & (SLAP_TOOL_QUICK|SLAP_TOOL_SORTED_INDEX)) \
+	== (SLAP_TOOL_QUICK|SLAP_TOOL_SORTED_INDEX))
+
 typedef struct IndexRbody {
 	AttrInfo *ai;
 	AttrList *attrs;
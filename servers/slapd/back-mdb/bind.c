@@ -115,11 +115,13 @@ mdb_bind( Operation *op, SlapReply *rs )
 			goto done;
 		}
 
-		if ( slap_passwd_check( op, e, a, &op->oq_bind.rb_cred,
-					&rs->sr_text ) != 0 )
+		rs->sr_err = slap_passwd_check( op, e, a, &op->oq_bind.rb_cred,
+					&rs->sr_text );
+		if ( rs->sr_err != 0 )
 		{
 			/* failure; stop front end from sending result */
-			rs->sr_err = LDAP_INVALID_CREDENTIALS;
+			if ( rs->sr_err != LDAP_BUSY )
+				rs->sr_err = LDAP_INVALID_CREDENTIALS;
 			goto done;
 		}
 			
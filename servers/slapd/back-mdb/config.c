@@ -116,6 +116,12 @@ static ConfigTable mdbcfg[] = {
 		"DESC 'Depth of search stack in IDLs' "
 		"EQUALITY integerMatch "
 		"SYNTAX OMsInteger SINGLE-VALUE )", NULL, NULL },
+	{ "searchthreads", "num", 2, 2, 0, ARG_UINT|ARG_OFFSET,
+		(void *)offsetof(struct mdb_info, mi_search_threads),
+		"( OLcfgDbAt:12.7 NAME 'olcDbSearchThreads' "
+		"DESC 'Number of pool threads that may help evaluate a large search' "
+		"EQUALITY integerMatch "
+		"SYNTAX OMsInteger SINGLE-VALUE )", NULL, NULL },
 	{ NULL, NULL, 0, 0, 0, ARG_IGNORED,
 		NULL, NULL, NULL, NULL }
 };
@@ -137,7 +143,7 @@ static ConfigOCs mdbocs[] = {
 		"MAY ( olcDbCheckpoint $ olcDbEnvFlags $ "
 		"olcDbNoSync $ olcDbIndex $ olcDbMaxReaders $ olcDbMaxSize $ "
 		"olcDbMode $ olcDbSearchStack $ olcDbMaxEntrySize $ olcDbRtxnSize $ "
-		"olcDbMultival ) )",
+		"olcDbMultival $ olcDbSearchThreads ) )",
 			Cft_Database, mdbcfg+1 },
 	{ NULL, 0, NULL }
 };
@@ -191,7 +197,18 @@ mdb_checkpoint( void *ctx, void *arg )
 	return NULL;
 }
 
-/* reindex entries on the fly */
+/* reindex entries on the fly.
+ *
+ * Entries are processed in ascending ID order, at most MDB_INDEX_CHUNK
+ * of them per write txn, so that client writes never wait behind more
+ * than one chunk. Between chunks the task honors pool pauses; if more
+ * indexes are configured meanwhile, the scan restarts from the first ID.
+ * Writers maintain ai_newmask for every entry they touch, and searches
+ * keep using ai_indexmask, so a new index is only used once the scan
+ * has completed.
+ */
+#define MDB_INDEX_CHUNK	256
+
 static void *
 mdb_online_index( void *ctx, void *arg )
 {
@@ -208,21 +225,26 @@ mdb_online_index( void *ctx, void *arg )
 	MDB_txn *txn;
 	ID id;
 	Entry *e;
-	int rc, getnext = 1;
-	int i;
+	int rc = 0, n;
+	int i, done = 0;
 
 	connection_fake_init( &conn, &opbuf, ctx );
 	op = &opbuf.ob_op;
 
 	op->o_bd = be;
 
-	id = 1;
 	key.mv_size = sizeof(ID);
 
 	while ( 1 ) {
 		if ( slapd_shutdown )
 			break;
 
+		/* let a pending cn=config change go through, it may
+		 * have added more indexes and reset the scan.
+		 */
+		ldap_pvt_thread_pool_pausecheck( &connection_pool );
+		id = mdb->mi_index_next;
+
 		rc = mdb_txn_begin( mdb->mi_dbenv, NULL, 0, &txn );
 		if ( rc )
 			break;
@@ -231,38 +253,49 @@ mdb_online_index( void *ctx, void *arg )
 			mdb_txn_abort( txn );
 			break;
 		}
-		if ( getnext ) {
-			getnext = 0;
+		if ( mdb->mi_index_last == 0 ) {
+			/* entries added after this point are indexed by their writers */
+			rc = mdb_cursor_get( curs, &key, &data, MDB_LAST );
+			if ( rc == 0 )
+				memcpy( &mdb->mi_index_last, key.mv_data, sizeof( ID ));
+		}
+
+		for ( n = 0; n < MDB_INDEX_CHUNK; n++ ) {
 			key.mv_data = &id;
 			rc = mdb_cursor_get( curs, &key, &data, MDB_SET_RANGE );
-			if ( rc ) {
-				mdb_txn_abort( txn );
-				if ( rc == MDB_NOTFOUND )
-					rc = 0;
+			if ( rc )
 				break;
-			}
 			memcpy( &id, key.mv_data, sizeof( id ));
-		}
 
-		rc = mdb_id2entry( op, curs, id, &e );
-		mdb_cursor_close( curs );
-		if ( rc ) {
-			mdb_txn_abort( txn );
+			rc = mdb_id2entry( op, curs, id, &e );
 			if ( rc == MDB_NOTFOUND ) {
+				/* stub of a missing parent */
+				rc = 0;
 				id++;
-				getnext = 1;
 				continue;
 			}
-			break;
+			if ( rc )
+				break;
+			rc = mdb_index_entry( op, txn, MDB_INDEX_UPDATE_OP, e );
+			mdb_entry_return( op, e );
+			if ( rc )
+				break;
+			id++;
 		}
-		rc = mdb_index_entry( op, txn, MDB_INDEX_UPDATE_OP, e );
-		mdb_entry_return( op, e );
-		if ( rc == 0 ) {
+		mdb_cursor_close( curs );
+		if ( rc == MDB_NOTFOUND ) {
+			/* reached the end of id2entry */
+			rc = mdb_txn_commit( txn );
+			if ( rc == 0 ) {
+				mdb->mi_index_next = id;
+				mdb->mi_index_count += n;
+				done = 1;
+				break;
+			}
+		} else if ( rc == 0 ) {
 			rc = mdb_txn_commit( txn );
-			txn = NULL;
 		} else {
 			mdb_txn_abort( txn );
-			txn = NULL;
 		}
 		if ( rc ) {
 			Debug( LDAP_DEBUG_ANY,
@@ -271,19 +304,34 @@ mdb_online_index( void *ctx, void *arg )
 				be->be_suffix[0].bv_val, mdb_strerror(rc), rc );
 			break;
 		}
-		id++;
-		getnext = 1;
+		mdb->mi_index_next = id;
+		mdb->mi_index_count += n;
+		ldap_pvt_thread_yield();
 	}
 
-	for ( i = 0; i < mdb->mi_nattrs; i++ ) {
-		if ( mdb->mi_attrs[ i ]->ai_indexmask & MDB_INDEX_DELETING
-			|| mdb->mi_attrs[ i ]->ai_newmask == 0 )
-		{
-			continue;
+	if ( done ) {
+		for ( i = 0; i < mdb->mi_nattrs; i++ ) {
+			if ( mdb->mi_attrs[ i ]->ai_indexmask & MDB_INDEX_DELETING
+				|| mdb->mi_attrs[ i ]->ai_newmask == 0 )
+			{
+				continue;
+			}
+			mdb->mi_attrs[ i ]->ai_indexmask = mdb->mi_attrs[ i ]->ai_newmask;
+			mdb->mi_attrs[ i ]->ai_newmask = 0;
 		}
-		mdb->mi_attrs[ i ]->ai_indexmask = mdb->mi_attrs[ i ]->ai_newmask;
-		mdb->mi_attrs[ i ]->ai_newmask = 0;
+		Debug( LDAP_DEBUG_STATS,
+			LDAP_XSTRING(mdb_online_index) ": database %s: "
+			"indexing complete\n",
+			be->be_suffix[0].bv_val );
+	} else {
+		Debug( LDAP_DEBUG_ANY,
+			LDAP_XSTRING(mdb_online_index) ": database %s: "
+			"indexing stopped before ID %lu, the new indexes are "
+			"incomplete and will not be used; run slapindex\n",
+			be->be_suffix[0].bv_val, (unsigned long) mdb->mi_index_next );
 	}
+	mdb->mi_index_next = 0;
+	mdb->mi_index_last = 0;
 
 	ldap_pvt_thread_mutex_lock( &slapd_rq.rq_mutex );
 	ldap_pvt_runqueue_stoptask( &slapd_rq, rtask );
@@ -758,6 +806,9 @@ mdb_cf_gen( ConfigArgs *c )
 		if ( mdb->mi_flags & MDB_IS_OPEN ) {
 			mdb->mi_flags |= MDB_OPEN_INDEX;
 			c->cleanup = mdb_cf_cleanup;
+			/* (re)start the scan from the first entry */
+			mdb->mi_index_next = 1;
+			mdb->mi_index_count = 0;
 			if ( !mdb->mi_index_task ) {
 				/* Start the task as soon as we finish here. Set a long
 				 * interval (10 hours) so that it only gets scheduled once.
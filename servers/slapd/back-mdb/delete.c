@@ -360,6 +360,8 @@ mdb_delete( Operation *op, SlapReply *rs )
 			}
 			parent_is_leaf = 1;
 		}
+		/* not an error, and in a caller's txn nothing overwrites it */
+		rs->sr_err = 0;
 		mdb_entry_return( op, p );
 		p = NULL;
 	}
@@ -389,6 +391,8 @@ mdb_delete( Operation *op, SlapReply *rs )
 		goto return_results;
 	}
 
+	mdb_groupcache_update( moi, moi == &opinfo, &e->e_nname, 0 );
+
 	Debug( LDAP_DEBUG_TRACE,
 		LDAP_XSTRING(mdb_delete) ": deleted%s id=%08lx dn=\"%s\"\n",
 		op->o_noop ? " (no-op)" : "",
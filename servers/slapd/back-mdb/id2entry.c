@@ -809,6 +809,26 @@ ok:
 	return 0;
 }
 
+/* Drop shared ACL group results for a changed entry. Writes made
+ * inside another txn only become visible when that txn commits, so
+ * they are just remembered and the whole cache is flushed then.
+ */
+void
+mdb_groupcache_update(
+	mdb_op_info *moi,
+	int committed,
+	struct berval *ndn,
+	int subtree )
+{
+	if ( !committed ) {
+		moi->moi_flag |= MOI_GCFLUSH;
+	} else if ( moi->moi_flag & MOI_GCFLUSH ) {
+		group_cache_flush();
+	} else {
+		group_cache_invalidate( ndn, subtree );
+	}
+}
+
 #ifdef LDAP_X_TXN
 int mdb_txn( Operation *op, int txnop, OpExtra **ptr )
 {
@@ -828,6 +848,8 @@ int mdb_txn( Operation *op, int txnop, OpExtra **ptr )
 		rc = mdb_txn_commit( moi->moi_txn );
 		if ( rc )
 			mdb->mi_numads = 0;
+		else if ( moi->moi_flag & MOI_GCFLUSH )
+			group_cache_flush();
 		op->o_tmpfree( moi, op->o_tmpmemctx );
 		return rc;
 	case SLAP_TXN_ABORT:
@@ -1010,11 +1032,45 @@ static int mdb_entry_encode(Operation *op, Entry *e, MDB_val *data, Ecount *eh)
  */
 
 int mdb_entry_decode(Operation *op, MDB_txn *txn, MDB_val *data, ID id, Entry **e)
+{
+	return mdb_entry_decode_sel(op, txn, data, id, NULL, e);
+}
+
+/* Build a selection of the attributes that are, or are subtypes of,
+ * one of the NULL-terminated ads, as attrs_find() would look for them.
+ */
+mdb_attrsel *mdb_attrsel_new(Operation *op, AttributeDescription **ads)
+{
+	struct mdb_info *mdb = (struct mdb_info *) op->o_bd->be_private;
+	mdb_attrsel *sel;
+	int i, j, nads = mdb->mi_numads + 1;
+
+	sel = op->o_tmpalloc(sizeof(mdb_attrsel) + nads, op->o_tmpmemctx);
+	sel->ms_nads = nads;
+	sel->ms_want[0] = 0;
+	for (i=1; i<nads; i++) {
+		sel->ms_want[i] = 0;
+		for (j=0; ads[j]; j++) {
+			if (is_ad_subtype(mdb->mi_ads[i], ads[j])) {
+				sel->ms_want[i] = 1;
+				break;
+			}
+		}
+	}
+	return sel;
+}
+
+/* Decode only the attributes in sel, or all of them if sel is NULL.
+ * The values of the others are skipped over without being looked at,
+ * and those stored separately are not read at all.
+ */
+int mdb_entry_decode_sel(Operation *op, MDB_txn *txn, MDB_val *data, ID id,
+	mdb_attrsel *sel, Entry **e)
 {
 	struct mdb_info *mdb = (struct mdb_info *) op->o_bd->be_private;
 	int i, j, nattrs, nvals;
 	int rc;
-	Attribute *a;
+	Attribute *a, *prev = NULL;
 	Entry *x;
 	const char *text;
 	unsigned int *lp = (unsigned int *)data->mv_data;
@@ -1068,6 +1124,17 @@ int mdb_entry_decode(Operation *op, MDB_txn *txn, MDB_val *data, ID id, Entry **
 			a->a_numvals ^= MDB_AT_NVALS;
 			have_nval = 1;
 		}
+		if (sel && i < sel->ms_nads && !sel->ms_want[i]) {
+			/* not wanted, step over its values */
+			if (!multi) {
+				j = a->a_numvals;
+				if (have_nval)
+					j *= 2;
+				for (; j>0; j--)
+					ptr += *lp++ + 1;
+			}
+			continue;
+		}
 		a->a_vals = bptr;
 		if (multi) {
 			if (!mvc) {
@@ -1121,10 +1188,17 @@ int mdb_entry_decode(Operation *op, MDB_txn *txn, MDB_val *data, ID id, Entry **
 				goto leave;
 			}
 		}
-		a->a_next = a+1;
-		a = a->a_next;
+		if (prev)
+			prev->a_next = a;
+		else
+			x->e_attrs = a;
+		prev = a;
+		a++;
 	}
-	a[-1].a_next = NULL;
+	if (prev)
+		prev->a_next = NULL;
+	else
+		x->e_attrs = NULL;
 done:
 	Debug(LDAP_DEBUG_TRACE, "<= mdb_entry_decode\n" );
 	*e = x;
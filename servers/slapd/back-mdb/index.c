@@ -161,6 +161,15 @@ done:
 	return LDAP_SUCCESS;
 }
 
+static unsigned long
+index_count_keys( struct berval *keys )
+{
+	unsigned long n;
+
+	for ( n = 0; keys[n].bv_val; n++ ) ;
+	return n;
+}
+
 static int indexer(
 	Operation *op,
 	MDB_txn *txn,
@@ -176,10 +185,18 @@ static int indexer(
 	struct berval *keys;
 	MDB_cursor *mc = ai->ai_cursor;
 	mdb_idl_keyfunc *keyfunc;
+	unsigned long nkeys = 0;
 	char *err;
 
 	assert( mask != 0 );
 
+	if ( opid == SLAP_INDEX_ADD_OP && MDB_TOOL_SORTING ) {
+		/* keys are only spooled, no cursor needed */
+		keyfunc = mdb_tool_sort_add;
+		mc = mdb_tool_sort_spool( op, ai );
+		goto keys;
+	}
+
 	if ( !mc ) {
 		err = "c_open";
 		rc = mdb_cursor_open( txn, ai->ai_dbi, &mc );
@@ -201,12 +218,14 @@ static int indexer(
 	} else
 		keyfunc = mdb_idl_delete_keys;
 
+keys:
 	if( IS_SLAP_INDEX( mask, SLAP_INDEX_PRESENT ) ) {
 		rc = keyfunc( op->o_bd, mc, presence_key, id );
 		if( rc ) {
 			err = "presence";
 			goto done;
 		}
+		nkeys++;
 	}
 
 	if( IS_SLAP_INDEX( mask, SLAP_INDEX_EQUALITY ) ) {
@@ -219,6 +238,7 @@ static int indexer(
 
 		if( rc == LDAP_SUCCESS && keys != NULL ) {
 			rc = keyfunc( op->o_bd, mc, keys, id );
+			nkeys += index_count_keys( keys );
 			ber_bvarray_free_x( keys, op->o_tmpmemctx );
 			if ( rc ) {
 				err = "equality";
@@ -238,6 +258,7 @@ static int indexer(
 
 		if( rc == LDAP_SUCCESS && keys != NULL ) {
 			rc = keyfunc( op->o_bd, mc, keys, id );
+			nkeys += index_count_keys( keys );
 			ber_bvarray_free_x( keys, op->o_tmpmemctx );
 			if ( rc ) {
 				err = "approx";
@@ -258,6 +279,7 @@ static int indexer(
 
 		if( rc == LDAP_SUCCESS && keys != NULL ) {
 			rc = keyfunc( op->o_bd, mc, keys, id );
+			nkeys += index_count_keys( keys );
 			ber_bvarray_free_x( keys, op->o_tmpmemctx );
 			if( rc ) {
 				err = "substr";
@@ -269,6 +291,8 @@ static int indexer(
 	}
 
 done:
+	if ( slapMode & SLAP_TOOL_MODE )
+		mdb_tool_index_stat( op, ai, nkeys );
 	if ( !(slapMode & SLAP_TOOL_QUICK))
 		mdb_cursor_close( mc );
 	switch( rc ) {
@@ -65,6 +65,7 @@ mdb_db_init( BackendDB *be, ConfigReply *cr )
 	mdb->mi_rtxn_size = DEFAULT_RTXN_SIZE;
 	mdb->mi_multi_hi = UINT_MAX;
 	mdb->mi_multi_lo = UINT_MAX;
+	ldap_pvt_thread_mutex_init( &mdb->mi_search_mutex );
 
 	be->be_private = mdb;
 	be->be_cf_ocs = be->bd_info->bi_cf_ocs+1;
@@ -372,6 +373,7 @@ mdb_db_destroy( BackendDB *be, ConfigReply *cr )
 	if( mdb->mi_dbenv_home ) ch_free( mdb->mi_dbenv_home );
 
 	mdb_attr_index_destroy( mdb );
+	ldap_pvt_thread_mutex_destroy( &mdb->mi_search_mutex );
 
 	ch_free( mdb );
 	be->be_private = NULL;
@@ -409,7 +411,8 @@ mdb_back_initialize(
 		SLAP_BFLAG_INCREMENT |
 		SLAP_BFLAG_SUBENTRIES |
 		SLAP_BFLAG_ALIASES |
-		SLAP_BFLAG_REFERRALS;
+		SLAP_BFLAG_REFERRALS |
+		SLAP_BFLAG_GROUPCACHE;
 
 	bi->bi_controls = controls;
 
@@ -769,6 +769,8 @@ mdb_modify( Operation *op, SlapReply *rs )
 		goto return_results;
 	}
 
+	mdb_groupcache_update( moi, moi == &opinfo, &op->o_req_ndn, 0 );
+
 	Debug( LDAP_DEBUG_TRACE,
 		LDAP_XSTRING(mdb_modify) ": updated%s id=%08lx dn=\"%s\"\n",
 		op->o_noop ? " (no-op)" : "",
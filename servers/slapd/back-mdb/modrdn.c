@@ -559,6 +559,9 @@ mdb_modrdn( Operation	*op, SlapReply *rs )
 		goto return_results;
 	}
 
+	mdb_groupcache_update( moi, moi == &opinfo, &op->o_req_ndn, 1 );
+	mdb_groupcache_update( moi, moi == &opinfo, &new_ndn, 1 );
+
 	Debug(LDAP_DEBUG_TRACE,
 		LDAP_XSTRING(mdb_modrdn)
 		": rdn modified%s id=%08lx dn=\"%s\"\n",
@@ -50,6 +50,9 @@ static AttributeDescription *ad_olmMDBReadersMax,
 
 static AttributeDescription *ad_olmMDBEntries;
 
+static AttributeDescription *ad_olmMDBIndexProgress,
+	*ad_olmMDBIndexEntries;
+
 /*
  * NOTE: there's some confusion in monitor OID arc;
  * by now, let's consider:
@@ -143,6 +146,22 @@ static struct {
 		"NO-USER-MODIFICATION "
 		"USAGE dSAOperation )",
 		&ad_olmMDBEntries },
+
+	{ "( olmMDBAttributes:7 "
+		"NAME ( 'olmMDBIndexProgress' ) "
+		"DESC 'Percentage of entries processed by online indexing' "
+		"SUP monitorCounter "
+		"NO-USER-MODIFICATION "
+		"USAGE dSAOperation )",
+		&ad_olmMDBIndexProgress },
+
+	{ "( olmMDBAttributes:8 "
+		"NAME ( 'olmMDBIndexEntries' ) "
+		"DESC 'Number of entries processed by online indexing' "
+		"SUP monitorCounter "
+		"NO-USER-MODIFICATION "
+		"USAGE dSAOperation )",
+		&ad_olmMDBIndexEntries },
 	{ NULL }
 };
 
@@ -162,6 +181,7 @@ static struct {
 #endif /* MDB_MONITOR_IDX */
 			"$ olmMDBPagesMax $ olmMDBPagesUsed $ olmMDBPagesFree "
 			"$ olmMDBReadersMax $ olmMDBReadersUsed $ olmMDBEntries "
+			"$ olmMDBIndexProgress $ olmMDBIndexEntries "
 			") )",
 		&oc_olmMDBDatabase },
 
@@ -216,6 +236,27 @@ mdb_monitor_update(
 	bv.bv_len = snprintf( buf, sizeof( buf ), "%u", mei.me_numreaders );
 	ber_bvreplace( &a->a_vals[ 0 ], &bv );
 
+	/* 100 when no online indexing is in progress */
+	{
+		ID next = mdb->mi_index_next, last = mdb->mi_index_last;
+		unsigned long pct = 100;
+
+		if ( next && last )
+			pct = next > last ? 99 : (unsigned long)( (double)( next - 1 ) * 100 / last );
+
+		a = attr_find( e->e_attrs, ad_olmMDBIndexProgress );
+		assert( a != NULL );
+		bv.bv_val = buf;
+		bv.bv_len = snprintf( buf, sizeof( buf ), "%lu", pct );
+		ber_bvreplace( &a->a_vals[ 0 ], &bv );
+
+		a = attr_find( e->e_attrs, ad_olmMDBIndexEntries );
+		assert( a != NULL );
+		bv.bv_val = buf;
+		bv.bv_len = snprintf( buf, sizeof( buf ), "%lu", mdb->mi_index_count );
+		ber_bvreplace( &a->a_vals[ 0 ], &bv );
+	}
+
 	rc = mdb_txn_begin( mdb->mi_dbenv, NULL, MDB_RDONLY, &txn );
 	if ( !rc ) {
 		MDB_cursor *cursor;
@@ -436,7 +477,7 @@ mdb_monitor_db_open( BackendDB *be )
 	}
 
 	/* alloc as many as required (plus 1 for objectClass) */
-	a = attrs_alloc( 1 + 7 );
+	a = attrs_alloc( 1 + 9 );
 	if ( a == NULL ) {
 		rc = 1;
 		goto cleanup;
@@ -472,6 +513,14 @@ mdb_monitor_db_open( BackendDB *be )
 		next->a_desc = ad_olmMDBEntries;
 		attr_valadd( next, &bv, NULL, 1 );
 		next = next->a_next;
+
+		next->a_desc = ad_olmMDBIndexProgress;
+		attr_valadd( next, &bv, NULL, 1 );
+		next = next->a_next;
+
+		next->a_desc = ad_olmMDBIndexEntries;
+		attr_valadd( next, &bv, NULL, 1 );
+		next = next->a_next;
 	}
 
 	{
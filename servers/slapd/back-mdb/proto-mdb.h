@@ -216,9 +216,14 @@ BI_entry_get_rw mdb_entry_get;
 BI_op_txn mdb_txn;
 
 int mdb_entry_decode( Operation *op, MDB_txn *txn, MDB_val *data, ID id, Entry **e );
+int mdb_entry_decode_sel( Operation *op, MDB_txn *txn, MDB_val *data, ID id,
+	mdb_attrsel *sel, Entry **e );
+mdb_attrsel *mdb_attrsel_new( Operation *op, AttributeDescription **ads );
 
 void mdb_reader_flush( MDB_env *env );
 int mdb_opinfo_get( Operation *op, struct mdb_info *mdb, int rdonly, mdb_op_info **moi );
+void mdb_groupcache_update( mdb_op_info *moi, int committed,
+	struct berval *ndn, int subtree );
 
 int mdb_mval_put(Operation *op, MDB_cursor *mc, ID id, Attribute *a);
 int mdb_mval_del(Operation *op, MDB_cursor *mc, ID id, Attribute *a);
@@ -405,6 +410,9 @@ extern BI_tool_entry_modify		mdb_tool_entry_modify;
 extern BI_tool_entry_delete		mdb_tool_entry_delete;
 
 extern mdb_idl_keyfunc mdb_tool_idl_add;
+extern mdb_idl_keyfunc mdb_tool_sort_add;
+void *mdb_tool_sort_spool( Operation *op, AttrInfo *ai );
+void mdb_tool_index_stat( Operation *op, AttrInfo *ai, unsigned long nkeys );
 
 LDAP_END_DECL
 
@@ -416,6 +416,605 @@ mdb_waitfixup( Operation *op, ww_ctx *ww, MDB_cursor *mci, MDB_cursor *mcd, IdSc
 	return rc;
 }
 
+#define SEARCH_MAXADS	32
+
+typedef struct search_ads {
+	int sa_n;
+	AttributeDescription *sa_ads[SEARCH_MAXADS+1];
+} search_ads;
+
+static int
+search_ads_add( search_ads *sa, AttributeDescription *ad )
+{
+	int i;
+
+	for ( i = 0; i < sa->sa_n; i++ ) {
+		if ( sa->sa_ads[i] == ad )
+			return 0;
+	}
+	if ( sa->sa_n == SEARCH_MAXADS )
+		return -1;
+	sa->sa_ads[sa->sa_n++] = ad;
+	sa->sa_ads[sa->sa_n] = NULL;
+	return 0;
+}
+
+/* Note the attributes f tests; -1 if it may test any of them */
+static int
+search_filter_ads( search_ads *sa, Filter *f )
+{
+	if ( f->f_choice & SLAPD_FILTER_UNDEFINED )
+		return 0;
+
+	switch ( f->f_choice ) {
+	case SLAPD_FILTER_COMPUTED:
+		return 0;
+	case LDAP_FILTER_AND:
+	case LDAP_FILTER_OR:
+		for ( f = f->f_list; f; f = f->f_next ) {
+			if ( search_filter_ads( sa, f ))
+				return -1;
+		}
+		return 0;
+	case LDAP_FILTER_NOT:
+		return search_filter_ads( sa, f->f_not );
+	case LDAP_FILTER_EQUALITY:
+	case LDAP_FILTER_GE:
+	case LDAP_FILTER_LE:
+	case LDAP_FILTER_APPROX:
+#ifdef LDAP_COMP_MATCH
+		if ( f->f_ava->aa_cf )
+			return -1;
+#endif
+		return search_ads_add( sa, f->f_av_desc );
+	case LDAP_FILTER_SUBSTRINGS:
+		return search_ads_add( sa, f->f_sub_desc );
+	case LDAP_FILTER_PRESENT:
+		return search_ads_add( sa, f->f_desc );
+	case LDAP_FILTER_EXT:
+		if ( !f->f_mr_desc )
+			return -1;
+		return search_ads_add( sa, f->f_mr_desc );
+	}
+	return -1;
+}
+
+/* Note the attributes of the entry itself acl may look at */
+static int
+search_acl_ads( search_ads *sa, AccessControl *acl )
+{
+	Access *b;
+
+	for ( ; acl; acl = acl->acl_next ) {
+		if ( acl->acl_filter &&
+			search_filter_ads( sa, acl->acl_filter ))
+			return -1;
+		for ( b = acl->acl_access; b; b = b->a_next ) {
+			if ( !BER_BVISEMPTY( &b->a_set_pat ))
+				return -1;
+#ifdef SLAP_DYNACL
+			if ( b->a_dynacl )
+				return -1;
+#endif
+			if (( b->a_dn_at && search_ads_add( sa, b->a_dn_at )) ||
+				( b->a_realdn_at &&
+					search_ads_add( sa, b->a_realdn_at )) ||
+				( b->a_group_at && search_ads_add( sa, b->a_group_at )))
+				return -1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Most candidates of a search are only tested against the filter, so
+ * only the attributes that needs are decoded at first, and the rest
+ * once an entry matches.  Besides those in the filter, the access
+ * controls consulted while testing it may look at attributes of the
+ * entry, and the search loop needs objectClass to tell subentries,
+ * aliases, glue and referrals apart.  Returns NULL if the entry should
+ * be decoded in full.
+ */
+static mdb_attrsel *
+search_attrsel( Operation *op )
+{
+	search_ads sa;
+	Filter *f = op->ors_filter;
+
+	/* everything matches, nothing to save */
+	if ( f->f_choice == LDAP_FILTER_PRESENT &&
+		f->f_desc == slap_schema.si_ad_objectClass )
+		return NULL;
+
+	sa.sa_n = 0;
+	sa.sa_ads[0] = NULL;
+	search_ads_add( &sa, slap_schema.si_ad_objectClass );
+	if ( search_filter_ads( &sa, f ) ||
+		search_acl_ads( &sa, op->o_bd->be_acl ) ||
+		search_acl_ads( &sa, frontendDB->be_acl ) ||
+		( !get_manageDSAit( op ) &&
+			search_ads_add( &sa, slap_schema.si_ad_ref )))
+		return NULL;
+
+	return mdb_attrsel_new( op, sa.sa_ads );
+}
+
+/*
+ * Parallel filter evaluation.
+ *
+ * A search that walks a long candidate list spends most of its time
+ * decoding entries and testing them against the filter.  With
+ * "searchthreads" set, the candidates from the current position on
+ * are cut into chunks of MDB_PSEARCH_CHUNK IDs, and up to that many
+ * pool threads test chunks ahead of the search thread, each in a read
+ * txn of its own.  A helper only works while its txn has the same
+ * txnid as the search's, i.e. sees the same snapshot; otherwise it
+ * leaves the remaining chunks alone.
+ *
+ * The search thread still visits the candidates in ID order and does
+ * the scope checks, referrals, access control and sending itself, so
+ * size and time limits and paged results behave as before.  It just
+ * skips the IDs a finished chunk has ruled out, and processes a chunk
+ * no helper has started as it always did.  Referrals are never ruled
+ * out, as they are returned whether they match or not.
+ *
+ * "searchthreads" also caps the helpers a database has at any one
+ * time, and they only take pool threads nobody else is waiting for:
+ * none is queued while operations are pending or when it would take
+ * the last idle thread, and a running one gives its thread back as
+ * soon as operations start queueing.
+ */
+#define MDB_PSEARCH_CHUNK	1024
+#define MDB_PSEARCH_AHEAD	8	/* chunks per helper beyond the search */
+
+enum {
+	PC_FREE = 0,	/* not started */
+	PC_BUSY,	/* being tested by a helper */
+	PC_DONE,	/* pc_keep is valid */
+	PC_SERIAL	/* left to the search thread */
+};
+
+typedef struct psearch_chunk {
+	ID		pc_first;	/* first and last ID covered */
+	ID		pc_last;
+	ID		pc_pos;		/* position of pc_first in a list IDL */
+	int		pc_state;
+	ID		*pc_keep;	/* IDs the search must look at */
+} psearch_chunk;
+
+typedef struct psearch {
+	ldap_pvt_thread_mutex_t	ps_mutex;
+	ldap_pvt_thread_cond_t	ps_cond;
+	int		ps_refcnt;	/* the search and its queued helpers */
+	int		ps_helpers;
+	int		ps_nhelpers;	/* as configured */
+	int		ps_busy;	/* chunks in PC_BUSY */
+	volatile int	ps_stop;
+	int		ps_next;	/* next chunk to hand out */
+	int		ps_cur;		/* chunk the search thread is in */
+	int		ps_reach;	/* ps_cur, as far as helpers know */
+	int		ps_state;	/* state of ps_cur, once settled */
+	ID		ps_kpos;	/* position in its pc_keep */
+	int		ps_nchunks;
+	size_t		ps_txnid;
+	time_t		ps_stoptime;	/* 0 if there is no time limit */
+	volatile sig_atomic_t	*ps_abandon;	/* the search's o_abandon */
+	ID		*ps_cands;
+	FilterProgram	*ps_fprog;
+	mdb_attrsel	*ps_asel;
+	Operation	ps_op;
+	Opheader	ps_hdr;
+	psearch_chunk	ps_chunks[1];
+} psearch;
+
+static void *psearch_task( void *ctx, void *arg );
+
+static void
+psearch_free( psearch *ps )
+{
+	int i;
+
+	for ( i = 0; i < ps->ps_nchunks; i++ )
+		ch_free( ps->ps_chunks[i].pc_keep );
+	ldap_pvt_thread_cond_destroy( &ps->ps_cond );
+	ldap_pvt_thread_mutex_destroy( &ps->ps_mutex );
+	ch_free( ps );
+}
+
+/* Whether no operation is waiting for a pool thread and, if more is
+ * set, there is an idle one left after taking one more.
+ */
+static int
+psearch_pool_idle( int more )
+{
+	int pending;
+
+	if ( ldap_pvt_thread_pool_query( &connection_pool,
+		LDAP_PVT_THREAD_POOL_PARAM_PENDING, (void *)&pending ) || pending )
+		return 0;
+	return !more ||
+		ldap_pvt_thread_pool_backload( &connection_pool ) + 1 <
+			connection_pool_max;
+}
+
+static void
+psearch_helper_done( struct mdb_info *mdb )
+{
+	ldap_pvt_thread_mutex_lock( &mdb->mi_search_mutex );
+	mdb->mi_search_helpers--;
+	ldap_pvt_thread_mutex_unlock( &mdb->mi_search_mutex );
+}
+
+/* Queue a helper if the database and the pool can spare one.
+ * Call with ps_mutex held.
+ */
+static void
+psearch_submit( psearch *ps )
+{
+	struct mdb_info *mdb = (struct mdb_info *) ps->ps_op.o_bd->be_private;
+	int ok;
+
+	if ( !psearch_pool_idle( 1 ))
+		return;
+	ldap_pvt_thread_mutex_lock( &mdb->mi_search_mutex );
+	ok = mdb->mi_search_helpers < mdb->mi_search_threads;
+	if ( ok )
+		mdb->mi_search_helpers++;
+	ldap_pvt_thread_mutex_unlock( &mdb->mi_search_mutex );
+	if ( !ok )
+		return;
+
+	ps->ps_refcnt++;
+	ps->ps_helpers++;
+	if ( ldap_pvt_thread_pool_submit( &connection_pool,
+		psearch_task, ps ))
+	{
+		ps->ps_refcnt--;
+		ps->ps_helpers--;
+		psearch_helper_done( mdb );
+	}
+}
+
+/* Give the next free chunk within reach to a helper, or -1.
+ * Call with ps_mutex held.
+ */
+static int
+psearch_claim( psearch *ps )
+{
+	int k;
+
+	if ( ps->ps_stop )
+		return -1;
+	while ( ps->ps_next < ps->ps_nchunks &&
+		ps->ps_chunks[ps->ps_next].pc_state != PC_FREE )
+		ps->ps_next++;
+	k = ps->ps_next;
+	if ( k >= ps->ps_nchunks ||
+		k > ps->ps_reach + MDB_PSEARCH_AHEAD * ps->ps_nhelpers )
+		return -1;
+	ps->ps_chunks[k].pc_state = PC_BUSY;
+	ps->ps_next++;
+	ps->ps_busy++;
+	return k;
+}
+
+/* Test the entries of one chunk, leaving those the search must look
+ * at in pc_keep.
+ */
+static int
+psearch_test( psearch *ps, psearch_chunk *pc, Operation *op,
+	MDB_txn *txn, MDB_cursor *mci, MDB_cursor **mcd )
+{
+	ID *keep, id = pc->pc_first, pos = pc->pc_pos;
+	MDB_val key, data;
+	Entry *e;
+	int rc = 0, range = MDB_IDL_IS_RANGE( ps->ps_cands );
+	int manageDSAit = get_manageDSAit( op ), keepit;
+	MDB_cursor_op mop = MDB_SET_RANGE;
+
+	keep = ch_malloc(( MDB_PSEARCH_CHUNK + 1 ) * sizeof( ID ));
+	keep[0] = 0;
+	key.mv_size = sizeof( ID );
+
+	for (;;) {
+		if ( ps->ps_stop || *ps->ps_abandon || ( ps->ps_stoptime &&
+			slap_get_time() > ps->ps_stoptime ))
+		{
+			rc = -1;
+			break;
+		}
+		if ( range ) {
+			/* walk id2entry, skipping the gaps */
+			key.mv_data = &id;
+			rc = mdb_cursor_get( mci, &key, &data, mop );
+			mop = MDB_NEXT;
+			if ( rc == MDB_NOTFOUND ) {
+				rc = 0;
+				break;
+			}
+			if ( rc )
+				break;
+			memcpy( &id, key.mv_data, sizeof( ID ));
+			if ( id > pc->pc_last )
+				break;
+			if ( !data.mv_size )
+				continue;
+		} else {
+			if ( pos > ps->ps_cands[0] )
+				break;
+			id = ps->ps_cands[pos++];
+			if ( id > pc->pc_last )
+				break;
+			rc = mdb_id2edata( op, mci, id, &data );
+			if ( rc == MDB_NOTFOUND ) {
+				rc = 0;
+				continue;
+			}
+			if ( rc )
+				break;
+		}
+
+		if ( ps->ps_asel )
+			rc = mdb_entry_decode_sel( op, txn, &data, id, ps->ps_asel, &e );
+		else
+			rc = mdb_entry_decode( op, txn, &data, id, &e );
+		if ( rc )
+			break;
+		e->e_id = id;
+
+		/* access controls may need the DN; keep it if there's none */
+		keepit = 1;
+		if ( mdb_id2name( op, txn, mcd, id, &e->e_name, &e->e_nname ) == 0 ) {
+			if ( manageDSAit || !is_entry_referral( e ))
+				keepit = test_filter_program( op, e, ps->ps_op.ors_filter,
+					ps->ps_fprog ) == LDAP_COMPARE_TRUE;
+			op->o_tmpfree( e->e_nname.bv_val, op->o_tmpmemctx );
+			op->o_tmpfree( e->e_name.bv_val, op->o_tmpmemctx );
+		}
+		e->e_name.bv_val = NULL;
+		e->e_nname.bv_val = NULL;
+		mdb_entry_return( op, e );
+
+		if ( keepit )
+			keep[++keep[0]] = id;
+	}
+
+	if ( rc ) {
+		ch_free( keep );
+		return rc;
+	}
+	pc->pc_keep = keep;
+	return 0;
+}
+
+static void *
+psearch_task( void *ctx, void *arg )
+{
+	psearch *ps = arg;
+	struct mdb_info *mdb = (struct mdb_info *) ps->ps_op.o_bd->be_private;
+	Operation op;
+	Opheader ohdr;
+	mdb_op_info opinfo = {{{0}}}, *moi = &opinfo;
+	MDB_cursor *mci = NULL, *mcd = NULL;
+	int k, rc, started = 0, ok = 0, last;
+
+	ldap_pvt_thread_mutex_lock( &ps->ps_mutex );
+	/* leave the thread to operations that are waiting for one */
+	while ( psearch_pool_idle( 0 ) && ( k = psearch_claim( ps )) >= 0 ) {
+		psearch_chunk *pc = &ps->ps_chunks[k];
+
+		ldap_pvt_thread_mutex_unlock( &ps->ps_mutex );
+
+		/* the search is waiting for us now, its op is safe to copy */
+		if ( !started ) {
+			started = 1;
+			op = ps->ps_op;
+			ohdr = ps->ps_hdr;
+			op.o_hdr = &ohdr;
+			op.o_threadctx = ctx;
+			op.o_tmpmemctx = slap_sl_mem_create( SLAP_SLAB_SIZE,
+				SLAP_SLAB_STACK, ctx, 1 );
+			op.o_tmpmfuncs = &slap_sl_mfuncs;
+			op.o_callback = NULL;
+			LDAP_SLIST_INIT( &op.o_extra );
+
+			if ( mdb_opinfo_get( &op, mdb, 1, &moi ) == 0 ) {
+				ok = 1;
+				if ( mdb_txn_id( moi->moi_txn ) != ps->ps_txnid ||
+					mdb_cursor_open( moi->moi_txn, mdb->mi_id2entry, &mci ))
+					ok = 0;
+			}
+		}
+
+		rc = ok ? psearch_test( ps, pc, &op, moi->moi_txn, mci, &mcd ) : -1;
+
+		ldap_pvt_thread_mutex_lock( &ps->ps_mutex );
+		if ( rc ) {
+			pc->pc_state = PC_SERIAL;
+			/* a newer snapshot, the end of the search or an error,
+			 * no use going on */
+			ps->ps_stop = 1;
+		} else {
+			pc->pc_state = PC_DONE;
+		}
+		ps->ps_busy--;
+		ldap_pvt_thread_cond_broadcast( &ps->ps_cond );
+	}
+	ps->ps_helpers--;
+	last = --ps->ps_refcnt == 0;
+	ldap_pvt_thread_mutex_unlock( &ps->ps_mutex );
+	psearch_helper_done( mdb );
+
+	if ( started ) {
+		if ( mcd )
+			mdb_cursor_close( mcd );
+		if ( mci )
+			mdb_cursor_close( mci );
+		if ( moi == &opinfo ) {
+			mdb_txn_reset( moi->moi_txn );
+			LDAP_SLIST_REMOVE( &op.o_extra, &moi->moi_oe, OpExtra, oe_next );
+		}
+	}
+	if ( last )
+		psearch_free( ps );
+	return NULL;
+}
+
+/* Set up parallel evaluation of the candidates from id on, whose
+ * position is cursor.  Returns NULL if it is not worth it.
+ */
+static psearch *
+psearch_start( Operation *op, struct mdb_info *mdb, MDB_txn *txn,
+	MDB_cursor *mci, ID *cands, ID cursor, ID id,
+	FilterProgram *fprog, mdb_attrsel *asel )
+{
+	psearch *ps;
+	ID last;
+	int i, n;
+
+	if ( MDB_IDL_IS_RANGE( cands )) {
+		MDB_val key;
+
+		last = MDB_IDL_RANGE_LAST( cands );
+		if ( mdb_cursor_get( mci, &key, NULL, MDB_LAST ) == 0 ) {
+			ID dblast;
+
+			memcpy( &dblast, key.mv_data, sizeof( ID ));
+			if ( dblast < last )
+				last = dblast;
+		}
+		if ( last < id )
+			return NULL;
+		n = ( last - id ) / MDB_PSEARCH_CHUNK + 1;
+	} else {
+		n = ( cands[0] - cursor ) / MDB_PSEARCH_CHUNK + 1;
+	}
+	if ( n < 2 )
+		return NULL;
+
+	ps = ch_calloc( 1, sizeof( psearch ) + ( n - 1 ) * sizeof( psearch_chunk ));
+	for ( i = 0; i < n; i++ ) {
+		psearch_chunk *pc = &ps->ps_chunks[i];
+
+		if ( MDB_IDL_IS_RANGE( cands )) {
+			pc->pc_first = id + (ID)i * MDB_PSEARCH_CHUNK;
+			pc->pc_last = i == n - 1 ? last :
+				pc->pc_first + MDB_PSEARCH_CHUNK - 1;
+		} else {
+			ID end = cursor + (ID)( i + 1 ) * MDB_PSEARCH_CHUNK - 1;
+
+			pc->pc_pos = cursor + (ID)i * MDB_PSEARCH_CHUNK;
+			pc->pc_first = cands[pc->pc_pos];
+			pc->pc_last = cands[end < cands[0] ? end : cands[0]];
+		}
+	}
+	ldap_pvt_thread_mutex_init( &ps->ps_mutex );
+	ldap_pvt_thread_cond_init( &ps->ps_cond );
+	ps->ps_refcnt = 1;
+	ps->ps_nchunks = n;
+	ps->ps_nhelpers = mdb->mi_search_threads;
+	ps->ps_state = -1;
+	ps->ps_txnid = mdb_txn_id( txn );
+	if ( op->ors_tlimit != SLAP_NO_LIMIT )
+		ps->ps_stoptime = op->o_time + op->ors_tlimit;
+	ps->ps_abandon = &op->o_abandon;
+	ps->ps_cands = cands;
+	ps->ps_fprog = fprog;
+	ps->ps_asel = asel;
+	ps->ps_op = *op;
+	ps->ps_hdr = *op->o_hdr;
+
+	Debug( LDAP_DEBUG_TRACE, LDAP_XSTRING(mdb_search)
+		": %d chunks for %d helpers\n", n, ps->ps_nhelpers );
+
+	ldap_pvt_thread_mutex_lock( &ps->ps_mutex );
+	for ( i = 0; i < ps->ps_nhelpers; i++ )
+		psearch_submit( ps );
+	ldap_pvt_thread_mutex_unlock( &ps->ps_mutex );
+
+	return ps;
+}
+
+/* Whether the search must look at id.  If not, *skip is set to the
+ * last ID that may be skipped as well.  Returns -1 if the search was
+ * abandoned or ran out of time while waiting for a helper.
+ */
+static int
+psearch_keep( psearch *ps, ID id, ID *skip )
+{
+	psearch_chunk *pc;
+	ID *keep;
+
+	while ( ps->ps_cur < ps->ps_nchunks &&
+		id > ps->ps_chunks[ps->ps_cur].pc_last )
+	{
+		if ( ps->ps_state == PC_DONE ) {
+			ch_free( ps->ps_chunks[ps->ps_cur].pc_keep );
+			ps->ps_chunks[ps->ps_cur].pc_keep = NULL;
+		}
+		ps->ps_cur++;
+		ps->ps_state = -1;
+	}
+	if ( ps->ps_cur >= ps->ps_nchunks )
+		return 1;
+	pc = &ps->ps_chunks[ps->ps_cur];
+	if ( id < pc->pc_first )
+		return 1;
+
+	if ( ps->ps_state < 0 ) {
+		ldap_pvt_thread_mutex_lock( &ps->ps_mutex );
+		if ( pc->pc_state == PC_FREE ) {
+			/* nobody got to it */
+			pc->pc_state = PC_SERIAL;
+		}
+		/* the helper gives up on the chunk once the time
+		 * limit is reached or the search is abandoned */
+		while ( pc->pc_state == PC_BUSY )
+			ldap_pvt_thread_cond_wait( &ps->ps_cond, &ps->ps_mutex );
+		ps->ps_state = pc->pc_state;
+		ps->ps_reach = ps->ps_cur;
+		/* helpers that stopped for getting too far ahead */
+		if ( !ps->ps_stop && ps->ps_helpers < ps->ps_nhelpers &&
+			ps->ps_next < ps->ps_nchunks )
+			psearch_submit( ps );
+		ldap_pvt_thread_mutex_unlock( &ps->ps_mutex );
+		ps->ps_kpos = 1;
+		if ( *ps->ps_abandon || ( ps->ps_stoptime &&
+			slap_get_time() > ps->ps_stoptime ))
+			return -1;
+	}
+	if ( ps->ps_state != PC_DONE )
+		return 1;
+
+	keep = pc->pc_keep;
+	while ( ps->ps_kpos <= keep[0] && keep[ps->ps_kpos] < id )
+		ps->ps_kpos++;
+	if ( ps->ps_kpos <= keep[0] ) {
+		if ( keep[ps->ps_kpos] == id )
+			return 1;
+		*skip = keep[ps->ps_kpos] - 1;
+	} else {
+		*skip = pc->pc_last;
+	}
+	return 0;
+}
+
+/* Stop the helpers and wait for those in a chunk */
+static void
+psearch_end( psearch *ps )
+{
+	int last;
+
+	ldap_pvt_thread_mutex_lock( &ps->ps_mutex );
+	ps->ps_stop = 1;
+	while ( ps->ps_busy )
+		ldap_pvt_thread_cond_wait( &ps->ps_cond, &ps->ps_mutex );
+	last = --ps->ps_refcnt == 0;
+	ldap_pvt_thread_mutex_unlock( &ps->ps_mutex );
+	if ( last )
+		psearch_free( ps );
+}
+
 int
 mdb_search( Operation *op, SlapReply *rs )
 {
@@ -428,6 +1027,10 @@ mdb_search( Operation *op, SlapReply *rs )
 	Entry		*e = NULL, *base = NULL;
 	Entry		*matched = NULL;
 	AttributeName	*attrs;
+	FilterProgram	*fprog = NULL;
+	mdb_attrsel	*asel = NULL;
+	int		asel_done = 0;
+	psearch		*pss = NULL;
 	slap_mask_t	mask;
 	time_t		stoptime;
 	int		manageDSAit;
@@ -763,7 +1366,7 @@ adminlimit:
 		if ( id == (ID)ps->ps_cookie )
 			id = mdb_idl_next( candidates, &cursor );
 		nsubs = ncand;	/* always bypass scope'd search */
-		goto loop_begin;
+		goto parallel;
 	}
 	if ( nsubs < ncand ) {
 		int rc;
@@ -794,6 +1397,20 @@ adminlimit:
 		cscope = 0;
 	} else {
 		id = mdb_idl_first( candidates, &cursor );
+parallel:
+		if ( mdb->mi_search_threads && id != NOID &&
+			( moi->moi_flag & MOI_READER ) &&
+			!( slapMode & SLAP_TOOL_MODE ))
+		{
+			if ( fprog == NULL )
+				fprog = filter_compile( op, op->oq_search.rs_filter );
+			if ( !asel_done ) {
+				asel = search_attrsel( op );
+				asel_done = 1;
+			}
+			pss = psearch_start( op, mdb, ltid, mci, candidates, cursor, id,
+				fprog, asel );
+		}
 	}
 
 	while (id != NOID)
@@ -831,6 +1448,22 @@ loop_begin:
 		}
 
 
+		if ( pss ) {
+			ID skip;
+			int keep = psearch_keep( pss, id, &skip );
+
+			if ( keep < 0 ) {
+				/* caught by the checks above */
+				goto loop_begin;
+			}
+			if ( !keep ) {
+				/* ruled out by a helper */
+				if ( MDB_IDL_IS_RANGE( candidates ))
+					cursor = skip;
+				goto loop_continue;
+			}
+		}
+
 		if ( nsubs < ncand ) {
 			unsigned i;
 			/* Is this entry in the candidate list? */
@@ -936,7 +1569,12 @@ notfound:
 				goto done;
 			}
 
-			rs->sr_err = mdb_entry_decode( op, ltid, &edata, id, &e );
+			if ( !asel_done ) {
+				asel = search_attrsel( op );
+				asel_done = 1;
+			}
+			rs->sr_err = mdb_entry_decode_sel( op, ltid, &edata, id,
+				asel, &e );
 			if ( rs->sr_err ) {
 				rs->sr_err = LDAP_OTHER;
 				rs->sr_text = "internal error in mdb_entry_decode";
@@ -1073,7 +1711,33 @@ notfound:
 		}
 
 		/* if it matches the filter and scope, send it */
-		rs->sr_err = test_filter( op, e, op->oq_search.rs_filter );
+		if ( fprog == NULL )
+			fprog = filter_compile( op, op->oq_search.rs_filter );
+		rs->sr_err = test_filter_program( op, e,
+			op->oq_search.rs_filter, fprog );
+
+		if ( rs->sr_err == LDAP_COMPARE_TRUE && asel && e != base ) {
+			/* it's a match, now get the rest of it */
+			Entry *full;
+			int rc;
+
+			rc = mdb_entry_decode( op, ltid, &edata, id, &full );
+			if ( rc ) {
+				mdb_entry_return( op, e );
+				e = NULL;
+				rs->sr_err = LDAP_OTHER;
+				rs->sr_text = "internal error in mdb_entry_decode";
+				send_ldap_result( op, rs );
+				goto done;
+			}
+			full->e_id = id;
+			full->e_name = e->e_name;
+			full->e_nname = e->e_nname;
+			BER_BVZERO( &e->e_name );
+			BER_BVZERO( &e->e_nname );
+			mdb_entry_return( op, e );
+			e = full;
+		}
 
 		if ( rs->sr_err == LDAP_COMPARE_TRUE ) {
 			/* check size limit */
@@ -1150,6 +1814,11 @@ loop_continue:
 				send_ldap_result( op, rs );
 				goto done;
 			}
+			/* the helpers' verdicts are for the old snapshot */
+			if ( pss && mdb_txn_id( ltid ) != pss->ps_txnid ) {
+				psearch_end( pss );
+				pss = NULL;
+			}
 		}
 
 		if( e != NULL ) {
@@ -1206,6 +1875,8 @@ nochange:
 	rs->sr_err = LDAP_SUCCESS;
 
 done:
+	if ( pss )
+		psearch_end( pss );
 	if ( cb.sc_private ) {
 		/* remove our writewait callback */
 		slap_callback **scp = &op->o_callback;
@@ -1231,6 +1902,9 @@ done:
 	}
 	if (base)
 		mdb_entry_return( op, base );
+	filter_program_free( op, fprog );
+	if ( asel )
+		op->o_tmpfree( asel, op->o_tmpmemctx );
 	scope_chunk_ret( op, scopes );
 	if ( candidates != c0 ) {
 		ch_free( candidates );
@@ -19,6 +19,9 @@
 #include <stdio.h>
 #include <ac/string.h>
 #include <ac/errno.h>
+#include <ac/time.h>
+#include <ac/unistd.h>
+#include <lutil_meter.h>
 
 #define AVL_INTERNAL
 #include "back-mdb.h"
@@ -50,6 +53,14 @@ typedef struct mdb_tool_idl_cache {
 #define MDB_TOOL_IDL_FLUSH(be, txn)
 #endif /* MDB_TOOL_IDL_CACHING */
 
+static int mdb_tool_sort_commit( BackendDB *be );
+static void mdb_tool_sort_abort( BackendDB *be );
+static int mdb_tool_sort_flush( BackendDB *be );
+static void mdb_tool_reindex_init( BackendDB *be );
+static int mdb_tool_sort_run( BackendDB *be );
+static void mdb_tool_sort_drop( BackendDB *be );
+static void mdb_tool_sort_shutdown( void );
+
 MDB_txn *mdb_tool_txn = NULL;
 
 static MDB_txn *txi = NULL;
@@ -87,6 +98,29 @@ static void * mdb_tool_index_task( void *ctx, void *ptr );
 
 static int	mdb_writes, mdb_writes_per_commit;
 
+/* sorted index spools, one per slot */
+static int mdb_tool_sort_nslots = 1;
+
+/* parallel slapindex state */
+static int mdb_tool_sort_nthreads;
+static ldap_pvt_thread_t *mdb_tool_sort_tids;
+static ldap_pvt_thread_mutex_t mdb_tool_sort_mutex;
+static ldap_pvt_thread_cond_t mdb_tool_sort_cond_work;
+static ldap_pvt_thread_cond_t mdb_tool_sort_cond_done;
+static BackendDB *mdb_tool_sort_be;
+static Entry **mdb_tool_sort_batch;
+static int mdb_tool_sort_nbatch;
+static unsigned mdb_tool_sort_gen;
+static int mdb_tool_sort_busy, mdb_tool_sort_rc, mdb_tool_sort_stop;
+
+/* reindex progress and statistics */
+static int mdb_tool_reindexing;
+static int mdb_tool_meter_on;
+static lutil_meter_t mdb_tool_meter;
+static struct timeval mdb_tool_reindex_start;
+static unsigned long mdb_tool_reindex_count;
+static ID mdb_tool_reindex_last;
+
 /* Number of ops per commit in Quick mode.
  * Batching speeds writes overall, but too large a
  * batch will fail with MDB_TXN_FULL.
@@ -190,6 +224,20 @@ int mdb_tool_entry_close(
 	}
 #endif
 
+	if ( mdb_tool_sort_nthreads ) {
+		int rc = 0;
+		if ( mdb_tool_sort_nbatch )
+			rc = mdb_tool_sort_run( be );
+		mdb_tool_sort_shutdown();
+		if ( rc ) {
+			Debug( LDAP_DEBUG_ANY,
+				LDAP_XSTRING(mdb_tool_entry_close) ": database %s: "
+				"indexing failed: err=%d\n",
+				be->be_suffix[0].bv_val, rc );
+			return -1;
+		}
+	}
+
 	if( idcursor ) {
 		mdb_cursor_close( idcursor );
 		idcursor = NULL;
@@ -229,6 +277,14 @@ int mdb_tool_entry_close(
 		txi = NULL;
 	}
 
+	if ( mdb_tool_sort_flush( be )) {
+		Debug( LDAP_DEBUG_ANY,
+			LDAP_XSTRING(mdb_tool_entry_close) ": database %s: "
+			"sorted index build failed\n",
+			be->be_suffix[0].bv_val );
+		return -1;
+	}
+
 	if( nholes ) {
 		unsigned i;
 		fprintf( stderr, "Error, entries missing!\n");
@@ -764,6 +820,7 @@ done:
 			idcursor = NULL;
 			if( rc != 0 ) {
 				mdb->mi_numads = 0;
+				mdb_tool_sort_abort( be );
 				snprintf( text->bv_val, text->bv_len,
 						"txn_commit failed: %s (%d)",
 						mdb_strerror(rc), rc );
@@ -771,12 +828,17 @@ done:
 					"=> " LDAP_XSTRING(mdb_tool_entry_put) ": %s\n",
 					text->bv_val );
 				e->e_id = NOID;
+			} else if ( mdb_tool_sort_commit( be ) != 0 ) {
+				snprintf( text->bv_val, text->bv_len,
+						"index spool write failed" );
+				e->e_id = NOID;
 			}
 		}
 
 	} else {
 		unsigned i;
 		mdb_txn_abort( mdb_tool_txn );
+		mdb_tool_sort_abort( be );
 		mdb_tool_txn = NULL;
 		idcursor = NULL;
 		for ( i=0; i<mdb->mi_nattrs; i++ )
@@ -803,7 +865,7 @@ int mdb_tool_entry_reindex(
 	AttributeDescription **adv )
 {
 	struct mdb_info *mi = (struct mdb_info *) be->be_private;
-	int rc;
+	int rc, queued = 0;
 	Entry *e;
 	Operation op = {0};
 	Opheader ohdr = {0};
@@ -920,7 +982,21 @@ int mdb_tool_entry_reindex(
 	op.o_tmpmemctx = NULL;
 	op.o_tmpmfuncs = &ch_mfuncs;
 
-	rc = mdb_tool_index_add( &op, txi, e );
+	if ( !mdb_tool_reindexing )
+		mdb_tool_reindex_init( be );
+	mdb_tool_reindex_count++;
+	mdb_tool_reindex_last = id;
+	if ( mdb_tool_meter_on )
+		lutil_meter_update( &mdb_tool_meter, id, 0 );
+
+	if ( mdb_tool_sort_nthreads ) {
+		/* keys are generated by all threads at the commit point */
+		mdb_tool_sort_batch[mdb_tool_sort_nbatch++] = e;
+		queued = 1;
+		rc = 0;
+	} else {
+		rc = mdb_tool_index_add( &op, txi, e );
+	}
 
 done:
 	if( rc == 0 ) {
@@ -929,16 +1005,29 @@ done:
 			MDB_val key;
 			unsigned i;
 			MDB_TOOL_IDL_FLUSH( be, txi );
-			rc = mdb_txn_commit( txi );
+			if ( mdb_tool_sort_nbatch )
+				rc = mdb_tool_sort_run( be );
+			if ( rc == 0 ) {
+				rc = mdb_txn_commit( txi );
+			} else {
+				mdb_txn_abort( txi );
+			}
 			mdb_writes = 0;
 			for ( i=0; i<mi->mi_nattrs; i++ )
 				mi->mi_attrs[i]->ai_cursor = NULL;
 			if( rc != 0 ) {
+				mdb_tool_sort_abort( be );
 				Debug( LDAP_DEBUG_ANY,
 					"=> " LDAP_XSTRING(mdb_tool_entry_reindex)
 					": txn_commit failed: %s (%d)\n",
 					mdb_strerror(rc), rc );
-				e->e_id = NOID;
+				if ( !queued )
+					e->e_id = NOID;
+			} else {
+				rc = mdb_tool_sort_commit( be );
+				/* sorted keys are only written at close */
+				if ( rc == 0 && !MDB_TOOL_SORTING )
+					slap_tool_checkpoint = id;
 			}
 			mdb_cursor_close( cursor );
 			txi = NULL;
@@ -958,16 +1047,23 @@ done:
 		mdb_cursor_close( cursor );
 		cursor = NULL;
 		mdb_txn_abort( txi );
+		if ( mdb_tool_sort_nbatch ) {
+			mdb_tool_sort_drop( be );
+			queued = 1;
+		}
+		mdb_tool_sort_abort( be );
 		for ( i=0; i<mi->mi_nattrs; i++ )
 			mi->mi_attrs[i]->ai_cursor = NULL;
 		Debug( LDAP_DEBUG_ANY,
 			"=> " LDAP_XSTRING(mdb_tool_entry_reindex)
 			": txn_aborted! err=%d\n",
 			rc );
-		e->e_id = NOID;
+		if ( !queued )
+			e->e_id = NOID;
 		txi = NULL;
 	}
-	mdb_entry_release( &op, e, 0 );
+	if ( !queued )
+		mdb_entry_release( &op, e, 0 );
 
 	return rc;
 }
@@ -1508,6 +1604,858 @@ int mdb_tool_idl_add(
 }
 #endif /* MDB_TOOL_IDL_CACHING */
 
+/* Sorted index build for offline loads.
+ *
+ * With -q and -o index-sort=yes, slapadd and slapindex do not insert
+ * index keys entry by entry.  Instead mdb_tool_sort_add() spools the
+ * (key, ID) pairs of each index in memory.  At each commit point the
+ * spools are sorted and spilled to a temporary file as runs once they
+ * hold more than MDB_TOOL_SORT_MEM bytes.  When the tool closes the
+ * database, the runs of each index are merged and written in key order.
+ * An index DB that starts out empty is written with MDB_APPEND and
+ * MDB_APPENDDUP, which fills its pages completely.  Otherwise the keys
+ * are merged into the existing data with mdb_idl_insert_keys().
+ *
+ * Each index has one spool per slot.  slapindex with tool-threads > 1
+ * splits the IDs of each commit window into contiguous slices, and one
+ * worker thread per slot generates the keys of its slice.  The spools of
+ * all slots are merged together at the end.
+ */
+
+#ifndef MDB_TOOL_SORT_MEM
+#define MDB_TOOL_SORT_MEM	(64*1024*1024)
+#endif
+
+/* IDs written between commits of the merge txn */
+#ifndef MDB_TOOL_SORT_PUTS
+#define MDB_TOOL_SORT_PUTS	(1024*1024)
+#endif
+
+#define SORT_BUFSIZ	65536
+
+typedef struct mdb_tool_srec {
+	ID id;
+	unsigned int klen;
+	/* key follows */
+} mdb_tool_srec;
+
+#define SREC_KEY(r)	((char *)((r)+1))
+#define SREC_SIZE(klen)	((sizeof(mdb_tool_srec) + (klen) + sizeof(ID)-1) & \
+	~(sizeof(ID)-1))
+
+typedef struct mdb_tool_run {
+	off_t start, end;
+} mdb_tool_run;
+
+typedef struct mdb_tool_spool {
+	char *buf;
+	size_t len, size;
+	size_t committed;	/* len as of the last commit */
+	FILE *fp;			/* sorted runs */
+	off_t fend;
+	mdb_tool_run *runs;
+	int nruns;
+	unsigned long nkeys;	/* statistics */
+} mdb_tool_spool;
+
+/* a sorted input of the merge, either in memory or a run on disk */
+typedef struct mdb_tool_src {
+	mdb_tool_srec *rec;
+	mdb_tool_srec **ptrs;
+	size_t n, cur;
+	int fd;
+	off_t off, end;
+	char *buf;
+	size_t bpos, blen, bsize;
+} mdb_tool_src;
+
+/* merge output state */
+typedef struct mdb_tool_sortw {
+	BackendDB *w_be;
+	AttrInfo *w_ai;
+	MDB_txn *w_txn;
+	MDB_cursor *w_mc;
+	int w_append;
+	int w_haskey;
+	char *w_key;
+	unsigned int w_klen, w_ksize;
+	ID *w_ids;
+	unsigned int w_nids;
+	int w_range;
+	ID w_hi;
+	unsigned long w_puts;
+} mdb_tool_sortw;
+
+/* slot of a worker thread's operations */
+typedef struct mdb_tool_sortx {
+	OpExtra sx_oe;
+	int sx_slot;
+} mdb_tool_sortx;
+
+
+static int
+mdb_tool_srec_cmp( const mdb_tool_srec *r1, const mdb_tool_srec *r2 )
+{
+	unsigned int len = r1->klen < r2->klen ? r1->klen : r2->klen;
+	int rc;
+
+	/* same order as the default LMDB key compare, then by ID */
+	rc = memcmp( SREC_KEY(r1), SREC_KEY(r2), len );
+	if ( rc == 0 )
+		rc = ( r1->klen > r2->klen ) - ( r1->klen < r2->klen );
+	if ( rc == 0 )
+		rc = ( r1->id > r2->id ) - ( r1->id < r2->id );
+	return rc;
+}
+
+static int
+mdb_tool_srec_pcmp( const void *v1, const void *v2 )
+{
+	return mdb_tool_srec_cmp( *(mdb_tool_srec * const *)v1,
+		*(mdb_tool_srec * const *)v2 );
+}
+
+int mdb_tool_sort_add(
+	BackendDB *be,
+	MDB_cursor *mc,
+	struct berval *keys,
+	ID id )
+{
+	mdb_tool_spool *sp = (mdb_tool_spool *)mc;
+	mdb_tool_srec *r;
+	size_t len;
+	int i;
+
+	for ( i=0; keys[i].bv_val; i++ ) {
+		unsigned int klen = keys[i].bv_len;
+#ifndef MISALIGNED_OK
+		/* mdb_idl_insert_keys() pads such keys, store them the same way */
+		if ( klen & ALIGNER )
+			klen = 2 * sizeof(int);
+#endif
+		len = SREC_SIZE( klen );
+		if ( sp->len + len > sp->size ) {
+			size_t size = sp->size ? sp->size : SORT_BUFSIZ;
+			while ( sp->len + len > size )
+				size *= 2;
+			sp->buf = ch_realloc( sp->buf, size );
+			sp->size = size;
+		}
+		r = (mdb_tool_srec *)(sp->buf + sp->len);
+		r->id = id;
+		r->klen = klen;
+		memset( SREC_KEY(r), 0, klen );
+		AC_MEMCPY( SREC_KEY(r), keys[i].bv_val, keys[i].bv_len );
+		sp->len += len;
+	}
+	return 0;
+}
+
+static int
+mdb_tool_sort_slot( Operation *op )
+{
+	OpExtra *oex;
+
+	LDAP_SLIST_FOREACH( oex, &op->o_extra, oe_next ) {
+		if ( oex->oe_key == (void *)&mdb_tool_sort_nslots )
+			return ((mdb_tool_sortx *)oex)->sx_slot;
+	}
+	return 0;
+}
+
+/* Return the spool of this operation's slot for an index */
+void *
+mdb_tool_sort_spool( Operation *op, AttrInfo *ai )
+{
+	if ( !ai->ai_spool )
+		ai->ai_spool = ch_calloc( mdb_tool_sort_nslots,
+			sizeof( mdb_tool_spool ));
+	return (mdb_tool_spool *)ai->ai_spool + mdb_tool_sort_slot( op );
+}
+
+/* Count the keys generated for an index, for the reindex statistics */
+void
+mdb_tool_index_stat( Operation *op, AttrInfo *ai, unsigned long nkeys )
+{
+	if ( ai->ai_spool )
+		((mdb_tool_spool *)ai->ai_spool)[mdb_tool_sort_slot( op )].nkeys += nkeys;
+}
+
+/* Sort the in-memory part of a spool, returns the number of records */
+static size_t
+mdb_tool_spool_sort( mdb_tool_spool *sp, mdb_tool_srec ***ptrs )
+{
+	mdb_tool_srec **p, *r;
+	size_t off, n = 0;
+
+	for ( off = 0; off < sp->len; off += SREC_SIZE( r->klen )) {
+		r = (mdb_tool_srec *)(sp->buf + off);
+		n++;
+	}
+	p = ch_malloc( ( n + 1 ) * sizeof( mdb_tool_srec * ));
+	n = 0;
+	for ( off = 0; off < sp->len; off += SREC_SIZE( r->klen )) {
+		r = (mdb_tool_srec *)(sp->buf + off);
+		p[n++] = r;
+	}
+	qsort( p, n, sizeof( mdb_tool_srec * ), mdb_tool_srec_pcmp );
+	*ptrs = p;
+	return n;
+}
+
+/* Write the in-memory part of a spool to its file as a sorted run */
+static int
+mdb_tool_spool_spill( struct mdb_info *mdb, mdb_tool_spool *sp )
+{
+	mdb_tool_srec **p, *prev = NULL;
+	mdb_tool_run *run;
+	size_t i, n, len;
+
+	if ( !sp->len )
+		return 0;
+
+	if ( !sp->fp ) {
+		char *path = ch_malloc( strlen( mdb->mi_dbenv_home ) +
+			STRLENOF( LDAP_DIRSEP "index-sort.XXXXXX" ) + 1 );
+		int fd;
+
+		sprintf( path, "%s" LDAP_DIRSEP "index-sort.XXXXXX",
+			mdb->mi_dbenv_home );
+		fd = mkstemp( path );
+		if ( fd >= 0 ) {
+			unlink( path );
+			sp->fp = fdopen( fd, "w+" );
+			if ( !sp->fp )
+				close( fd );
+		}
+		if ( !sp->fp ) {
+			int save_errno = errno;
+			char ebuf[128];
+			Debug( LDAP_DEBUG_ANY,
+				LDAP_XSTRING(mdb_tool_spool_spill) ": cannot create "
+				"temporary file %s: %s (%d)\n",
+				path, AC_STRERROR_R( save_errno, ebuf, sizeof(ebuf) ), save_errno );
+			ch_free( path );
+			return -1;
+		}
+		ch_free( path );
+	}
+
+	n = mdb_tool_spool_sort( sp, &p );
+	sp->runs = ch_realloc( sp->runs, ( sp->nruns + 1 ) * sizeof( mdb_tool_run ));
+	run = &sp->runs[sp->nruns++];
+	run->start = sp->fend;
+	for ( i=0; i<n; i++ ) {
+		if ( prev && !mdb_tool_srec_cmp( prev, p[i] ))
+			continue;
+		len = SREC_SIZE( p[i]->klen );
+		if ( fwrite( p[i], len, 1, sp->fp ) != 1 )
+			break;
+		sp->fend += len;
+		prev = p[i];
+	}
+	ch_free( p );
+	run->end = sp->fend;
+	if ( i < n || fflush( sp->fp )) {
+		int save_errno = errno;
+		char ebuf[128];
+		Debug( LDAP_DEBUG_ANY,
+			LDAP_XSTRING(mdb_tool_spool_spill) ": write failed: %s (%d)\n",
+			AC_STRERROR_R( save_errno, ebuf, sizeof(ebuf) ), save_errno );
+		return -1;
+	}
+
+	sp->len = sp->committed = 0;
+	return 0;
+}
+
+static void
+mdb_tool_spool_free( mdb_tool_spool *sp )
+{
+	int i;
+
+	for ( i=0; i<mdb_tool_sort_nslots; i++ ) {
+		if ( sp[i].fp )
+			fclose( sp[i].fp );
+		ch_free( sp[i].runs );
+		ch_free( sp[i].buf );
+	}
+	ch_free( sp );
+}
+
+/* The write txn was committed: keep what was spooled so far */
+static int
+mdb_tool_sort_commit( BackendDB *be )
+{
+	struct mdb_info *mdb = (struct mdb_info *) be->be_private;
+	mdb_tool_spool *sp;
+	size_t mem = 0;
+	int i, j, rc = 0;
+
+	for ( i=0; i<mdb->mi_nattrs; i++ ) {
+		if (( sp = mdb->mi_attrs[i]->ai_spool )) {
+			for ( j=0; j<mdb_tool_sort_nslots; j++ ) {
+				sp[j].committed = sp[j].len;
+				mem += sp[j].len;
+			}
+		}
+	}
+	if ( mem > MDB_TOOL_SORT_MEM ) {
+		for ( i=0; i<mdb->mi_nattrs && !rc; i++ ) {
+			if (( sp = mdb->mi_attrs[i]->ai_spool )) {
+				for ( j=0; j<mdb_tool_sort_nslots && !rc; j++ )
+					rc = mdb_tool_spool_spill( mdb, &sp[j] );
+			}
+		}
+	}
+	return rc;
+}
+
+/* The write txn was aborted: forget the keys spooled since the last commit */
+static void
+mdb_tool_sort_abort( BackendDB *be )
+{
+	struct mdb_info *mdb = (struct mdb_info *) be->be_private;
+	mdb_tool_spool *sp;
+	int i, j;
+
+	for ( i=0; i<mdb->mi_nattrs; i++ ) {
+		if (( sp = mdb->mi_attrs[i]->ai_spool )) {
+			for ( j=0; j<mdb_tool_sort_nslots; j++ )
+				sp[j].len = sp[j].committed;
+		}
+	}
+}
+
+static int
+mdb_tool_src_fill( mdb_tool_src *s, size_t need )
+{
+	size_t avail = s->blen - s->bpos;
+	ssize_t n;
+
+	if ( need > s->bsize ) {
+		s->bsize = need;
+		s->buf = ch_realloc( s->buf, s->bsize );
+	}
+	AC_MEMCPY( s->buf, s->buf + s->bpos, avail );
+	s->bpos = 0;
+	s->blen = avail;
+	while ( s->blen < need && s->off < s->end ) {
+		size_t want = s->bsize - s->blen;
+		if ( want > s->end - s->off )
+			want = s->end - s->off;
+		n = pread( s->fd, s->buf + s->blen, want, s->off );
+		if ( n <= 0 )
+			return -1;
+		s->blen += n;
+		s->off += n;
+	}
+	return s->blen < need ? -1 : 0;
+}
+
+/* Advance a merge input to its next record, rec is NULL at the end */
+static int
+mdb_tool_src_next( mdb_tool_src *s )
+{
+	mdb_tool_srec *r;
+	size_t len;
+
+	if ( s->ptrs ) {
+		s->rec = s->cur < s->n ? s->ptrs[s->cur++] : NULL;
+		return 0;
+	}
+
+	if ( s->rec )
+		s->bpos += SREC_SIZE( s->rec->klen );
+	s->rec = NULL;
+	if ( s->bpos == s->blen && s->off == s->end )
+		return 0;
+	if ( s->blen - s->bpos < sizeof( mdb_tool_srec ) &&
+		mdb_tool_src_fill( s, sizeof( mdb_tool_srec )))
+		return -1;
+	r = (mdb_tool_srec *)(s->buf + s->bpos);
+	len = SREC_SIZE( r->klen );
+	if ( s->blen - s->bpos < len ) {
+		if ( mdb_tool_src_fill( s, len ))
+			return -1;
+		r = (mdb_tool_srec *)s->buf;
+	}
+	s->rec = r;
+	return 0;
+}
+
+static int
+mdb_tool_sortw_begin( mdb_tool_sortw *w )
+{
+	struct mdb_info *mdb = (struct mdb_info *) w->w_be->be_private;
+	int rc;
+
+	rc = mdb_txn_begin( mdb->mi_dbenv, NULL, 0, &w->w_txn );
+	if ( rc == 0 ) {
+		rc = mdb_cursor_open( w->w_txn, w->w_ai->ai_dbi, &w->w_mc );
+		if ( rc ) {
+			mdb_txn_abort( w->w_txn );
+			w->w_txn = NULL;
+		}
+	}
+	return rc;
+}
+
+static int
+mdb_tool_sortw_commit( mdb_tool_sortw *w )
+{
+	int rc;
+
+	mdb_cursor_close( w->w_mc );
+	w->w_mc = NULL;
+	rc = mdb_txn_commit( w->w_txn );
+	w->w_txn = NULL;
+	w->w_puts = 0;
+	return rc;
+}
+
+/* Write out the IDs collected for the current key of an empty DB */
+static int
+mdb_tool_sortw_key( mdb_tool_sortw *w )
+{
+	MDB_val key, data[2];
+	ID nid = 0;
+	int rc;
+
+	key.mv_data = w->w_key;
+	key.mv_size = w->w_klen;
+	data[0].mv_size = sizeof(ID);
+
+	if ( w->w_range ) {
+		data[0].mv_data = &nid;
+		rc = mdb_cursor_put( w->w_mc, &key, data, MDB_APPEND );
+		if ( rc == 0 ) {
+			data[0].mv_data = &w->w_ids[0];
+			rc = mdb_cursor_put( w->w_mc, &key, data, MDB_APPENDDUP );
+		}
+		if ( rc == 0 ) {
+			data[0].mv_data = &w->w_hi;
+			rc = mdb_cursor_put( w->w_mc, &key, data, MDB_APPENDDUP );
+		}
+		w->w_puts += 3;
+	} else {
+		data[0].mv_data = &w->w_ids[0];
+		rc = mdb_cursor_put( w->w_mc, &key, data, MDB_APPEND );
+		if ( rc == 0 && w->w_nids > 1 ) {
+			data[0].mv_data = &w->w_ids[1];
+			data[1].mv_size = w->w_nids - 1;
+			rc = mdb_cursor_put( w->w_mc, &key, data,
+				MDB_APPENDDUP|MDB_MULTIPLE );
+		}
+		w->w_puts += w->w_nids;
+	}
+	if ( rc == 0 && w->w_puts >= MDB_TOOL_SORT_PUTS ) {
+		rc = mdb_tool_sortw_commit( w );
+		if ( rc == 0 )
+			rc = mdb_tool_sortw_begin( w );
+	}
+	return rc;
+}
+
+/* Feed the next record in sorted order, or NULL to finish */
+static int
+mdb_tool_sortw_put( mdb_tool_sortw *w, mdb_tool_srec *r )
+{
+	int rc = 0;
+
+	if ( w->w_haskey && r && r->klen == w->w_klen &&
+		!memcmp( SREC_KEY(r), w->w_key, r->klen )) {
+		if ( w->w_range ) {
+			w->w_hi = r->id;
+			return 0;
+		}
+		if ( w->w_ids[w->w_nids-1] == r->id )
+			return 0;
+		if ( !w->w_append ) {
+			w->w_ids[0] = r->id;
+			goto insert;
+		}
+		if ( w->w_nids < MDB_idl_db_max ) {
+			w->w_ids[w->w_nids++] = r->id;
+		} else {
+			/* Too many IDs, store a range */
+			w->w_range = 1;
+			w->w_hi = r->id;
+		}
+		return 0;
+	}
+
+	if ( w->w_haskey && w->w_append ) {
+		rc = mdb_tool_sortw_key( w );
+		if ( rc )
+			return rc;
+	}
+	w->w_haskey = 0;
+	if ( !r )
+		return 0;
+
+	if ( r->klen > w->w_ksize ) {
+		w->w_ksize = r->klen;
+		w->w_key = ch_realloc( w->w_key, w->w_ksize );
+	}
+	AC_MEMCPY( w->w_key, SREC_KEY(r), r->klen );
+	w->w_klen = r->klen;
+	w->w_ids[0] = r->id;
+	w->w_nids = 1;
+	w->w_range = 0;
+	w->w_haskey = 1;
+	if ( w->w_append )
+		return 0;
+
+insert:
+	{
+		struct berval keys[2];
+
+		keys[0].bv_val = w->w_key;
+		keys[0].bv_len = w->w_klen;
+		BER_BVZERO( &keys[1] );
+		rc = mdb_idl_insert_keys( w->w_be, w->w_mc, keys, r->id );
+		if ( rc == 0 && ++w->w_puts >= MDB_TOOL_SORT_PUTS ) {
+			rc = mdb_tool_sortw_commit( w );
+			if ( rc == 0 )
+				rc = mdb_tool_sortw_begin( w );
+		}
+	}
+	return rc;
+}
+
+/* Merge all runs of one index and write them to its DB */
+static int
+mdb_tool_sort_write( BackendDB *be, AttrInfo *ai, mdb_tool_spool *sp )
+{
+	struct mdb_info *mdb = (struct mdb_info *) be->be_private;
+	mdb_tool_sortw w = {0};
+	mdb_tool_src *src, *min;
+	MDB_stat st;
+	int i, j, nsrc = 0, nruns = 0, rc;
+
+	/* Use an in-memory spool directly unless it already overflowed */
+	for ( j=0; j<mdb_tool_sort_nslots; j++ ) {
+		if ( sp[j].nruns ) {
+			rc = mdb_tool_spool_spill( mdb, &sp[j] );
+			if ( rc )
+				return rc;
+			nsrc += sp[j].nruns;
+			nruns += sp[j].nruns;
+		} else if ( sp[j].len ) {
+			nsrc++;
+		}
+	}
+	if ( !nsrc )
+		return 0;
+
+	src = ch_calloc( nsrc, sizeof( mdb_tool_src ));
+	for ( j=0, i=0; j<mdb_tool_sort_nslots; j++ ) {
+		int k;
+		if ( !sp[j].nruns ) {
+			if ( sp[j].len ) {
+				src[i].n = mdb_tool_spool_sort( &sp[j], &src[i].ptrs );
+				i++;
+			}
+			continue;
+		}
+		for ( k=0; k<sp[j].nruns; k++, i++ ) {
+			src[i].fd = fileno( sp[j].fp );
+			src[i].off = sp[j].runs[k].start;
+			src[i].end = sp[j].runs[k].end;
+			src[i].bsize = SORT_BUFSIZ;
+			src[i].buf = ch_malloc( src[i].bsize );
+		}
+	}
+
+	w.w_be = be;
+	w.w_ai = ai;
+	w.w_ids = ch_malloc( ( MDB_idl_db_max + 1 ) * sizeof(ID));
+	rc = mdb_tool_sortw_begin( &w );
+	if ( rc == 0 ) {
+		rc = mdb_stat( w.w_txn, ai->ai_dbi, &st );
+		w.w_append = ( rc == 0 && st.ms_entries == 0 );
+	}
+
+	Debug( LDAP_DEBUG_TRACE,
+		"=> " LDAP_XSTRING(mdb_tool_sort_write) ": %s, %d run(s)%s\n",
+		ai->ai_desc->ad_cname.bv_val, nruns,
+		w.w_append ? ", append" : "" );
+
+	for ( i=0; i<nsrc && rc == 0; i++ )
+		rc = mdb_tool_src_next( &src[i] );
+
+	while ( rc == 0 ) {
+		min = NULL;
+		for ( i=0; i<nsrc; i++ ) {
+			if ( src[i].rec && ( !min ||
+				mdb_tool_srec_cmp( src[i].rec, min->rec ) < 0 ))
+				min = &src[i];
+		}
+		rc = mdb_tool_sortw_put( &w, min ? min->rec : NULL );
+		if ( !min )
+			break;
+		if ( rc == 0 )
+			rc = mdb_tool_src_next( min );
+	}
+
+	if ( w.w_txn ) {
+		if ( rc == 0 ) {
+			rc = mdb_tool_sortw_commit( &w );
+		} else {
+			mdb_txn_abort( w.w_txn );
+		}
+	}
+	if ( rc ) {
+		Debug( LDAP_DEBUG_ANY,
+			LDAP_XSTRING(mdb_tool_sort_write) ": %s: %s (%d)\n",
+			ai->ai_desc->ad_cname.bv_val,
+			rc > 0 ? mdb_strerror(rc) : "read failed", rc );
+	}
+
+	for ( i=0; i<nsrc; i++ ) {
+		ch_free( src[i].ptrs );
+		ch_free( src[i].buf );
+	}
+	ch_free( src );
+	ch_free( w.w_ids );
+	ch_free( w.w_key );
+	return rc;
+}
+
+static int
+mdb_tool_sort_slice( int slot )
+{
+	Operation op = {0};
+	Opheader ohdr = {0};
+	mdb_tool_sortx sx;
+	int i, hi, rc = 0;
+
+	op.o_hdr = &ohdr;
+	op.o_bd = mdb_tool_sort_be;
+	op.o_tmpmemctx = NULL;
+	op.o_tmpmfuncs = &ch_mfuncs;
+	sx.sx_oe.oe_key = (void *)&mdb_tool_sort_nslots;
+	sx.sx_slot = slot;
+	LDAP_SLIST_INSERT_HEAD( &op.o_extra, &sx.sx_oe, oe_next );
+
+	i = mdb_tool_sort_nbatch * slot / mdb_tool_sort_nthreads;
+	hi = mdb_tool_sort_nbatch * ( slot + 1 ) / mdb_tool_sort_nthreads;
+	for ( ; i < hi && rc == 0; i++ )
+		rc = mdb_index_entry_add( &op, NULL, mdb_tool_sort_batch[i] );
+	return rc;
+}
+
+static void *
+mdb_tool_sort_task( void *ptr )
+{
+	int slot = (int)(long)ptr, rc;
+	unsigned gen = 0;
+
+	ldap_pvt_thread_mutex_lock( &mdb_tool_sort_mutex );
+	for (;;) {
+		while ( gen == mdb_tool_sort_gen && !mdb_tool_sort_stop )
+			ldap_pvt_thread_cond_wait( &mdb_tool_sort_cond_work,
+				&mdb_tool_sort_mutex );
+		if ( mdb_tool_sort_stop )
+			break;
+		gen = mdb_tool_sort_gen;
+		ldap_pvt_thread_mutex_unlock( &mdb_tool_sort_mutex );
+
+		rc = mdb_tool_sort_slice( slot );
+
+		ldap_pvt_thread_mutex_lock( &mdb_tool_sort_mutex );
+		if ( rc && !mdb_tool_sort_rc )
+			mdb_tool_sort_rc = rc;
+		if ( --mdb_tool_sort_busy == 0 )
+			ldap_pvt_thread_cond_signal( &mdb_tool_sort_cond_done );
+	}
+	ldap_pvt_thread_mutex_unlock( &mdb_tool_sort_mutex );
+	return NULL;
+}
+
+/* Generate the keys of the queued entries, one slice per thread */
+static int
+mdb_tool_sort_run( BackendDB *be )
+{
+	int rc;
+
+	ldap_pvt_thread_mutex_lock( &mdb_tool_sort_mutex );
+	mdb_tool_sort_gen++;
+	mdb_tool_sort_busy = mdb_tool_sort_nthreads - 1;
+	mdb_tool_sort_rc = 0;
+	ldap_pvt_thread_cond_broadcast( &mdb_tool_sort_cond_work );
+	ldap_pvt_thread_mutex_unlock( &mdb_tool_sort_mutex );
+
+	rc = mdb_tool_sort_slice( 0 );
+
+	ldap_pvt_thread_mutex_lock( &mdb_tool_sort_mutex );
+	while ( mdb_tool_sort_busy )
+		ldap_pvt_thread_cond_wait( &mdb_tool_sort_cond_done,
+			&mdb_tool_sort_mutex );
+	if ( rc == 0 )
+		rc = mdb_tool_sort_rc;
+	ldap_pvt_thread_mutex_unlock( &mdb_tool_sort_mutex );
+
+	mdb_tool_sort_drop( be );
+	return rc;
+}
+
+/* Release the queued entries */
+static void
+mdb_tool_sort_drop( BackendDB *be )
+{
+	Operation op = {0};
+	Opheader ohdr = {0};
+	int i;
+
+	op.o_hdr = &ohdr;
+	op.o_bd = be;
+	op.o_tmpmemctx = NULL;
+	op.o_tmpmfuncs = &ch_mfuncs;
+	for ( i=0; i<mdb_tool_sort_nbatch; i++ )
+		mdb_entry_release( &op, mdb_tool_sort_batch[i], 0 );
+	mdb_tool_sort_nbatch = 0;
+}
+
+static void
+mdb_tool_sort_shutdown( void )
+{
+	int i;
+
+	ldap_pvt_thread_mutex_lock( &mdb_tool_sort_mutex );
+	mdb_tool_sort_stop = 1;
+	ldap_pvt_thread_cond_broadcast( &mdb_tool_sort_cond_work );
+	ldap_pvt_thread_mutex_unlock( &mdb_tool_sort_mutex );
+	for ( i=1; i<mdb_tool_sort_nthreads; i++ )
+		ldap_pvt_thread_join( mdb_tool_sort_tids[i-1], NULL );
+
+	ldap_pvt_thread_cond_destroy( &mdb_tool_sort_cond_done );
+	ldap_pvt_thread_cond_destroy( &mdb_tool_sort_cond_work );
+	ldap_pvt_thread_mutex_destroy( &mdb_tool_sort_mutex );
+	ch_free( mdb_tool_sort_tids );
+	mdb_tool_sort_tids = NULL;
+	ch_free( mdb_tool_sort_batch );
+	mdb_tool_sort_batch = NULL;
+	mdb_tool_sort_nthreads = 0;
+	mdb_tool_sort_stop = 0;
+}
+
+static void
+mdb_tool_reindex_init( BackendDB *be )
+{
+	struct mdb_info *mdb = (struct mdb_info *) be->be_private;
+	int i;
+
+	mdb_tool_reindexing = 1;
+	mdb_tool_reindex_count = 0;
+	gettimeofday( &mdb_tool_reindex_start, NULL );
+
+	if ( MDB_TOOL_SORTING && slap_tool_thread_max > 1 ) {
+		mdb_tool_sort_nthreads = slap_tool_thread_max;
+		mdb_tool_sort_nslots = mdb_tool_sort_nthreads;
+		mdb_tool_sort_be = be;
+		mdb_tool_sort_batch = ch_malloc( mdb_writes_per_commit *
+			sizeof( Entry * ));
+		mdb_tool_sort_nbatch = 0;
+		ldap_pvt_thread_mutex_init( &mdb_tool_sort_mutex );
+		ldap_pvt_thread_cond_init( &mdb_tool_sort_cond_work );
+		ldap_pvt_thread_cond_init( &mdb_tool_sort_cond_done );
+		mdb_tool_sort_tids = ch_malloc( ( mdb_tool_sort_nthreads - 1 ) *
+			sizeof( ldap_pvt_thread_t ));
+		for ( i=1; i<mdb_tool_sort_nthreads; i++ )
+			ldap_pvt_thread_create( &mdb_tool_sort_tids[i-1], 0,
+				mdb_tool_sort_task, (void *)(long)i );
+	}
+
+	/* spools hold the key counts even when not sorting */
+	for ( i=0; i<mdb->mi_nattrs; i++ ) {
+		if ( !mdb->mi_attrs[i]->ai_spool )
+			mdb->mi_attrs[i]->ai_spool = ch_calloc( mdb_tool_sort_nslots,
+				sizeof( mdb_tool_spool ));
+	}
+
+	if ( isatty( 2 )) {
+		MDB_cursor *mc;
+		MDB_val key, data;
+		ID last = 0;
+
+		if ( mdb_cursor_open( mdb_tool_txn, mdb->mi_id2entry, &mc ) == 0 ) {
+			if ( mdb_cursor_get( mc, &key, &data, MDB_LAST ) == 0 )
+				memcpy( &last, key.mv_data, sizeof( ID ));
+			mdb_cursor_close( mc );
+		}
+		mdb_tool_meter_on = last && !lutil_meter_open( &mdb_tool_meter,
+			&lutil_meter_text_display, &lutil_meter_linear_estimator,
+			last );
+	}
+}
+
+static void
+mdb_tool_reindex_report( struct mdb_info *mdb )
+{
+	struct timeval now;
+	double secs;
+	int i, j;
+
+	gettimeofday( &now, NULL );
+	secs = ( now.tv_sec - mdb_tool_reindex_start.tv_sec ) +
+		( now.tv_usec - mdb_tool_reindex_start.tv_usec ) / 1000000.0;
+	if ( secs <= 0 )
+		secs = 0.000001;
+
+	fprintf( stderr, "indexed %lu entries in %.2f seconds\n",
+		mdb_tool_reindex_count, secs );
+	for ( i=0; i<mdb->mi_nattrs; i++ ) {
+		AttrInfo *ai = mdb->mi_attrs[i];
+		mdb_tool_spool *sp = ai->ai_spool;
+		unsigned long nkeys = 0;
+
+		if ( !sp )
+			continue;
+		for ( j=0; j<mdb_tool_sort_nslots; j++ )
+			nkeys += sp[j].nkeys;
+		fprintf( stderr, "  %-24s %12lu keys %12.0f keys/s\n",
+			ai->ai_desc->ad_cname.bv_val, nkeys, nkeys / secs );
+	}
+}
+
+static int
+mdb_tool_sort_flush( BackendDB *be )
+{
+	struct mdb_info *mdb = (struct mdb_info *) be->be_private;
+	AttrInfo *ai;
+	int i, rc = 0;
+
+	if ( !mdb )
+		return 0;
+
+	for ( i=0; i<mdb->mi_nattrs && rc == 0; i++ ) {
+		ai = mdb->mi_attrs[i];
+		if ( ai->ai_spool )
+			rc = mdb_tool_sort_write( be, ai, ai->ai_spool );
+	}
+
+	if ( mdb_tool_meter_on ) {
+		lutil_meter_update( &mdb_tool_meter, mdb_tool_reindex_last, 1 );
+		lutil_meter_close( &mdb_tool_meter );
+		mdb_tool_meter_on = 0;
+	}
+	if ( mdb_tool_reindexing && rc == 0 )
+		mdb_tool_reindex_report( mdb );
+	mdb_tool_reindexing = 0;
+
+	for ( i=0; i<mdb->mi_nattrs; i++ ) {
+		ai = mdb->mi_attrs[i];
+		if ( ai->ai_spool ) {
+			mdb_tool_spool_free( ai->ai_spool );
+			ai->ai_spool = NULL;
+		}
+	}
+	mdb_tool_sort_nslots = 1;
+	return rc;
+}
+
 /* Upgrade from pre 2.4.34 dn2id format */
 
 #include <ac/unistd.h>
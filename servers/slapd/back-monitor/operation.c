@@ -171,8 +171,8 @@ monitor_subsys_ops_update(
 {
 	monitor_info_t		*mi = ( monitor_info_t * )op->o_bd->be_private;
 
-	ldap_pvt_mp_t		nInitiated = LDAP_PVT_MP_INIT,
-				nCompleted = LDAP_PVT_MP_INIT;
+	slap_counter_t		nInitiated = 0,
+				nCompleted = 0;
 	struct berval		rdn;
 	int 			i;
 	Attribute		*a;
@@ -185,32 +185,25 @@ monitor_subsys_ops_update(
 	dnRdn( &e->e_nname, &rdn );
 
 	if ( dn_match( &rdn, &bv_ops ) ) {
-		ldap_pvt_mp_init( nInitiated );
-		ldap_pvt_mp_init( nCompleted );
-
 		ldap_pvt_thread_mutex_lock( &slap_counters.sc_mutex );
-		ldap_pvt_mp_add( nInitiated, slap_counters.sc_ops_initiated );
-		ldap_pvt_mp_add( nCompleted, slap_counters.sc_ops_completed );
+		nInitiated = slap_counters.sc_ops_initiated;
+		nCompleted = slap_counters.sc_ops_completed;
 		for ( sc = slap_counters.sc_next; sc; sc = sc->sc_next ) {
-			ldap_pvt_thread_mutex_lock( &sc->sc_mutex );
-			ldap_pvt_mp_add( nInitiated, sc->sc_ops_initiated );
-			ldap_pvt_mp_add( nCompleted, sc->sc_ops_completed );
-			ldap_pvt_thread_mutex_unlock( &sc->sc_mutex );
+			nInitiated += sc->sc_ops_initiated;
+			nCompleted += sc->sc_ops_completed;
 		}
 		ldap_pvt_thread_mutex_unlock( &slap_counters.sc_mutex );
-		
+
 	} else {
 		for ( i = 0; i < SLAP_OP_LAST; i++ ) {
 			if ( dn_match( &rdn, &monitor_op[ i ].nrdn ) )
 			{
 				ldap_pvt_thread_mutex_lock( &slap_counters.sc_mutex );
-				ldap_pvt_mp_init_set( nInitiated, slap_counters.sc_ops_initiated_[ i ] );
-				ldap_pvt_mp_init_set( nCompleted, slap_counters.sc_ops_completed_[ i ] );
+				nInitiated = slap_counters.sc_ops_initiated_[ i ];
+				nCompleted = slap_counters.sc_ops_completed_[ i ];
 				for ( sc = slap_counters.sc_next; sc; sc = sc->sc_next ) {
-					ldap_pvt_thread_mutex_lock( &sc->sc_mutex );
-					ldap_pvt_mp_add( nInitiated, sc->sc_ops_initiated_[ i ] );
-					ldap_pvt_mp_add( nCompleted, sc->sc_ops_completed_[ i ] );
-					ldap_pvt_thread_mutex_unlock( &sc->sc_mutex );
+					nInitiated += sc->sc_ops_initiated_[ i ];
+					nCompleted += sc->sc_ops_completed_[ i ];
 				}
 				ldap_pvt_thread_mutex_unlock( &slap_counters.sc_mutex );
 				break;
@@ -227,15 +220,13 @@ monitor_subsys_ops_update(
 	assert ( a != NULL );
 
 	/* NOTE: no minus sign is allowed in the counters... */
-	UI2BV( &a->a_vals[ 0 ], nInitiated );
-	ldap_pvt_mp_clear( nInitiated );
+	SLAP_COUNTER2BV( &a->a_vals[ 0 ], nInitiated );
 	
 	a = attr_find( e->e_attrs, mi->mi_ad_monitorOpCompleted );
 	assert ( a != NULL );
 
 	/* NOTE: no minus sign is allowed in the counters... */
-	UI2BV( &a->a_vals[ 0 ], nCompleted );
-	ldap_pvt_mp_clear( nCompleted );
+	SLAP_COUNTER2BV( &a->a_vals[ 0 ], nCompleted );
 
 	/* FIXME: touch modifyTimestamp? */
 
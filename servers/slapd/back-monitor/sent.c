@@ -43,6 +43,9 @@ enum {
 	MONITOR_SENT_PDU,
 	MONITOR_SENT_ENTRIES,
 	MONITOR_SENT_REFERRALS,
+	MONITOR_SENT_GROUPCACHE_ENTRIES,
+	MONITOR_SENT_GROUPCACHE_HITS,
+	MONITOR_SENT_GROUPCACHE_MISSES,
 
 	MONITOR_SENT_LAST
 };
@@ -55,6 +58,9 @@ struct monitor_sent_t {
 	{ BER_BVC("cn=PDU"),		BER_BVNULL },
 	{ BER_BVC("cn=Entries"),	BER_BVNULL },
 	{ BER_BVC("cn=Referrals"),	BER_BVNULL },
+	{ BER_BVC("cn=Group Cache Entries"),	BER_BVNULL },
+	{ BER_BVC("cn=Group Cache Hits"),	BER_BVNULL },
+	{ BER_BVC("cn=Group Cache Misses"),	BER_BVNULL },
 	{ BER_BVNULL,			BER_BVNULL }
 };
 
@@ -164,7 +170,7 @@ monitor_subsys_sent_update(
 	monitor_info_t	*mi = ( monitor_info_t *)op->o_bd->be_private;
 	
 	struct berval		nrdn;
-	ldap_pvt_mp_t		n;
+	slap_counter_t		n = 0;
 	Attribute		*a;
 	slap_counters_t *sc;
 	int			i;
@@ -184,55 +190,63 @@ monitor_subsys_sent_update(
 		return SLAP_CB_CONTINUE;
 	}
 
+	if ( i >= MONITOR_SENT_GROUPCACHE_ENTRIES ) {
+		unsigned long	count, hits, misses;
+
+		group_cache_stats( &count, &hits, &misses );
+		switch ( i ) {
+		case MONITOR_SENT_GROUPCACHE_ENTRIES:
+			n = count;
+			break;
+
+		case MONITOR_SENT_GROUPCACHE_HITS:
+			n = hits;
+			break;
+
+		case MONITOR_SENT_GROUPCACHE_MISSES:
+			n = misses;
+			break;
+		}
+		goto done;
+	}
+
 	ldap_pvt_thread_mutex_lock(&slap_counters.sc_mutex);
 	switch ( i ) {
 	case MONITOR_SENT_ENTRIES:
-		ldap_pvt_mp_init_set( n, slap_counters.sc_entries );
-		for ( sc = slap_counters.sc_next; sc; sc = sc->sc_next ) {
-			ldap_pvt_thread_mutex_lock( &sc->sc_mutex );
-			ldap_pvt_mp_add( n, sc->sc_entries );
-			ldap_pvt_thread_mutex_unlock( &sc->sc_mutex );
-		}
+		n = slap_counters.sc_entries;
+		for ( sc = slap_counters.sc_next; sc; sc = sc->sc_next )
+			n += sc->sc_entries;
 		break;
 
 	case MONITOR_SENT_REFERRALS:
-		ldap_pvt_mp_init_set( n, slap_counters.sc_refs );
-		for ( sc = slap_counters.sc_next; sc; sc = sc->sc_next ) {
-			ldap_pvt_thread_mutex_lock( &sc->sc_mutex );
-			ldap_pvt_mp_add( n, sc->sc_refs );
-			ldap_pvt_thread_mutex_unlock( &sc->sc_mutex );
-		}
+		n = slap_counters.sc_refs;
+		for ( sc = slap_counters.sc_next; sc; sc = sc->sc_next )
+			n += sc->sc_refs;
 		break;
 
 	case MONITOR_SENT_PDU:
-		ldap_pvt_mp_init_set( n, slap_counters.sc_pdu );
-		for ( sc = slap_counters.sc_next; sc; sc = sc->sc_next ) {
-			ldap_pvt_thread_mutex_lock( &sc->sc_mutex );
-			ldap_pvt_mp_add( n, sc->sc_pdu );
-			ldap_pvt_thread_mutex_unlock( &sc->sc_mutex );
-		}
+		n = slap_counters.sc_pdu;
+		for ( sc = slap_counters.sc_next; sc; sc = sc->sc_next )
+			n += sc->sc_pdu;
 		break;
 
 	case MONITOR_SENT_BYTES:
-		ldap_pvt_mp_init_set( n, slap_counters.sc_bytes );
-		for ( sc = slap_counters.sc_next; sc; sc = sc->sc_next ) {
-			ldap_pvt_thread_mutex_lock( &sc->sc_mutex );
-			ldap_pvt_mp_add( n, sc->sc_bytes );
-			ldap_pvt_thread_mutex_unlock( &sc->sc_mutex );
-		}
+		n = slap_counters.sc_bytes;
+		for ( sc = slap_counters.sc_next; sc; sc = sc->sc_next )
+			n += sc->sc_bytes;
 		break;
 
 	default:
 		assert(0);
 	}
 	ldap_pvt_thread_mutex_unlock(&slap_counters.sc_mutex);
-	
+
+done:
 	a = attr_find( e->e_attrs, mi->mi_ad_monitorCounter );
 	assert( a != NULL );
 
 	/* NOTE: no minus sign is allowed in the counters... */
-	UI2BV( &a->a_vals[ 0 ], n );
-	ldap_pvt_mp_clear( n );
+	SLAP_COUNTER2BV( &a->a_vals[ 0 ], n );
 
 	/* FIXME: touch modifyTimestamp? */
 
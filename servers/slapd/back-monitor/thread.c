@@ -34,6 +34,13 @@ typedef enum {
 	MT_UNKNOWN,
 	MT_RUNQUEUE,
 	MT_TASKLIST,
+	MT_VERIFY_THREADS,
+	MT_VERIFY_PENDING,
+	MT_VERIFY_ACTIVE,
+	MT_VERIFY_COMPLETED,
+	MT_VERIFY_BUSY,
+	MT_VERIFY_LATENCY,
+	MT_VERIFY_LATENCY_MAX,
 
 	MT_LAST
 } monitor_thread_t;
@@ -88,6 +95,28 @@ static struct {
 		BER_BVC("List of running plus standby threads - besides those handling operations"),
 		BER_BVNULL,	LDAP_PVT_THREAD_POOL_PARAM_UNKNOWN,	MT_TASKLIST },
 
+	{ BER_BVC( "cn=Verify Threads" ),
+		BER_BVC("Number of password verification threads"),
+		BER_BVNULL,	LDAP_PVT_THREAD_POOL_PARAM_UNKNOWN,	MT_VERIFY_THREADS },
+	{ BER_BVC( "cn=Verify Pending" ),
+		BER_BVC("Number of password verifications waiting for a thread"),
+		BER_BVNULL,	LDAP_PVT_THREAD_POOL_PARAM_UNKNOWN,	MT_VERIFY_PENDING },
+	{ BER_BVC( "cn=Verify Active" ),
+		BER_BVC("Number of password verifications in progress"),
+		BER_BVNULL,	LDAP_PVT_THREAD_POOL_PARAM_UNKNOWN,	MT_VERIFY_ACTIVE },
+	{ BER_BVC( "cn=Verify Completed" ),
+		BER_BVC("Number of password verifications completed"),
+		BER_BVNULL,	LDAP_PVT_THREAD_POOL_PARAM_UNKNOWN,	MT_VERIFY_COMPLETED },
+	{ BER_BVC( "cn=Verify Busy" ),
+		BER_BVC("Number of binds refused because the verification queue was full"),
+		BER_BVNULL,	LDAP_PVT_THREAD_POOL_PARAM_UNKNOWN,	MT_VERIFY_BUSY },
+	{ BER_BVC( "cn=Verify Latency" ),
+		BER_BVC("Average password verification time in microseconds, queueing included"),
+		BER_BVNULL,	LDAP_PVT_THREAD_POOL_PARAM_UNKNOWN,	MT_VERIFY_LATENCY },
+	{ BER_BVC( "cn=Verify Latency Max" ),
+		BER_BVC("Longest password verification time in microseconds, queueing included"),
+		BER_BVNULL,	LDAP_PVT_THREAD_POOL_PARAM_UNKNOWN,	MT_VERIFY_LATENCY_MAX },
+
 	{ BER_BVNULL }
 };
 
@@ -96,6 +125,45 @@ monitor_subsys_thread_update(
 	Operation		*op,
 	SlapReply		*rs,
 	Entry 			*e );
+
+/* format a password verification pool statistic */
+static void
+monitor_thread_verify( monitor_thread_t which, char *buf, size_t len,
+	struct berval *bv )
+{
+	slap_pwverify_stats	ps;
+	unsigned long		val = 0;
+
+	slap_pwverify_query( &ps );
+	switch ( which ) {
+	case MT_VERIFY_THREADS:
+		val = ps.ps_threads;
+		break;
+	case MT_VERIFY_PENDING:
+		val = ps.ps_pending;
+		break;
+	case MT_VERIFY_ACTIVE:
+		val = ps.ps_active;
+		break;
+	case MT_VERIFY_COMPLETED:
+		val = ps.ps_verified;
+		break;
+	case MT_VERIFY_BUSY:
+		val = ps.ps_busy;
+		break;
+	case MT_VERIFY_LATENCY:
+		if ( ps.ps_verified )
+			val = ps.ps_usec / ps.ps_verified;
+		break;
+	case MT_VERIFY_LATENCY_MAX:
+		val = ps.ps_usec_max;
+		break;
+	default:
+		assert( 0 );
+	}
+	bv->bv_val = buf;
+	bv->bv_len = snprintf( buf, len, "%lu", val );
+}
 #endif /* ! NO_THREADS */
 
 /*
@@ -154,6 +222,9 @@ monitor_subsys_thread_init(
 
 		switch ( mt[ i ].param ) {
 		case LDAP_PVT_THREAD_POOL_PARAM_UNKNOWN:
+			if ( mt[ i ].mt >= MT_VERIFY_THREADS ) {
+				monitor_thread_verify( mt[ i ].mt, buf, sizeof( buf ), &bv );
+			}
 			break;
 
 		case LDAP_PVT_THREAD_POOL_PARAM_STATE:
@@ -317,6 +388,22 @@ monitor_subsys_thread_update(
 			}
 			break;
 
+		case MT_VERIFY_THREADS:
+		case MT_VERIFY_PENDING:
+		case MT_VERIFY_ACTIVE:
+		case MT_VERIFY_COMPLETED:
+		case MT_VERIFY_BUSY:
+		case MT_VERIFY_LATENCY:
+		case MT_VERIFY_LATENCY_MAX:
+			if ( a == NULL ) {
+				return rs->sr_err = LDAP_OTHER;
+			}
+			monitor_thread_verify( mt[ which ].mt, buf, sizeof( buf ), &bv );
+			if ( bv.bv_len < sizeof( buf ) ) {
+				ber_bvreplace( &a->a_vals[ 0 ], &bv );
+			}
+			break;
+
 		default:
 			assert( 0 );
 		}
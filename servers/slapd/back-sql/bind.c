@@ -83,10 +83,12 @@ backsql_bind( Operation *op, SlapReply *rs )
 		goto error_return;
 	}
 
-	if ( slap_passwd_check( op, &e, a, &op->oq_bind.rb_cred,
-				&rs->sr_text ) != 0 )
+	rs->sr_err = slap_passwd_check( op, &e, a, &op->oq_bind.rb_cred,
+				&rs->sr_text );
+	if ( rs->sr_err != 0 )
 	{
-		rs->sr_err = LDAP_INVALID_CREDENTIALS;
+		if ( rs->sr_err != LDAP_BUSY )
+			rs->sr_err = LDAP_INVALID_CREDENTIALS;
 		goto error_return;
 	}
 
@@ -68,8 +68,23 @@ struct wt_info {
 #define bv2ITEM(bv,item) ((item)->data = (bv)->bv_val, \
 						 (item)->size = (bv)->bv_len )
 
+/* a cursor kept open in a wt_ctx, reset rather than closed between uses */
+typedef struct wt_cursor_cache {
+	char *wcc_uri;
+	char *wcc_config;
+	WT_CURSOR *wcc_cursor;
+	int wcc_busy;
+} wt_cursor_cache;
+
+/* The number of cursors a wt_ctx keeps open */
+#define WT_CTX_CURSORS	32
+
 typedef struct {
 	WT_SESSION *session;
+	wt_cursor_cache cursors[WT_CTX_CURSORS];
+	int ncursors;
+	unsigned long cursor_hits;
+	unsigned long cursor_misses;
 } wt_ctx;
 
 /* for the cache of attribute information (which are indexed, etc.) */
@@ -55,6 +55,24 @@ void
 wt_ctx_free( void *key, void *data )
 {
 	wt_ctx *wc = data;
+	int i;
+
+	Debug( LDAP_DEBUG_STATS,
+		   LDAP_XSTRING(wt_ctx_free)
+		   ": cursor cache hits=%lu misses=%lu\n",
+		   wc->cursor_hits, wc->cursor_misses );
+
+	for( i = 0; i < wc->ncursors; i++ ){
+		wt_cursor_cache *cc = &wc->cursors[i];
+		if(wc->session){
+			cc->wcc_cursor->close(cc->wcc_cursor);
+		}
+		ch_free(cc->wcc_uri);
+		if(cc->wcc_config){
+			ch_free(cc->wcc_config);
+		}
+	}
+	wc->ncursors = 0;
 
 	if(wc->session){
 		wc->session->close(wc->session, NULL);
@@ -69,8 +87,9 @@ wt_ctx_get(Operation *op, struct wt_info *wi){
 	void *data;
 	wt_ctx *wc = NULL;
 
+	/* keyed on the database: the cached cursors belong to its connection */
 	rc = ldap_pvt_thread_pool_getkey(op->o_threadctx,
-									 wt_ctx_get, &data, NULL );
+									 wi, &data, NULL );
 	if( rc ){
 		wc = wt_ctx_init(wi);
 		if( !wc ) {
@@ -80,7 +99,7 @@ wt_ctx_get(Operation *op, struct wt_info *wi){
 			return NULL;
 		}
 		rc = ldap_pvt_thread_pool_setkey( op->o_threadctx,
-										  wt_ctx_get, wc, wt_ctx_free,
+										  wi, wc, wt_ctx_free,
 										  NULL, NULL );
 		if( rc ) {
 			Debug( LDAP_DEBUG_ANY, "wt_ctx: setkey error(%d)\n",
@@ -92,6 +111,77 @@ wt_ctx_get(Operation *op, struct wt_info *wi){
 	return (wt_ctx *)data;
 }
 
+static int
+wt_ctx_config_eq(const char *a, const char *b)
+{
+	if( !a || !b ){
+		return a == b;
+	}
+	return !strcmp(a, b);
+}
+
+/*
+ * Get a cursor on uri from the cursors kept open in this context,
+ * opening one if none is free. Release it with wt_ctx_close_cursor().
+ */
+int
+wt_ctx_open_cursor(
+	wt_ctx *wc,
+	const char *uri,
+	const char *config,
+	WT_CURSOR **cursorp)
+{
+	wt_cursor_cache *cc;
+	int i, rc;
+
+	for( i = 0; i < wc->ncursors; i++ ){
+		cc = &wc->cursors[i];
+		/* a busy cursor is still in use by a caller up the stack */
+		if( !cc->wcc_busy &&
+			!strcmp(cc->wcc_uri, uri) &&
+			wt_ctx_config_eq(cc->wcc_config, config) ){
+			cc->wcc_busy = 1;
+			wc->cursor_hits++;
+			*cursorp = cc->wcc_cursor;
+			return 0;
+		}
+	}
+
+	wc->cursor_misses++;
+	rc = wc->session->open_cursor(wc->session, uri, NULL, config, cursorp);
+	if( rc ){
+		return rc;
+	}
+
+	if( wc->ncursors < WT_CTX_CURSORS ){
+		cc = &wc->cursors[wc->ncursors++];
+		cc->wcc_uri = ch_strdup(uri);
+		cc->wcc_config = config ? ch_strdup(config) : NULL;
+		cc->wcc_cursor = *cursorp;
+		cc->wcc_busy = 1;
+	}
+	return 0;
+}
+
+/*
+ * Give back a cursor from wt_ctx_open_cursor(). Cached cursors are
+ * reset, which releases their position and snapshot, others are closed.
+ */
+void
+wt_ctx_close_cursor(wt_ctx *wc, WT_CURSOR *cursor)
+{
+	int i;
+
+	for( i = 0; i < wc->ncursors; i++ ){
+		if( wc->cursors[i].wcc_cursor == cursor ){
+			cursor->reset(cursor);
+			wc->cursors[i].wcc_busy = 0;
+			return;
+		}
+	}
+	cursor->close(cursor);
+}
+
 WT_CURSOR *
 wt_ctx_index_cursor(wt_ctx *wc, struct berval *name, int create)
 {
@@ -102,8 +192,7 @@ wt_ctx_index_cursor(wt_ctx *wc, struct berval *name, int create)
 
 	snprintf(tablename, sizeof(tablename), "table:%s", name->bv_val);
 
-	rc = session->open_cursor(session, tablename, NULL,
-							  "overwrite=false", &cursor);
+	rc = wt_ctx_open_cursor(wc, tablename, "overwrite=false", &cursor);
 	if (rc == ENOENT && create) {
 		rc = session->create(session,
 							 tablename,
@@ -117,8 +206,7 @@ wt_ctx_index_cursor(wt_ctx *wc, struct berval *name, int create)
 				   tablename, wiredtiger_strerror(rc), rc);
 			return NULL;
 		}
-		rc = session->open_cursor(session, tablename, NULL,
-								  "overwrite=false", &cursor);
+		rc = wt_ctx_open_cursor(wc, tablename, "overwrite=false", &cursor);
 	}
 	if ( rc ) {
 		Debug( LDAP_DEBUG_ANY,
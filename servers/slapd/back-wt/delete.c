@@ -270,7 +270,7 @@ wt_delete( Operation *op, SlapReply *rs )
 	}
 
     /* Can't do it if we have kids */
-	rc = wt_dn2id_has_children( op, wc->session, e->e_id );
+	rc = wt_dn2id_has_children( op, wc, e->e_id );
 	if( rc != WT_NOTFOUND ) {
 		switch( rc ) {
 		case 0:
@@ -304,7 +304,7 @@ wt_delete( Operation *op, SlapReply *rs )
 	}
 
 	/* delete from dn2id */
-	rc = wt_dn2id_delete( op, wc->session, &e->e_nname);
+	rc = wt_dn2id_delete( op, wc, &e->e_nname);
 	if ( rc ) {
 		Debug(LDAP_DEBUG_TRACE,
 			  "<== " LDAP_XSTRING(wt_delete)
@@ -336,7 +336,7 @@ wt_delete( Operation *op, SlapReply *rs )
 		assert( !BER_BVISNULL( &op->o_csn ) );
 		vals[0] = op->o_csn;
 		BER_BVZERO( &vals[1] );
-		rs->sr_err = wt_index_values( op, wc->session, slap_schema.si_ad_entryCSN,
+		rs->sr_err = wt_index_values( op, wc, slap_schema.si_ad_entryCSN,
 									  vals, 0, SLAP_INDEX_ADD_OP );
 		if ( rs->sr_err != LDAP_SUCCESS ) {
 			rs->sr_text = "entryCSN index update failed";
@@ -347,7 +347,7 @@ wt_delete( Operation *op, SlapReply *rs )
 	}
 
 	/* delete from id2entry */
-	rc = wt_id2entry_delete( op, wc->session, e );
+	rc = wt_id2entry_delete( op, wc, e );
 	if ( rc ) {
 		Debug( LDAP_DEBUG_TRACE,
 			   "<== " LDAP_XSTRING(wt_delete)
@@ -41,16 +41,13 @@ int wt_dn2entry( BackendDB *be,
 	int rc;
 	int eoff;
 	Entry *e = NULL;
-	WT_SESSION *session = wc->session;
 
 	if( ndn->bv_len == 0 ){
 		/* parent of root dn */
 		return WT_NOTFOUND;
 	}
 
-	rc = session->open_cursor(session,
-							  WT_INDEX_DN"(id, entry)",
-							  NULL, NULL, &cursor);
+	rc = wt_ctx_open_cursor(wc, WT_INDEX_DN"(id, entry)", NULL, &cursor);
 	if ( rc ) {
 		Debug( LDAP_DEBUG_ANY,
 			   LDAP_XSTRING(wt_dn2entry)
@@ -97,7 +94,7 @@ int wt_dn2entry( BackendDB *be,
 
 done:
 	if(cursor){
-		cursor->close(cursor);
+		wt_ctx_close_cursor(wc, cursor);
 	}
 	return rc;
 }
@@ -57,7 +57,7 @@ mkrevdn(struct berval src){
 int
 wt_dn2id_add(
 	Operation *op,
-	WT_SESSION *session,
+	wt_ctx *wc,
 	ID pid,
 	Entry *e)
 {
@@ -72,8 +72,7 @@ wt_dn2id_add(
 	/* make reverse dn */
 	revdn = mkrevdn(e->e_nname);
 
-	rc = session->open_cursor(session, WT_TABLE_DN2ID, NULL,
-							  NULL, &cursor);
+	rc = wt_ctx_open_cursor(wc, WT_TABLE_DN2ID, NULL, &cursor);
 	if(rc){
 		Debug( LDAP_DEBUG_ANY,
 			   LDAP_XSTRING(wt_dn2id_add)
@@ -97,7 +96,7 @@ done:
 		ch_free(revdn);
 	}
 	if(cursor){
-		cursor->close(cursor);
+		wt_ctx_close_cursor(wc, cursor);
 	}
 	Debug( LDAP_DEBUG_TRACE, "<= wt_dn2id_add 0x%lx: %d\n", e->e_id, rc );
 	return rc;
@@ -106,7 +105,7 @@ done:
 int
 wt_dn2id_delete(
 	Operation *op,
-	WT_SESSION *session,
+	wt_ctx *wc,
 	struct berval *ndn)
 {
 	int rc = 0;
@@ -114,8 +113,7 @@ wt_dn2id_delete(
 
 	Debug( LDAP_DEBUG_TRACE, "=> wt_dn2id_delete %s\n", ndn->bv_val );
 
-	rc = session->open_cursor(session, WT_TABLE_DN2ID, NULL,
-							  NULL, &cursor);
+	rc = wt_ctx_open_cursor(wc, WT_TABLE_DN2ID, NULL, &cursor);
 	if ( rc ) {
 		Debug( LDAP_DEBUG_ANY,
 			   LDAP_XSTRING(wt_dn2id_delete)
@@ -139,7 +137,7 @@ wt_dn2id_delete(
 		   ndn->bv_val, rc );
 done:
 	if(cursor){
-		cursor->close(cursor);
+		wt_ctx_close_cursor(wc, cursor);
 	}
 	return rc;
 }
@@ -147,7 +145,7 @@ done:
 int
 wt_dn2id(
 	Operation *op,
-	WT_SESSION *session,
+	wt_ctx *wc,
     struct berval *ndn,
     ID *id)
 {
@@ -164,9 +162,7 @@ wt_dn2id(
 		goto done;
 	}
 
-	rc = session->open_cursor(session, WT_TABLE_DN2ID
-							  "(id)",
-                              NULL, NULL, &cursor);
+	rc = wt_ctx_open_cursor(wc, WT_TABLE_DN2ID"(id)", NULL, &cursor);
 	if( rc ){
 		Debug( LDAP_DEBUG_ANY,
 			   LDAP_XSTRING(wt_dn2id)
@@ -200,7 +196,7 @@ wt_dn2id(
 
 done:
 	if(cursor){
-		cursor->close(cursor);
+		wt_ctx_close_cursor(wc, cursor);
 	}
 
 	if( rc ) {
@@ -217,7 +213,7 @@ done:
 int
 wt_dn2id_has_children(
 	Operation *op,
-	WT_SESSION *session,
+	wt_ctx *wc,
 	ID id )
 {
 	struct wt_info *wi = (struct wt_info *) op->o_bd->be_private;
@@ -225,8 +221,7 @@ wt_dn2id_has_children(
 	int rc;
 	uint64_t key = id;
 
-	rc = session->open_cursor(session, WT_INDEX_PID,
-                              NULL, NULL, &cursor);
+	rc = wt_ctx_open_cursor(wc, WT_INDEX_PID, NULL, &cursor);
 	if( rc ){
 		Debug( LDAP_DEBUG_ANY,
 			   LDAP_XSTRING(wt_dn2id_has_children)
@@ -240,7 +235,7 @@ wt_dn2id_has_children(
 
 done:
 	if(cursor){
-		cursor->close(cursor);
+		wt_ctx_close_cursor(wc, cursor);
 	}
 
 	return rc;
@@ -249,7 +244,7 @@ done:
 int
 wt_dn2idl(
 	Operation *op,
-	WT_SESSION *session,
+	wt_ctx *wc,
 	struct berval *ndn,
 	Entry *e,
 	ID *ids,
@@ -276,8 +271,7 @@ wt_dn2idl(
 
 	revdn = mkrevdn(*ndn);
 	revdn_len = strlen(revdn);
-	rc = session->open_cursor(session, WT_INDEX_REVDN"(id, pid)",
-                              NULL, NULL, &cursor);
+	rc = wt_ctx_open_cursor(wc, WT_INDEX_REVDN"(id, pid)", NULL, &cursor);
 	if( rc ){
 		Debug( LDAP_DEBUG_ANY,
 			   LDAP_XSTRING(wt_dn2idl)
@@ -347,7 +341,7 @@ done:
 		ch_free(revdn);
 	}
 	if(cursor){
-		cursor->close(cursor);
+		wt_ctx_close_cursor(wc, cursor);
 	}
 	return rc;
 }
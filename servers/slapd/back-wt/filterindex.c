@@ -86,7 +86,7 @@ presence_candidates(
 	rc = wt_key_read( op->o_bd, cursor, &prefix, ids, NULL, 0 );
 
 	if(cursor){
-		cursor->close(cursor);
+		wt_ctx_close_cursor(wc, cursor);
 	}
 	Debug(LDAP_DEBUG_TRACE,
 		  "<= wt_presence_candidates: id=%ld first=%ld last=%ld\n",
@@ -119,7 +119,7 @@ equality_candidates(
 
 	if ( ava->aa_desc == slap_schema.si_ad_entryDN ) {
 		ID id = NOID;
-		rc = wt_dn2id(op, wc->session, &ava->aa_value, &id);
+		rc = wt_dn2id(op, wc, &ava->aa_value, &id);
 		if( rc == 0 ){
 			wt_idl_append_one(ids, id);
 		}else if ( rc == WT_NOTFOUND ) {
@@ -216,7 +216,7 @@ equality_candidates(
 	ber_bvarray_free_x( keys, op->o_tmpmemctx );
 
 	if(cursor){
-		cursor->close(cursor);
+		wt_ctx_close_cursor(wc, cursor);
 	}
 
 	Debug( LDAP_DEBUG_TRACE,
@@ -228,6 +228,122 @@ equality_candidates(
 	return rc;
 }
 
+static int
+inequality_candidates(
+	Operation *op,
+	wt_ctx *wc,
+	AttributeAssertion *ava,
+	ID *ids,
+	ID *tmp,
+	int gtorlt )
+{
+	struct wt_info *wi = (struct wt_info *) op->o_bd->be_private;
+	slap_mask_t mask;
+	struct berval prefix = {0, NULL};
+	struct berval *keys = NULL;
+	int rc;
+	MatchingRule *mr;
+	WT_CURSOR *cursor = NULL;
+
+	Debug( LDAP_DEBUG_TRACE, "=> wt_inequality_candidates (%s)\n",
+		   ava->aa_desc->ad_cname.bv_val );
+
+	WT_IDL_ALL( wi, ids );
+
+	rc = wt_index_param( op->o_bd, ava->aa_desc, LDAP_FILTER_EQUALITY,
+						 &mask, &prefix );
+
+	if ( rc == LDAP_INAPPROPRIATE_MATCHING ) {
+		Debug( LDAP_DEBUG_ANY,
+			   "<= wt_inequality_candidates: (%s) not indexed\n",
+			   ava->aa_desc->ad_cname.bv_val );
+		return 0;
+	}
+
+	if( rc != LDAP_SUCCESS ) {
+		Debug( LDAP_DEBUG_ANY,
+			   "<= wt_inequality_candidates: (%s) index_param failed (%d)\n",
+			   ava->aa_desc->ad_cname.bv_val, rc );
+		return 0;
+	}
+
+	mr = ava->aa_desc->ad_type->sat_equality;
+	if( !mr ) {
+		return 0;
+	}
+
+	if( !mr->smr_filter ) {
+		return 0;
+	}
+
+	rc = (mr->smr_filter)(
+		LDAP_FILTER_EQUALITY,
+		mask,
+		ava->aa_desc->ad_type->sat_syntax,
+		mr,
+		&prefix,
+		&ava->aa_value,
+		&keys, op->o_tmpmemctx );
+
+	if( rc != LDAP_SUCCESS ) {
+		Debug( LDAP_DEBUG_TRACE,
+			   "<= wt_inequality_candidates: (%s, %s) "
+			   "MR filter failed (%d)\n",
+			   prefix.bv_val, ava->aa_desc->ad_cname.bv_val, rc );
+		return 0;
+	}
+
+	if( keys == NULL ) {
+		Debug( LDAP_DEBUG_TRACE,
+			   "<= wt_inequality_candidates: (%s) no keys\n",
+			   ava->aa_desc->ad_cname.bv_val );
+		return 0;
+	}
+
+	/* open index cursor */
+	cursor = wt_ctx_index_cursor(wc, &ava->aa_desc->ad_type->sat_cname, 0);
+	if( !cursor ) {
+		Debug( LDAP_DEBUG_ANY,
+			   "<= wt_inequality_candidates: open index cursor failed: %s\n",
+			   ava->aa_desc->ad_type->sat_cname.bv_val );
+		ber_bvarray_free_x( keys, op->o_tmpmemctx );
+		return 0;
+	}
+
+	/* one scan of the ordered equality keys from or up to ours */
+	rc = wt_key_read( op->o_bd, cursor, &keys[0], ids, NULL, gtorlt );
+	if( rc != LDAP_SUCCESS ) {
+		Debug( LDAP_DEBUG_TRACE,
+			   "<= wt_inequality_candidates: (%s) "
+			   "key read failed (%d)\n",
+			   ava->aa_desc->ad_cname.bv_val, rc );
+		WT_IDL_ALL( wi, ids );
+		rc = 0;
+	} else if ( !WT_IDL_IS_RANGE( ids ) && ids[0] > 1 ) {
+		ID i, j;
+
+		/* an entry with several values in the range was read once
+		 * for each of them */
+		wt_idl_sort( ids, tmp );
+		for ( i = 2, j = 1; i <= ids[0]; i++ ) {
+			if ( ids[i] != ids[j] )
+				ids[++j] = ids[i];
+		}
+		ids[0] = j;
+	}
+
+	ber_bvarray_free_x( keys, op->o_tmpmemctx );
+	wt_ctx_close_cursor(wc, cursor);
+
+	Debug( LDAP_DEBUG_TRACE,
+		   "<= wt_inequality_candidates: id=%ld, first=%ld, last=%ld\n",
+		   (long) ids[0],
+		   (long) WT_IDL_FIRST(ids),
+		   (long) WT_IDL_LAST(ids) );
+
+	return rc;
+}
+
 static int
 approx_candidates(
 	Operation *op,
@@ -347,7 +463,7 @@ approx_candidates(
 	ber_bvarray_free_x( keys, op->o_tmpmemctx );
 
 	if(cursor){
-		cursor->close(cursor);
+		wt_ctx_close_cursor(wc, cursor);
 	}
 
 	Debug( LDAP_DEBUG_TRACE,
@@ -476,7 +592,7 @@ substring_candidates(
 	ber_bvarray_free_x( keys, op->o_tmpmemctx );
 
 	if(cursor){
-		cursor->close(cursor);
+		wt_ctx_close_cursor(wc, cursor);
 	}
 
 	Debug( LDAP_DEBUG_TRACE,
@@ -619,15 +735,22 @@ wt_filter_candidates(
 
 	case LDAP_FILTER_GE:
 		/* if no GE index, use pres */
-		/* TODO: not implement yet */
-		rc = presence_candidates( op, wc, f->f_ava->aa_desc, ids );
+		Debug( LDAP_DEBUG_FILTER, "\tGE\n" );
+		if( f->f_ava->aa_desc->ad_type->sat_ordering &&
+			( f->f_ava->aa_desc->ad_type->sat_ordering->smr_usage & SLAP_MR_ORDERED_INDEX ) )
+			rc = inequality_candidates( op, wc, f->f_ava, ids, tmp, LDAP_FILTER_GE );
+		else
+			rc = presence_candidates( op, wc, f->f_ava->aa_desc, ids );
 		break;
 
-    case LDAP_FILTER_LE:
+	case LDAP_FILTER_LE:
 		/* if no LE index, use pres */
-		/* TODO: not implement yet */
 		Debug( LDAP_DEBUG_FILTER, "\tLE\n" );
-		rc = presence_candidates( op, wc, f->f_ava->aa_desc, ids );
+		if( f->f_ava->aa_desc->ad_type->sat_ordering &&
+			( f->f_ava->aa_desc->ad_type->sat_ordering->smr_usage & SLAP_MR_ORDERED_INDEX ) )
+			rc = inequality_candidates( op, wc, f->f_ava, ids, tmp, LDAP_FILTER_LE );
+		else
+			rc = presence_candidates( op, wc, f->f_ava->aa_desc, ids );
 		break;
 
 	case LDAP_FILTER_NOT:
@@ -24,7 +24,7 @@
 
 static int wt_id2entry_put(
 	Operation *op,
-	WT_SESSION *session,
+	wt_ctx *wc,
 	Entry *e,
 	const char *config )
 {
@@ -40,8 +40,7 @@ static int wt_id2entry_put(
 	item.size = bv.bv_len;
 	item.data = bv.bv_val;
 
-	rc = session->open_cursor(session, WT_TABLE_ID2ENTRY, NULL,
-							  config, &cursor);
+	rc = wt_ctx_open_cursor(wc, WT_TABLE_ID2ENTRY, config, &cursor);
 	if ( rc ) {
 		Debug( LDAP_DEBUG_ANY,
 			   LDAP_XSTRING(wt_id2entry_put)
@@ -63,36 +62,35 @@ static int wt_id2entry_put(
 done:
 	ch_free( bv.bv_val );
 	if(cursor){
-		cursor->close(cursor);
+		wt_ctx_close_cursor(wc, cursor);
 	}
 	return rc;
 }
 
 int wt_id2entry_add(
 	Operation *op,
-	WT_SESSION *session,
+	wt_ctx *wc,
 	Entry *e )
 {
-	return wt_id2entry_put(op, session, e, "overwrite=false");
+	return wt_id2entry_put(op, wc, e, "overwrite=false");
 }
 
 int wt_id2entry_update(
 	Operation *op,
-	WT_SESSION *session,
+	wt_ctx *wc,
 	Entry *e )
 {
-	return wt_id2entry_put(op, session, e, "overwrite=true");
+	return wt_id2entry_put(op, wc, e, "overwrite=true");
 }
 
 int wt_id2entry_delete(
 	Operation *op,
-	WT_SESSION *session,
+	wt_ctx *wc,
 	Entry *e )
 {
 	int rc;
 	WT_CURSOR *cursor = NULL;
-	rc = session->open_cursor(session, WT_TABLE_ID2ENTRY, NULL,
-							  NULL, &cursor);
+	rc = wt_ctx_open_cursor(wc, WT_TABLE_ID2ENTRY, NULL, &cursor);
 	if ( rc ) {
 		Debug( LDAP_DEBUG_ANY,
 			   LDAP_XSTRING(wt_id2entry_delete)
@@ -112,13 +110,13 @@ int wt_id2entry_delete(
 
 done:
 	if(cursor){
-		cursor->close(cursor);
+		wt_ctx_close_cursor(wc, cursor);
 	}
 	return rc;
 }
 
 int wt_id2entry( BackendDB *be,
-				 WT_SESSION *session,
+				 wt_ctx *wc,
 				 ID id,
 				 Entry **ep ){
 	int rc;
@@ -128,8 +126,7 @@ int wt_id2entry( BackendDB *be,
 	int eoff;
 	Entry *e = NULL;
 
-	rc = session->open_cursor(session, WT_TABLE_ID2ENTRY"(entry)", NULL,
-							  NULL, &cursor);
+	rc = wt_ctx_open_cursor(wc, WT_TABLE_ID2ENTRY"(entry)", NULL, &cursor);
 	if ( rc ) {
 		Debug( LDAP_DEBUG_ANY,
 			   LDAP_XSTRING(wt_id2entry)
@@ -166,7 +163,7 @@ int wt_id2entry( BackendDB *be,
 
 done:
 	if(cursor){
-		cursor->close(cursor);
+		wt_ctx_close_cursor(wc, cursor);
 	}
 	return rc;
 }
@@ -237,7 +237,7 @@ static int indexer(
 
 done:
 	if(cursor){
-		cursor->close(cursor);
+		wt_ctx_close_cursor(wc, cursor);
 	}
 	return rc;
 }
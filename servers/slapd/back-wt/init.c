@@ -176,6 +176,9 @@ wt_db_close( BackendDB *be, ConfigReply *cr )
 	struct wt_info *wi = (struct wt_info *) be->be_private;
 	int rc;
 
+	/* close the sessions and cursors the threads keep open */
+	ldap_pvt_thread_pool_purgekey( wi );
+
 	rc = wi->wi_conn->close(wi->wi_conn, NULL);
 	if( rc ) {
 		Debug( LDAP_DEBUG_ANY,
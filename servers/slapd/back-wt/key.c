@@ -27,6 +27,75 @@
 #include "config.h"
 #include "idl.h"
 
+/*
+ * Read the IDs of all keys >= k (LDAP_FILTER_GE) or <= k (LDAP_FILTER_LE)
+ * of the same size as k. Matching rules flagged SLAP_MR_ORDERED_INDEX
+ * produce fixed size equality keys that sort like their values, so this
+ * is a range scan of the equality index. The IDs are not sorted.
+ */
+static int
+wt_key_range(
+	WT_CURSOR *cursor,
+	WT_ITEM *key,
+	ID *ids,
+	int get_flag )
+{
+	WT_ITEM start, key2;
+	char zero[64], *zbuf = NULL;
+	int rc, exact;
+	ID id;
+
+	if ( get_flag == LDAP_FILTER_LE ) {
+		/* start at the lowest key of this size */
+		if ( key->size > sizeof(zero) ) {
+			zbuf = ch_malloc( key->size );
+		}
+		start.data = zbuf ? zbuf : zero;
+		start.size = key->size;
+		memset( (void *)start.data, 0, start.size );
+	} else {
+		start = *key;
+	}
+
+	cursor->set_key(cursor, &start, 0);
+	rc = cursor->search_near(cursor, &exact);
+	if ( rc == 0 && exact < 0 ) {
+		rc = cursor->next(cursor);
+	}
+
+	while ( rc == 0 ) {
+		rc = cursor->get_key(cursor, &key2, &id);
+		if( rc ){
+			Debug( LDAP_DEBUG_ANY,
+				   LDAP_XSTRING(wt_key_range)
+				   ": get_key failed: %s (%d)\n",
+				   wiredtiger_strerror(rc), rc );
+			break;
+		}
+		/* A raw column that is not the last one is packed with its
+		 * size in front, so keys sort by size first: the keys of the
+		 * same size as ours are contiguous.
+		 */
+		if ( key2.size != key->size ) {
+			break;
+		}
+		if ( get_flag == LDAP_FILTER_LE &&
+			 memcmp( key2.data, key->data, key->size ) > 0 ) {
+			break;
+		}
+		wt_idl_append_one(ids, id);
+		rc = cursor->next(cursor);
+	}
+
+	if ( zbuf ) {
+		ch_free( zbuf );
+	}
+	if ( rc == WT_NOTFOUND ) {
+		rc = 0;
+	}
+	return rc;
+}
+
 /* read a key */
 int
 wt_key_read(
@@ -49,6 +118,11 @@ wt_key_read(
 	WT_IDL_ZERO(ids);
 
 	bv2ITEM(k, &key);
+	if ( get_flag == LDAP_FILTER_GE || get_flag == LDAP_FILTER_LE ) {
+		rc = wt_key_range( cursor, &key, ids, get_flag );
+		goto done;
+	}
+
 	cursor->set_key(cursor, &key, 0);
 	rc = cursor->search_near(cursor, &exact);
 	if( rc ){
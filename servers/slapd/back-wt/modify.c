@@ -580,7 +580,7 @@ wt_modify( Operation *op, SlapReply *rs )
 	}
 
 	/* change the entry itself */
-	rs->sr_err = wt_id2entry_update( op, wc->session, &dummy );
+	rs->sr_err = wt_id2entry_update( op, wc, &dummy );
 	if ( rs->sr_err != 0 ) {
 		Debug( LDAP_DEBUG_TRACE,
 			   LDAP_XSTRING(wt_modify) ": id2entry update failed " "(%d)\n",
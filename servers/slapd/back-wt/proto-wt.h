@@ -32,9 +32,10 @@ void wt_attr_flush( struct wt_info *wi );
 /*
  * id2entry.c
  */
-int wt_id2entry_add(Operation *op, WT_SESSION *session, Entry *e );
-int wt_id2entry_update(Operation *op, WT_SESSION *session, Entry *e );
-int wt_id2entry_delete(Operation *op, WT_SESSION *session, Entry *e );
+int wt_id2entry_add(Operation *op, wt_ctx *wc, Entry *e );
+int wt_id2entry_update(Operation *op, wt_ctx *wc, Entry *e );
+int wt_id2entry_delete(Operation *op, wt_ctx *wc, Entry *e );
+int wt_id2entry(BackendDB *be, wt_ctx *wc, ID id, Entry **ep);
 
 BI_entry_release_rw wt_entry_release;
 BI_entry_get_rw wt_entry_get;
@@ -50,6 +51,7 @@ unsigned wt_idl_search( ID *ids, ID id );
 
 ID wt_idl_first( ID *ids, ID *cursor );
 ID wt_idl_next( ID *ids, ID *cursor );
+void wt_idl_sort( ID *ids, ID *tmp );
 
 
 /*
@@ -110,23 +112,38 @@ int wt_back_init_cf( BackendInfo *bi );
 int
 wt_dn2id(
 	Operation *op,
-	WT_SESSION *session,
+	wt_ctx *wc,
     struct berval *ndn,
     ID *id);
 
 int
 wt_dn2id_add(
 	Operation *op,
-	WT_SESSION *session,
+	wt_ctx *wc,
 	ID pid,
 	Entry *e);
 
 int
 wt_dn2id_delete(
 	Operation *op,
-	WT_SESSION *session,
+	wt_ctx *wc,
 	struct berval *ndn);
 
+int
+wt_dn2id_has_children(
+	Operation *op,
+	wt_ctx *wc,
+	ID id );
+
+int
+wt_dn2idl(
+	Operation *op,
+	wt_ctx *wc,
+	struct berval *ndn,
+	Entry *e,
+	ID *ids,
+	ID *stack);
+
 /*
  * dn2entry.c
  */
@@ -146,6 +163,9 @@ int wt_dn2pentry( BackendDB *be,
 wt_ctx *wt_ctx_init(struct wt_info *wi);
 void wt_ctx_free(void *key, void *data);
 wt_ctx *wt_ctx_get(Operation *op, struct wt_info *wi);
+int wt_ctx_open_cursor(wt_ctx *wc, const char *uri, const char *config,
+					   WT_CURSOR **cursorp);
+void wt_ctx_close_cursor(wt_ctx *wc, WT_CURSOR *cursor);
 WT_CURSOR *wt_ctx_index_cursor(wt_ctx *wc, struct berval *name, int create);
 
 
@@ -31,7 +31,7 @@ static int search_aliases(
 	Operation *op,
 	SlapReply *rs,
 	Entry *e,
-	WT_SESSION *session,
+	wt_ctx *wc,
 	ID *ids,
 	ID *scopes,
 	ID *stack )
@@ -193,11 +193,11 @@ static int search_candidates(
 	}
 
     if( op->ors_deref & LDAP_DEREF_SEARCHING ) {
-		rc = search_aliases( op, rs, e, wc->session, ids, scopes, stack );
+		rc = search_aliases( op, rs, e, wc, ids, scopes, stack );
 		if ( WT_IDL_IS_ZERO( ids ) && rc == LDAP_SUCCESS )
-			rc = wt_dn2idl( op, wc->session, &e->e_nname, e, ids, stack );
+			rc = wt_dn2idl( op, wc, &e->e_nname, e, ids, stack );
 	} else {
-		rc = wt_dn2idl(op, wc->session, &e->e_nname, e, ids, stack );
+		rc = wt_dn2idl(op, wc, &e->e_nname, e, ids, stack );
 	}
 
 	if ( rc == LDAP_SUCCESS ) {
@@ -549,7 +549,7 @@ loop_begin:
 
 	fetch_entry_retry:
 
-		rc = wt_id2entry(op->o_bd, wc->session, id, &e);
+		rc = wt_id2entry(op->o_bd, wc, id, &e);
 		/* TODO: error handling */
 		if ( e == NULL ) {
 			/* TODO: */
@@ -481,6 +481,8 @@ void backend_destroy_one( BackendDB *bd, int dynamic )
 	ldap_pvt_thread_mutex_destroy( &bd->be_pcl_mutex );
 
 	if ( dynamic ) {
+		/* cached group results refer to this database */
+		group_cache_flush();
 		free( bd );
 	}
 }
@@ -1452,6 +1454,7 @@ fe_acl_group(
 	GroupAssertion *g;
 	Backend *be = op->o_bd;
 	OpExtra		*oex;
+	int cache = 0;
 
 	LDAP_SLIST_FOREACH(oex, &op->o_extra, oe_next) {
 		if ( oex->oe_key == (void *)backend_group )
@@ -1485,10 +1488,29 @@ fe_acl_group(
 		rc = 0;
 
 	} else {
+		/* the target may be an uncommitted version of the group,
+		 * so only results read from the database are shared */
+		if ( slap_group_cache_max && op->o_bd &&
+			SLAP_GROUPCACHE( op->o_bd ) &&
+			op->o_tag != LDAP_REQ_BIND && !op->o_do_not_cache )
+		{
+			rc = group_cache_get( op->o_bd, gr_ndn, op_ndn,
+				group_oc, group_at );
+			if ( rc >= 0 ) {
+				goto done;
+			}
+			cache = 1;
+		}
 		op->o_private = NULL;
 		rc = be_entry_get_rw( op, gr_ndn, group_oc, group_at, 0, &e );
 		e_priv = op->o_private;
 		op->o_private = o_priv;
+		if ( rc != LDAP_SUCCESS && rc != LDAP_NO_SUCH_OBJECT &&
+			rc != LDAP_NO_SUCH_ATTRIBUTE )
+		{
+			/* don't remember transient failures */
+			cache = 0;
+		}
 	}
 
 	if ( e ) {
@@ -1508,6 +1530,9 @@ fe_acl_group(
 				void *user_priv = NULL;
 				Backend *b2 = op->o_bd;
 
+				/* the result depends on the user entry too */
+				cache = 0;
+
 				if ( target && dn_match( &target->e_nname, op_ndn ) ) {
 					user = target;
 				}
@@ -1653,6 +1678,11 @@ loopit:
 		op->o_groups = g;
 	}
 
+	if ( cache ) {
+		group_cache_put( op->o_bd, gr_ndn, op_ndn, group_oc, group_at,
+			rc, op->o_groupgen );
+	}
+
 done:
 	op->o_bd = be;
 	return rc;
@@ -203,6 +203,10 @@ enum {
 	CFG_TLS_CACERT,
 	CFG_TLS_CERT,
 	CFG_TLS_KEY,
+	CFG_GROUPCACHE,
+	CFG_PWVERIFY_THREADS,
+	CFG_PWVERIFY_QUEUE,
+	CFG_DNCACHE,
 
 	CFG_LAST
 };
@@ -390,6 +394,10 @@ static ConfigTable config_back_cf_table[] = {
 			"SUBSTR caseIgnoreSubstringsMatch "
 			"SYNTAX OMsDirectoryString X-ORDERED 'VALUES' )",
 			NULL, NULL },
+	{ "dncache", "entries", 2, 2, 0, ARG_UINT|ARG_MAGIC|CFG_DNCACHE,
+		&config_generic, "( OLcfgGlAt:103 NAME 'olcDnCacheSize' "
+			"EQUALITY integerMatch "
+			"SYNTAX OMsInteger SINGLE-VALUE )", NULL, NULL },
 	{ "extra_attrs", "attrlist", 2, 2, 0, ARG_DB|ARG_MAGIC,
 		&config_extra_attrs, "( OLcfgDbAt:0.20 NAME 'olcExtraAttrs' "
 			"EQUALITY caseIgnoreMatch "
@@ -403,6 +411,10 @@ static ConfigTable config_back_cf_table[] = {
 		"( OLcfgGlAt:17 NAME 'olcGentleHUP' "
 			"EQUALITY booleanMatch "
 			"SYNTAX OMsBoolean SINGLE-VALUE )", NULL, NULL },
+	{ "groupcache", "entries", 2, 2, 0, ARG_UINT|ARG_MAGIC|CFG_GROUPCACHE,
+		&config_generic, "( OLcfgGlAt:100 NAME 'olcGroupCacheSize' "
+			"EQUALITY integerMatch "
+			"SYNTAX OMsInteger SINGLE-VALUE )", NULL, NULL },
 	{ "hidden", "on|off", 2, 2, 0, ARG_DB|ARG_ON_OFF|ARG_MAGIC|CFG_HIDDEN,
 		&config_generic, "( OLcfgDbAt:0.17 NAME 'olcHidden' "
 			"EQUALITY booleanMatch "
@@ -529,6 +541,24 @@ static ConfigTable config_back_cf_table[] = {
 		&config_passwd_hash, "( OLcfgGlAt:36 NAME 'olcPasswordHash' "
 			"EQUALITY caseIgnoreMatch "
 			"SYNTAX OMsDirectoryString )", NULL, NULL },
+	{ "password-verify-queue", "count", 2, 2, 0,
+#ifdef NO_THREADS
+		ARG_IGNORED, NULL,
+#else
+		ARG_INT|ARG_MAGIC|CFG_PWVERIFY_QUEUE, &config_generic,
+#endif
+		"( OLcfgGlAt:102 NAME 'olcPasswordVerifyQueue' "
+			"EQUALITY integerMatch "
+			"SYNTAX OMsInteger SINGLE-VALUE )", NULL, NULL },
+	{ "password-verify-threads", "count", 2, 2, 0,
+#ifdef NO_THREADS
+		ARG_IGNORED, NULL,
+#else
+		ARG_INT|ARG_MAGIC|CFG_PWVERIFY_THREADS, &config_generic,
+#endif
+		"( OLcfgGlAt:101 NAME 'olcPasswordVerifyThreads' "
+			"EQUALITY integerMatch "
+			"SYNTAX OMsInteger SINGLE-VALUE )", NULL, NULL },
 	{ "pidfile", "file", 2, 2, 0, ARG_STRING,
 		&slapd_pid_file, "( OLcfgGlAt:37 NAME 'olcPidFile' "
 			"EQUALITY caseExactMatch "
@@ -940,12 +970,14 @@ static ConfigOCs cf_ocs[] = {
 		 "olcAttributeOptions $ olcAuthIDRewrite $ "
 		 "olcAuthzPolicy $ olcAuthzRegexp $ olcConcurrency $ "
 		 "olcConnMaxPending $ olcConnMaxPendingAuth $ "
-		 "olcDisallows $ olcGentleHUP $ olcIdleTimeout $ "
+		 "olcDisallows $ olcDnCacheSize $ olcGentleHUP $ olcGroupCacheSize $ "
+		 "olcIdleTimeout $ "
 		 "olcIndexSubstrIfMaxLen $ olcIndexSubstrIfMinLen $ "
 		 "olcIndexSubstrAnyLen $ olcIndexSubstrAnyStep $ olcIndexHash64 $ "
 		 "olcIndexIntLen $ "
 		 "olcListenerThreads $ olcLocalSSF $ olcLogFile $ olcLogLevel $ "
-		 "olcPasswordCryptSaltFormat $ olcPasswordHash $ olcPidFile $ "
+		 "olcPasswordCryptSaltFormat $ olcPasswordHash $ "
+		 "olcPasswordVerifyQueue $ olcPasswordVerifyThreads $ olcPidFile $ "
 		 "olcPluginLogFile $ olcReadOnly $ olcReferral $ "
 		 "olcReplogFile $ olcRequires $ olcRestrict $ olcReverseLookup $ "
 		 "olcRootDSE $ "
@@ -1067,6 +1099,18 @@ config_generic(ConfigArgs *c) {
 		case CFG_LTHREADS:
 			c->value_uint = slapd_daemon_threads;
 			break;
+		case CFG_GROUPCACHE:
+			c->value_uint = slap_group_cache_max;
+			break;
+		case CFG_DNCACHE:
+			c->value_uint = slap_dn_cache_max;
+			break;
+		case CFG_PWVERIFY_THREADS:
+			c->value_int = slap_pwverify_threads;
+			break;
+		case CFG_PWVERIFY_QUEUE:
+			c->value_int = slap_pwverify_queue;
+			break;
 		case CFG_SALT:
 			if ( passwd_salt )
 				c->value_string = ch_strdup( passwd_salt );
@@ -1547,6 +1591,22 @@ config_generic(ConfigArgs *c) {
 				SLAP_INDEX_INTLEN_DEFAULT );
 			break;
 
+		case CFG_GROUPCACHE:
+			group_cache_resize( 0 );
+			break;
+
+		case CFG_DNCACHE:
+			dn_cache_resize( SLAP_DN_CACHE_DEFAULT );
+			break;
+
+		case CFG_PWVERIFY_THREADS:
+			slap_pwverify_set( 0, slap_pwverify_queue );
+			break;
+
+		case CFG_PWVERIFY_QUEUE:
+			slap_pwverify_set( slap_pwverify_threads, SLAP_PWVERIFY_QUEUE );
+			break;
+
 		case CFG_ACL:
 			if ( c->valx < 0 ) {
 				acl_destroy( c->be->be_acl );
@@ -2082,6 +2142,29 @@ config_generic(ConfigArgs *c) {
 				index_intlen );
 			break;
 
+		case CFG_GROUPCACHE:
+			group_cache_resize( c->value_uint );
+			break;
+
+		case CFG_DNCACHE:
+			dn_cache_resize( c->value_uint );
+			break;
+
+		case CFG_PWVERIFY_THREADS:
+		case CFG_PWVERIFY_QUEUE:
+			if ( c->value_int < ( c->type == CFG_PWVERIFY_QUEUE ? 1 : 0 )) {
+				snprintf( c->cr_msg, sizeof( c->cr_msg ),
+					"<%s> invalid value %d", c->argv[0], c->value_int );
+				Debug(LDAP_DEBUG_ANY, "%s: %s.\n",
+					c->log, c->cr_msg );
+				return 1;
+			}
+			if ( c->type == CFG_PWVERIFY_THREADS )
+				slap_pwverify_set( c->value_int, slap_pwverify_queue );
+			else
+				slap_pwverify_set( slap_pwverify_threads, c->value_int );
+			break;
+
 		case CFG_SORTVALS: {
 			ADlist *svnew = NULL, *svtail, *sv;
 
@@ -958,28 +958,17 @@ void connection_done( Connection *c )
  */
 
 #ifdef SLAPD_MONITOR
-/* FIXME: returns 0 in case of failure */
 #define INCR_OP_INITIATED(index) \
-	do { \
-		ldap_pvt_thread_mutex_lock( &op->o_counters->sc_mutex ); \
-		ldap_pvt_mp_add_ulong(op->o_counters->sc_ops_initiated_[(index)], 1); \
-		ldap_pvt_thread_mutex_unlock( &op->o_counters->sc_mutex ); \
-	} while (0)
+	SLAP_COUNTER_ADD( op->o_counters, sc_ops_initiated_[(index)], 1 )
 #define INCR_OP_COMPLETED(index) \
 	do { \
-		ldap_pvt_thread_mutex_lock( &op->o_counters->sc_mutex ); \
-		ldap_pvt_mp_add_ulong(op->o_counters->sc_ops_completed, 1); \
-		ldap_pvt_mp_add_ulong(op->o_counters->sc_ops_completed_[(index)], 1); \
-		ldap_pvt_thread_mutex_unlock( &op->o_counters->sc_mutex ); \
+		SLAP_COUNTER_ADD( op->o_counters, sc_ops_completed, 1 ); \
+		SLAP_COUNTER_ADD( op->o_counters, sc_ops_completed_[(index)], 1 ); \
 	} while (0)
 #else /* !SLAPD_MONITOR */
 #define INCR_OP_INITIATED(index) do { } while (0)
 #define INCR_OP_COMPLETED(index) \
-	do { \
-		ldap_pvt_thread_mutex_lock( &op->o_counters->sc_mutex ); \
-		ldap_pvt_mp_add_ulong(op->o_counters->sc_ops_completed, 1); \
-		ldap_pvt_thread_mutex_unlock( &op->o_counters->sc_mutex ); \
-	} while (0)
+	SLAP_COUNTER_ADD( op->o_counters, sc_ops_completed, 1 )
 #endif /* !SLAPD_MONITOR */
 
 /*
@@ -1014,16 +1003,16 @@ conn_counter_destroy( void *key, void *data )
 
 			*prev = sc->sc_next;
 			/* Copy data to main counter */
-			ldap_pvt_mp_add( slap_counters.sc_bytes, sc->sc_bytes );
-			ldap_pvt_mp_add( slap_counters.sc_pdu, sc->sc_pdu );
-			ldap_pvt_mp_add( slap_counters.sc_entries, sc->sc_entries );
-			ldap_pvt_mp_add( slap_counters.sc_refs, sc->sc_refs );
-			ldap_pvt_mp_add( slap_counters.sc_ops_initiated, sc->sc_ops_initiated );
-			ldap_pvt_mp_add( slap_counters.sc_ops_completed, sc->sc_ops_completed );
+			slap_counters.sc_bytes += sc->sc_bytes;
+			slap_counters.sc_pdu += sc->sc_pdu;
+			slap_counters.sc_entries += sc->sc_entries;
+			slap_counters.sc_refs += sc->sc_refs;
+			slap_counters.sc_ops_initiated += sc->sc_ops_initiated;
+			slap_counters.sc_ops_completed += sc->sc_ops_completed;
 #ifdef SLAPD_MONITOR
 			for ( i = 0; i < SLAP_OP_LAST; i++ ) {
-				ldap_pvt_mp_add( slap_counters.sc_ops_initiated_[ i ], sc->sc_ops_initiated_[ i ] );
-				ldap_pvt_mp_add( slap_counters.sc_ops_initiated_[ i ], sc->sc_ops_completed_[ i ] );
+				slap_counters.sc_ops_initiated_[ i ] += sc->sc_ops_initiated_[ i ];
+				slap_counters.sc_ops_completed_[ i ] += sc->sc_ops_completed_[ i ];
 			}
 #endif /* SLAPD_MONITOR */
 			slap_counters_destroy( sc );
@@ -1045,6 +1034,7 @@ conn_counter_init( Operation *op, void *ctx )
 		vsc = ch_malloc( sizeof( slap_counters_t ));
 		sc = vsc;
 		slap_counters_init( sc );
+		sc->sc_owner = ldap_pvt_thread_self();
 		ldap_pvt_thread_pool_setkey( ctx, (void*)conn_counter_init, vsc,
 			conn_counter_destroy, NULL, NULL );
 
@@ -1102,13 +1092,11 @@ connection_operation( void *ctx, void *arg_v )
 	}
 	op->o_qtime.tv_sec -= op->o_time;
 	conn_counter_init( op, ctx );
-	ldap_pvt_thread_mutex_lock( &op->o_counters->sc_mutex );
-	/* FIXME: returns 0 in case of failure */
-	ldap_pvt_mp_add_ulong(op->o_counters->sc_ops_initiated, 1);
-	ldap_pvt_thread_mutex_unlock( &op->o_counters->sc_mutex );
+	SLAP_COUNTER_ADD( op->o_counters, sc_ops_initiated, 1 );
 
 	op->o_threadctx = ctx;
 	op->o_tid = ldap_pvt_thread_pool_tid( ctx );
+	op->o_groupgen = group_cache_gen();
 
 	switch ( tag ) {
 	case LDAP_REQ_BIND:
@@ -2107,6 +2095,7 @@ operation_fake_init(
 	op->o_tmpmfuncs = &slap_sl_mfuncs;
 	op->o_threadctx = ctx;
 	op->o_tid = ldap_pvt_thread_pool_tid( ctx );
+	op->o_groupgen = group_cache_gen();
 
 	op->o_counters = &slap_counters;
 	op->o_conn = conn;
@@ -426,7 +426,13 @@ dnNormalize(
 
 	Debug( LDAP_DEBUG_TRACE, ">>> dnNormalize: <%s>\n", val->bv_val ? val->bv_val : "" );
 
-	if ( val->bv_len != 0 ) {
+	if ( val->bv_len == 0 ) {
+		ber_dupbv_x( out, val, ctx );
+
+	} else if ( dn_cache_get( val, NULL, out, ctx ) == 0 ) {
+		/* normalized before */
+
+	} else {
 		LDAPDN		dn = NULL;
 		int		rc;
 
@@ -459,8 +465,8 @@ dnNormalize(
 		if ( rc != LDAP_SUCCESS ) {
 			return LDAP_INVALID_SYNTAX;
 		}
-	} else {
-		ber_dupbv_x( out, val, ctx );
+
+		dn_cache_put( val, NULL, out );
 	}
 
 	Debug( LDAP_DEBUG_TRACE, "<<< dnNormalize: <%s>\n", out->bv_val ? out->bv_val : "" );
@@ -544,6 +550,9 @@ dnPretty(
 	} else if ( val->bv_len > SLAP_LDAPDN_MAXLEN ) {
 		return LDAP_INVALID_SYNTAX;
 
+	} else if ( dn_cache_get( val, out, NULL, ctx ) == 0 ) {
+		/* prettied before */
+
 	} else {
 		LDAPDN		dn = NULL;
 		int		rc;
@@ -576,6 +585,8 @@ dnPretty(
 		if ( rc != LDAP_SUCCESS ) {
 			return LDAP_INVALID_SYNTAX;
 		}
+
+		dn_cache_put( val, out, NULL );
 	}
 
 	Debug( LDAP_DEBUG_TRACE, "<<< dnPretty: <%s>\n", out->bv_val ? out->bv_val : "" );
@@ -715,6 +726,9 @@ dnPrettyNormal(
 		/* too big */
 		return LDAP_INVALID_SYNTAX;
 
+	} else if ( dn_cache_get( val, pretty, normal, ctx ) == 0 ) {
+		/* seen before */
+
 	} else {
 		LDAPDN		dn = NULL;
 		int		rc;
@@ -766,6 +780,8 @@ dnPrettyNormal(
 			pretty->bv_len = 0;
 			return LDAP_INVALID_SYNTAX;
 		}
+
+		dn_cache_put( val, pretty, normal );
 	}
 
 	Debug( LDAP_DEBUG_TRACE, "<<< dnPrettyNormal: <%s>, <%s>\n",
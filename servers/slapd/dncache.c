@@ -0,0 +1,328 @@
+/* dncache.c - cache of DN pretty/normalize results */
+/* $OpenLDAP$ */
+/* This work is part of OpenLDAP Software <http://www.openldap.org/>.
+ *
+ * Copyright 1998-2020 The OpenLDAP Foundation.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted only as authorized by the OpenLDAP
+ * Public License.
+ *
+ * A copy of this license is available in the file LICENSE in the
+ * top-level directory of the distribution or, alternatively, at
+ * <http://www.OpenLDAP.org/license.html>.
+ */
+
+/*
+ * dnPretty(), dnNormalize() and dnPrettyNormal() parse the DN, rewrite
+ * each RDN according to the schema and serialize it again.  The same
+ * few DNs (bind identities, group and member DNs, search bases) go
+ * through this over and over, so the results are remembered here,
+ * keyed by the exact input string.
+ *
+ * Lookups first try a small direct-mapped table private to the thread,
+ * then a shared direct-mapped table of "dncache" slots whose locks are
+ * striped by slot.  Both hold a copy of the input and its results.
+ * Entries are tagged with a generation that is bumped whenever an
+ * attribute type is added or removed, or the table is resized, which
+ * retires all of them at once.  Such changes only happen while the
+ * thread pool is paused or before it starts.
+ */
+
+#include "portable.h"
+
+#include <stdio.h>
+
+#include <ac/string.h>
+
+#include "slap.h"
+
+#define DNC_LOCKS	64
+#define DNC_THREAD_SLOTS	64
+#define DNC_MAXLEN	512	/* don't cache longer DNs */
+
+typedef struct dnc_entry {
+	unsigned long de_gen;
+	unsigned int de_hash;
+	struct berval de_val;
+	struct berval de_pretty;	/* BER_BVNULL if not known */
+	struct berval de_normal;	/* BER_BVNULL if not known */
+} dnc_entry;
+
+static struct {
+	ldap_pvt_thread_rdwr_t dc_locks[DNC_LOCKS];
+	dnc_entry **dc_slots;
+	unsigned int dc_size;	/* a power of 2, or 0 */
+	unsigned long dc_gen;
+	void *dc_mainctx;
+} dc;
+
+unsigned int slap_dn_cache_max = SLAP_DN_CACHE_DEFAULT;
+
+static unsigned int
+dnc_hash( struct berval *val )
+{
+	unsigned int h = 2166136261U;
+	ber_len_t i;
+
+	for ( i = 0; i < val->bv_len; i++ ) {
+		h ^= (unsigned char)val->bv_val[i];
+		h *= 16777619U;
+	}
+	return h;
+}
+
+static dnc_entry *
+dnc_entry_new(
+	unsigned int hash,
+	struct berval *val,
+	struct berval *pretty,
+	struct berval *normal )
+{
+	dnc_entry *de;
+	ber_len_t len;
+	char *p;
+
+	len = val->bv_len + 1;
+	if ( pretty ) len += pretty->bv_len + 1;
+	if ( normal ) len += normal->bv_len + 1;
+
+	de = ch_malloc( sizeof( dnc_entry ) + len );
+	de->de_gen = dc.dc_gen;
+	de->de_hash = hash;
+	p = (char *)(de+1);
+
+	de->de_val.bv_val = p;
+	de->de_val.bv_len = val->bv_len;
+	AC_MEMCPY( p, val->bv_val, val->bv_len );
+	p[val->bv_len] = '\0';
+	p += val->bv_len + 1;
+
+	BER_BVZERO( &de->de_pretty );
+	if ( pretty ) {
+		de->de_pretty.bv_val = p;
+		de->de_pretty.bv_len = pretty->bv_len;
+		AC_MEMCPY( p, pretty->bv_val, pretty->bv_len );
+		p[pretty->bv_len] = '\0';
+		p += pretty->bv_len + 1;
+	}
+
+	BER_BVZERO( &de->de_normal );
+	if ( normal ) {
+		de->de_normal.bv_val = p;
+		de->de_normal.bv_len = normal->bv_len;
+		AC_MEMCPY( p, normal->bv_val, normal->bv_len );
+		p[normal->bv_len] = '\0';
+		p += normal->bv_len + 1;
+	}
+
+	return de;
+}
+
+/* Can this entry answer for val, with the results asked for? */
+static int
+dnc_entry_match(
+	dnc_entry *de,
+	unsigned int hash,
+	struct berval *val,
+	struct berval *pretty,
+	struct berval *normal )
+{
+	return de && de->de_gen == dc.dc_gen && de->de_hash == hash &&
+		de->de_val.bv_len == val->bv_len &&
+		( !pretty || !BER_BVISNULL( &de->de_pretty )) &&
+		( !normal || !BER_BVISNULL( &de->de_normal )) &&
+		!memcmp( de->de_val.bv_val, val->bv_val, val->bv_len );
+}
+
+static void
+dnc_entry_copy(
+	dnc_entry *de,
+	struct berval *pretty,
+	struct berval *normal,
+	void *ctx )
+{
+	if ( pretty )
+		ber_dupbv_x( pretty, &de->de_pretty, ctx );
+	if ( normal )
+		ber_dupbv_x( normal, &de->de_normal, ctx );
+}
+
+static void
+dnc_thread_free( void *key, void *data )
+{
+	dnc_entry **slots = data;
+	int i;
+
+	for ( i = 0; i < DNC_THREAD_SLOTS; i++ ) {
+		if ( slots[i] )
+			ch_free( slots[i] );
+	}
+	ch_free( slots );
+}
+
+/* The calling thread's private table, if it has one */
+static dnc_entry **
+dnc_thread_slots( void )
+{
+	void *ctx, *data = NULL;
+
+	ctx = ldap_pvt_thread_pool_context();
+	/* threads outside the pool all share the main context */
+	if ( ctx == dc.dc_mainctx )
+		return NULL;
+
+	if ( ldap_pvt_thread_pool_getkey( ctx, (void *)dnc_thread_free,
+			&data, NULL ) ) {
+		data = ch_calloc( DNC_THREAD_SLOTS, sizeof( dnc_entry * ));
+		if ( ldap_pvt_thread_pool_setkey( ctx, (void *)dnc_thread_free,
+				data, dnc_thread_free, NULL, NULL ) ) {
+			ch_free( data );
+			return NULL;
+		}
+	}
+	return data;
+}
+
+void
+dn_cache_init( void )
+{
+	int i;
+
+	for ( i = 0; i < DNC_LOCKS; i++ )
+		ldap_pvt_thread_rdwr_init( &dc.dc_locks[i] );
+	dc.dc_mainctx = ldap_pvt_thread_pool_context();
+	dn_cache_resize( slap_dn_cache_max );
+}
+
+void
+dn_cache_destroy( void )
+{
+	int i;
+
+	dn_cache_resize( 0 );
+	for ( i = 0; i < DNC_LOCKS; i++ )
+		ldap_pvt_thread_rdwr_destroy( &dc.dc_locks[i] );
+}
+
+void
+dn_cache_resize( unsigned int max )
+{
+	dnc_entry **slots = NULL;
+	unsigned int i, size = 0;
+
+	if ( max ) {
+		for ( size = 1; size < max; size <<= 1 )
+			/* empty */ ;
+		slots = ch_calloc( size, sizeof( dnc_entry * ));
+	}
+
+	for ( i = 0; i < DNC_LOCKS; i++ )
+		ldap_pvt_thread_rdwr_wlock( &dc.dc_locks[i] );
+	for ( i = 0; i < dc.dc_size; i++ ) {
+		if ( dc.dc_slots[i] )
+			ch_free( dc.dc_slots[i] );
+	}
+	ch_free( dc.dc_slots );
+	dc.dc_slots = slots;
+	dc.dc_size = size;
+	dc.dc_gen++;
+	slap_dn_cache_max = max;
+	for ( i = 0; i < DNC_LOCKS; i++ )
+		ldap_pvt_thread_rdwr_wunlock( &dc.dc_locks[i] );
+}
+
+/* The schema changed, the cached results may no longer hold */
+void
+dn_cache_flush( void )
+{
+	dc.dc_gen++;
+}
+
+/*
+ * Look up val.  Returns 0 and copies the results asked for (pretty
+ * and/or normal, either may be NULL) into ctx on a hit, -1 on a miss.
+ */
+int
+dn_cache_get(
+	struct berval *val,
+	struct berval *pretty,
+	struct berval *normal,
+	void *ctx )
+{
+	dnc_entry **tslots, *de;
+	unsigned int hash, i;
+	int rc = -1;
+
+	if ( !dc.dc_size || val->bv_len > DNC_MAXLEN )
+		return -1;
+
+	hash = dnc_hash( val );
+
+	tslots = dnc_thread_slots();
+	if ( tslots ) {
+		de = tslots[hash & ( DNC_THREAD_SLOTS - 1 )];
+		if ( dnc_entry_match( de, hash, val, pretty, normal )) {
+			dnc_entry_copy( de, pretty, normal, ctx );
+			return 0;
+		}
+	}
+
+	i = hash & ( dc.dc_size - 1 );
+	ldap_pvt_thread_rdwr_rlock( &dc.dc_locks[i % DNC_LOCKS] );
+	de = dc.dc_slots[i];
+	if ( dnc_entry_match( de, hash, val, pretty, normal )) {
+		dnc_entry_copy( de, pretty, normal, ctx );
+		/* bring it into this thread's table too */
+		if ( tslots ) {
+			de = dnc_entry_new( hash, &de->de_val,
+				BER_BVISNULL( &de->de_pretty ) ? NULL : &de->de_pretty,
+				BER_BVISNULL( &de->de_normal ) ? NULL : &de->de_normal );
+		}
+		rc = 0;
+	}
+	ldap_pvt_thread_rdwr_runlock( &dc.dc_locks[i % DNC_LOCKS] );
+
+	if ( rc == 0 && tslots ) {
+		i = hash & ( DNC_THREAD_SLOTS - 1 );
+		if ( tslots[i] )
+			ch_free( tslots[i] );
+		tslots[i] = de;
+	}
+	return rc;
+}
+
+/* Remember the results computed for val; either may be NULL */
+void
+dn_cache_put(
+	struct berval *val,
+	struct berval *pretty,
+	struct berval *normal )
+{
+	dnc_entry **tslots, *de, *old;
+	unsigned int hash, i;
+
+	if ( !dc.dc_size || val->bv_len > DNC_MAXLEN )
+		return;
+
+	hash = dnc_hash( val );
+
+	tslots = dnc_thread_slots();
+	if ( tslots ) {
+		i = hash & ( DNC_THREAD_SLOTS - 1 );
+		if ( tslots[i] )
+			ch_free( tslots[i] );
+		tslots[i] = dnc_entry_new( hash, val, pretty, normal );
+	}
+
+	de = dnc_entry_new( hash, val, pretty, normal );
+	i = hash & ( dc.dc_size - 1 );
+	ldap_pvt_thread_rdwr_wlock( &dc.dc_locks[i % DNC_LOCKS] );
+	old = dc.dc_slots[i];
+	dc.dc_slots[i] = de;
+	ldap_pvt_thread_rdwr_wunlock( &dc.dc_locks[i % DNC_LOCKS] );
+
+	if ( old )
+		ch_free( old );
+}
@@ -37,15 +37,23 @@
 #include "component.h"
 #endif
 
+/* What a FilterProgram knows about one attribute of the current entry */
+typedef struct fp_slot {
+	Attribute *fs_attr;		/* first attribute of the description */
+	AccessControlState fs_acl;	/* checks of an assertion value */
+	AccessControlState fs_acl_nv;	/* checks without a value */
+} fp_slot;
+
 static int	test_filter_and( Operation *op, Entry *e, Filter *flist );
 static int	test_filter_or( Operation *op, Entry *e, Filter *flist );
-static int	test_substrings_filter( Operation *op, Entry *e, Filter *f);
+static int	test_substrings_filter( Operation *op, Entry *e, Filter *f,
+	fp_slot *fs );
 static int	test_ava_filter( Operation *op,
-	Entry *e, AttributeAssertion *ava, int type );
+	Entry *e, AttributeAssertion *ava, int type, fp_slot *fs );
 static int	test_mra_filter( Operation *op,
 	Entry *e, MatchingRuleAssertion *mra );
 static int	test_presence_filter( Operation *op,
-	Entry *e, AttributeDescription *desc );
+	Entry *e, AttributeDescription *desc, fp_slot *fs );
 
 
 /*
@@ -85,32 +93,32 @@ test_filter(
 
 	case LDAP_FILTER_EQUALITY:
 		Debug( LDAP_DEBUG_FILTER, "    EQUALITY\n" );
-		rc = test_ava_filter( op, e, f->f_ava, LDAP_FILTER_EQUALITY );
+		rc = test_ava_filter( op, e, f->f_ava, LDAP_FILTER_EQUALITY, NULL );
 		break;
 
 	case LDAP_FILTER_SUBSTRINGS:
 		Debug( LDAP_DEBUG_FILTER, "    SUBSTRINGS\n" );
-		rc = test_substrings_filter( op, e, f );
+		rc = test_substrings_filter( op, e, f, NULL );
 		break;
 
 	case LDAP_FILTER_GE:
 		Debug( LDAP_DEBUG_FILTER, "    GE\n" );
-		rc = test_ava_filter( op, e, f->f_ava, LDAP_FILTER_GE );
+		rc = test_ava_filter( op, e, f->f_ava, LDAP_FILTER_GE, NULL );
 		break;
 
 	case LDAP_FILTER_LE:
 		Debug( LDAP_DEBUG_FILTER, "    LE\n" );
-		rc = test_ava_filter( op, e, f->f_ava, LDAP_FILTER_LE );
+		rc = test_ava_filter( op, e, f->f_ava, LDAP_FILTER_LE, NULL );
 		break;
 
 	case LDAP_FILTER_PRESENT:
 		Debug( LDAP_DEBUG_FILTER, "    PRESENT\n" );
-		rc = test_presence_filter( op, e, f->f_desc );
+		rc = test_presence_filter( op, e, f->f_desc, NULL );
 		break;
 
 	case LDAP_FILTER_APPROX:
 		Debug( LDAP_DEBUG_FILTER, "    APPROX\n" );
-		rc = test_ava_filter( op, e, f->f_ava, LDAP_FILTER_APPROX );
+		rc = test_ava_filter( op, e, f->f_ava, LDAP_FILTER_APPROX, NULL );
 		break;
 
 	case LDAP_FILTER_AND:
@@ -528,7 +536,8 @@ test_ava_filter(
 	Operation	*op,
 	Entry		*e,
 	AttributeAssertion *ava,
-	int		type )
+	int		type,
+	fp_slot		*fs )
 {
 	int rc;
 	Attribute	*a;
@@ -537,8 +546,8 @@ test_ava_filter(
 	AttributeAliasing *a_alias = NULL;
 #endif
 
-	if ( !access_allowed( op, e,
-		ava->aa_desc, &ava->aa_value, ACL_SEARCH, NULL ) )
+	if ( !access_allowed( op, e, ava->aa_desc, &ava->aa_value, ACL_SEARCH,
+		fs ? &fs->fs_acl : NULL ) )
 	{
 		return LDAP_INSUFFICIENT_ACCESS;
 	}
@@ -612,7 +621,7 @@ test_ava_filter(
 	}
 #endif
 
-	for(a = attrs_find( e->e_attrs, ava->aa_desc );
+	for(a = fs ? fs->fs_attr : attrs_find( e->e_attrs, ava->aa_desc );
 		a != NULL;
 		a = attrs_find( a->a_next, ava->aa_desc ) )
 	{
@@ -813,12 +822,15 @@ static int
 test_presence_filter(
 	Operation	*op,
 	Entry		*e,
-	AttributeDescription *desc )
+	AttributeDescription *desc,
+	fp_slot		*fs )
 {
 	Attribute	*a;
 	int rc;
 
-	if ( !access_allowed( op, e, desc, NULL, ACL_SEARCH, NULL ) ) {
+	if ( !access_allowed( op, e, desc, NULL, ACL_SEARCH,
+		fs ? &fs->fs_acl_nv : NULL ) )
+	{
 		return LDAP_INSUFFICIENT_ACCESS;
 	}
 
@@ -845,7 +857,7 @@ test_presence_filter(
 
 	rc = LDAP_COMPARE_FALSE;
 
-	for(a = attrs_find( e->e_attrs, desc );
+	for(a = fs ? fs->fs_attr : attrs_find( e->e_attrs, desc );
 		a != NULL;
 		a = attrs_find( a->a_next, desc ) )
 	{
@@ -930,22 +942,23 @@ static int
 test_substrings_filter(
 	Operation	*op,
 	Entry	*e,
-	Filter	*f )
+	Filter	*f,
+	fp_slot	*fs )
 {
 	Attribute	*a;
 	int rc;
 
 	Debug( LDAP_DEBUG_FILTER, "begin test_substrings_filter\n" );
 
-	if ( !access_allowed( op, e,
-		f->f_sub_desc, NULL, ACL_SEARCH, NULL ) )
+	if ( !access_allowed( op, e, f->f_sub_desc, NULL, ACL_SEARCH,
+		fs ? &fs->fs_acl_nv : NULL ) )
 	{
 		return LDAP_INSUFFICIENT_ACCESS;
 	}
 
 	rc = LDAP_COMPARE_FALSE;
 
-	for(a = attrs_find( e->e_attrs, f->f_sub_desc );
+	for(a = fs ? fs->fs_attr : attrs_find( e->e_attrs, f->f_sub_desc );
 		a != NULL;
 		a = attrs_find( a->a_next, f->f_sub_desc ) )
 	{
@@ -984,3 +997,350 @@ test_substrings_filter(
 		rc );
 	return rc;
 }
+
+/*
+ * Filter programs
+ *
+ * A search evaluates the same filter against every candidate entry.
+ * filter_compile() flattens the filter once per operation into an
+ * array of nodes in preorder, each knowing where its subtree ends, and
+ * gives each attribute description the filter mentions a slot.  While
+ * an entry is tested, a slot remembers the first matching attribute of
+ * the entry and the ACL state for the description, so a description
+ * used by several assertions is looked up and access checked once.
+ * Checks made without a value (presence, substrings) keep a state of
+ * their own: access_allowed() caches their result without looking at
+ * value-specific ACLs, which must not be reused for an assertion value.
+ * Assertion values were already validated and normalized by
+ * get_filter(), and matching rules come with the attribute.
+ *
+ * The children of AND and OR nodes are ordered so that the cheapest
+ * ones are tried first, as they are the most likely to decide the
+ * result.  This can only change which result code is returned when
+ * several of the children are undefined or fail with different errors;
+ * TRUE and FALSE results are the same as test_filter()'s.
+ */
+
+#define FP_SLOTS	32	/* descriptions with a slot; the rest look up */
+
+typedef struct fp_op {
+	short fo_slot;		/* index into fp_descs, -1 if none */
+	int fo_next;		/* index of the node after this subtree */
+	Filter *fo_f;
+} fp_op;
+
+struct FilterProgram {
+	Filter *fp_filter;
+	int fp_nslots;
+	int fp_nops;
+	AttributeDescription *fp_descs[FP_SLOTS];
+	fp_op fp_ops[1];
+};
+
+typedef struct fp_ctx {
+	Operation *fc_op;
+	Entry *fc_e;
+	FilterProgram *fc_fp;
+	unsigned int fc_valid;	/* slots filled for fc_e */
+	fp_slot fc_slots[FP_SLOTS];
+} fp_ctx;
+
+static int
+fp_count( Filter *f )
+{
+	int n = 1;
+
+	switch ( f->f_choice ) {
+	case LDAP_FILTER_AND:
+	case LDAP_FILTER_OR:
+		for ( f = f->f_list; f != NULL; f = f->f_next )
+			n += fp_count( f );
+		break;
+	case LDAP_FILTER_NOT:
+		n += fp_count( f->f_not );
+		break;
+	}
+	return n;
+}
+
+/* A rough relative cost of evaluating f against an entry */
+static int
+fp_cost( Filter *f )
+{
+	int cost;
+
+	if ( f->f_choice & SLAPD_FILTER_UNDEFINED )
+		return 0;
+
+	switch ( f->f_choice ) {
+	case SLAPD_FILTER_COMPUTED:
+		return 0;
+	case LDAP_FILTER_PRESENT:
+		return 1;
+	case LDAP_FILTER_EQUALITY:
+		/* objectSubClassMatch looks up the class of every value */
+		if ( f->f_av_desc == slap_schema.si_ad_objectClass )
+			return 6;
+		return 2;
+	case LDAP_FILTER_GE:
+	case LDAP_FILTER_LE:
+		return 3;
+	case LDAP_FILTER_SUBSTRINGS:
+		return 4;
+	case LDAP_FILTER_APPROX:
+		return 5;
+	case LDAP_FILTER_NOT:
+		return fp_cost( f->f_not );
+	case LDAP_FILTER_AND:
+	case LDAP_FILTER_OR:
+		cost = 1;
+		for ( f = f->f_list; f != NULL; f = f->f_next )
+			cost += fp_cost( f );
+		return cost;
+	}
+	return 8;
+}
+
+static short
+fp_slot_of( FilterProgram *fp, Filter *f )
+{
+	AttributeDescription *ad;
+	int i;
+
+	if ( f->f_choice & SLAPD_FILTER_UNDEFINED )
+		return -1;
+
+	switch ( f->f_choice ) {
+	case LDAP_FILTER_EQUALITY:
+	case LDAP_FILTER_GE:
+	case LDAP_FILTER_LE:
+	case LDAP_FILTER_APPROX:
+#ifdef LDAP_COMP_MATCH
+		/* component filters may switch to the aliased attribute */
+		if ( f->f_ava->aa_cf )
+			return -1;
+#endif
+		ad = f->f_av_desc;
+		break;
+	case LDAP_FILTER_SUBSTRINGS:
+		ad = f->f_sub_desc;
+		break;
+	case LDAP_FILTER_PRESENT:
+		ad = f->f_desc;
+		break;
+	default:
+		return -1;
+	}
+
+	for ( i = 0; i < fp->fp_nslots; i++ ) {
+		if ( fp->fp_descs[i] == ad )
+			return i;
+	}
+	if ( i == FP_SLOTS )
+		return -1;
+	fp->fp_descs[fp->fp_nslots++] = ad;
+	return i;
+}
+
+static void
+fp_emit( Operation *op, FilterProgram *fp, Filter *f )
+{
+	fp_op *fo = &fp->fp_ops[fp->fp_nops++];
+
+	fo->fo_f = f;
+	fo->fo_slot = fp_slot_of( fp, f );
+
+	switch ( f->f_choice ) {
+	case LDAP_FILTER_AND:
+	case LDAP_FILTER_OR: {
+		Filter *sf, **kids;
+		int *costs, n, i, j;
+
+		for ( n = 0, sf = f->f_list; sf != NULL; sf = sf->f_next )
+			n++;
+		kids = op->o_tmpalloc( n * ( sizeof( Filter * ) + sizeof( int )),
+			op->o_tmpmemctx );
+		costs = (int *)( kids + n );
+
+		/* stable insertion sort by cost */
+		for ( i = 0, sf = f->f_list; sf != NULL; sf = sf->f_next, i++ ) {
+			int cost = fp_cost( sf );
+
+			for ( j = i; j > 0 && costs[j - 1] > cost; j-- ) {
+				kids[j] = kids[j - 1];
+				costs[j] = costs[j - 1];
+			}
+			kids[j] = sf;
+			costs[j] = cost;
+		}
+		for ( i = 0; i < n; i++ )
+			fp_emit( op, fp, kids[i] );
+		op->o_tmpfree( kids, op->o_tmpmemctx );
+		} break;
+
+	case LDAP_FILTER_NOT:
+		fp_emit( op, fp, f->f_not );
+		break;
+	}
+
+	fo->fo_next = fp->fp_nops;
+}
+
+FilterProgram *
+filter_compile( Operation *op, Filter *f )
+{
+	FilterProgram *fp;
+	int n;
+
+	if ( f == NULL )
+		return NULL;
+
+	n = fp_count( f );
+	fp = op->o_tmpalloc( sizeof( FilterProgram ) + ( n - 1 ) * sizeof( fp_op ),
+		op->o_tmpmemctx );
+	fp->fp_filter = f;
+	fp->fp_nslots = 0;
+	fp->fp_nops = 0;
+	fp_emit( op, fp, f );
+	assert( fp->fp_nops == n );
+
+	return fp;
+}
+
+void
+filter_program_free( Operation *op, FilterProgram *fp )
+{
+	if ( fp )
+		op->o_tmpfree( fp, op->o_tmpmemctx );
+}
+
+static fp_slot *
+fp_slot_get( fp_ctx *fc, int slot )
+{
+	static AccessControlState state_init = ACL_STATE_INIT;
+	fp_slot *fs;
+
+	if ( slot < 0 )
+		return NULL;
+
+	fs = &fc->fc_slots[slot];
+	if ( !( fc->fc_valid & ( 1U << slot ))) {
+		fs->fs_attr = attrs_find( fc->fc_e->e_attrs,
+			fc->fc_fp->fp_descs[slot] );
+		fs->fs_acl = state_init;
+		fs->fs_acl_nv = state_init;
+		fc->fc_valid |= 1U << slot;
+	}
+	return fs;
+}
+
+static int
+fp_test( fp_ctx *fc, int i )
+{
+	fp_op *ops = fc->fc_fp->fp_ops;
+	Filter *f = ops[i].fo_f;
+	int rc, j;
+
+	if ( f->f_choice & SLAPD_FILTER_UNDEFINED )
+		return SLAPD_COMPARE_UNDEFINED;
+
+	switch ( f->f_choice ) {
+	case SLAPD_FILTER_COMPUTED:
+		rc = f->f_result;
+		break;
+
+	case LDAP_FILTER_EQUALITY:
+	case LDAP_FILTER_GE:
+	case LDAP_FILTER_LE:
+	case LDAP_FILTER_APPROX:
+		rc = test_ava_filter( fc->fc_op, fc->fc_e, f->f_ava, f->f_choice,
+			fp_slot_get( fc, ops[i].fo_slot ));
+		break;
+
+	case LDAP_FILTER_SUBSTRINGS:
+		rc = test_substrings_filter( fc->fc_op, fc->fc_e, f,
+			fp_slot_get( fc, ops[i].fo_slot ));
+		break;
+
+	case LDAP_FILTER_PRESENT:
+		rc = test_presence_filter( fc->fc_op, fc->fc_e, f->f_desc,
+			fp_slot_get( fc, ops[i].fo_slot ));
+		break;
+
+	case LDAP_FILTER_AND:
+		rc = LDAP_COMPARE_TRUE;
+		for ( j = i + 1; j < ops[i].fo_next; j = ops[j].fo_next ) {
+			int rc2 = fp_test( fc, j );
+
+			if ( rc2 == LDAP_COMPARE_FALSE ) {
+				rc = rc2;
+				break;
+			}
+			if ( rc2 != LDAP_COMPARE_TRUE )
+				rc = rc2;
+		}
+		break;
+
+	case LDAP_FILTER_OR:
+		rc = LDAP_COMPARE_FALSE;
+		for ( j = i + 1; j < ops[i].fo_next; j = ops[j].fo_next ) {
+			int rc2 = fp_test( fc, j );
+
+			if ( rc2 == LDAP_COMPARE_TRUE ) {
+				rc = rc2;
+				break;
+			}
+			if ( rc2 != LDAP_COMPARE_FALSE )
+				rc = rc2;
+		}
+		break;
+
+	case LDAP_FILTER_NOT:
+		rc = fp_test( fc, i + 1 );
+		switch ( rc ) {
+		case LDAP_COMPARE_TRUE:
+			rc = LDAP_COMPARE_FALSE;
+			break;
+		case LDAP_COMPARE_FALSE:
+			rc = LDAP_COMPARE_TRUE;
+			break;
+		}
+		break;
+
+	default:
+		/* extensible match and anything unexpected */
+		rc = test_filter( fc->fc_op, fc->fc_e, f );
+		break;
+	}
+
+	return rc;
+}
+
+/*
+ * Like test_filter(), using fp if it was compiled from f.
+ */
+int
+test_filter_program(
+	Operation	*op,
+	Entry	*e,
+	Filter	*f,
+	FilterProgram	*fp )
+{
+	fp_ctx fc;
+	int rc;
+
+	/* the filter may have been replaced since fp was compiled */
+	if ( fp == NULL || fp->fp_filter != f )
+		return test_filter( op, e, f );
+
+	Debug( LDAP_DEBUG_FILTER, "=> test_filter_program\n" );
+
+	fc.fc_op = op;
+	fc.fc_e = e;
+	fc.fc_fp = fp;
+	fc.fc_valid = 0;
+	rc = fp_test( &fc, 0 );
+
+	Debug( LDAP_DEBUG_FILTER, "<= test_filter_program %d\n", rc );
+	return rc;
+}
@@ -0,0 +1,367 @@
+/* groupcache.c - shared cache of ACL group membership results */
+/* $OpenLDAP$ */
+/* This work is part of OpenLDAP Software <http://www.openldap.org/>.
+ *
+ * Copyright 1998-2020 The OpenLDAP Foundation.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted only as authorized by the OpenLDAP
+ * Public License.
+ *
+ * A copy of this license is available in the file LICENSE in the
+ * top-level directory of the distribution or, alternatively, at
+ * <http://www.OpenLDAP.org/license.html>.
+ */
+
+/*
+ * backend_group() only remembers its results in op->o_groups for the
+ * lifetime of a single operation.  This module keeps (group, identity)
+ * membership results across operations, bounded by "groupcache" entries
+ * and evicted in LRU order.  Only backends that advertise
+ * SLAP_BFLAG_GROUPCACHE are cached; such backends must call
+ * group_cache_invalidate() after committing any change to an entry.
+ *
+ * Results are stored in a two-level tree: groups keyed by normalized DN,
+ * each holding a tree of the identities that were checked against it,
+ * so that a write to a group drops all of its results at once.
+ *
+ * A backend may evaluate a group from a read snapshot it took earlier
+ * in the operation, so a result is only stored if no invalidation
+ * happened since the operation started: connection_operation() records
+ * group_cache_gen() in o_groupgen before the operation can take one.
+ */
+
+#include "portable.h"
+
+#include <stdio.h>
+
+#include <ac/string.h>
+
+#include "slap.h"
+#include "ldap_queue.h"
+
+typedef struct gc_group {
+	struct berval gg_ndn;
+	Avlnode *gg_members;
+	struct gc_group *gg_next;	/* used while invalidating */
+} gc_group;
+
+typedef struct gc_member {
+	LDAP_TAILQ_ENTRY(gc_member) gm_lru;
+	gc_group *gm_group;
+	Backend *gm_be;
+	ObjectClass *gm_oc;
+	AttributeDescription *gm_at;
+	int gm_res;
+	struct berval gm_ndn;
+} gc_member;
+
+static struct {
+	ldap_pvt_thread_mutex_t gc_mutex;
+	Avlnode *gc_groups;
+	LDAP_TAILQ_HEAD(gc_lru, gc_member) gc_lru;
+	unsigned long gc_count;
+	unsigned long gc_gen;
+	unsigned long gc_hits;
+	unsigned long gc_misses;
+} gc;
+
+unsigned int slap_group_cache_max;
+
+static int
+gc_group_cmp( const void *v1, const void *v2 )
+{
+	const gc_group *g1 = v1, *g2 = v2;
+	int rc;
+
+	rc = g1->gg_ndn.bv_len - g2->gg_ndn.bv_len;
+	if ( rc == 0 )
+		rc = memcmp( g1->gg_ndn.bv_val, g2->gg_ndn.bv_val,
+			g1->gg_ndn.bv_len );
+	return rc;
+}
+
+#define PTRCMP(a,b)	( (a) < (b) ? -1 : (a) > (b) )
+
+static int
+gc_member_cmp( const void *v1, const void *v2 )
+{
+	const gc_member *m1 = v1, *m2 = v2;
+	int rc;
+
+	rc = m1->gm_ndn.bv_len - m2->gm_ndn.bv_len;
+	if ( rc == 0 )
+		rc = memcmp( m1->gm_ndn.bv_val, m2->gm_ndn.bv_val,
+			m1->gm_ndn.bv_len );
+	if ( rc == 0 )
+		rc = PTRCMP( m1->gm_be, m2->gm_be );
+	if ( rc == 0 )
+		rc = PTRCMP( m1->gm_oc, m2->gm_oc );
+	if ( rc == 0 )
+		rc = PTRCMP( m1->gm_at, m2->gm_at );
+	return rc;
+}
+
+static void
+gc_member_free( void *v )
+{
+	gc_member *m = v;
+
+	LDAP_TAILQ_REMOVE( &gc.gc_lru, m, gm_lru );
+	gc.gc_count--;
+	ch_free( m );
+}
+
+static void
+gc_group_free( gc_group *g )
+{
+	avl_free( g->gg_members, gc_member_free );
+	ch_free( g );
+}
+
+/* must be called with gc_mutex held */
+static void
+gc_evict( unsigned int max )
+{
+	gc_member *m;
+	gc_group *g;
+
+	while ( gc.gc_count > max ) {
+		m = LDAP_TAILQ_LAST( &gc.gc_lru, gc_lru );
+		g = m->gm_group;
+		avl_delete( &g->gg_members, m, gc_member_cmp );
+		gc_member_free( m );
+		if ( g->gg_members == NULL ) {
+			avl_delete( &gc.gc_groups, g, gc_group_cmp );
+			ch_free( g );
+		}
+	}
+}
+
+void
+group_cache_init( void )
+{
+	ldap_pvt_thread_mutex_init( &gc.gc_mutex );
+	LDAP_TAILQ_INIT( &gc.gc_lru );
+}
+
+void
+group_cache_destroy( void )
+{
+	group_cache_flush();
+	ldap_pvt_thread_mutex_destroy( &gc.gc_mutex );
+}
+
+void
+group_cache_flush( void )
+{
+	if ( slap_group_cache_max == 0 && gc.gc_groups == NULL )
+		return;
+
+	ldap_pvt_thread_mutex_lock( &gc.gc_mutex );
+	gc_evict( 0 );
+	gc.gc_gen++;
+	ldap_pvt_thread_mutex_unlock( &gc.gc_mutex );
+}
+
+void
+group_cache_resize( unsigned int max )
+{
+	ldap_pvt_thread_mutex_lock( &gc.gc_mutex );
+	/* writers skip invalidation while the cache is disabled, so
+	 * results of operations already running must not be stored */
+	if ( slap_group_cache_max == 0 && max )
+		gc.gc_gen++;
+	slap_group_cache_max = max;
+	gc_evict( max );
+	ldap_pvt_thread_mutex_unlock( &gc.gc_mutex );
+}
+
+/* The generation an operation hands to group_cache_put() */
+unsigned long
+group_cache_gen( void )
+{
+	unsigned long gen;
+
+	if ( slap_group_cache_max == 0 )
+		return 0;
+
+	ldap_pvt_thread_mutex_lock( &gc.gc_mutex );
+	gen = gc.gc_gen;
+	ldap_pvt_thread_mutex_unlock( &gc.gc_mutex );
+	return gen;
+}
+
+/* Look up a cached result.  Returns -1 on a miss. */
+int
+group_cache_get(
+	Backend *be,
+	struct berval *gr_ndn,
+	struct berval *op_ndn,
+	ObjectClass *group_oc,
+	AttributeDescription *group_at )
+{
+	gc_group gtmp, *g;
+	gc_member mtmp, *m = NULL;
+	int rc = -1;
+
+	gtmp.gg_ndn = *gr_ndn;
+	mtmp.gm_ndn = *op_ndn;
+	mtmp.gm_be = be;
+	mtmp.gm_oc = group_oc;
+	mtmp.gm_at = group_at;
+
+	ldap_pvt_thread_mutex_lock( &gc.gc_mutex );
+	g = avl_find( gc.gc_groups, &gtmp, gc_group_cmp );
+	if ( g ) {
+		m = avl_find( g->gg_members, &mtmp, gc_member_cmp );
+	}
+	if ( m ) {
+		rc = m->gm_res;
+		if ( m != LDAP_TAILQ_FIRST( &gc.gc_lru )) {
+			LDAP_TAILQ_REMOVE( &gc.gc_lru, m, gm_lru );
+			LDAP_TAILQ_INSERT_HEAD( &gc.gc_lru, m, gm_lru );
+		}
+		gc.gc_hits++;
+	} else {
+		gc.gc_misses++;
+	}
+	ldap_pvt_thread_mutex_unlock( &gc.gc_mutex );
+
+	return rc;
+}
+
+void
+group_cache_put(
+	Backend *be,
+	struct berval *gr_ndn,
+	struct berval *op_ndn,
+	ObjectClass *group_oc,
+	AttributeDescription *group_at,
+	int res,
+	unsigned long gen )
+{
+	gc_group gtmp, *g;
+	gc_member *m;
+
+	gtmp.gg_ndn = *gr_ndn;
+
+	m = ch_malloc( sizeof( gc_member ) + op_ndn->bv_len + 1 );
+	m->gm_be = be;
+	m->gm_oc = group_oc;
+	m->gm_at = group_at;
+	m->gm_res = res;
+	m->gm_ndn.bv_len = op_ndn->bv_len;
+	m->gm_ndn.bv_val = (char *)(m+1);
+	AC_MEMCPY( m->gm_ndn.bv_val, op_ndn->bv_val, op_ndn->bv_len );
+	m->gm_ndn.bv_val[op_ndn->bv_len] = '\0';
+
+	ldap_pvt_thread_mutex_lock( &gc.gc_mutex );
+	if ( gen != gc.gc_gen || slap_group_cache_max == 0 ) {
+		/* the group may have changed while we looked at it */
+		ldap_pvt_thread_mutex_unlock( &gc.gc_mutex );
+		ch_free( m );
+		return;
+	}
+
+	g = avl_find( gc.gc_groups, &gtmp, gc_group_cmp );
+	if ( g == NULL ) {
+		g = ch_malloc( sizeof( gc_group ) + gr_ndn->bv_len + 1 );
+		g->gg_members = NULL;
+		g->gg_next = NULL;
+		g->gg_ndn.bv_len = gr_ndn->bv_len;
+		g->gg_ndn.bv_val = (char *)(g+1);
+		AC_MEMCPY( g->gg_ndn.bv_val, gr_ndn->bv_val, gr_ndn->bv_len );
+		g->gg_ndn.bv_val[gr_ndn->bv_len] = '\0';
+		avl_insert( &gc.gc_groups, g, gc_group_cmp, avl_dup_error );
+	}
+
+	m->gm_group = g;
+	if ( avl_insert( &g->gg_members, m, gc_member_cmp, avl_dup_error )) {
+		/* another thread got here first */
+		ch_free( m );
+	} else {
+		LDAP_TAILQ_INSERT_HEAD( &gc.gc_lru, m, gm_lru );
+		gc.gc_count++;
+		gc_evict( slap_group_cache_max );
+	}
+	ldap_pvt_thread_mutex_unlock( &gc.gc_mutex );
+}
+
+typedef struct gc_subtree {
+	struct berval *gs_base;
+	gc_group *gs_list;
+} gc_subtree;
+
+static int
+gc_collect( void *v, void *arg )
+{
+	gc_group *g = v;
+	gc_subtree *gs = arg;
+
+	if ( dnIsSuffix( &g->gg_ndn, gs->gs_base )) {
+		g->gg_next = gs->gs_list;
+		gs->gs_list = g;
+	}
+	return 0;
+}
+
+/*
+ * When the cache is disabled and empty there is nothing to drop and no
+ * lookup in progress can store a result, so the writers' calls below
+ * return without taking the mutex.
+ */
+
+/*
+ * Drop all results for the group at ndn, or for every group at or
+ * below ndn if subtree is set (renames and deletes).
+ */
+void
+group_cache_invalidate( struct berval *ndn, int subtree )
+{
+	gc_group gtmp, *g;
+
+	if ( slap_group_cache_max == 0 && gc.gc_groups == NULL )
+		return;
+
+	ldap_pvt_thread_mutex_lock( &gc.gc_mutex );
+	gc.gc_gen++;
+	if ( gc.gc_groups == NULL ) {
+		ldap_pvt_thread_mutex_unlock( &gc.gc_mutex );
+		return;
+	}
+
+	if ( subtree ) {
+		gc_subtree gs;
+
+		gs.gs_base = ndn;
+		gs.gs_list = NULL;
+		avl_apply( gc.gc_groups, gc_collect, &gs, -1, AVL_INORDER );
+		while (( g = gs.gs_list ) != NULL ) {
+			gs.gs_list = g->gg_next;
+			avl_delete( &gc.gc_groups, g, gc_group_cmp );
+			gc_group_free( g );
+		}
+	} else {
+		gtmp.gg_ndn = *ndn;
+		g = avl_delete( &gc.gc_groups, &gtmp, gc_group_cmp );
+		if ( g ) {
+			gc_group_free( g );
+		}
+	}
+	ldap_pvt_thread_mutex_unlock( &gc.gc_mutex );
+}
+
+void
+group_cache_stats(
+	unsigned long *count,
+	unsigned long *hits,
+	unsigned long *misses )
+{
+	ldap_pvt_thread_mutex_lock( &gc.gc_mutex );
+	*count = gc.gc_count;
+	*hits = gc.gc_hits;
+	*misses = gc.gc_misses;
+	ldap_pvt_thread_mutex_unlock( &gc.gc_mutex );
+}
@@ -63,6 +63,9 @@ int		connection_pool_max = SLAP_MAX_WORKER_THREADS;
 int		connection_pool_queues = 1;
 int		slap_tool_thread_max = 1;
 
+/* highest ID whose reindexing a backend has committed, see slapindex */
+ID		slap_tool_checkpoint;
+
 slap_counters_t			slap_counters, *slap_counters_list;
 
 static const char* slap_name = NULL;
@@ -139,6 +142,8 @@ slap_init( int mode, const char *name )
 				connection_pool_max, 0, connection_pool_queues);
 
 		slap_counters_init( &slap_counters );
+		group_cache_init();
+		dn_cache_init();
 
 		ldap_pvt_thread_mutex_init( &slapd_rq.rq_mutex );
 		LDAP_STAILQ_INIT( &slapd_rq.task_list );
@@ -254,6 +259,7 @@ int slap_destroy(void)
 
 	rc = backend_destroy();
 
+	slap_passwd_destroy();
 	slap_sasl_destroy();
 
 	/* rootdse destroy goes before entry_destroy()
@@ -265,6 +271,8 @@ int slap_destroy(void)
 	case SLAP_SERVER_MODE:
 	case SLAP_TOOL_MODE:
 		slap_counters_destroy( &slap_counters );
+		group_cache_destroy();
+		dn_cache_destroy();
 		break;
 
 	default:
@@ -286,43 +294,12 @@ int slap_destroy(void)
 
 void slap_counters_init( slap_counters_t *sc )
 {
-	int i;
-
+	memset( sc, 0, sizeof( *sc ));
 	ldap_pvt_thread_mutex_init( &sc->sc_mutex );
-	ldap_pvt_mp_init( sc->sc_bytes );
-	ldap_pvt_mp_init( sc->sc_pdu );
-	ldap_pvt_mp_init( sc->sc_entries );
-	ldap_pvt_mp_init( sc->sc_refs );
-
-	ldap_pvt_mp_init( sc->sc_ops_initiated );
-	ldap_pvt_mp_init( sc->sc_ops_completed );
-
-#ifdef SLAPD_MONITOR
-	for ( i = 0; i < SLAP_OP_LAST; i++ ) {
-		ldap_pvt_mp_init( sc->sc_ops_initiated_[ i ] );
-		ldap_pvt_mp_init( sc->sc_ops_completed_[ i ] );
-	}
-#endif /* SLAPD_MONITOR */
 }
 
 void slap_counters_destroy( slap_counters_t *sc )
 {
-	int i;
-
 	ldap_pvt_thread_mutex_destroy( &sc->sc_mutex );
-	ldap_pvt_mp_clear( sc->sc_bytes );
-	ldap_pvt_mp_clear( sc->sc_pdu );
-	ldap_pvt_mp_clear( sc->sc_entries );
-	ldap_pvt_mp_clear( sc->sc_refs );
-
-	ldap_pvt_mp_clear( sc->sc_ops_initiated );
-	ldap_pvt_mp_clear( sc->sc_ops_completed );
-
-#ifdef SLAPD_MONITOR
-	for ( i = 0; i < SLAP_OP_LAST; i++ ) {
-		ldap_pvt_mp_clear( sc->sc_ops_initiated_[ i ] );
-		ldap_pvt_mp_clear( sc->sc_ops_completed_[ i ] );
-	}
-#endif /* SLAPD_MONITOR */
 }
 
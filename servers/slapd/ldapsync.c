@@ -23,6 +23,7 @@
 #include <ac/socket.h>
 
 #include "lutil.h"
+#include "lutil_sha1.h"
 #include "slap.h"
 #include "../../libraries/liblber/lber-int.h" /* get ber_strndup() */
 #include "lutil_ldap.h"
@@ -462,3 +463,278 @@ slap_dup_sync_cookie(
 	return new;
 }
 
+
+/*
+ * Sync digests let a consumer find the entries it should no longer
+ * hold without a present phase. The entryUUID space is split by the
+ * byte following each of a set of prefixes; for each such range the
+ * number of entries and the sum (mod 2^160) of SHA1(entryUUID, entryCSN)
+ * are kept, so ranges holding the same entries have equal digests
+ * regardless of the order entries were seen in.
+ */
+
+#define SYNC_DIGEST_UUID_LEN	16
+
+static int
+sync_digest_prefix_cmp( const void *a, const void *b )
+{
+	const struct berval *p1 = a, *p2 = b;
+
+	return memcmp( p1->bv_val, p2->bv_val, p1->bv_len );
+}
+
+void
+slap_sync_digest_init( sync_digest *sd, void *memctx )
+{
+	sd->sd_memctx = memctx;
+	sd->sd_buckets = NULL;
+	sd->sd_uuids = NULL;
+	sd->sd_nuuids = 0;
+	sd->sd_maxuuids = 0;
+	if ( !sd->sd_list ) {
+		sd->sd_buckets = slap_sl_calloc( sd->sd_nprefixes * 256,
+			sizeof( sync_digest_bucket ), memctx );
+	}
+}
+
+void
+slap_sync_digest_free( sync_digest *sd )
+{
+	if ( sd->sd_buckets ) {
+		slap_sl_free( sd->sd_buckets, sd->sd_memctx );
+		sd->sd_buckets = NULL;
+	}
+	if ( sd->sd_uuids ) {
+		slap_sl_free( sd->sd_uuids, sd->sd_memctx );
+		sd->sd_uuids = NULL;
+	}
+	sd->sd_nuuids = 0;
+	sd->sd_maxuuids = 0;
+}
+
+/* Account for e if its entryUUID falls under one of the prefixes */
+int
+slap_sync_digest_add( sync_digest *sd, Entry *e )
+{
+	Attribute *a;
+	struct berval *uuid;
+	int i = 0;
+
+	a = attr_find( e->e_attrs, slap_schema.si_ad_entryUUID );
+	if ( !a || a->a_nvals[0].bv_len != SYNC_DIGEST_UUID_LEN )
+		return 0;
+	uuid = &a->a_nvals[0];
+
+	if ( sd->sd_plen ) {
+		int lo = 0, hi = sd->sd_nprefixes - 1, c;
+
+		for (;;) {
+			if ( lo > hi )
+				return 0;
+			i = ( lo + hi ) / 2;
+			c = memcmp( uuid->bv_val, sd->sd_prefixes[i].bv_val, sd->sd_plen );
+			if ( !c )
+				break;
+			if ( c < 0 )
+				hi = i - 1;
+			else
+				lo = i + 1;
+		}
+	}
+
+	if ( sd->sd_list ) {
+		if ( sd->sd_nuuids == sd->sd_maxuuids ) {
+			sd->sd_maxuuids = sd->sd_maxuuids ? sd->sd_maxuuids * 2 : 64;
+			sd->sd_uuids = slap_sl_realloc( sd->sd_uuids,
+				sd->sd_maxuuids * SYNC_DIGEST_UUID_LEN, sd->sd_memctx );
+		}
+		AC_MEMCPY( sd->sd_uuids + sd->sd_nuuids * SYNC_DIGEST_UUID_LEN,
+			uuid->bv_val, SYNC_DIGEST_UUID_LEN );
+		sd->sd_nuuids++;
+	} else {
+		sync_digest_bucket *b;
+		lutil_SHA1_CTX ctx;
+		unsigned char hash[LUTIL_SHA1_BYTES];
+		int j, carry = 0;
+
+		lutil_SHA1Init( &ctx );
+		lutil_SHA1Update( &ctx, (unsigned char *)uuid->bv_val, uuid->bv_len );
+		a = attr_find( e->e_attrs, slap_schema.si_ad_entryCSN );
+		if ( a ) {
+			lutil_SHA1Update( &ctx, (unsigned char *)a->a_nvals[0].bv_val,
+				a->a_nvals[0].bv_len );
+		}
+		lutil_SHA1Final( hash, &ctx );
+
+		b = &sd->sd_buckets[ i * 256 +
+			(unsigned char)uuid->bv_val[ sd->sd_plen ] ];
+		b->sdb_count++;
+		for ( j = SLAP_SYNC_DIGEST_LEN - 1; j >= 0; j-- ) {
+			carry += b->sdb_sum[j] + hash[j];
+			b->sdb_sum[j] = carry & 0xff;
+			carry >>= 8;
+		}
+	}
+	return 1;
+}
+
+/*
+ * syncDigestRequestValue ::= SEQUENCE {
+ *		list		BOOLEAN,
+ *		prefixes	SEQUENCE OF OCTET STRING
+ * }
+ */
+int
+slap_sync_digest_request( sync_digest *sd, struct berval *val )
+{
+	BerElementBuffer berbuf;
+	BerElement *ber = (BerElement *)&berbuf;
+	int i, rc;
+
+	ber_init2( ber, NULL, LBER_USE_DER );
+	ber_printf( ber, "{b{" /*}}*/, sd->sd_list );
+	for ( i = 0; i < sd->sd_nprefixes; i++ ) {
+		ber_printf( ber, "O", &sd->sd_prefixes[i] );
+	}
+	ber_printf( ber, /*{{*/ "}N}" );
+	rc = ber_flatten2( ber, val, 1 );
+	ber_free_buf( ber );
+	return rc < 0 ? LDAP_OTHER : LDAP_SUCCESS;
+}
+
+int
+slap_sync_digest_parse_request( struct berval *val, sync_digest *sd,
+	void *memctx )
+{
+	BerElementBuffer berbuf;
+	BerElement *ber = (BerElement *)&berbuf;
+	ber_tag_t tag;
+	ber_len_t len;
+	ber_int_t list;
+	char *last;
+	int n = 0;
+
+	memset( sd, 0, sizeof( *sd ));
+	ber_init2( ber, val, 0 );
+	if ( ber_scanf( ber, "{b" /*}*/, &list ) == LBER_ERROR )
+		return LDAP_PROTOCOL_ERROR;
+
+	sd->sd_list = list;
+	sd->sd_prefixes = slap_sl_malloc( SLAP_SYNC_DIGEST_MAXPREFIXES *
+		sizeof( struct berval ), memctx );
+	for ( tag = ber_first_element( ber, &len, &last );
+		tag != LBER_DEFAULT;
+		tag = ber_next_element( ber, &len, last ) )
+	{
+		if ( n == SLAP_SYNC_DIGEST_MAXPREFIXES ||
+			ber_scanf( ber, "m", &sd->sd_prefixes[n] ) == LBER_ERROR )
+			goto fail;
+		/* prefixes all have the same length, and leave a byte to
+		 * bucket on unless only entryUUIDs are wanted
+		 */
+		if ( sd->sd_prefixes[n].bv_len != sd->sd_prefixes[0].bv_len ||
+			sd->sd_prefixes[n].bv_len > SYNC_DIGEST_UUID_LEN - !list )
+			goto fail;
+		n++;
+	}
+	if ( !n )
+		goto fail;
+
+	sd->sd_nprefixes = n;
+	sd->sd_plen = sd->sd_prefixes[0].bv_len;
+	qsort( sd->sd_prefixes, n, sizeof( struct berval ),
+		sync_digest_prefix_cmp );
+	return LDAP_SUCCESS;
+
+fail:
+	slap_sl_free( sd->sd_prefixes, memctx );
+	sd->sd_prefixes = NULL;
+	return LDAP_PROTOCOL_ERROR;
+}
+
+/*
+ * syncDigestResponseValue ::= CHOICE {
+ *		digests	SEQUENCE OF SEQUENCE {
+ *			bucket	INTEGER,	-- prefix index * 256 + next byte
+ *			count	INTEGER,
+ *			sum		OCTET STRING
+ *		},
+ *		uuids	SEQUENCE OF OCTET STRING	-- in list mode
+ * }
+ * Empty buckets are left out.
+ */
+int
+slap_sync_digest_response( sync_digest *sd, struct berval *val, void *memctx )
+{
+	BerElementBuffer berbuf;
+	BerElement *ber = (BerElement *)&berbuf;
+	int i, rc;
+
+	ber_init2( ber, NULL, LBER_USE_DER );
+	ber_set_option( ber, LBER_OPT_BER_MEMCTX, &memctx );
+
+	ber_printf( ber, "{" /*}*/ );
+	if ( sd->sd_list ) {
+		for ( i = 0; i < sd->sd_nuuids; i++ ) {
+			ber_printf( ber, "o", sd->sd_uuids + i * SYNC_DIGEST_UUID_LEN,
+				(ber_len_t)SYNC_DIGEST_UUID_LEN );
+		}
+	} else {
+		for ( i = 0; i < sd->sd_nprefixes * 256; i++ ) {
+			sync_digest_bucket *b = &sd->sd_buckets[i];
+
+			if ( !b->sdb_count )
+				continue;
+			ber_printf( ber, "{iio}", i, b->sdb_count, b->sdb_sum,
+				(ber_len_t)SLAP_SYNC_DIGEST_LEN );
+		}
+	}
+	ber_printf( ber, /*{*/ "N}" );
+	rc = ber_flatten2( ber, val, 1 );
+	ber_free_buf( ber );
+	return rc < 0 ? LDAP_OTHER : LDAP_SUCCESS;
+}
+
+/* Fill in sd, set up for the same request, from a response */
+int
+slap_sync_digest_parse_response( struct berval *val, sync_digest *sd )
+{
+	BerElementBuffer berbuf;
+	BerElement *ber = (BerElement *)&berbuf;
+	ber_tag_t tag;
+	ber_len_t len;
+	char *last;
+
+	ber_init2( ber, val, 0 );
+	for ( tag = ber_first_element( ber, &len, &last );
+		tag != LBER_DEFAULT;
+		tag = ber_next_element( ber, &len, last ) )
+	{
+		struct berval bv;
+
+		if ( sd->sd_list ) {
+			if ( ber_scanf( ber, "m", &bv ) == LBER_ERROR ||
+				bv.bv_len != SYNC_DIGEST_UUID_LEN )
+				return LDAP_PROTOCOL_ERROR;
+			if ( sd->sd_nuuids == sd->sd_maxuuids ) {
+				sd->sd_maxuuids = sd->sd_maxuuids ? sd->sd_maxuuids * 2 : 64;
+				sd->sd_uuids = slap_sl_realloc( sd->sd_uuids,
+					sd->sd_maxuuids * SYNC_DIGEST_UUID_LEN, sd->sd_memctx );
+			}
+			AC_MEMCPY( sd->sd_uuids + sd->sd_nuuids * SYNC_DIGEST_UUID_LEN,
+				bv.bv_val, SYNC_DIGEST_UUID_LEN );
+			sd->sd_nuuids++;
+		} else {
+			ber_int_t i, count;
+
+			if ( ber_scanf( ber, "{iim}", &i, &count, &bv ) == LBER_ERROR ||
+				i < 0 || i >= sd->sd_nprefixes * 256 || count < 0 ||
+				bv.bv_len != SLAP_SYNC_DIGEST_LEN )
+				return LDAP_PROTOCOL_ERROR;
+			sd->sd_buckets[i].sdb_count = count;
+			AC_MEMCPY( sd->sd_buckets[i].sdb_sum, bv.bv_val,
+				SLAP_SYNC_DIGEST_LEN );
+		}
+	}
+	return LDAP_SUCCESS;
+}
@@ -70,6 +70,9 @@ typedef struct log_info {
 	int li_age;
 	int li_cycle;
 	struct re_s *li_task;
+	int li_partition;
+	time_t li_part_last;
+	ldap_pvt_thread_mutex_t li_part_mutex;
 	Filter *li_oldf;
 	Entry *li_old;
 	log_attr *li_oldattrs;
@@ -89,7 +92,8 @@ enum {
 	LOG_SUCCESS,
 	LOG_OLD,
 	LOG_OLDATTR,
-	LOG_BASE
+	LOG_BASE,
+	LOG_PARTITION
 };
 
 static ConfigTable log_cfats[] = {
@@ -130,6 +134,11 @@ static ConfigTable log_cfats[] = {
 			"DESC 'Operation types to log under a specific branch' "
 			"EQUALITY caseIgnoreMatch "
 			"SYNTAX OMsDirectoryString )", NULL, NULL },
+	{ "logpartition", "interval", 2, 2, 0, ARG_MAGIC|LOG_PARTITION,
+		log_cf_gen, "( OLcfgOvAt:4.8 NAME 'olcAccessLogPartition' "
+			"DESC 'Time span of each branch of the log' "
+			"EQUALITY caseIgnoreMatch "
+			"SYNTAX OMsDirectoryString SINGLE-VALUE )", NULL, NULL },
 	{ NULL }
 };
 
@@ -140,7 +149,8 @@ static ConfigOCs log_cfocs[] = {
 		"SUP olcOverlayConfig "
 		"MUST olcAccessLogDB "
 		"MAY ( olcAccessLogOps $ olcAccessLogPurge $ olcAccessLogSuccess $ "
-			"olcAccessLogOld $ olcAccessLogOldAttr $ olcAccessLogBase ) )",
+			"olcAccessLogOld $ olcAccessLogOldAttr $ olcAccessLogBase $ "
+			"olcAccessLogPartition ) )",
 			Cft_Overlay, log_cfats },
 	{ NULL }
 };
@@ -586,11 +596,16 @@ static slap_callback nullsc;
 
 #define PURGE_INCREMENT	100
 
+/* Expired entries deleted in one transaction */
+#define PURGE_BATCH	100
+
 typedef struct purge_data {
 	int slots;
 	int used;
 	BerVarray dn;
 	BerVarray ndn;
+	BerVarray part;		/* expired logpartition branches */
+	BerVarray npart;
 	struct berval csn;	/* an arbitrary old CSN */
 } purge_data;
 
@@ -604,6 +619,13 @@ log_old_lookup( Operation *op, SlapReply *rs )
 
 	if ( slapd_shutdown ) return 0;
 
+	/* Branches are deleted after their contents */
+	if ( is_entry_objectclass( rs->sr_entry, log_container, 0 )) {
+		value_add_one( &pd->part, &rs->sr_entry->e_name );
+		value_add_one( &pd->npart, &rs->sr_entry->e_nname );
+		return 0;
+	}
+
 	/* Remember max CSN: should always be the last entry
 	 * seen, since log entries are ordered chronologically...
 	 */
@@ -630,6 +652,24 @@ log_old_lookup( Operation *op, SlapReply *rs )
 	return 0;
 }
 
+/* Delete one expired entry, within txn if given */
+static int
+log_old_delete( Operation *op, void *item, OpExtra *txn, void *arg )
+{
+	purge_data *pd = arg;
+	int i = (struct berval *)item - pd->dn;
+	SlapReply rs = {REP_RESULT};
+
+	op->o_req_dn = pd->dn[i];
+	op->o_req_ndn = pd->ndn[i];
+	if ( txn )
+		LDAP_SLIST_INSERT_HEAD( &op->o_extra, txn, oe_next );
+	op->o_bd->be_delete( op, &rs );
+	if ( txn )
+		LDAP_SLIST_REMOVE( &op->o_extra, txn, OpExtra, oe_next );
+	return rs.sr_err;
+}
+
 /* Periodically search for old entries in the log database and delete them */
 static void *
 accesslog_purge( void *ctx, void *arg )
@@ -642,26 +682,30 @@ accesslog_purge( void *ctx, void *arg )
 	Operation *op;
 	SlapReply rs = {REP_RESULT};
 	slap_callback cb = { NULL, log_old_lookup, NULL, NULL, NULL };
-	Filter f;
-	AttributeAssertion ava = ATTRIBUTEASSERTION_INIT;
 	purge_data pd = {0};
 	char timebuf[LDAP_LUTIL_GENTIME_BUFSIZE];
 	char csnbuf[LDAP_PVT_CSNSTR_BUFSIZE];
+	char filterbuf[STRLENOF("(&(reqStart<=)(|(!(objectClass=auditContainer))"
+		"(reqEnd<=)))") + 2*LDAP_LUTIL_GENTIME_BUFSIZE];
+	struct berval bv;
 	time_t old = slap_get_time();
 
 	connection_fake_init( &conn, &opbuf, ctx );
 	op = &opbuf.ob_op;
 
-	f.f_choice = LDAP_FILTER_LE;
-	f.f_ava = &ava;
-	f.f_next = NULL;
-
-	ava.aa_desc = ad_reqStart;
-	ava.aa_value.bv_val = timebuf;
-	ava.aa_value.bv_len = sizeof(timebuf);
+	bv.bv_val = timebuf;
+	bv.bv_len = sizeof(timebuf);
 
 	old -= li->li_age;
-	slap_timestamp( &old, &ava.aa_value );
+	slap_timestamp( &old, &bv );
+
+	/* Old entries, and logpartition branches that ended before the
+	 * cutoff. Branches still holding recent entries are left alone.
+	 */
+	op->ors_filterstr.bv_val = filterbuf;
+	op->ors_filterstr.bv_len = snprintf( filterbuf, sizeof( filterbuf ),
+		"(&(reqStart<=%s)(|(!(objectClass=auditContainer))(reqEnd<=%s)))",
+		timebuf, timebuf );
 
 	op->o_tag = LDAP_REQ_SEARCH;
 	op->o_bd = li->li_db;
@@ -674,8 +718,7 @@ accesslog_purge( void *ctx, void *arg )
 	op->ors_deref = LDAP_DEREF_NEVER;
 	op->ors_tlimit = SLAP_NO_LIMIT;
 	op->ors_slimit = SLAP_NO_LIMIT;
-	op->ors_filter = &f;
-	filter2bv_x( op, &f, &op->ors_filterstr );
+	op->ors_filter = str2filter_x( op, filterbuf );
 	op->ors_attrs = slap_anlist_no_attrs;
 	op->ors_attrsonly = 1;
 	
@@ -685,27 +728,71 @@ accesslog_purge( void *ctx, void *arg )
 	cb.sc_private = &pd;
 
 	op->o_bd->be_search( op, &rs );
-	op->o_tmpfree( op->ors_filterstr.bv_val, op->o_tmpmemctx );
+	filter_free_x( op, op->ors_filter, 1 );
 
-	if ( pd.used ) {
+	if ( pd.part ) {
 		int i;
 
-		/* delete the expired entries */
+		/* Collect the contents of the expired branches, each
+		 * followed by the branch itself.
+		 */
+		op->ors_filter = (Filter *)slap_filter_objectClass_pres;
+		op->ors_filterstr = *slap_filterstr_objectClass_pres;
+
+		for ( i = 0; !BER_BVISNULL( &pd.part[i] ) && !slapd_shutdown; i++ ) {
+			BerVarray part = pd.part, npart = pd.npart;
+
+			pd.part = pd.npart = NULL;
+			op->o_req_dn = part[i];
+			op->o_req_ndn = npart[i];
+			rs_reinit( &rs, REP_RESULT );
+			op->o_bd->be_search( op, &rs );
+
+			/* nested branches are not expected, drop them */
+			ber_bvarray_free( pd.part );
+			ber_bvarray_free( pd.npart );
+			pd.part = part;
+			pd.npart = npart;
+
+			if ( pd.used >= pd.slots ) {
+				pd.slots += PURGE_INCREMENT;
+				pd.dn = ch_realloc( pd.dn, pd.slots * sizeof( struct berval ));
+				pd.ndn = ch_realloc( pd.ndn, pd.slots * sizeof( struct berval ));
+			}
+			ber_dupbv( &pd.dn[pd.used], &part[i] );
+			ber_dupbv( &pd.ndn[pd.used], &npart[i] );
+			pd.used++;
+		}
+		ber_bvarray_free( pd.part );
+		ber_bvarray_free( pd.npart );
+	}
+
+	if ( pd.used ) {
+		void *items[PURGE_BATCH];
+		int i, j, n;
+
+		/* delete the expired entries, a batch per transaction.
+		 * Branches come after their contents, in the same batch
+		 * or a later one.
+		 */
 		op->o_tag = LDAP_REQ_DELETE;
 		op->o_callback = &nullsc;
 		op->o_csn = pd.csn;
 		op->o_dont_replicate = 1;
 
+		for (i=0; i<pd.used && !slapd_shutdown; i+=n) {
+			n = pd.used - i;
+			if ( n > PURGE_BATCH )
+				n = PURGE_BATCH;
+			for (j=0; j<n; j++)
+				items[j] = &pd.dn[i+j];
+			(void)slap_txn_batch( op, li->li_db->bd_info, items, n,
+				log_old_delete, &pd, "accesslog_purge" );
+			ldap_pvt_thread_pool_pausecheck( &connection_pool );
+		}
 		for (i=0; i<pd.used; i++) {
-			op->o_req_dn = pd.dn[i];
-			op->o_req_ndn = pd.ndn[i];
-			if ( !slapd_shutdown ) {
-				rs_reinit( &rs, REP_RESULT );
-				op->o_bd->be_delete( op, &rs );
-			}
 			ch_free( pd.ndn[i].bv_val );
 			ch_free( pd.dn[i].bv_val );
-			ldap_pvt_thread_pool_pausecheck( &connection_pool );
 		}
 		ch_free( pd.ndn );
 		ch_free( pd.dn );
@@ -826,6 +913,15 @@ log_cf_gen(ConfigArgs *c)
 			else
 				rc = 1;
 			break;
+		case LOG_PARTITION:
+			if ( !li->li_partition ) {
+				rc = 1;
+				break;
+			}
+			agebv.bv_val = agebuf;
+			log_age_unparse( li->li_partition, &agebv, sizeof( agebuf ) );
+			value_add_one( &c->rvalue_vals, &agebv );
+			break;
 		}
 		break;
 	case LDAP_MOD_DELETE:
@@ -904,6 +1000,10 @@ log_cf_gen(ConfigArgs *c)
 				ch_free( lb );
 			}
 			break;
+		case LOG_PARTITION:
+			li->li_partition = 0;
+			li->li_part_last = 0;
+			break;
 		}
 		break;
 	default:
@@ -1028,6 +1128,18 @@ log_cf_gen(ConfigArgs *c)
 			}
 			}
 			break;
+		case LOG_PARTITION:
+			li->li_partition = log_age_parse( c->argv[1] );
+			li->li_part_last = 0;
+			if ( li->li_partition < 1 ) {
+				snprintf( c->cr_msg, sizeof( c->cr_msg ), "%s invalid interval: %s",
+					c->argv[0], c->argv[1] );
+				Debug( LDAP_DEBUG_CONFIG|LDAP_DEBUG_NONE,
+					"%s: %s\n", c->log, c->cr_msg );
+				li->li_partition = 0;
+				rc = ARG_BAD_CONF;
+			}
+			break;
 		}
 		break;
 	}
@@ -1294,6 +1406,82 @@ accesslog_ctrls(
 	
 }
 
+/*
+ * With logpartition, log entries are filed under one auditContainer per
+ * time span, named by the start of the span, so that purging can drop
+ * whole branches instead of searching the entire log for old entries.
+ * Return the DN of the branch for time t, creating it if needed.
+ */
+static void
+accesslog_partition( Operation *op, log_info *li, time_t t,
+	struct berval *dn, struct berval *ndn )
+{
+	char rdnbuf[STRLENOF(RDNEQ)+LDAP_LUTIL_GENTIME_BUFSIZE];
+	char endbuf[LDAP_LUTIL_GENTIME_BUFSIZE];
+	struct berval rdn, start, end;
+	time_t tstart, tend;
+
+	tstart = t - t % li->li_partition;
+
+	strcpy( rdnbuf, RDNEQ );
+	start.bv_val = rdnbuf + STRLENOF(RDNEQ);
+	start.bv_len = sizeof(rdnbuf) - STRLENOF(RDNEQ);
+	slap_timestamp( &tstart, &start );
+	rdn.bv_val = rdnbuf;
+	rdn.bv_len = STRLENOF(RDNEQ) + start.bv_len;
+
+	/* generalizedTime values as built by slap_timestamp are normalized */
+	build_new_dn( dn, li->li_db->be_suffix, &rdn, op->o_tmpmemctx );
+	build_new_dn( ndn, li->li_db->be_nsuffix, &rdn, op->o_tmpmemctx );
+
+	ldap_pvt_thread_mutex_lock( &li->li_part_mutex );
+	if ( li->li_part_last != tstart ) {
+		Operation op2 = {0};
+		SlapReply rs2 = {REP_RESULT};
+		BackendDB db = *li->li_db;
+		Entry *e = entry_alloc();
+
+		ber_dupbv( &e->e_name, dn );
+		ber_dupbv( &e->e_nname, ndn );
+		attr_merge_one( e, slap_schema.si_ad_objectClass,
+			&log_container->soc_cname, NULL );
+		attr_merge_one( e, slap_schema.si_ad_structuralObjectClass,
+			&log_container->soc_cname, NULL );
+		attr_merge_one( e, ad_reqStart, &start, &start );
+
+		tend = tstart + li->li_partition;
+		end.bv_val = endbuf;
+		end.bv_len = sizeof(endbuf);
+		slap_timestamp( &tend, &end );
+		attr_merge_one( e, ad_reqEnd, &end, &end );
+
+		/* like the log root, the branches carry no operational attrs */
+		SLAP_DBFLAGS( &db ) |= SLAP_DBFLAG_NOLASTMOD;
+		op2.o_hdr = op->o_hdr;
+		op2.o_tag = LDAP_REQ_ADD;
+		op2.o_bd = &db;
+		op2.o_dn = li->li_db->be_rootdn;
+		op2.o_ndn = li->li_db->be_rootndn;
+		op2.o_req_dn = e->e_name;
+		op2.o_req_ndn = e->e_nname;
+		op2.ora_e = e;
+		op2.o_callback = &nullsc;
+
+		op2.o_bd->be_add( &op2, &rs2 );
+		if ( rs2.sr_err == LDAP_SUCCESS ||
+			rs2.sr_err == LDAP_ALREADY_EXISTS )
+		{
+			li->li_part_last = tstart;
+		} else {
+			Debug( LDAP_DEBUG_ANY,
+				"accesslog_partition: got result 0x%x adding log branch %s\n",
+				rs2.sr_err, dn->bv_val );
+		}
+		if ( e == op2.ora_e ) entry_free( e );
+	}
+	ldap_pvt_thread_mutex_unlock( &li->li_part_mutex );
+}
+
 static Entry *accesslog_entry( Operation *op, SlapReply *rs,
 	log_info *li, int logop, Operation *op2 ) {
 
@@ -1324,8 +1512,18 @@ static Entry *accesslog_entry( Operation *op, SlapReply *rs,
 
 	strcpy( nrdn.bv_val + STRLENOF(RDNEQ), ntimestamp.bv_val );
 	nrdn.bv_len = STRLENOF(RDNEQ)+ntimestamp.bv_len;
-	build_new_dn( &e->e_name, li->li_db->be_suffix, &rdn, NULL );
-	build_new_dn( &e->e_nname, li->li_db->be_nsuffix, &nrdn, NULL );
+	if ( li->li_partition ) {
+		struct berval pdn, pndn;
+
+		accesslog_partition( op, li, op->o_time, &pdn, &pndn );
+		build_new_dn( &e->e_name, &pdn, &rdn, NULL );
+		build_new_dn( &e->e_nname, &pndn, &nrdn, NULL );
+		op->o_tmpfree( pndn.bv_val, op->o_tmpmemctx );
+		op->o_tmpfree( pdn.bv_val, op->o_tmpmemctx );
+	} else {
+		build_new_dn( &e->e_name, li->li_db->be_suffix, &rdn, NULL );
+		build_new_dn( &e->e_nname, li->li_db->be_nsuffix, &nrdn, NULL );
+	}
 
 	attr_merge_one( e, slap_schema.si_ad_objectClass,
 		&log_ocs[logop]->soc_cname, NULL );
@@ -2137,6 +2335,7 @@ accesslog_db_init(
 	on->on_bi.bi_private = li;
 	ldap_pvt_thread_mutex_recursive_init( &li->li_op_rmutex );
 	ldap_pvt_thread_mutex_init( &li->li_log_mutex );
+	ldap_pvt_thread_mutex_init( &li->li_part_mutex );
 	return 0;
 }
 
@@ -2156,6 +2355,7 @@ accesslog_db_destroy(
 		li->li_oldattrs = la->next;
 		ch_free( la );
 	}
+	ldap_pvt_thread_mutex_destroy( &li->li_part_mutex );
 	ldap_pvt_thread_mutex_destroy( &li->li_log_mutex );
 	ldap_pvt_thread_mutex_destroy( &li->li_op_rmutex );
 	free( li );
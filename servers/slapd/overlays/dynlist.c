@@ -35,6 +35,7 @@
 #include "slap.h"
 #include "config.h"
 #include "lutil.h"
+#include "ldap_queue.h"
 
 static AttributeDescription *ad_dgIdentity, *ad_dgAuthz;
 
@@ -57,6 +58,64 @@ typedef struct dynlist_info_t {
 	struct dynlist_info_t	*dli_next;
 } dynlist_info_t;
 
+/*
+ * Every memberURL that is expanded is parsed once and kept, with its
+ * normalized base and the complete search filter already built, keyed
+ * by the dynlist-attrset it was found under and the URL itself.  When
+ * dynlist-cache-ttl is set, the members found for a plain member list
+ * are kept as well, per URL and per identity, until the TTL expires, a
+ * write in this database touches the scope of the URL, or an ACL is
+ * added or removed.  Both caches hold at most dynlist-cache-size items
+ * and are evicted in LRU order.
+ * Items are reference counted, since they are used after the mutex is
+ * released; an evicted item is freed when its last user lets go.
+ */
+typedef struct dynlist_url_t {
+	dynlist_info_t		*du_dli;
+	struct berval		du_url;
+	struct dynlist_gen_t	*du_dlg;
+	LDAPURLDesc		*du_lud;
+	struct berval		du_dn;
+	struct berval		du_ndn;
+	int			du_scope;
+	struct berval		du_filterstr;
+	Filter			*du_filter;
+	int			du_bad;		/* not a usable URL */
+	Avlnode			*du_results;
+	unsigned long		du_gen;		/* bumped when they go stale */
+	int			du_refs;
+	int			du_dead;	/* no longer in the cache */
+	LDAP_TAILQ_ENTRY(dynlist_url_t) du_lru;
+} dynlist_url_t;
+
+typedef struct dynlist_res_t {
+	struct berval		dr_key;		/* who searched, and how */
+	dynlist_url_t		*dr_url;
+	time_t			dr_expire;
+	unsigned long		dr_aclgen;	/* the ACLs it was checked with */
+	BerVarray		dr_vals;
+	BerVarray		dr_nvals;
+	int			dr_numvals;
+	int			dr_refs;
+	int			dr_dead;
+	LDAP_TAILQ_ENTRY(dynlist_res_t) dr_lru;
+} dynlist_res_t;
+
+typedef struct dynlist_gen_t {
+	dynlist_info_t		*dlg_dli;
+	BackendDB		*dlg_be;	/* the database we're on */
+	ldap_pvt_thread_mutex_t	dlg_mutex;
+	Avlnode			*dlg_urls;
+	LDAP_TAILQ_HEAD(dlg_url_lru, dynlist_url_t) dlg_url_lru;
+	LDAP_TAILQ_HEAD(dlg_res_lru, dynlist_res_t) dlg_res_lru;
+	unsigned		dlg_nurls;
+	unsigned		dlg_nres;
+	unsigned		dlg_cache_max;
+	unsigned		dlg_cache_ttl;
+} dynlist_gen_t;
+
+#define	DYNLIST_CACHE_SIZE_DEFAULT	1024
+
 #define DYNLIST_USAGE \
 	"\"dynlist-attrset <oc> [uri] <URL-ad> [[<mapped-ad>:]<member-ad>[@<memberOf-ad>] ...]\": "
 
@@ -126,10 +185,470 @@ dynlist_make_filter( Operation *op, Entry *e, dynlist_info_t *dli, const char *u
 	return 0;
 }
 
+#define PTRCMP(a,b)	( (a) < (b) ? -1 : (a) > (b) )
+
+static int
+dynlist_url_cmp( const void *v1, const void *v2 )
+{
+	const dynlist_url_t *du1 = v1, *du2 = v2;
+	int rc;
+
+	rc = PTRCMP( du1->du_dli, du2->du_dli );
+	if ( rc == 0 )
+		rc = du1->du_url.bv_len - du2->du_url.bv_len;
+	if ( rc == 0 )
+		rc = memcmp( du1->du_url.bv_val, du2->du_url.bv_val,
+			du1->du_url.bv_len );
+	return rc;
+}
+
+static int
+dynlist_res_cmp( const void *v1, const void *v2 )
+{
+	const dynlist_res_t *dr1 = v1, *dr2 = v2;
+	int rc;
+
+	rc = dr1->dr_key.bv_len - dr2->dr_key.bv_len;
+	if ( rc == 0 )
+		rc = memcmp( dr1->dr_key.bv_val, dr2->dr_key.bv_val,
+			dr1->dr_key.bv_len );
+	return rc;
+}
+
+static void
+dynlist_res_free( dynlist_res_t *dr )
+{
+	ber_bvarray_free( dr->dr_vals );
+	ber_bvarray_free( dr->dr_nvals );
+	ch_free( dr );
+}
+
+/* Take dr out of the cache; it was already removed from its URL's tree.
+ * Called with dlg_mutex held. */
+static void
+dynlist_res_drop( void *v )
+{
+	dynlist_res_t *dr = v;
+	dynlist_gen_t *dlg = dr->dr_url->du_dlg;
+
+	LDAP_TAILQ_REMOVE( &dlg->dlg_res_lru, dr, dr_lru );
+	dlg->dlg_nres--;
+	dr->dr_dead = 1;
+	if ( dr->dr_refs == 0 )
+		dynlist_res_free( dr );
+}
+
+static void
+dynlist_url_free( dynlist_url_t *du )
+{
+	if ( du->du_lud != NULL )
+		ldap_free_urldesc( du->du_lud );
+	if ( !BER_BVISNULL( &du->du_dn ) )
+		ber_memfree( du->du_dn.bv_val );
+	if ( !BER_BVISNULL( &du->du_ndn ) )
+		ber_memfree( du->du_ndn.bv_val );
+	if ( !BER_BVISNULL( &du->du_filterstr ) )
+		ber_memfree( du->du_filterstr.bv_val );
+	if ( du->du_filter != NULL )
+		filter_free( du->du_filter );
+	ch_free( du );
+}
+
+/* Take du and its results out of the cache.
+ * Called with dlg_mutex held. */
+static void
+dynlist_url_drop( dynlist_gen_t *dlg, dynlist_url_t *du )
+{
+	avl_delete( &dlg->dlg_urls, du, dynlist_url_cmp );
+	LDAP_TAILQ_REMOVE( &dlg->dlg_url_lru, du, du_lru );
+	dlg->dlg_nurls--;
+	avl_free( du->du_results, dynlist_res_drop );
+	du->du_results = NULL;
+	du->du_dead = 1;
+	if ( du->du_refs == 0 )
+		dynlist_url_free( du );
+}
+
+/* Evict down to dlg_cache_max; called with dlg_mutex held */
+static void
+dynlist_cache_trim( dynlist_gen_t *dlg )
+{
+	while ( dlg->dlg_nres > dlg->dlg_cache_max ) {
+		dynlist_res_t *dr = LDAP_TAILQ_FIRST( &dlg->dlg_res_lru );
+
+		avl_delete( &dr->dr_url->du_results, dr, dynlist_res_cmp );
+		dynlist_res_drop( dr );
+	}
+	while ( dlg->dlg_nurls > dlg->dlg_cache_max ) {
+		dynlist_url_drop( dlg, LDAP_TAILQ_FIRST( &dlg->dlg_url_lru ) );
+	}
+}
+
+static void
+dynlist_cache_flush( dynlist_gen_t *dlg )
+{
+	ldap_pvt_thread_mutex_lock( &dlg->dlg_mutex );
+	while ( !LDAP_TAILQ_EMPTY( &dlg->dlg_url_lru ) ) {
+		dynlist_url_drop( dlg, LDAP_TAILQ_FIRST( &dlg->dlg_url_lru ) );
+	}
+	ldap_pvt_thread_mutex_unlock( &dlg->dlg_mutex );
+}
+
+/*
+ * Drop the results of every URL whose scope the entry ndn is in, or,
+ * if the subtree below ndn moved, whose base is in that subtree.
+ */
+static void
+dynlist_cache_invalidate( dynlist_gen_t *dlg, struct berval *ndn, int subtree )
+{
+	dynlist_url_t *du;
+
+	if ( !dlg->dlg_cache_ttl )
+		return;
+
+	ldap_pvt_thread_mutex_lock( &dlg->dlg_mutex );
+	LDAP_TAILQ_FOREACH( du, &dlg->dlg_url_lru, du_lru ) {
+		if ( dnIsSuffixScope( ndn, &du->du_ndn, du->du_scope ) ||
+			( subtree && dnIsSuffix( &du->du_ndn, ndn ) ) )
+		{
+			/* and those of searches already running */
+			du->du_gen++;
+			if ( du->du_results ) {
+				avl_free( du->du_results, dynlist_res_drop );
+				du->du_results = NULL;
+			}
+		}
+	}
+	ldap_pvt_thread_mutex_unlock( &dlg->dlg_mutex );
+}
+
+/* Parse a memberURL and build everything needed to search it */
+static dynlist_url_t *
+dynlist_url_compile( Operation *op, dynlist_gen_t *dlg, dynlist_info_t *dli,
+	struct berval *url, Entry *e )
+{
+	dynlist_url_t	*du;
+	LDAPURLDesc	*lud = NULL;
+	struct berval	dn;
+
+	du = ch_calloc( 1, sizeof( dynlist_url_t ) + url->bv_len + 1 );
+	du->du_dli = dli;
+	du->du_dlg = dlg;
+	du->du_url.bv_val = (char *)(du + 1);
+	du->du_url.bv_len = url->bv_len;
+	AC_MEMCPY( du->du_url.bv_val, url->bv_val, url->bv_len );
+	du->du_bad = 1;
+
+	if ( ldap_url_parse( url->bv_val, &lud ) != LDAP_URL_SUCCESS ) {
+		/* FIXME: error? */
+		return du;
+	}
+	du->du_lud = lud;
+
+	if ( lud->lud_host != NULL ) {
+		/* FIXME: host not allowed; reject as illegal? */
+		Debug( LDAP_DEBUG_ANY, "dynlist_prepare_entry(\"%s\"): "
+			"illegal URI \"%s\"\n",
+			e->e_name.bv_val, url->bv_val );
+		return du;
+	}
+
+	if ( lud->lud_dn == NULL ) {
+		/* note that an empty base is not honored in terms
+		 * of defaultSearchBase, because select_backend()
+		 * is not aware of the defaultSearchBase option;
+		 * this can be useful in case of a database serving
+		 * the empty suffix */
+		BER_BVSTR( &dn, "" );
+
+	} else {
+		ber_str2bv( lud->lud_dn, 0, 0, &dn );
+	}
+	if ( dnPrettyNormal( NULL, &dn, &du->du_dn, &du->du_ndn, NULL )
+		!= LDAP_SUCCESS )
+	{
+		/* FIXME: error? */
+		return du;
+	}
+	du->du_scope = lud->lud_scope;
+
+	if ( lud->lud_filter == NULL ) {
+		ber_dupbv( &du->du_filterstr, &dli->dli_default_filter );
+
+	} else {
+		struct berval	flt, newf;
+
+		ber_str2bv( lud->lud_filter, 0, 0, &flt );
+		if ( dynlist_make_filter( op, e, dli, url->bv_val, &flt, &newf ) ) {
+			/* error */
+			return du;
+		}
+		ber_dupbv( &du->du_filterstr, &newf );
+		op->o_tmpfree( newf.bv_val, op->o_tmpmemctx );
+	}
+	du->du_filter = str2filter( du->du_filterstr.bv_val );
+	if ( du->du_filter == NULL ) {
+		return du;
+	}
+
+	du->du_bad = 0;
+	return du;
+}
+
+/* Find or build the compiled form of url; release it when done */
+static dynlist_url_t *
+dynlist_url_get( Operation *op, dynlist_gen_t *dlg, dynlist_info_t *dli,
+	struct berval *url, Entry *e )
+{
+	dynlist_url_t	key, *du, *old;
+
+	if ( dlg->dlg_cache_max ) {
+		key.du_dli = dli;
+		key.du_url = *url;
+		ldap_pvt_thread_mutex_lock( &dlg->dlg_mutex );
+		du = avl_find( dlg->dlg_urls, &key, dynlist_url_cmp );
+		if ( du ) {
+			du->du_refs++;
+			LDAP_TAILQ_REMOVE( &dlg->dlg_url_lru, du, du_lru );
+			LDAP_TAILQ_INSERT_TAIL( &dlg->dlg_url_lru, du, du_lru );
+		}
+		ldap_pvt_thread_mutex_unlock( &dlg->dlg_mutex );
+		if ( du )
+			return du;
+	}
+
+	du = dynlist_url_compile( op, dlg, dli, url, e );
+	du->du_refs = 1;
+
+	if ( !dlg->dlg_cache_max ) {
+		du->du_dead = 1;
+		return du;
+	}
+
+	ldap_pvt_thread_mutex_lock( &dlg->dlg_mutex );
+	if ( avl_insert( &dlg->dlg_urls, du, dynlist_url_cmp, avl_dup_error ) ) {
+		/* another thread got here first */
+		old = avl_find( dlg->dlg_urls, du, dynlist_url_cmp );
+		old->du_refs++;
+		ldap_pvt_thread_mutex_unlock( &dlg->dlg_mutex );
+		dynlist_url_free( du );
+		return old;
+	}
+	LDAP_TAILQ_INSERT_TAIL( &dlg->dlg_url_lru, du, du_lru );
+	dlg->dlg_nurls++;
+	dynlist_cache_trim( dlg );
+	ldap_pvt_thread_mutex_unlock( &dlg->dlg_mutex );
+
+	return du;
+}
+
+static void
+dynlist_url_release( dynlist_gen_t *dlg, dynlist_url_t *du )
+{
+	ldap_pvt_thread_mutex_lock( &dlg->dlg_mutex );
+	if ( --du->du_refs == 0 && du->du_dead )
+		dynlist_url_free( du );
+	ldap_pvt_thread_mutex_unlock( &dlg->dlg_mutex );
+}
+
+/*
+ * Whether the members found for du may be cached: a write is only seen
+ * by dynlist_response() if it goes to the database the overlay is on.
+ */
+static int
+dynlist_res_target( dynlist_gen_t *dlg, dynlist_url_t *du )
+{
+	BackendDB	*be = select_backend( &du->du_ndn, 1 );
+
+	return be != NULL && be == dlg->dlg_be && !SLAP_GLUE_INSTANCE( be );
+}
+
+#define	DYNLIST_KEY_REALDN	0x01
+#define	DYNLIST_KEY_SSF		0x02
+#define	DYNLIST_KEY_PEERNAME	0x04
+#define	DYNLIST_KEY_DOMAIN	0x08
+#define	DYNLIST_KEY_SOCKURL	0x10
+#define	DYNLIST_KEY_SOCKNAME	0x20
+#define	DYNLIST_KEY_PARTS	7
+
+/*
+ * Build the cache key for the expansions op does in be: the identity
+ * plus whatever else about the requester the ACLs look at.  Returns
+ * -1 if they use group or set clauses or dynamic ACLs, which may
+ * depend on entries anywhere, so the results can't be cached.
+ */
+static int
+dynlist_res_key( Operation *op, BackendDB *be, struct berval *key )
+{
+	Connection	*c = op->o_conn;
+	AccessControl	*acls[ 2 ], *a;
+	Access		*b;
+	struct berval	parts[ DYNLIST_KEY_PARTS ];
+	char		ssf[ 64 ], *p;
+	int		i, need = 0;
+
+	acls[ 0 ] = be->be_acl;
+	acls[ 1 ] = frontendDB->be_acl;
+	for ( i = 0; i < 2; i++ ) {
+		for ( a = acls[ i ]; a; a = a->acl_next ) {
+			for ( b = a->acl_access; b; b = b->a_next ) {
+				if ( !BER_BVISNULL( &b->a_group_pat ) ||
+					!BER_BVISNULL( &b->a_set_pat )
+#ifdef SLAP_DYNACL
+					|| b->a_dynacl != NULL
+#endif /* SLAP_DYNACL */
+					)
+				{
+					return -1;
+				}
+				if ( !BER_BVISEMPTY( &b->a_realdn_pat ) ||
+					b->a_realdn_at != NULL )
+					need |= DYNLIST_KEY_REALDN;
+				if ( b->a_authz.sai_ssf ||
+					b->a_authz.sai_transport_ssf ||
+					b->a_authz.sai_tls_ssf ||
+					b->a_authz.sai_sasl_ssf )
+					need |= DYNLIST_KEY_SSF;
+				if ( !BER_BVISNULL( &b->a_peername_pat ) )
+					need |= DYNLIST_KEY_PEERNAME;
+				if ( !BER_BVISNULL( &b->a_domain_pat ) )
+					need |= DYNLIST_KEY_DOMAIN;
+				if ( !BER_BVISNULL( &b->a_sockurl_pat ) )
+					need |= DYNLIST_KEY_SOCKURL;
+				if ( !BER_BVISNULL( &b->a_sockname_pat ) )
+					need |= DYNLIST_KEY_SOCKNAME;
+			}
+		}
+	}
+
+	for ( i = 0; i < DYNLIST_KEY_PARTS; i++ )
+		BER_BVZERO( &parts[ i ] );
+	parts[ 0 ] = op->o_ndn;
+	if ( need & DYNLIST_KEY_SSF ) {
+		parts[ 1 ].bv_val = ssf;
+		parts[ 1 ].bv_len = snprintf( ssf, sizeof( ssf ), "%u %u %u %u",
+			(unsigned)op->o_ssf, (unsigned)op->o_transport_ssf,
+			(unsigned)op->o_tls_ssf, (unsigned)op->o_sasl_ssf );
+	}
+	if ( c ) {
+		if ( need & DYNLIST_KEY_REALDN )
+			parts[ 2 ] = c->c_ndn;
+		if ( need & DYNLIST_KEY_PEERNAME )
+			parts[ 3 ] = c->c_peer_name;
+		if ( need & DYNLIST_KEY_DOMAIN )
+			parts[ 4 ] = c->c_peer_domain;
+		if ( c->c_listener ) {
+			if ( need & DYNLIST_KEY_SOCKURL )
+				parts[ 5 ] = c->c_listener_url;
+			if ( need & DYNLIST_KEY_SOCKNAME )
+				parts[ 6 ] = c->c_sock_name;
+		}
+	}
+
+	key->bv_len = 0;
+	for ( i = 0; i < DYNLIST_KEY_PARTS; i++ )
+		key->bv_len += parts[ i ].bv_len + 1;
+	key->bv_val = p = op->o_tmpalloc( key->bv_len, op->o_tmpmemctx );
+	for ( i = 0; i < DYNLIST_KEY_PARTS; i++ ) {
+		if ( parts[ i ].bv_len ) {
+			AC_MEMCPY( p, parts[ i ].bv_val, parts[ i ].bv_len );
+			p += parts[ i ].bv_len;
+		}
+		*p++ = '\0';
+	}
+	return 0;
+}
+
+/*
+ * Find the members of du that were found for key, if still valid.
+ * Otherwise note the generations a new search of du starts from.
+ */
+static dynlist_res_t *
+dynlist_res_get( dynlist_gen_t *dlg, dynlist_url_t *du, struct berval *rkey,
+	unsigned long *genp, unsigned long *aclgenp )
+{
+	dynlist_res_t	key, *dr;
+
+	key.dr_key = *rkey;
+	ldap_pvt_thread_mutex_lock( &dlg->dlg_mutex );
+	*genp = du->du_gen;
+	*aclgenp = slap_acl_gen;
+	dr = avl_find( du->du_results, &key, dynlist_res_cmp );
+	if ( dr ) {
+		if ( dr->dr_expire <= slap_get_time() ||
+			dr->dr_aclgen != slap_acl_gen )
+		{
+			avl_delete( &du->du_results, dr, dynlist_res_cmp );
+			dynlist_res_drop( dr );
+			dr = NULL;
+
+		} else {
+			dr->dr_refs++;
+			LDAP_TAILQ_REMOVE( &dlg->dlg_res_lru, dr, dr_lru );
+			LDAP_TAILQ_INSERT_TAIL( &dlg->dlg_res_lru, dr, dr_lru );
+		}
+	}
+	ldap_pvt_thread_mutex_unlock( &dlg->dlg_mutex );
+
+	return dr;
+}
+
+/*
+ * Remember the members found for du and key; takes over vals and nvals.
+ * They are dropped if the scope of du was written to or the ACLs
+ * changed since the search started, at generations gen and aclgen.
+ */
+static void
+dynlist_res_put( dynlist_gen_t *dlg, dynlist_url_t *du, struct berval *key,
+	unsigned long gen, unsigned long aclgen,
+	BerVarray vals, BerVarray nvals, int numvals )
+{
+	dynlist_res_t	*dr;
+
+	dr = ch_calloc( 1, sizeof( dynlist_res_t ) + key->bv_len );
+	dr->dr_key.bv_val = (char *)(dr + 1);
+	dr->dr_key.bv_len = key->bv_len;
+	AC_MEMCPY( dr->dr_key.bv_val, key->bv_val, key->bv_len );
+	dr->dr_url = du;
+	dr->dr_expire = slap_get_time() + dlg->dlg_cache_ttl;
+	dr->dr_aclgen = aclgen;
+	dr->dr_vals = vals;
+	dr->dr_nvals = nvals;
+	dr->dr_numvals = numvals;
+
+	ldap_pvt_thread_mutex_lock( &dlg->dlg_mutex );
+	if ( du->du_dead || du->du_gen != gen || aclgen != slap_acl_gen ||
+		avl_insert( &du->du_results, dr, dynlist_res_cmp, avl_dup_error ) )
+	{
+		ldap_pvt_thread_mutex_unlock( &dlg->dlg_mutex );
+		dynlist_res_free( dr );
+		return;
+	}
+	LDAP_TAILQ_INSERT_TAIL( &dlg->dlg_res_lru, dr, dr_lru );
+	dlg->dlg_nres++;
+	dynlist_cache_trim( dlg );
+	ldap_pvt_thread_mutex_unlock( &dlg->dlg_mutex );
+}
+
+static void
+dynlist_res_release( dynlist_gen_t *dlg, dynlist_res_t *dr )
+{
+	ldap_pvt_thread_mutex_lock( &dlg->dlg_mutex );
+	if ( --dr->dr_refs == 0 && dr->dr_dead )
+		dynlist_res_free( dr );
+	ldap_pvt_thread_mutex_unlock( &dlg->dlg_mutex );
+}
+
 /* dynlist_sc_update() callback info set by dynlist_prepare_entry() */
 typedef struct dynlist_sc_t {
 	dynlist_info_t    *dlc_dli;
 	Entry		*dlc_e;
+	int		dlc_collect;	/* keep the members for the cache */
+	unsigned long	dlc_gen;	/* as of the start of the search */
+	unsigned long	dlc_aclgen;
+	BerVarray	dlc_vals;
+	BerVarray	dlc_nvals;
+	int		dlc_numvals;
 } dynlist_sc_t;
 
 static int
@@ -189,6 +708,12 @@ dynlist_sc_update( Operation *op, SlapReply *rs )
 
 			(void)modify_add_values( e, &mod, /* permissive */ 1,
 					&text, textbuf, sizeof( textbuf ) );
+
+			if ( dlc->dlc_collect ) {
+				value_add_one( &dlc->dlc_vals, &vals[ 0 ] );
+				value_add_one( &dlc->dlc_nvals, &nvals[ 0 ] );
+				dlc->dlc_numvals++;
+			}
 		}
 
 		goto done;
@@ -319,7 +844,7 @@ done:;
 }
 	
 static int
-dynlist_prepare_entry( Operation *op, SlapReply *rs, dynlist_info_t *dli )
+dynlist_prepare_entry( Operation *op, SlapReply *rs, dynlist_gen_t *dlg, dynlist_info_t *dli )
 {
 	Attribute	*a, *id = NULL;
 	slap_callback	cb = { 0 };
@@ -330,6 +855,8 @@ dynlist_prepare_entry( Operation *op, SlapReply *rs, dynlist_info_t *dli )
 			userattrs;
 	dynlist_sc_t	dlc = { 0 };
 	dynlist_map_t	*dlm;
+	int		listing;
+	struct berval	rkey = BER_BVNULL;
 
 	a = attrs_find( rs->sr_entry->e_attrs, dli->dli_ad );
 	if ( a == NULL ) {
@@ -388,48 +915,59 @@ dynlist_prepare_entry( Operation *op, SlapReply *rs, dynlist_info_t *dli )
 	o.ors_tlimit = SLAP_NO_LIMIT;
 	o.ors_slimit = SLAP_NO_LIMIT;
 
+	/* a plain member list does not depend on the attributes requested,
+	 * only on who is looking and how, so it can be cached */
+	dlm = dli->dli_dlm;
+	listing = dlm && dlm->dlm_mapped_ad == NULL && dlm->dlm_next == NULL;
+
 	for ( url = a->a_nvals; !BER_BVISNULL( url ); url++ ) {
-		LDAPURLDesc	*lud = NULL;
+		dynlist_url_t	*du;
+		dynlist_res_t	*dr = NULL;
+		LDAPURLDesc	*lud;
 		int		i, j;
-		struct berval	dn;
-		int		rc;
 
-		BER_BVZERO( &o.o_req_dn );
-		BER_BVZERO( &o.o_req_ndn );
-		o.ors_filter = NULL;
 		o.ors_attrs = NULL;
-		BER_BVZERO( &o.ors_filterstr );
-
-		if ( ldap_url_parse( url->bv_val, &lud ) != LDAP_URL_SUCCESS ) {
-			/* FIXME: error? */
-			continue;
-		}
 
-		if ( lud->lud_host != NULL ) {
-			/* FIXME: host not allowed; reject as illegal? */
-			Debug( LDAP_DEBUG_ANY, "dynlist_prepare_entry(\"%s\"): "
-				"illegal URI \"%s\"\n",
-				e->e_name.bv_val, url->bv_val );
+		du = dynlist_url_get( op, dlg, dli, url, rs->sr_entry );
+		if ( du->du_bad ) {
 			goto cleanup;
 		}
-
-		if ( lud->lud_dn == NULL ) {
-			/* note that an empty base is not honored in terms
-			 * of defaultSearchBase, because select_backend()
-			 * is not aware of the defaultSearchBase option;
-			 * this can be useful in case of a database serving
-			 * the empty suffix */
-			BER_BVSTR( &dn, "" );
-
-		} else {
-			ber_str2bv( lud->lud_dn, 0, 0, &dn );
-		}
-		rc = dnPrettyNormal( NULL, &dn, &o.o_req_dn, &o.o_req_ndn, op->o_tmpmemctx );
-		if ( rc != LDAP_SUCCESS ) {
-			/* FIXME: error? */
-			goto cleanup;
+		lud = du->du_lud;
+
+		o.o_req_dn = du->du_dn;
+		o.o_req_ndn = du->du_ndn;
+		o.ors_scope = du->du_scope;
+		/* shared with other threads, the search only reads it */
+		o.ors_filter = du->du_filter;
+		o.ors_filterstr = du->du_filterstr;
+
+		if ( listing && dlg->dlg_cache_ttl &&
+			dynlist_res_target( dlg, du ) &&
+			( !BER_BVISNULL( &rkey ) ||
+				dynlist_res_key( &o, dlg->dlg_be, &rkey ) == 0 ) )
+		{
+			dr = dynlist_res_get( dlg, du, &rkey,
+				&dlc.dlc_gen, &dlc.dlc_aclgen );
+			if ( dr ) {
+				if ( dr->dr_numvals ) {
+					Modification	mod;
+					const char	*text = NULL;
+					char		textbuf[1024];
+
+					mod.sm_op = LDAP_MOD_ADD;
+					mod.sm_desc = dlm->dlm_member_ad;
+					mod.sm_type = dlm->dlm_member_ad->ad_cname;
+					mod.sm_values = dr->dr_vals;
+					mod.sm_nvalues = dr->dr_nvals;
+					mod.sm_numvals = dr->dr_numvals;
+
+					(void)modify_add_values( e, &mod, /* permissive */ 1,
+							&text, textbuf, sizeof( textbuf ) );
+				}
+				goto cleanup;
+			}
+			dlc.dlc_collect = 1;
 		}
-		o.ors_scope = lud->lud_scope;
 
 		for ( dlm = dli->dli_dlm; dlm; dlm = dlm->dlm_next ) {
 			if ( dlm->dlm_mapped_ad != NULL ) {
@@ -521,53 +1059,48 @@ dynlist_prepare_entry( Operation *op, SlapReply *rs, dynlist_info_t *dli )
 			BER_BVZERO( &o.ors_attrs[j].an_name );
 		}
 
-		if ( lud->lud_filter == NULL ) {
-			ber_dupbv_x( &o.ors_filterstr,
-					&dli->dli_default_filter, op->o_tmpmemctx );
-
-		} else {
-			struct berval	flt;
-			ber_str2bv( lud->lud_filter, 0, 0, &flt );
-			if ( dynlist_make_filter( op, rs->sr_entry, dli, url->bv_val, &flt, &o.ors_filterstr ) ) {
-				/* error */
-				goto cleanup;
-			}
-		}
-		o.ors_filter = str2filter_x( op, o.ors_filterstr.bv_val );
-		if ( o.ors_filter == NULL ) {
-			goto cleanup;
-		}
-		
 		o.o_bd = select_backend( &o.o_req_ndn, 1 );
 		if ( o.o_bd && o.o_bd->be_search ) {
 			SlapReply	r = { REP_SEARCH };
+			int		rc;
+
 			r.sr_attr_flags = slap_attr_flags( o.ors_attrs );
 			o.o_managedsait = SLAP_CONTROL_CRITICAL;
-			(void)o.o_bd->be_search( &o, &r );
+			rc = o.o_bd->be_search( &o, &r );
+			if ( dlc.dlc_collect && rc == LDAP_SUCCESS ) {
+				dynlist_res_put( dlg, du, &rkey,
+					dlc.dlc_gen, dlc.dlc_aclgen,
+					dlc.dlc_vals, dlc.dlc_nvals, dlc.dlc_numvals );
+				dlc.dlc_vals = NULL;
+				dlc.dlc_nvals = NULL;
+			}
 		}
 
 cleanup:;
 		if ( id ) {
 			slap_op_groups_free( &o );
 		}
-		if ( o.ors_filter ) {
-			filter_free_x( &o, o.ors_filter, 1 );
-		}
 		if ( o.ors_attrs && o.ors_attrs != rs->sr_attrs
 				&& o.ors_attrs != slap_anlist_no_attrs )
 		{
 			op->o_tmpfree( o.ors_attrs, op->o_tmpmemctx );
 		}
-		if ( !BER_BVISNULL( &o.o_req_dn ) ) {
-			op->o_tmpfree( o.o_req_dn.bv_val, op->o_tmpmemctx );
+		if ( dlc.dlc_vals ) {
+			ber_bvarray_free( dlc.dlc_vals );
+			ber_bvarray_free( dlc.dlc_nvals );
+			dlc.dlc_vals = NULL;
+			dlc.dlc_nvals = NULL;
 		}
-		if ( !BER_BVISNULL( &o.o_req_ndn ) ) {
-			op->o_tmpfree( o.o_req_ndn.bv_val, op->o_tmpmemctx );
+		dlc.dlc_collect = 0;
+		dlc.dlc_numvals = 0;
+		if ( dr ) {
+			dynlist_res_release( dlg, dr );
 		}
-		assert( BER_BVISNULL( &o.ors_filterstr )
-			|| o.ors_filterstr.bv_val != lud->lud_filter );
-		op->o_tmpfree( o.ors_filterstr.bv_val, op->o_tmpmemctx );
-		ldap_free_urldesc( lud );
+		dynlist_url_release( dlg, du );
+	}
+
+	if ( !BER_BVISNULL( &rkey ) ) {
+		op->o_tmpfree( rkey.bv_val, op->o_tmpmemctx );
 	}
 
 	if ( e != rs->sr_entry ) {
@@ -611,7 +1144,8 @@ static int
 dynlist_compare( Operation *op, SlapReply *rs )
 {
 	slap_overinst	*on = (slap_overinst *)op->o_bd->bd_info;
-	dynlist_info_t	*dli = (dynlist_info_t *)on->on_bi.bi_private;
+	dynlist_gen_t	*dlg = (dynlist_gen_t *)on->on_bi.bi_private;
+	dynlist_info_t	*dli = dlg->dlg_dli;
 	Operation o = *op;
 	Entry *e = NULL;
 	dynlist_map_t *dlm;
@@ -702,7 +1236,7 @@ done:;
 	}
 
 	/* check for dynlist objectClass; done if not found */
-	dli = (dynlist_info_t *)on->on_bi.bi_private;
+	dli = dlg->dlg_dli;
 	while ( dli != NULL && !is_entry_objectclass_or_sub( e, dli->dli_oc ) ) {
 		dli = dli->dli_next;
 	}
@@ -758,7 +1292,7 @@ done:;
 		r.sr_attrs = an;
 
 		o.o_acl_priv = ACL_COMPARE;
-		dynlist_prepare_entry( &o, &r, dli );
+		dynlist_prepare_entry( &o, &r, dlg, dli );
 		a = attrs_find( r.sr_entry->e_attrs, op->orc_ava->aa_desc );
 
 		ret = LDAP_NO_SUCH_ATTRIBUTE;
@@ -794,6 +1328,7 @@ typedef struct dynlist_name_t {
 } dynlist_name_t;
 
 typedef struct dynlist_search_t {
+	dynlist_gen_t *ds_dlg;
 	TAvlnode *ds_names;
 	dynlist_info_t *ds_dli;
 	Filter *ds_origfilter;
@@ -961,7 +1496,7 @@ dynlist_search2resp( Operation *op, SlapReply *rs )
 		dyn = tavl_find( ds->ds_names, &rs->sr_entry->e_nname, dynlist_avl_cmp );
 		if ( dyn ) {
 			dyn->dy_seen = 1;
-			rc = dynlist_prepare_entry( op, rs, dyn->dy_dli );
+			rc = dynlist_prepare_entry( op, rs, ds->ds_dlg, dyn->dy_dli );
 			return rc;
 		} else {
 			TAvlnode *ptr;
@@ -1015,7 +1550,7 @@ dynlist_search2resp( Operation *op, SlapReply *rs )
 				r.sr_entry == NULL )
 				continue;
 			r.sr_flags = REP_ENTRY_MUSTRELEASE;
-			dynlist_prepare_entry( op, &r, dyn->dy_dli );
+			dynlist_prepare_entry( op, &r, ds->ds_dlg, dyn->dy_dli );
 			if ( test_filter( op, r.sr_entry, op->ors_filter ) == LDAP_COMPARE_TRUE ) {
 				r.sr_attrs = op->ors_attrs;
 				rs->sr_err = send_search_entry( op, &r );
@@ -1048,7 +1583,8 @@ static int
 dynlist_search( Operation *op, SlapReply *rs )
 {
 	slap_overinst	*on = (slap_overinst *)op->o_bd->bd_info;
-	dynlist_info_t	*dli = (dynlist_info_t *)on->on_bi.bi_private;
+	dynlist_gen_t	*dlg = (dynlist_gen_t *)on->on_bi.bi_private;
+	dynlist_info_t	*dli = dlg->dlg_dli;
 	Operation o = *op;
 	dynlist_map_t *dlm;
 	Filter f;
@@ -1064,6 +1600,7 @@ dynlist_search( Operation *op, SlapReply *rs )
 	sc = op->o_tmpcalloc( 1, sizeof(slap_callback)+sizeof(dynlist_search_t), op->o_tmpmemctx );
 	sc->sc_private = (void *)(sc+1);
 	ds = sc->sc_private;
+	ds->ds_dlg = dlg;
 
 	f.f_choice = LDAP_FILTER_EQUALITY;
 	f.f_ava = &ava;
@@ -1121,6 +1658,44 @@ dynlist_search( Operation *op, SlapReply *rs )
 	return SLAP_CB_CONTINUE;
 }
 
+/* drop the cached expansions a successful write may have changed */
+static int
+dynlist_response( Operation *op, SlapReply *rs )
+{
+	slap_overinst	*on = (slap_overinst *)op->o_bd->bd_info;
+	dynlist_gen_t	*dlg = (dynlist_gen_t *)on->on_bi.bi_private;
+
+	if ( rs->sr_type != REP_RESULT || rs->sr_err != LDAP_SUCCESS ||
+		!dlg->dlg_cache_ttl )
+	{
+		return SLAP_CB_CONTINUE;
+	}
+
+	switch ( op->o_tag ) {
+	case LDAP_REQ_ADD:
+	case LDAP_REQ_DELETE:
+	case LDAP_REQ_MODIFY:
+		dynlist_cache_invalidate( dlg, &op->o_req_ndn, 0 );
+		break;
+
+	case LDAP_REQ_MODRDN: {
+		struct berval	pdn, ndn;
+
+		dynlist_cache_invalidate( dlg, &op->o_req_ndn, 1 );
+		if ( op->orr_nnewSup ) {
+			pdn = *op->orr_nnewSup;
+		} else {
+			dnParent( &op->o_req_ndn, &pdn );
+		}
+		build_new_dn( &ndn, &pdn, &op->orr_nnewrdn, op->o_tmpmemctx );
+		dynlist_cache_invalidate( dlg, &ndn, 1 );
+		op->o_tmpfree( ndn.bv_val, op->o_tmpmemctx );
+		} break;
+	}
+
+	return SLAP_CB_CONTINUE;
+}
+
 static int
 dynlist_build_def_filter( dynlist_info_t *dli )
 {
@@ -1147,6 +1722,8 @@ enum {
 	DL_ATTRSET = 1,
 	DL_ATTRPAIR,
 	DL_ATTRPAIR_COMPAT,
+	DL_CACHE_SIZE,
+	DL_CACHE_TTL,
 	DL_LAST
 };
 
@@ -1170,6 +1747,20 @@ static ConfigTable dlcfg[] = {
 		3, 3, 0, ARG_MAGIC|DL_ATTRPAIR_COMPAT, dl_cfgen,
 			NULL, NULL, NULL },
 #endif
+	{ "dynlist-cache-size", "count",
+		2, 2, 0, ARG_MAGIC|ARG_UINT|DL_CACHE_SIZE, dl_cfgen,
+		"( OLcfgOvAt:8.2 NAME 'olcDlCacheSize' "
+			"DESC 'Dynamic list: number of memberURLs and of expansions cached' "
+			"EQUALITY integerMatch "
+			"SYNTAX OMsInteger SINGLE-VALUE )",
+			NULL, NULL },
+	{ "dynlist-cache-ttl", "seconds",
+		2, 2, 0, ARG_MAGIC|ARG_UINT|DL_CACHE_TTL, dl_cfgen,
+		"( OLcfgOvAt:8.3 NAME 'olcDlCacheTTL' "
+			"DESC 'Dynamic list: how long an expansion stays cached, 0 to disable' "
+			"EQUALITY integerMatch "
+			"SYNTAX OMsInteger SINGLE-VALUE )",
+			NULL, NULL },
 	{ NULL, NULL, 0, 0, 0, ARG_IGNORED }
 };
 
@@ -1178,7 +1769,7 @@ static ConfigOCs dlocs[] = {
 		"NAME 'olcDynamicList' "
 		"DESC 'Dynamic list configuration' "
 		"SUP olcOverlayConfig "
-		"MAY olcDLattrSet )",
+		"MAY ( olcDLattrSet $ olcDlCacheSize $ olcDlCacheTTL ) )",
 		Cft_Overlay, dlcfg, NULL, NULL },
 	{ NULL, 0, NULL }
 };
@@ -1187,7 +1778,8 @@ static int
 dl_cfgen( ConfigArgs *c )
 {
 	slap_overinst	*on = (slap_overinst *)c->bi;
-	dynlist_info_t	*dli = (dynlist_info_t *)on->on_bi.bi_private;
+	dynlist_gen_t	*dlg = (dynlist_gen_t *)on->on_bi.bi_private;
+	dynlist_info_t	*dli = dlg->dlg_dli;
 
 	int		rc = 0, i;
 
@@ -1247,6 +1839,14 @@ dl_cfgen( ConfigArgs *c )
 			rc = 1;
 			break;
 
+		case DL_CACHE_SIZE:
+			c->value_uint = dlg->dlg_cache_max;
+			break;
+
+		case DL_CACHE_TTL:
+			c->value_uint = dlg->dlg_cache_ttl;
+			break;
+
 		default:
 			rc = 1;
 			break;
@@ -1257,6 +1857,8 @@ dl_cfgen( ConfigArgs *c )
 	} else if ( c->op == LDAP_MOD_DELETE ) {
 		switch( c->type ) {
 		case DL_ATTRSET:
+			/* cached URLs refer to the attrsets */
+			dynlist_cache_flush( dlg );
 			if ( c->valx < 0 ) {
 				dynlist_info_t	*dli_next;
 
@@ -1292,14 +1894,14 @@ dl_cfgen( ConfigArgs *c )
 					ch_free( dli );
 				}
 
-				on->on_bi.bi_private = NULL;
+				dlg->dlg_dli = NULL;
 
 			} else {
 				dynlist_info_t	**dlip;
 				dynlist_map_t *dlm;
 				dynlist_map_t *dlm_next;
 
-				for ( i = 0, dlip = (dynlist_info_t **)&on->on_bi.bi_private;
+				for ( i = 0, dlip = &dlg->dlg_dli;
 					i < c->valx; i++ )
 				{
 					if ( *dlip == NULL ) {
@@ -1337,7 +1939,7 @@ dl_cfgen( ConfigArgs *c )
 				}
 				ch_free( dli );
 
-				dli = (dynlist_info_t *)on->on_bi.bi_private;
+				dli = dlg->dlg_dli;
 			}
 			break;
 
@@ -1346,6 +1948,18 @@ dl_cfgen( ConfigArgs *c )
 			rc = 1;
 			break;
 
+		case DL_CACHE_SIZE:
+			ldap_pvt_thread_mutex_lock( &dlg->dlg_mutex );
+			dlg->dlg_cache_max = DYNLIST_CACHE_SIZE_DEFAULT;
+			dynlist_cache_trim( dlg );
+			ldap_pvt_thread_mutex_unlock( &dlg->dlg_mutex );
+			break;
+
+		case DL_CACHE_TTL:
+			dlg->dlg_cache_ttl = 0;
+			dynlist_cache_flush( dlg );
+			break;
+
 		default:
 			rc = 1;
 			break;
@@ -1571,7 +2185,7 @@ done_uri:;
 		if ( c->valx > 0 ) {
 			int	i;
 
-			for ( i = 0, dlip = (dynlist_info_t **)&on->on_bi.bi_private;
+			for ( i = 0, dlip = &dlg->dlg_dli;
 				i < c->valx; i++ )
 			{
 				if ( *dlip == NULL ) {
@@ -1589,7 +2203,7 @@ done_uri:;
 			dli_next = *dlip;
 
 		} else {
-			for ( dlip = (dynlist_info_t **)&on->on_bi.bi_private;
+			for ( dlip = &dlg->dlg_dli;
 				*dlip; dlip = &(*dlip)->dli_next )
 				/* goto last */;
 		}
@@ -1667,7 +2281,7 @@ done_uri:;
 			return 1;
 		}
 
-		for ( dlip = (dynlist_info_t **)&on->on_bi.bi_private;
+		for ( dlip = &dlg->dlg_dli;
 			*dlip; dlip = &(*dlip)->dli_next )
 		{
 			/* 
@@ -1706,6 +2320,20 @@ done_uri:;
 
 		} break;
 
+	case DL_CACHE_SIZE:
+		ldap_pvt_thread_mutex_lock( &dlg->dlg_mutex );
+		dlg->dlg_cache_max = c->value_uint;
+		dynlist_cache_trim( dlg );
+		ldap_pvt_thread_mutex_unlock( &dlg->dlg_mutex );
+		break;
+
+	case DL_CACHE_TTL:
+		/* results kept under the old setting may have missed
+		 * invalidations, or be due to expire too late */
+		dlg->dlg_cache_ttl = c->value_uint;
+		dynlist_cache_flush( dlg );
+		break;
+
 	default:
 		rc = 1;
 		break;
@@ -1714,13 +2342,32 @@ done_uri:;
 	return rc;
 }
 
+static int
+dynlist_db_init(
+	BackendDB	*be,
+	ConfigReply	*cr )
+{
+	slap_overinst	*on = (slap_overinst *) be->bd_info;
+	dynlist_gen_t	*dlg;
+
+	dlg = (dynlist_gen_t *)ch_calloc( 1, sizeof( dynlist_gen_t ) );
+	ldap_pvt_thread_mutex_init( &dlg->dlg_mutex );
+	LDAP_TAILQ_INIT( &dlg->dlg_url_lru );
+	LDAP_TAILQ_INIT( &dlg->dlg_res_lru );
+	dlg->dlg_cache_max = DYNLIST_CACHE_SIZE_DEFAULT;
+	on->on_bi.bi_private = (void *)dlg;
+
+	return 0;
+}
+
 static int
 dynlist_db_open(
 	BackendDB	*be,
 	ConfigReply	*cr )
 {
 	slap_overinst		*on = (slap_overinst *) be->bd_info;
-	dynlist_info_t		*dli = (dynlist_info_t *)on->on_bi.bi_private;
+	dynlist_gen_t		*dlg = (dynlist_gen_t *)on->on_bi.bi_private;
+	dynlist_info_t		*dli = dlg->dlg_dli;
 	ObjectClass		*oc = NULL;
 	AttributeDescription	*ad = NULL;
 	const char	*text;
@@ -1728,9 +2375,11 @@ dynlist_db_open(
 
 	if ( dli == NULL ) {
 		dli = ch_calloc( 1, sizeof( dynlist_info_t ) );
-		on->on_bi.bi_private = (void *)dli;
+		dlg->dlg_dli = dli;
 	}
 
+	dlg->dlg_be = on->on_info->oi_origdb;
+
 	for ( ; dli; dli = dli->dli_next ) {
 		if ( dli->dli_oc == NULL ) {
 			if ( oc == NULL ) {
@@ -1800,9 +2449,17 @@ dynlist_db_destroy(
 	ConfigReply	*cr )
 {
 	slap_overinst	*on = (slap_overinst *) be->bd_info;
+	dynlist_gen_t	*dlg = (dynlist_gen_t *)on->on_bi.bi_private;
+
+	if ( dlg == NULL ) {
+		return 0;
+	}
+
+	dynlist_cache_flush( dlg );
+	ldap_pvt_thread_mutex_destroy( &dlg->dlg_mutex );
 
-	if ( on->on_bi.bi_private ) {
-		dynlist_info_t	*dli = (dynlist_info_t *)on->on_bi.bi_private,
+	if ( dlg->dlg_dli ) {
+		dynlist_info_t	*dli = dlg->dlg_dli,
 				*dli_next;
 
 		for ( dli_next = dli; dli_next; dli = dli_next ) {
@@ -1839,6 +2496,9 @@ dynlist_db_destroy(
 		}
 	}
 
+	ch_free( dlg );
+	on->on_bi.bi_private = NULL;
+
 	return 0;
 }
 
@@ -1865,12 +2525,14 @@ dynlist_initialize(void)
 	dynlist.on_bi.bi_obsolete_names = obsolete_names;
 #endif
 
+	dynlist.on_bi.bi_db_init = dynlist_db_init;
 	dynlist.on_bi.bi_db_config = config_generic_wrapper;
 	dynlist.on_bi.bi_db_open = dynlist_db_open;
 	dynlist.on_bi.bi_db_destroy = dynlist_db_destroy;
 
 	dynlist.on_bi.bi_op_search = dynlist_search;
 	dynlist.on_bi.bi_op_compare = dynlist_compare;
+	dynlist.on_response = dynlist_response;
 
 	dynlist.on_bi.bi_cf_ocs = dlocs;
 
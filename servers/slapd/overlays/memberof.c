@@ -162,6 +162,10 @@ typedef struct memberof_t {
 
 	ber_int_t		mo_dangling_err;
 
+	/* apply this many updates or more in a single transaction */
+	unsigned		mo_batch;
+#define	MEMBEROF_BATCH_DEFAULT	16
+
 #define MEMBEROF_CHK(mo,f) \
 	(((mo)->mo_flags & (f)) == (f))
 #define MEMBEROF_DANGLING_CHECK(mo) \
@@ -189,11 +193,25 @@ typedef struct memberof_cookie_t {
 	int			foundit;
 } memberof_cookie_t;
 
+/* a pending change to the member or memberOf values of ndn */
+typedef struct memberof_update_t {
+	struct memberof_update_t *mu_next;
+	struct berval		mu_ndn;
+	AttributeDescription	*mu_ad;
+	struct berval		*mu_old_dn;
+	struct berval		*mu_old_ndn;
+	struct berval		*mu_new_dn;
+	struct berval		*mu_new_ndn;
+} memberof_update_t;
+
 typedef struct memberof_cbinfo_t {
 	slap_overinst *on;
 	BerVarray member;
 	BerVarray memberof;
 	memberof_is_t what;
+	memberof_update_t *updates;
+	memberof_update_t **tail;
+	int nupdates;
 } memberof_cbinfo_t;
 
 static void
@@ -340,35 +358,33 @@ memberof_isGroupOrMember( Operation *op, memberof_cbinfo_t *mci )
 }
 
 /*
- * response callback that adds memberof values when a group is modified.
+ * Apply one update with internal modify operations, within txn if
+ * given.  Returns the first error of the modifications.
  */
-static void
-memberof_value_modify(
+static int
+memberof_value_apply(
 	Operation		*op,
-	struct berval		*ndn,
-	AttributeDescription	*ad,
-	struct berval		*old_dn,
-	struct berval		*old_ndn,
-	struct berval		*new_dn,
-	struct berval		*new_ndn )
+	void			*item,
+	OpExtra			*txn,
+	void			*arg )
 {
+	memberof_update_t	*mu = item;
 	memberof_cbinfo_t *mci = op->o_callback->sc_private;
 	slap_overinst	*on = mci->on;
 	memberof_t	*mo = (memberof_t *)on->on_bi.bi_private;
 
+	struct berval	*ndn = &mu->mu_ndn;
+	AttributeDescription	*ad = mu->mu_ad;
+	struct berval	*old_dn = mu->mu_old_dn, *old_ndn = mu->mu_old_ndn,
+			*new_dn = mu->mu_new_dn, *new_ndn = mu->mu_new_ndn;
+
 	Operation	op2 = *op;
 	unsigned long opid = op->o_opid;
 	SlapReply	rs2 = { REP_RESULT };
 	slap_callback	cb = { NULL, slap_null_cb, NULL, NULL };
 	Modifications	mod[ 2 ] = { { { 0 } } }, *ml;
 	struct berval	values[ 4 ], nvalues[ 4 ];
-	int		mcnt = 0;
-
-	if ( old_ndn != NULL && new_ndn != NULL &&
-		ber_bvcmp( old_ndn, new_ndn ) == 0 ) {
-	    /* DNs compare equal, it's a noop */
-	    return;
-	}
+	int		mcnt = 0, rc = LDAP_SUCCESS;
 
 	op2.o_tag = LDAP_REQ_MODIFY;
 
@@ -429,17 +445,22 @@ memberof_value_modify(
 		ml->sml_values[ 0 ] = *new_dn;
 		ml->sml_nvalues[ 0 ] = *new_ndn;
 
+		if ( txn )
+			LDAP_SLIST_INSERT_HEAD(&op2.o_extra, txn, oe_next);
 		oex.oe_key = (void *)&memberof;
 		LDAP_SLIST_INSERT_HEAD(&op2.o_extra, &oex, oe_next);
 		memberof_set_backend( &op2, op, on );
 		(void)op->o_bd->be_modify( &op2, &rs2 );
 		op2.o_bd->bd_info = bi;
 		LDAP_SLIST_REMOVE(&op2.o_extra, &oex, OpExtra, oe_next);
+		if ( txn )
+			LDAP_SLIST_REMOVE(&op2.o_extra, txn, OpExtra, oe_next);
 		if ( rs2.sr_err != LDAP_SUCCESS ) {
 			Debug(LDAP_DEBUG_ANY,
 			      "%s: memberof_value_modify DN=\"%s\" add %s=\"%s\" failed err=%d\n",
 			      op->o_log_prefix, op2.o_req_dn.bv_val,
 			      ad->ad_cname.bv_val, new_dn->bv_val, rs2.sr_err );
+			rc = rs2.sr_err;
 		}
 
 		assert( op2.orm_modlist == &mod[ mcnt ] );
@@ -469,17 +490,24 @@ memberof_value_modify(
 		ml->sml_values[ 0 ] = *old_dn;
 		ml->sml_nvalues[ 0 ] = *old_ndn;
 
+		rs2.sr_err = LDAP_SUCCESS;
+		if ( txn )
+			LDAP_SLIST_INSERT_HEAD(&op2.o_extra, txn, oe_next);
 		oex.oe_key = (void *)&memberof;
 		LDAP_SLIST_INSERT_HEAD(&op2.o_extra, &oex, oe_next);
 		memberof_set_backend( &op2, op, on );
 		(void)op->o_bd->be_modify( &op2, &rs2 );
 		op2.o_bd->bd_info = bi;
 		LDAP_SLIST_REMOVE(&op2.o_extra, &oex, OpExtra, oe_next);
+		if ( txn )
+			LDAP_SLIST_REMOVE(&op2.o_extra, txn, OpExtra, oe_next);
 		if ( rs2.sr_err != LDAP_SUCCESS ) {
 			Debug(LDAP_DEBUG_ANY,
 			      "%s: memberof_value_modify DN=\"%s\" delete %s=\"%s\" failed err=%d\n",
 			      op->o_log_prefix, op2.o_req_dn.bv_val,
 			      ad->ad_cname.bv_val, old_dn->bv_val, rs2.sr_err );
+			if ( rc == LDAP_SUCCESS )
+				rc = rs2.sr_err;
 		}
 
 		assert( op2.orm_modlist == &mod[ mcnt ] );
@@ -499,6 +527,98 @@ memberof_value_modify(
 	 * add will fail; better split in two operations, although
 	 * not optimal in terms of performance.  At least it would
 	 * move towards self-repairing capabilities. */
+
+	return rc;
+}
+
+/*
+ * Queue a change to the member or memberOf values of ndn; the response
+ * callbacks apply them all with memberof_value_flush() once they are
+ * done.  The DNs other than ndn must remain valid until then.
+ */
+static void
+memberof_value_modify(
+	Operation		*op,
+	struct berval		*ndn,
+	AttributeDescription	*ad,
+	struct berval		*old_dn,
+	struct berval		*old_ndn,
+	struct berval		*new_dn,
+	struct berval		*new_ndn )
+{
+	memberof_cbinfo_t *mci = op->o_callback->sc_private;
+	memberof_update_t *mu;
+
+	if ( old_ndn != NULL && new_ndn != NULL &&
+		ber_bvcmp( old_ndn, new_ndn ) == 0 ) {
+	    /* DNs compare equal, it's a noop */
+	    return;
+	}
+
+	mu = op->o_tmpalloc( sizeof( memberof_update_t ) + ndn->bv_len + 1,
+		op->o_tmpmemctx );
+	mu->mu_next = NULL;
+	mu->mu_ndn.bv_len = ndn->bv_len;
+	mu->mu_ndn.bv_val = (char *)(mu+1);
+	AC_MEMCPY( mu->mu_ndn.bv_val, ndn->bv_val, ndn->bv_len );
+	mu->mu_ndn.bv_val[ ndn->bv_len ] = '\0';
+	mu->mu_ad = ad;
+	mu->mu_old_dn = old_dn;
+	mu->mu_old_ndn = old_ndn;
+	mu->mu_new_dn = new_dn;
+	mu->mu_new_ndn = new_ndn;
+
+	*mci->tail = mu;
+	mci->tail = &mu->mu_next;
+	mci->nupdates++;
+}
+
+/*
+ * Apply the queued updates.  When there are enough of them, they are
+ * all made in one backend transaction rather than one each, see
+ * slap_txn_batch().
+ */
+static void
+memberof_value_flush( Operation *op )
+{
+	memberof_cbinfo_t *mci = op->o_callback->sc_private;
+	slap_overinst	*on = mci->on;
+	memberof_t	*mo = (memberof_t *)on->on_bi.bi_private;
+	BackendInfo	*bi = NULL;
+	memberof_update_t *mu, *next;
+	OpExtra		*oex;
+	void		**items;
+	int		i;
+
+	if ( !mci->updates )
+		return;
+
+	if ( mo->mo_batch && mci->nupdates >= mo->mo_batch ) {
+		/* if the operation is still within a write transaction
+		 * of the backend, just join it as before */
+		LDAP_SLIST_FOREACH( oex, &op->o_extra, oe_next ) {
+			if ( oex->oe_key == op->o_bd->be_private )
+				break;
+		}
+		if ( oex == NULL )
+			bi = on->on_info->oi_orig;
+	}
+
+	items = op->o_tmpalloc( mci->nupdates * sizeof(void *),
+		op->o_tmpmemctx );
+	for ( i = 0, mu = mci->updates; mu; mu = mu->mu_next )
+		items[i++] = mu;
+	(void)slap_txn_batch( op, bi, items, i, memberof_value_apply,
+		NULL, "memberof" );
+	op->o_tmpfree( items, op->o_tmpmemctx );
+
+	for ( mu = mci->updates; mu; mu = next ) {
+		next = mu->mu_next;
+		op->o_tmpfree( mu, op->o_tmpmemctx );
+	}
+	mci->updates = NULL;
+	mci->tail = &mci->updates;
+	mci->nupdates = 0;
 }
 
 static int
@@ -748,6 +868,9 @@ memberof_op_add( Operation *op, SlapReply *rs )
 	mci = sc->sc_private;
 	mci->on = on;
 	mci->member = NULL;
+	mci->updates = NULL;
+	mci->tail = &mci->updates;
+	mci->nupdates = 0;
 	mci->memberof = NULL;
 	sc->sc_next = op->o_callback;
 	op->o_callback = sc;
@@ -783,6 +906,9 @@ memberof_op_delete( Operation *op, SlapReply *rs )
 	mci = sc->sc_private;
 	mci->on = on;
 	mci->member = NULL;
+	mci->updates = NULL;
+	mci->tail = &mci->updates;
+	mci->nupdates = 0;
 	mci->memberof = NULL;
 	mci->what = MEMBEROF_IS_GROUP;
 	if ( MEMBEROF_REFINT( mo ) ) {
@@ -1202,6 +1328,9 @@ done2:;
 	mci = sc->sc_private;
 	mci->on = on;
 	mci->member = NULL;
+	mci->updates = NULL;
+	mci->tail = &mci->updates;
+	mci->nupdates = 0;
 	mci->memberof = NULL;
 	mci->what = mcis.what;
 
@@ -1248,6 +1377,9 @@ memberof_op_modrdn( Operation *op, SlapReply *rs )
 	mci = sc->sc_private;
 	mci->on = on;
 	mci->member = NULL;
+	mci->updates = NULL;
+	mci->tail = &mci->updates;
+	mci->nupdates = 0;
 	mci->memberof = NULL;
 
 	sc->sc_next = op->o_callback;
@@ -1318,6 +1450,8 @@ memberof_res_add( Operation *op, SlapReply *rs )
 		}
 	}
 
+	memberof_value_flush( op );
+
 	return SLAP_CB_CONTINUE;
 }
 
@@ -1360,6 +1494,8 @@ memberof_res_delete( Operation *op, SlapReply *rs )
 		}
 	}
 
+	memberof_value_flush( op );
+
 	return SLAP_CB_CONTINUE;
 }
 
@@ -1506,6 +1642,8 @@ memberof_res_modify( Operation *op, SlapReply *rs )
 		}
 	}
 
+	memberof_value_flush( op );
+
 	return SLAP_CB_CONTINUE;
 }
 
@@ -1601,6 +1739,8 @@ memberof_res_modrdn( Operation *op, SlapReply *rs )
 	}
 
 done:;
+	memberof_value_flush( op );
+
 	if ( !BER_BVISNULL( &newDN ) ) {
 		op->o_tmpfree( newDN.bv_val, op->o_tmpmemctx );
 	}
@@ -1624,6 +1764,7 @@ memberof_db_init(
 
 	/* safe default */
 	mo->mo_dangling_err = LDAP_CONSTRAINT_VIOLATION;
+	mo->mo_batch = MEMBEROF_BATCH_DEFAULT;
 
 	if ( !ad_memberOf ) {
 		rc = slap_str2ad( SLAPD_MEMBEROF_ATTR, &ad_memberOf, &text );
@@ -1673,6 +1814,7 @@ enum {
 #endif
 
 	MO_DANGLING_ERROR,
+	MO_BATCH,
 
 	MO_LAST
 };
@@ -1754,6 +1896,14 @@ static ConfigTable mo_cfg[] = {
 			"SYNTAX OMsDirectoryString SINGLE-VALUE )",
 		NULL, NULL },
 
+	{ "memberof-batch", "count",
+		2, 2, 0, ARG_MAGIC|ARG_UINT|MO_BATCH, mo_cf_gen,
+		"( OLcfgOvAt:18.8 NAME 'olcMemberOfBatch' "
+			"DESC 'Smallest number of updates made in one transaction' "
+			"EQUALITY integerMatch "
+			"SYNTAX OMsInteger SINGLE-VALUE )",
+		NULL, NULL },
+
 	{ NULL, NULL, 0, 0, 0, ARG_IGNORED }
 };
 
@@ -1770,6 +1920,7 @@ static ConfigOCs mo_ocs[] = {
 			"$ olcMemberOfGroupOC "
 			"$ olcMemberOfMemberAD "
 			"$ olcMemberOfMemberOfAD "
+			"$ olcMemberOfBatch "
 #if 0
 			"$ olcMemberOfReverse "
 #endif
@@ -1911,6 +2062,10 @@ mo_cf_gen( ConfigArgs *c )
 			c->value_ad = mo->mo_ad_memberof;
 			break;
 
+		case MO_BATCH:
+			c->value_uint = mo->mo_batch;
+			break;
+
 		default:
 			assert( 0 );
 			return 1;
@@ -1961,6 +2116,10 @@ mo_cf_gen( ConfigArgs *c )
 			memberof_make_member_filter( mo );
 			break;
 
+		case MO_BATCH:
+			mo->mo_batch = MEMBEROF_BATCH_DEFAULT;
+			break;
+
 		default:
 			assert( 0 );
 			return 1;
@@ -2070,6 +2229,10 @@ mo_cf_gen( ConfigArgs *c )
 			memberof_make_member_filter( mo );
 			} break;
 
+		case MO_BATCH:
+			mo->mo_batch = c->value_uint;
+			break;
+
 		default:
 			assert( 0 );
 			return 1;
@@ -49,12 +49,20 @@
 #define PPOLICY_DEFAULT_MAXRECORDED_FAILURE	5
 #endif
 
+#ifndef PPOLICY_DEFAULT_WRITE_BEHIND_MAX
+#define PPOLICY_DEFAULT_WRITE_BEHIND_MAX	1000
+#endif
+
 /* Per-instance configuration information */
 typedef struct pp_info {
 	struct berval def_policy;	/* DN of default policy subentry */
 	int use_lockout;		/* send AccountLocked result? */
 	int hash_passwords;		/* transparently hash cleartext pwds */
 	int forward_updates;	/* use frontend for policy state updates */
+	int wb_interval;	/* seconds to defer pwdFailureTime updates */
+	int wb_max;		/* pending entries that force a flush */
+	slap_wb *wb;		/* write-behind store, while open */
+	int db_open;
 } pp_info;
 
 /* Our per-connection info - note, it is not per-instance, it is 
@@ -214,10 +222,12 @@ static ldap_pvt_thread_mutex_t chk_syntax_mutex;
 enum {
 	PPOLICY_DEFAULT = 1,
 	PPOLICY_HASH_CLEARTEXT,
-	PPOLICY_USE_LOCKOUT
+	PPOLICY_USE_LOCKOUT,
+	PPOLICY_WRITE_BEHIND,
+	PPOLICY_WRITE_BEHIND_MAX
 };
 
-static ConfigDriver ppolicy_cf_default;
+static ConfigDriver ppolicy_cf_default, ppolicy_cf_wb;
 
 static ConfigTable ppolicycfg[] = {
 	{ "ppolicy_default", "policyDN", 2, 2, 0,
@@ -247,6 +257,18 @@ static ConfigTable ppolicycfg[] = {
 	  "DESC 'Warn clients with AccountLocked' "
 	  "EQUALITY booleanMatch "
 	  "SYNTAX OMsBoolean SINGLE-VALUE )", NULL, NULL },
+	{ "ppolicy_write_behind", "seconds", 2, 2, 0,
+	  ARG_INT|ARG_MAGIC|PPOLICY_WRITE_BEHIND, ppolicy_cf_wb,
+	  "( OLcfgOvAt:12.5 NAME 'olcPPolicyWriteBehind' "
+	  "DESC 'Seconds to defer pwdFailureTime updates, 0 to write them at once' "
+	  "EQUALITY integerMatch "
+	  "SYNTAX OMsInteger SINGLE-VALUE )", NULL, NULL },
+	{ "ppolicy_write_behind_max", "entries", 2, 2, 0,
+	  ARG_INT|ARG_MAGIC|PPOLICY_WRITE_BEHIND_MAX, ppolicy_cf_wb,
+	  "( OLcfgOvAt:12.6 NAME 'olcPPolicyWriteBehindMax' "
+	  "DESC 'Number of entries with deferred updates that forces a write' "
+	  "EQUALITY integerMatch "
+	  "SYNTAX OMsInteger SINGLE-VALUE )", NULL, NULL },
 	{ NULL, NULL, 0, 0, 0, ARG_IGNORED }
 };
 
@@ -256,7 +278,8 @@ static ConfigOCs ppolicyocs[] = {
 	  "DESC 'Password Policy configuration' "
 	  "SUP olcOverlayConfig "
 	  "MAY ( olcPPolicyDefault $ olcPPolicyHashCleartext $ "
-	  "olcPPolicyUseLockout $ olcPPolicyForwardUpdates ) )",
+	  "olcPPolicyUseLockout $ olcPPolicyForwardUpdates $ "
+	  "olcPPolicyWriteBehind $ olcPPolicyWriteBehindMax ) )",
 	  Cft_Overlay, ppolicycfg },
 	{ NULL, 0, NULL }
 };
@@ -312,6 +335,48 @@ ppolicy_cf_default( ConfigArgs *c )
 	return rc;
 }
 
+static void ppolicy_wb_start( slap_overinst *on );
+
+static int
+ppolicy_cf_wb( ConfigArgs *c )
+{
+	slap_overinst *on = (slap_overinst *)c->bi;
+	pp_info *pi = (pp_info *)on->on_bi.bi_private;
+	int *ptr = c->type == PPOLICY_WRITE_BEHIND ? &pi->wb_interval : &pi->wb_max;
+
+	switch ( c->op ) {
+	case SLAP_CONFIG_EMIT:
+		c->value_int = *ptr;
+		return 0;
+	case LDAP_MOD_DELETE:
+		*ptr = c->type == PPOLICY_WRITE_BEHIND ? 0 :
+			PPOLICY_DEFAULT_WRITE_BEHIND_MAX;
+		break;
+	case SLAP_CONFIG_ADD:
+	case LDAP_MOD_ADD:
+		if ( c->value_int < ( c->type == PPOLICY_WRITE_BEHIND ? 0 : 1 )) {
+			snprintf( c->cr_msg, sizeof( c->cr_msg ),
+				"<%s> invalid value \"%d\"", c->argv[0], c->value_int );
+			Debug( LDAP_DEBUG_ANY, "%s: %s\n", c->log, c->cr_msg );
+			return ARG_BAD_CONF;
+		}
+		*ptr = c->value_int;
+		break;
+	default:
+		abort ();
+	}
+
+	/* apply to a running database */
+	if ( pi->db_open ) {
+		if ( pi->wb ) {
+			slap_wb_free( pi->wb );
+			pi->wb = NULL;
+		}
+		ppolicy_wb_start( on );
+	}
+	return 0;
+}
+
 static time_t
 parse_time( char *atm )
 {
@@ -947,6 +1012,72 @@ ppolicy_ctrls_cleanup( Operation *op, SlapReply *rs )
 	return SLAP_CB_CONTINUE;
 }
 
+/* Write the policy state changes in mod to the target of op */
+static int
+ppolicy_update( Operation *op, slap_overinst *on, Modifications *mod )
+{
+	Operation op2 = *op;
+	SlapReply r2 = { REP_RESULT };
+	slap_callback cb = { NULL, slap_null_cb, NULL, NULL };
+	pp_info *pi = on->on_bi.bi_private;
+	BackendInfo *bi = op->o_bd->bd_info;
+	LDAPControl c, *ca[2];
+	int rc;
+
+	op2.o_tag = LDAP_REQ_MODIFY;
+	op2.o_callback = &cb;
+	op2.orm_modlist = mod;
+	op2.orm_no_opattrs = 0;
+	op2.o_dn = op->o_bd->be_rootdn;
+	op2.o_ndn = op->o_bd->be_rootndn;
+
+	/* If this server is a shadow and forward_updates is true,
+	 * use the frontend to perform this modify. That will trigger
+	 * the update referral, which can then be forwarded by the
+	 * chain overlay. Obviously the updateref and chain overlay
+	 * must be configured appropriately for this to be useful.
+	 */
+	if ( SLAP_SHADOW( op->o_bd ) && pi->forward_updates ) {
+		op2.o_bd = frontendDB;
+
+		/* Must use Relax control since these are no-user-mod */
+		op2.o_relax = SLAP_CONTROL_CRITICAL;
+		op2.o_ctrls = ca;
+		ca[0] = &c;
+		ca[1] = NULL;
+		BER_BVZERO( &c.ldctl_value );
+		c.ldctl_iscritical = 1;
+		c.ldctl_oid = LDAP_CONTROL_RELAX;
+	} else {
+		/* If not forwarding, don't update opattrs and don't replicate */
+		if ( SLAP_SINGLE_SHADOW( op->o_bd )) {
+			op2.orm_no_opattrs = 1;
+			op2.o_dont_replicate = 1;
+		}
+		op2.o_bd->bd_info = (BackendInfo *)on->on_info;
+	}
+	rc = op2.o_bd->be_modify( &op2, &r2 );
+	op->o_bd->bd_info = bi;
+	return rc;
+}
+
+/* slap_wb_write_f for deferred pwdFailureTime updates */
+static int
+ppolicy_wb_write( Operation *op, Modifications *ml, void *arg )
+{
+	return ppolicy_update( op, (slap_overinst *)arg, ml );
+}
+
+static void
+ppolicy_wb_start( slap_overinst *on )
+{
+	pp_info *pi = on->on_bi.bi_private;
+
+	if ( pi->wb_interval > 0 && ( slapMode & SLAP_SERVER_MODE ))
+		pi->wb = slap_wb_new( on->on_info->oi_origdb, pi->wb_interval,
+			pi->wb_max, ppolicy_wb_write, on );
+}
+
 static int
 ppolicy_bind_response( Operation *op, SlapReply *rs )
 {
@@ -963,7 +1094,9 @@ ppolicy_bind_response( Operation *op, SlapReply *rs )
 	char nowstr_usec[ LDAP_LUTIL_GENTIME_BUFSIZE+8 ];
 	struct berval timestamp, timestamp_usec;
 	BackendInfo *bi = op->o_bd->bd_info;
+	pp_info *pi = on->on_bi.bi_private;
 	Entry *e;
+	int e_dup = 0;
 
 	/* If we already know it's locked, just get on with it */
 	if ( ppb->pErr != PP_noError ) {
@@ -972,6 +1105,18 @@ ppolicy_bind_response( Operation *op, SlapReply *rs )
 
 	op->o_bd->bd_info = (BackendInfo *)on->on_info;
 	rc = be_entry_get_rw( op, &op->o_req_ndn, NULL, NULL, 0, &e );
+
+	/* Count the failures that have not been written yet */
+	if ( rc == LDAP_SUCCESS && pi->wb &&
+		slap_wb_pending( pi->wb, &op->o_req_ndn ))
+	{
+		Entry *e2 = entry_dup( e );
+
+		be_entry_release_r( op, e );
+		slap_wb_apply( pi->wb, e2 );
+		e = e2;
+		e_dup = 1;
+	}
 	op->o_bd->bd_info = bi;
 
 	if ( rc != LDAP_SUCCESS ) {
@@ -1234,55 +1379,33 @@ check_expiring_password:
 
 done:
 	op->o_bd->bd_info = (BackendInfo *)on->on_info;
-	be_entry_release_r( op, e );
+	if ( e_dup )
+		entry_free( e );
+	else
+		be_entry_release_r( op, e );
 
 locked:
 	if ( mod ) {
-		Operation op2 = *op;
-		SlapReply r2 = { REP_RESULT };
-		slap_callback cb = { NULL, slap_null_cb, NULL, NULL };
-		pp_info *pi = on->on_bi.bi_private;
-		LDAPControl c, *ca[2];
-
-		op2.o_tag = LDAP_REQ_MODIFY;
-		op2.o_callback = &cb;
-		op2.orm_modlist = mod;
-		op2.orm_no_opattrs = 0;
-		op2.o_dn = op->o_bd->be_rootdn;
-		op2.o_ndn = op->o_bd->be_rootndn;
-
-		/* If this server is a shadow and forward_updates is true,
-		 * use the frontend to perform this modify. That will trigger
-		 * the update referral, which can then be forwarded by the
-		 * chain overlay. Obviously the updateref and chain overlay
-		 * must be configured appropriately for this to be useful.
-		 */
-		if ( SLAP_SHADOW( op->o_bd ) && pi->forward_updates ) {
-			op2.o_bd = frontendDB;
-
-			/* Must use Relax control since these are no-user-mod */
-			op2.o_relax = SLAP_CONTROL_CRITICAL;
-			op2.o_ctrls = ca;
-			ca[0] = &c;
-			ca[1] = NULL;
-			BER_BVZERO( &c.ldctl_value );
-			c.ldctl_iscritical = 1;
-			c.ldctl_oid = LDAP_CONTROL_RELAX;
-		} else {
-			/* If not forwarding, don't update opattrs and don't replicate */
-			if ( SLAP_SINGLE_SHADOW( op->o_bd )) {
-				op2.orm_no_opattrs = 1;
-				op2.o_dont_replicate = 1;
+		if ( pi->wb ) {
+			/* Only failure times may wait, anything that changes
+			 * the lockout state is written at once, together with
+			 * whatever was already queued for this entry.
+			 */
+			for ( m = mod; m; m = m->sml_next ) {
+				if ( m->sml_desc != ad_pwdFailureTime )
+					break;
 			}
-			op2.o_bd->bd_info = (BackendInfo *)on->on_info;
+			slap_wb_queue( pi->wb, op, mod );
+			if ( m )
+				slap_wb_flush_dn( pi->wb, op );
+		} else {
+			ppolicy_update( op, on, mod );
+			slap_mods_free( mod, 1 );
 		}
-		rc = op2.o_bd->be_modify( &op2, &r2 );
-		slap_mods_free( mod, 1 );
 	}
 
 	if ( ppb->send_ctrl ) {
 		LDAPControl *ctrl = NULL;
-		pp_info *pi = on->on_bi.bi_private;
 
 		/* Do we really want to tell that the account is locked? */
 		if ( ppb->pErr == PP_accountLocked && !pi->use_lockout ) {
@@ -1416,6 +1539,53 @@ ppolicy_restrict(
 	return SLAP_CB_CONTINUE;
 }
 
+static int
+ppolicy_search_cleanup( Operation *op, SlapReply *rs )
+{
+	if ( rs->sr_type == REP_RESULT || rs->sr_err == SLAPD_ABANDON ) {
+		op->o_tmpfree( op->o_callback, op->o_tmpmemctx );
+		op->o_callback = NULL;
+	}
+	return SLAP_CB_CONTINUE;
+}
+
+/* Show deferred failure times in search results */
+static int
+ppolicy_search_response( Operation *op, SlapReply *rs )
+{
+	slap_overinst *on = op->o_callback->sc_private;
+	pp_info *pi = on->on_bi.bi_private;
+
+	if ( rs->sr_type == REP_SEARCH && pi->wb &&
+		slap_wb_pending( pi->wb, &rs->sr_entry->e_nname ))
+	{
+		rs_entry2modifiable( op, rs, on );
+		slap_wb_apply( pi->wb, rs->sr_entry );
+	}
+	return SLAP_CB_CONTINUE;
+}
+
+static int
+ppolicy_search( Operation *op, SlapReply *rs )
+{
+	slap_overinst *on = (slap_overinst *)op->o_bd->bd_info;
+	pp_info *pi = on->on_bi.bi_private;
+	int rc;
+
+	rc = ppolicy_restrict( op, rs );
+	if ( rc == SLAP_CB_CONTINUE && pi->wb ) {
+		slap_callback *sc;
+
+		sc = op->o_tmpcalloc( 1, sizeof( slap_callback ), op->o_tmpmemctx );
+		sc->sc_response = ppolicy_search_response;
+		sc->sc_cleanup = ppolicy_search_cleanup;
+		sc->sc_private = on;
+		sc->sc_next = op->o_callback->sc_next;
+		op->o_callback->sc_next = sc;
+	}
+	return rc;
+}
+
 static int
 ppolicy_compare_response(
 	Operation *op,
@@ -1648,6 +1818,10 @@ ppolicy_modify( Operation *op, SlapReply *rs )
 	int got_del_grace = 0, got_del_lock = 0, got_pw = 0, got_del_fail = 0;
 	int got_changed = 0, got_history = 0;
 
+	/* Deferred failure times must not land on top of this change */
+	if ( pi->wb )
+		slap_wb_flush_dn( pi->wb, op );
+
 	op->o_bd->bd_info = (BackendInfo *)on->on_info;
 	rc = be_entry_get_rw( op, &op->o_req_ndn, NULL, NULL, 0, &e );
 	op->o_bd->bd_info = (BackendInfo *)on;
@@ -2430,6 +2604,8 @@ ppolicy_db_init(
 	}
 
 	on->on_bi.bi_private = ch_calloc( sizeof(pp_info), 1 );
+	((pp_info *)on->on_bi.bi_private)->wb_max =
+		PPOLICY_DEFAULT_WRITE_BEHIND_MAX;
 
 	if ( !pwcons ) {
 		/* accommodate for c_conn_idx == -1 */
@@ -2448,6 +2624,12 @@ ppolicy_db_open(
 	ConfigReply *cr
 )
 {
+	slap_overinst *on = (slap_overinst *) be->bd_info;
+	pp_info *pi = on->on_bi.bi_private;
+
+	pi->db_open = 1;
+	ppolicy_wb_start( on );
+
 	return overlay_register_control( be, LDAP_CONTROL_PASSWORDPOLICYREQUEST );
 }
 
@@ -2457,6 +2639,16 @@ ppolicy_db_close(
 	ConfigReply *cr
 )
 {
+	slap_overinst *on = (slap_overinst *) be->bd_info;
+	pp_info *pi = on->on_bi.bi_private;
+
+	/* write out anything still deferred */
+	if ( pi->wb ) {
+		slap_wb_free( pi->wb );
+		pi->wb = NULL;
+	}
+	pi->db_open = 0;
+
 #ifdef SLAP_CONFIG_DELETE
 	overlay_unregister_control( be, LDAP_CONTROL_PASSWORDPOLICYREQUEST );
 #endif /* SLAP_CONFIG_DELETE */
@@ -2533,7 +2725,7 @@ int ppolicy_initialize()
 	ppolicy.on_bi.bi_op_compare = ppolicy_compare;
 	ppolicy.on_bi.bi_op_delete = ppolicy_restrict;
 	ppolicy.on_bi.bi_op_modify = ppolicy_modify;
-	ppolicy.on_bi.bi_op_search = ppolicy_restrict;
+	ppolicy.on_bi.bi_op_search = ppolicy_search;
 	ppolicy.on_bi.bi_connection_destroy = ppolicy_connection_destroy;
 
 	ppolicy.on_bi.bi_cf_ocs = ppolicyocs;
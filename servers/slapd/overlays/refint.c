@@ -28,6 +28,14 @@
  *
  * Updates are performed using the database rootdn in a separate task
  * to allow the original operation to complete immediately.
+ *
+ * The referencing entries are found with an equality search for the
+ * old DN, which the backend answers from the equality indices of the
+ * configured attributes, so those should be indexed.  Only when the
+ * entry had children is a dnSubtreeMatch search needed; that also
+ * catches references to subordinates which no longer exist, but it
+ * cannot use an index.  The entries found are then modified in
+ * batches, each in a single backend transaction where supported.
  */
 
 #ifdef SLAPD_OVER_REFINT
@@ -88,6 +96,7 @@ typedef struct refint_data_s {
 	refint_q *qhead;
 	refint_q *qtail;
 	BackendDB *db;
+	unsigned batch;			/* modifications per transaction */
 	ldap_pvt_thread_mutex_t qmutex;
 } refint_data;
 
@@ -98,12 +107,15 @@ typedef struct refint_pre_s {
 
 #define	RUNQ_INTERVAL	36000	/* a long time */
 
+#define	REFINT_BATCH_DEFAULT	64
+
 static MatchingRule	*mr_dnSubtreeMatch;
 
 enum {
 	REFINT_ATTRS = 1,
 	REFINT_NOTHING,
-	REFINT_MODIFIERSNAME
+	REFINT_MODIFIERSNAME,
+	REFINT_BATCH
 };
 
 static ConfigDriver refint_cf_gen;
@@ -127,6 +139,12 @@ static ConfigTable refintcfg[] = {
 	  "DESC 'The DN to use as modifiersName' "
 	  "EQUALITY distinguishedNameMatch "
 	  "SYNTAX OMsDN SINGLE-VALUE )", NULL, NULL },
+	{ "refint_batch", "count", 2, 2, 0,
+	  ARG_UINT|ARG_MAGIC|REFINT_BATCH, refint_cf_gen,
+	  "( OLcfgOvAt:11.4 NAME 'olcRefintBatch' "
+	  "DESC 'Largest number of entries updated in one transaction' "
+	  "EQUALITY integerMatch "
+	  "SYNTAX OMsInteger SINGLE-VALUE )", NULL, NULL },
 	{ NULL, NULL, 0, 0, 0, ARG_IGNORED }
 };
 
@@ -138,6 +156,7 @@ static ConfigOCs refintocs[] = {
 	  "MAY ( olcRefintAttribute "
 		"$ olcRefintNothing "
 		"$ olcRefintModifiersName "
+		"$ olcRefintBatch "
 	  ") )",
 	  Cft_Overlay, refintcfg },
 	{ NULL, 0, NULL }
@@ -188,6 +207,10 @@ refint_cf_gen(ConfigArgs *c)
 			}
 			rc = 0;
 			break;
+		case REFINT_BATCH:
+			c->value_uint = dd->batch;
+			rc = 0;
+			break;
 		default:
 			abort ();
 		}
@@ -232,6 +255,10 @@ refint_cf_gen(ConfigArgs *c)
 			BER_BVZERO( &dd->refint_ndn );
 			rc = 0;
 			break;
+		case REFINT_BATCH:
+			dd->batch = REFINT_BATCH_DEFAULT;
+			rc = 0;
+			break;
 		default:
 			abort ();
 		}
@@ -282,6 +309,10 @@ refint_cf_gen(ConfigArgs *c)
 				rc = ARG_BAD_CONF;
 			}
 			break;
+		case REFINT_BATCH:
+			dd->batch = c->value_uint;
+			rc = 0;
+			break;
 		default:
 			abort ();
 		}
@@ -309,6 +340,7 @@ refint_db_init(
 	refint_data *id = ch_calloc(1,sizeof(refint_data));
 
 	on->on_bi.bi_private = id;
+	id->batch = REFINT_BATCH_DEFAULT;
 	ldap_pvt_thread_mutex_init( &id->qmutex );
 	return(0);
 }
@@ -572,16 +604,168 @@ refint_search_cb(
 	return(0);
 }
 
+/*
+** make the changes to one referencing entry,
+** within txn if given
+*/
+
+static int
+refint_repair_one(
+	Operation	*op,
+	refint_data	*id,
+	refint_q	*rq,
+	dependent_data	*dp,
+	BackendDB	*db,
+	OpExtra		*txn )
+{
+	SlapReply		rs2 = {REP_RESULT};
+	Operation		op2 = *op;
+	refint_attrs	*ra;
+	Modifications	*m;
+	int		rc;
+
+	op2.o_bd = db;
+	op2.o_tag = LDAP_REQ_MODIFY;
+	op2.orm_modlist = NULL;
+	op2.o_req_dn	= dp->dn;
+	op2.o_req_ndn	= dp->ndn;
+	/* Internal ops, never replicate these */
+	op2.orm_no_opattrs = 1;
+	op2.o_dont_replicate = 1;
+	op2.o_opid = 0;
+
+	/* Set our ModifiersName */
+	if ( SLAP_LASTMOD( op->o_bd ) ) {
+		m = op2.o_tmpalloc( sizeof(Modifications) +
+			4*sizeof(BerValue), op2.o_tmpmemctx );
+		m->sml_next = op2.orm_modlist;
+		op2.orm_modlist = m;
+		m->sml_op = LDAP_MOD_REPLACE;
+		m->sml_flags = SLAP_MOD_INTERNAL;
+		m->sml_desc = slap_schema.si_ad_modifiersName;
+		m->sml_type = m->sml_desc->ad_cname;
+		m->sml_numvals = 1;
+		m->sml_values = (BerVarray)(m+1);
+		m->sml_nvalues = m->sml_values+2;
+		BER_BVZERO( &m->sml_values[1] );
+		BER_BVZERO( &m->sml_nvalues[1] );
+		m->sml_values[0] = id->refint_dn;
+		m->sml_nvalues[0] = id->refint_ndn;
+	}
+
+	for ( ra = dp->attrs; ra; ra = ra->next ) {
+		size_t	len;
+
+		/* Add values */
+		if ( ra->dont_empty || !BER_BVISEMPTY( &rq->newdn ) ) {
+			len = sizeof(Modifications);
+
+			if ( ra->new_vals == NULL ) {
+				len += 4*sizeof(BerValue);
+			}
+
+			m = op2.o_tmpalloc( len, op2.o_tmpmemctx );
+			m->sml_next = op2.orm_modlist;
+			op2.orm_modlist = m;
+			m->sml_op = LDAP_MOD_ADD;
+			m->sml_flags = 0;
+			m->sml_desc = ra->attr;
+			m->sml_type = ra->attr->ad_cname;
+			if ( ra->new_vals == NULL ) {
+				m->sml_values = (BerVarray)(m+1);
+				m->sml_nvalues = m->sml_values+2;
+				BER_BVZERO( &m->sml_values[1] );
+				BER_BVZERO( &m->sml_nvalues[1] );
+				m->sml_numvals = 1;
+				if ( BER_BVISEMPTY( &rq->newdn ) ) {
+					m->sml_values[0] = id->nothing;
+					m->sml_nvalues[0] = id->nnothing;
+				} else {
+					m->sml_values[0] = rq->newdn;
+					m->sml_nvalues[0] = rq->newndn;
+				}
+			} else {
+				m->sml_values = ra->new_vals;
+				m->sml_nvalues = ra->new_nvals;
+				m->sml_numvals = ra->ra_numvals;
+			}
+		}
+
+		/* Delete values */
+		len = sizeof(Modifications);
+		if ( ra->old_vals == NULL ) {
+			len += 4*sizeof(BerValue);
+		}
+		m = op2.o_tmpalloc( len, op2.o_tmpmemctx );
+		m->sml_next = op2.orm_modlist;
+		op2.orm_modlist = m;
+		m->sml_op = LDAP_MOD_DELETE;
+		m->sml_flags = 0;
+		m->sml_desc = ra->attr;
+		m->sml_type = ra->attr->ad_cname;
+		if ( ra->old_vals == NULL ) {
+			m->sml_numvals = 1;
+			m->sml_values = (BerVarray)(m+1);
+			m->sml_nvalues = m->sml_values+2;
+			m->sml_values[0] = rq->olddn;
+			m->sml_nvalues[0] = rq->oldndn;
+			BER_BVZERO( &m->sml_values[1] );
+			BER_BVZERO( &m->sml_nvalues[1] );
+		} else {
+			m->sml_values = ra->old_vals;
+			m->sml_nvalues = ra->old_nvals;
+			m->sml_numvals = ra->ra_numvals;
+		}
+	}
+
+	op2.o_dn = op2.o_bd->be_rootdn;
+	op2.o_ndn = op2.o_bd->be_rootndn;
+	if ( txn )
+		LDAP_SLIST_INSERT_HEAD( &op2.o_extra, txn, oe_next );
+	rc = op2.o_bd->be_modify( &op2, &rs2 );
+	if ( txn )
+		LDAP_SLIST_REMOVE( &op2.o_extra, txn, OpExtra, oe_next );
+	if ( rc != LDAP_SUCCESS ) {
+		Debug( LDAP_DEBUG_TRACE,
+			"refint_repair: dependent modify failed: %d\n",
+			rs2.sr_err );
+	}
+
+	while ( ( m = op2.orm_modlist ) ) {
+		op2.orm_modlist = m->sml_next;
+		op2.o_tmpfree( m, op2.o_tmpmemctx );
+	}
+
+	return rs2.sr_err;
+}
+
+typedef struct refint_batch {
+	refint_data	*rb_id;
+	refint_q	*rb_rq;
+	BackendDB	*rb_db;
+} refint_batch;
+
+static int
+refint_repair_item( Operation *op, void *item, OpExtra *txn, void *arg )
+{
+	refint_batch	*rb = arg;
+
+	return refint_repair_one( op, rb->rb_id, rb->rb_rq, item,
+		rb->rb_db, txn );
+}
+
 static int
 refint_repair(
 	Operation	*op,
 	refint_data	*id,
 	refint_q	*rq )
 {
-	dependent_data	*dp;
+	dependent_data	*dp, *end;
 	SlapReply		rs = {REP_RESULT};
-	Operation		op2;
-	unsigned long	opid;
+	BackendDB	*db = op->o_bd;
+	BackendInfo	*bi = db->bd_info;
+	refint_batch	rb;
+	void		**items;
 	int		rc;
 	int	cache;
 
@@ -616,137 +800,56 @@ refint_repair(
 
 	/*
 	 * [our search callback builds a list of attrs]
-	 * foreach attr:
-	 *	make sure its dn has a backend;
-	 *	build Modification* chain;
-	 *	call the backend modify function;
+	 * foreach batch of entries:
+	 *	foreach entry:
+	 *		make sure its dn has a backend;
+	 *		build Modification* chain;
+	 *		call the backend modify function,
+	 *		in one transaction for the entries of this backend
 	 *
 	 */
 
-	opid = op->o_opid;
-	op2 = *op;
-	for ( dp = rq->attrs; dp; dp = dp->next ) {
-		SlapReply	rs2 = {REP_RESULT};
-		refint_attrs	*ra;
-		Modifications	*m;
-
-		if ( dp->attrs == NULL ) continue; /* TODO: Is this needed? */
-
-		op2.o_bd = select_backend( &dp->ndn, 1 );
-		if ( !op2.o_bd ) {
-			Debug( LDAP_DEBUG_TRACE,
-				"refint_repair: no backend for DN %s!\n",
-				dp->dn.bv_val );
-			continue;
-		}
-		op2.o_tag = LDAP_REQ_MODIFY;
-		op2.orm_modlist = NULL;
-		op2.o_req_dn	= dp->dn;
-		op2.o_req_ndn	= dp->ndn;
-		/* Internal ops, never replicate these */
-		op2.orm_no_opattrs = 1;
-		op2.o_dont_replicate = 1;
-		op2.o_opid = 0;
-
-		/* Set our ModifiersName */
-		if ( SLAP_LASTMOD( op->o_bd ) ) {
-				m = op2.o_tmpalloc( sizeof(Modifications) +
-					4*sizeof(BerValue), op2.o_tmpmemctx );
-				m->sml_next = op2.orm_modlist;
-				op2.orm_modlist = m;
-				m->sml_op = LDAP_MOD_REPLACE;
-				m->sml_flags = SLAP_MOD_INTERNAL;
-				m->sml_desc = slap_schema.si_ad_modifiersName;
-				m->sml_type = m->sml_desc->ad_cname;
-				m->sml_numvals = 1;
-				m->sml_values = (BerVarray)(m+1);
-				m->sml_nvalues = m->sml_values+2;
-				BER_BVZERO( &m->sml_values[1] );
-				BER_BVZERO( &m->sml_nvalues[1] );
-				m->sml_values[0] = id->refint_dn;
-				m->sml_nvalues[0] = id->refint_ndn;
-		}
+	rb.rb_id = id;
+	rb.rb_rq = rq;
+	rb.rb_db = db;
+	items = op->o_tmpalloc( ( id->batch > 1 ? id->batch : 1 ) *
+		sizeof(void *), op->o_tmpmemctx );
 
-		for ( ra = dp->attrs; ra; ra = ra->next ) {
-			size_t	len;
+	for ( dp = rq->attrs; dp; dp = end ) {
+		dependent_data	*dq;
+		unsigned	n;
+		int		nitems = 0;
 
-			/* Add values */
-			if ( ra->dont_empty || !BER_BVISEMPTY( &rq->newdn ) ) {
-				len = sizeof(Modifications);
+		/* a batch size of 0 or 1 means every entry on its own */
+		for ( end = dp->next, n = 1; end && n < id->batch; end = end->next )
+			n++;
 
-				if ( ra->new_vals == NULL ) {
-					len += 4*sizeof(BerValue);
-				}
+		for ( dq = dp; dq != end; dq = dq->next ) {
+			BackendDB	*be;
 
-				m = op2.o_tmpalloc( len, op2.o_tmpmemctx );
-				m->sml_next = op2.orm_modlist;
-				op2.orm_modlist = m;
-				m->sml_op = LDAP_MOD_ADD;
-				m->sml_flags = 0;
-				m->sml_desc = ra->attr;
-				m->sml_type = ra->attr->ad_cname;
-				if ( ra->new_vals == NULL ) {
-					m->sml_values = (BerVarray)(m+1);
-					m->sml_nvalues = m->sml_values+2;
-					BER_BVZERO( &m->sml_values[1] );
-					BER_BVZERO( &m->sml_nvalues[1] );
-					m->sml_numvals = 1;
-					if ( BER_BVISEMPTY( &rq->newdn ) ) {
-						m->sml_values[0] = id->nothing;
-						m->sml_nvalues[0] = id->nnothing;
-					} else {
-						m->sml_values[0] = rq->newdn;
-						m->sml_nvalues[0] = rq->newndn;
-					}
-				} else {
-					m->sml_values = ra->new_vals;
-					m->sml_nvalues = ra->new_nvals;
-					m->sml_numvals = ra->ra_numvals;
-				}
-			}
+			if ( dq->attrs == NULL ) continue; /* TODO: Is this needed? */
 
-			/* Delete values */
-			len = sizeof(Modifications);
-			if ( ra->old_vals == NULL ) {
-				len += 4*sizeof(BerValue);
+			be = select_backend( &dq->ndn, 1 );
+			if ( !be ) {
+				Debug( LDAP_DEBUG_TRACE,
+					"refint_repair: no backend for DN %s!\n",
+					dq->dn.bv_val );
+				continue;
 			}
-			m = op2.o_tmpalloc( len, op2.o_tmpmemctx );
-			m->sml_next = op2.orm_modlist;
-			op2.orm_modlist = m;
-			m->sml_op = LDAP_MOD_DELETE;
-			m->sml_flags = 0;
-			m->sml_desc = ra->attr;
-			m->sml_type = ra->attr->ad_cname;
-			if ( ra->old_vals == NULL ) {
-				m->sml_numvals = 1;
-				m->sml_values = (BerVarray)(m+1);
-				m->sml_nvalues = m->sml_values+2;
-				m->sml_values[0] = rq->olddn;
-				m->sml_nvalues[0] = rq->oldndn;
-				BER_BVZERO( &m->sml_values[1] );
-				BER_BVZERO( &m->sml_nvalues[1] );
-			} else {
-				m->sml_values = ra->old_vals;
-				m->sml_nvalues = ra->old_nvals;
-				m->sml_numvals = ra->ra_numvals;
+			/* made together below */
+			if ( be == db ) {
+				items[nitems++] = dq;
+				continue;
 			}
-		}
 
-		op2.o_dn = op2.o_bd->be_rootdn;
-		op2.o_ndn = op2.o_bd->be_rootndn;
-		rc = op2.o_bd->be_modify( &op2, &rs2 );
-		if ( rc != LDAP_SUCCESS ) {
-			Debug( LDAP_DEBUG_TRACE,
-				"refint_repair: dependent modify failed: %d\n",
-				rs2.sr_err );
+			(void)refint_repair_one( op, id, rq, dq, be, NULL );
 		}
 
-		while ( ( m = op2.orm_modlist ) ) {
-			op2.orm_modlist = m->sml_next;
-			op2.o_tmpfree( m, op2.o_tmpmemctx );
-		}
+		(void)slap_txn_batch( op, nitems > 1 ? bi : NULL, items, nitems,
+			refint_repair_item, &rb, "refint" );
 	}
-	op2.o_opid = opid;
+
+	op->o_tmpfree( items, op->o_tmpmemctx );
 
 	return 0;
 }
@@ -105,6 +105,12 @@ typedef struct sync_control {
 /* o_sync_mode uses data bits of o_sync */
 #define	o_sync_mode	o_ctrlflag[slap_cids.sc_LDAPsync]
 
+/* A received sync digest control; without a value it only asks
+ * to skip the present phase of a refresh.
+ */
+static int sp_digest_cid;
+#define	o_sync_digest	o_ctrlflag[sp_digest_cid]
+
 #define SLAP_SYNC_NONE					(LDAP_SYNC_NONE<<SLAP_CONTROL_SHIFT)
 #define SLAP_SYNC_REFRESH				(LDAP_SYNC_REFRESH_ONLY<<SLAP_CONTROL_SHIFT)
 #define SLAP_SYNC_PERSIST				(LDAP_SYNC_RESERVED<<SLAP_CONTROL_SHIFT)
@@ -2261,6 +2267,87 @@ syncprov_op_extended( Operation *op, SlapReply *rs )
 	return SLAP_CB_CONTINUE;
 }
 
+static int
+syncprov_digest_cb( Operation *op, SlapReply *rs )
+{
+	sync_digest *sd = op->o_callback->sc_private;
+
+	switch ( rs->sr_type ) {
+	case REP_SEARCH:
+		if ( access_allowed( op, rs->sr_entry, slap_schema.si_ad_entryUUID,
+			NULL, ACL_READ, NULL ))
+			slap_sync_digest_add( sd, rs->sr_entry );
+		return LDAP_SUCCESS;
+	case REP_RESULT:
+		return rs->sr_err;
+	default:
+		return LDAP_SUCCESS;
+	}
+}
+
+/* Answer a sync digest request: digests of the entryUUID ranges under
+ * the requested prefixes, or the entryUUIDs themselves, for the entries
+ * the same search would refresh.
+ */
+static int
+syncprov_digest( Operation *op, SlapReply *rs )
+{
+	slap_overinst		*on = (slap_overinst *)op->o_bd->bd_info;
+	sync_digest	*sd = op->o_controls[sp_digest_cid];
+	slap_callback cb = {0};
+	Operation fop;
+	SlapReply frs = { REP_RESULT };
+	LDAPControl *cp, *ctrls[2];
+	struct berval bv;
+
+	slap_sync_digest_init( sd, op->o_tmpmemctx );
+
+	fop = *op;
+	fop.o_sync_digest = SLAP_CONTROL_NONE;
+	/* We want pure entries, not referrals */
+	fop.o_managedsait = SLAP_CONTROL_CRITICAL;
+	fop.o_callback = &cb;
+	fop.ors_attrsonly = 0;
+	fop.ors_attrs = csn_anlist;
+	fop.ors_slimit = SLAP_NO_LIMIT;
+	cb.sc_response = syncprov_digest_cb;
+	cb.sc_private = sd;
+
+	fop.o_bd->bd_info = (BackendInfo *)on->on_info;
+	fop.o_bd->be_search( &fop, &frs );
+	fop.o_bd->bd_info = (BackendInfo *)on;
+
+	if ( frs.sr_err != LDAP_SUCCESS ) {
+		slap_sync_digest_free( sd );
+		send_ldap_error( op, rs, frs.sr_err, frs.sr_text );
+		return rs->sr_err;
+	}
+
+	if ( slap_sync_digest_response( sd, &bv, op->o_tmpmemctx )) {
+		slap_sync_digest_free( sd );
+		send_ldap_error( op, rs, LDAP_OTHER, "internal error" );
+		return rs->sr_err;
+	}
+	slap_sync_digest_free( sd );
+
+	cp = op->o_tmpalloc( sizeof( LDAPControl ) + bv.bv_len, op->o_tmpmemctx );
+	cp->ldctl_oid = LDAP_CONTROL_X_SYNC_DIGEST;
+	cp->ldctl_iscritical = 0;
+	cp->ldctl_value.bv_val = (char *)&cp[1];
+	cp->ldctl_value.bv_len = bv.bv_len;
+	AC_MEMCPY( cp->ldctl_value.bv_val, bv.bv_val, bv.bv_len );
+	op->o_tmpfree( bv.bv_val, op->o_tmpmemctx );
+	ctrls[0] = cp;
+	ctrls[1] = NULL;
+
+	rs->sr_ctrls = ctrls;
+	rs->sr_err = LDAP_SUCCESS;
+	send_ldap_result( op, rs );
+	rs->sr_ctrls = NULL;
+	op->o_tmpfree( cp, op->o_tmpmemctx );
+	return rs->sr_err;
+}
+
 typedef struct searchstate {
 	slap_overinst *ss_on;
 	syncops *ss_so;
@@ -2528,6 +2615,10 @@ syncprov_op_search( Operation *op, SlapReply *rs )
 	int minsid, maxsid;
 	int dirty = 0;
 
+	if ( op->o_sync_digest && op->o_controls[sp_digest_cid] &&
+		!(op->o_sync_mode & SLAP_SYNC_REFRESH) )
+		return syncprov_digest( op, rs );
+
 	if ( !(op->o_sync_mode & SLAP_SYNC_REFRESH) ) return SLAP_CB_CONTINUE;
 
 	if ( op->ors_deref & LDAP_DEREF_SEARCHING ) {
@@ -2631,7 +2722,10 @@ syncprov_op_search( Operation *op, SlapReply *rs )
 			goto bailout;
 		}
 
-		if ( !si->si_nopres )
+		/* A consumer sending the sync digest control finds deleted
+		 * entries by comparing digests after the refresh instead.
+		 */
+		if ( !si->si_nopres && !op->o_sync_digest )
 			do_present = SS_PRESENT;
 
 		/* If there are SIDs we don't recognize in the cookie, drop them */
@@ -3164,6 +3258,10 @@ syncprov_db_open(
 	if ( rc ) {
 		return rc;
 	}
+	rc = overlay_register_control( be, LDAP_CONTROL_X_SYNC_DIGEST );
+	if ( rc ) {
+		return rc;
+	}
 
 	thrctx = ldap_pvt_thread_pool_context();
 	connection_fake_init2( &conn, &opbuf, thrctx, 0 );
@@ -3482,6 +3580,36 @@ static int syncprov_parseCtrl (
 	return LDAP_SUCCESS;
 }
 
+static int syncprov_parseDigestCtrl (
+	Operation *op,
+	SlapReply *rs,
+	LDAPControl *ctrl )
+{
+	sync_digest *sd = NULL;
+
+	if ( op->o_sync_digest != SLAP_CONTROL_NONE ) {
+		rs->sr_text = "Sync digest control specified multiple times";
+		return LDAP_PROTOCOL_ERROR;
+	}
+
+	if ( !BER_BVISNULL( &ctrl->ldctl_value ) ) {
+		sd = op->o_tmpalloc( sizeof( sync_digest ), op->o_tmpmemctx );
+		if ( slap_sync_digest_parse_request( &ctrl->ldctl_value, sd,
+			op->o_tmpmemctx ) != LDAP_SUCCESS ) {
+			op->o_tmpfree( sd, op->o_tmpmemctx );
+			rs->sr_text = "Sync digest control : decoding error";
+			return LDAP_PROTOCOL_ERROR;
+		}
+	}
+
+	op->o_controls[sp_digest_cid] = sd;
+	op->o_sync_digest = ctrl->ldctl_iscritical
+		? SLAP_CONTROL_CRITICAL
+		: SLAP_CONTROL_NONCRITICAL;
+
+	return LDAP_SUCCESS;
+}
+
 /* This overlay is set up for dynamic loading via moduleload. For static
  * configuration, you'll need to arrange for the slap_overinst to be
  * initialized and registered by some other function inside slapd.
@@ -3503,6 +3631,15 @@ syncprov_initialize()
 		return rc;
 	}
 
+	rc = register_supported_control( LDAP_CONTROL_X_SYNC_DIGEST,
+		SLAP_CTRL_SEARCH, NULL,
+		syncprov_parseDigestCtrl, &sp_digest_cid );
+	if ( rc != LDAP_SUCCESS ) {
+		Debug( LDAP_DEBUG_ANY,
+			"syncprov_init: Failed to register control %d\n", rc );
+		return rc;
+	}
+
 	syncprov.on_bi.bi_type = "syncprov";
 	syncprov.on_bi.bi_db_init = syncprov_db_init;
 	syncprov.on_bi.bi_db_destroy = syncprov_db_destroy;
@@ -827,6 +827,7 @@ unique_db_destroy(
 /*
 ** search callback
 **	if this is a REP_SEARCH, count++;
+**	one such entry decides it, so stop the search there
 **
 */
 
@@ -853,7 +854,8 @@ static int count_attr_cb(
 
 	uc->count++;
 
-	return(0);
+	/* makes the backend end the search right away */
+	return(LDAP_SIZELIMIT_EXCEEDED);
 }
 
 /* count the length of one attribute ad
@@ -1001,7 +1003,8 @@ unique_search(
 	rc = nop->o_bd->be_search(nop, &nrs);
 	filter_free_x(nop, nop->ors_filter, 1);
 
-	if(rc != LDAP_SUCCESS && rc != LDAP_NO_SUCH_OBJECT) {
+	if(rc != LDAP_SUCCESS && rc != LDAP_NO_SUCH_OBJECT &&
+		!(rc == LDAP_SIZELIMIT_EXCEEDED && uq.count)) {
 		op->o_bd->bd_info = (BackendInfo *) on->on_info;
 		send_ldap_error(op, rs, rc, "unique_search failed");
 		rc = rs->sr_err;
@@ -488,8 +488,164 @@ struct berval * slap_passwd_return(
 	return bv;
 }
 
+/*
+ * Password verification pool.
+ *
+ * Hashes such as PBKDF2 or Argon2 can take milliseconds to verify.  When
+ * password-verify-threads is set, simple Bind credentials are checked by
+ * that many dedicated threads instead of the operation's worker thread,
+ * so slow logins consume at most that many CPUs.  The worker still waits
+ * for the result, but at most password-verify-queue Binds wait at once;
+ * beyond that the Bind is refused with LDAP_BUSY instead of tying up
+ * another worker.
+ */
+typedef struct pwverify_job {
+	LDAP_STAILQ_ENTRY(pwverify_job) pj_next;
+	struct berval **pj_vals;
+	struct berval *pj_cred;
+	const char **pj_text;
+	struct timeval pj_queued;
+	ldap_pvt_thread_cond_t pj_cond;
+	int pj_result;
+	int pj_done;
+} pwverify_job;
+
+int slap_pwverify_threads;
+int slap_pwverify_queue = SLAP_PWVERIFY_QUEUE;
+
+static struct {
+	ldap_pvt_thread_mutex_t pv_mutex;
+	ldap_pvt_thread_cond_t pv_cond;	/* work queued, or thread exit */
+	LDAP_STAILQ_HEAD(pv_q, pwverify_job) pv_jobs;
+	int pv_nthreads;
+	int pv_shutdown;
+	slap_pwverify_stats pv_stats;
+} pwverify;
+
+static void *
+pwverify_thread( void *ctx )
+{
+	pwverify_job *pj;
+	struct timeval now;
+	unsigned long usec;
+	struct berval **bv;
+
+	ldap_pvt_thread_mutex_lock( &pwverify.pv_mutex );
+	for (;;) {
+		int surplus = pwverify.pv_shutdown ||
+			pwverify.pv_nthreads > slap_pwverify_threads;
+
+		if ( LDAP_STAILQ_EMPTY( &pwverify.pv_jobs )) {
+			if ( surplus )
+				break;
+			ldap_pvt_thread_cond_wait( &pwverify.pv_cond, &pwverify.pv_mutex );
+			continue;
+		}
+		/* the last thread drains the queue before leaving */
+		if ( surplus && pwverify.pv_nthreads > 1 )
+			break;
+
+		pj = LDAP_STAILQ_FIRST( &pwverify.pv_jobs );
+		LDAP_STAILQ_REMOVE_HEAD( &pwverify.pv_jobs, pj_next );
+		pwverify.pv_stats.ps_pending--;
+		pwverify.pv_stats.ps_active++;
+		ldap_pvt_thread_mutex_unlock( &pwverify.pv_mutex );
+
+		pj->pj_result = 1;
+		for ( bv = pj->pj_vals; *bv; bv++ ) {
+			if ( !lutil_passwd( *bv, pj->pj_cred, NULL, pj->pj_text )) {
+				pj->pj_result = 0;
+				break;
+			}
+		}
+
+		gettimeofday( &now, NULL );
+		usec = ( now.tv_sec - pj->pj_queued.tv_sec ) * 1000000UL +
+			now.tv_usec - pj->pj_queued.tv_usec;
+
+		ldap_pvt_thread_mutex_lock( &pwverify.pv_mutex );
+		pwverify.pv_stats.ps_active--;
+		pwverify.pv_stats.ps_verified++;
+		pwverify.pv_stats.ps_usec += usec;
+		if ( usec > pwverify.pv_stats.ps_usec_max )
+			pwverify.pv_stats.ps_usec_max = usec;
+		pj->pj_done = 1;
+		ldap_pvt_thread_cond_signal( &pj->pj_cond );
+	}
+	pwverify.pv_nthreads--;
+	pwverify.pv_stats.ps_threads = pwverify.pv_nthreads;
+	ldap_pvt_thread_cond_broadcast( &pwverify.pv_cond );
+	ldap_pvt_thread_mutex_unlock( &pwverify.pv_mutex );
+	return NULL;
+}
+
+/* Run the job on the verification threads and wait for the result.
+ * Returns LDAP_BUSY if the queue is full.
+ */
+static int
+pwverify_submit( pwverify_job *pj )
+{
+	ldap_pvt_thread_t tid;
+
+	ldap_pvt_thread_mutex_lock( &pwverify.pv_mutex );
+	if ( pwverify.pv_stats.ps_pending >= slap_pwverify_queue ) {
+		pwverify.pv_stats.ps_busy++;
+		ldap_pvt_thread_mutex_unlock( &pwverify.pv_mutex );
+		return LDAP_BUSY;
+	}
+
+	/* threads are started on demand; slapd may have forked since
+	 * the configuration was read */
+	if ( pwverify.pv_nthreads < slap_pwverify_threads && !pwverify.pv_shutdown ) {
+		if ( ldap_pvt_thread_create( &tid, 1, pwverify_thread, NULL ) == 0 ) {
+			pwverify.pv_nthreads++;
+			pwverify.pv_stats.ps_threads = pwverify.pv_nthreads;
+		}
+	}
+	if ( pwverify.pv_nthreads == 0 ) {
+		ldap_pvt_thread_mutex_unlock( &pwverify.pv_mutex );
+		return LDAP_OTHER;
+	}
+
+	ldap_pvt_thread_cond_init( &pj->pj_cond );
+	pj->pj_done = 0;
+	gettimeofday( &pj->pj_queued, NULL );
+	LDAP_STAILQ_INSERT_TAIL( &pwverify.pv_jobs, pj, pj_next );
+	pwverify.pv_stats.ps_pending++;
+	ldap_pvt_thread_cond_signal( &pwverify.pv_cond );
+
+	while ( !pj->pj_done )
+		ldap_pvt_thread_cond_wait( &pj->pj_cond, &pwverify.pv_mutex );
+	ldap_pvt_thread_mutex_unlock( &pwverify.pv_mutex );
+	ldap_pvt_thread_cond_destroy( &pj->pj_cond );
+
+	return LDAP_SUCCESS;
+}
+
+void
+slap_pwverify_set( int threads, int queue )
+{
+	ldap_pvt_thread_mutex_lock( &pwverify.pv_mutex );
+	slap_pwverify_threads = threads;
+	slap_pwverify_queue = queue;
+	/* let surplus threads exit */
+	ldap_pvt_thread_cond_broadcast( &pwverify.pv_cond );
+	ldap_pvt_thread_mutex_unlock( &pwverify.pv_mutex );
+}
+
+void
+slap_pwverify_query( slap_pwverify_stats *ps )
+{
+	ldap_pvt_thread_mutex_lock( &pwverify.pv_mutex );
+	*ps = pwverify.pv_stats;
+	ldap_pvt_thread_mutex_unlock( &pwverify.pv_mutex );
+}
+
 /*
  * if "e" is provided, access to each value of the password is checked first
+ *
+ * Returns 0 if cred matches, LDAP_BUSY if the verification queue was full,
+ * or another nonzero value otherwise.
  */
 int
 slap_passwd_check(
@@ -513,6 +669,57 @@ slap_passwd_check(
 
 	if ( credNul ) cred->bv_val[cred->bv_len] = 0;
 
+	if ( slap_pwverify_threads && op->o_tag == LDAP_REQ_BIND ) {
+		pwverify_job pj;
+		int i = 0;
+
+		pj.pj_vals = op->o_tmpalloc( ( a->a_numvals + 1 ) *
+			sizeof( struct berval * ), op->o_tmpmemctx );
+		for ( bv = a->a_vals; bv->bv_val != NULL; bv++ ) {
+			if ( e && access_allowed( op, e, a->a_desc, bv,
+						ACL_AUTH, &acl_state ) == 0 )
+			{
+				continue;
+			}
+#ifdef SLAPD_SPASSWD
+			/* {SASL} needs this thread's SASL context */
+			if ( !strncasecmp( bv->bv_val, "{SASL}", STRLENOF( "{SASL}" ))) {
+				if ( !lutil_passwd( bv, cred, NULL, text ) ) {
+					result = 0;
+					break;
+				}
+				continue;
+			}
+#endif
+			pj.pj_vals[i++] = bv;
+		}
+		pj.pj_vals[i] = NULL;
+
+		if ( result && i ) {
+			pj.pj_cred = cred;
+			pj.pj_text = text;
+			switch ( pwverify_submit( &pj )) {
+			case LDAP_SUCCESS:
+				result = pj.pj_result;
+				break;
+			case LDAP_BUSY:
+				result = LDAP_BUSY;
+				*text = "too many password verifications pending";
+				break;
+			default:
+				/* no thread could be started */
+				for ( i = 0; pj.pj_vals[i]; i++ ) {
+					if ( !lutil_passwd( pj.pj_vals[i], cred, NULL, text ) ) {
+						result = 0;
+						break;
+					}
+				}
+			}
+		}
+		op->o_tmpfree( pj.pj_vals, op->o_tmpmemctx );
+		goto done;
+	}
+
 	for ( bv = a->a_vals; bv->bv_val != NULL; bv++ ) {
 		/* if e is provided, check access */
 		if ( e && access_allowed( op, e, a->a_desc, bv,
@@ -527,6 +734,7 @@ slap_passwd_check(
 		}
 	}
 
+done:
 	if ( credNul ) cred->bv_val[cred->bv_len] = credNul;
 
 #ifdef SLAPD_SPASSWD
@@ -643,5 +851,18 @@ void slap_passwd_init()
 	ldap_pvt_thread_mutex_init( &passwd_mutex );
 	lutil_cryptptr = slapd_crypt;
 #endif
+	ldap_pvt_thread_mutex_init( &pwverify.pv_mutex );
+	ldap_pvt_thread_cond_init( &pwverify.pv_cond );
+	LDAP_STAILQ_INIT( &pwverify.pv_jobs );
+}
+
+void slap_passwd_destroy()
+{
+	ldap_pvt_thread_mutex_lock( &pwverify.pv_mutex );
+	pwverify.pv_shutdown = 1;
+	ldap_pvt_thread_cond_broadcast( &pwverify.pv_cond );
+	while ( pwverify.pv_nthreads )
+		ldap_pvt_thread_cond_wait( &pwverify.pv_cond, &pwverify.pv_mutex );
+	ldap_pvt_thread_mutex_unlock( &pwverify.pv_mutex );
 }
 
@@ -99,6 +99,7 @@ LDAP_SLAPD_F (int) acl_string_expand LDAP_P((
  * aclparse.c
  */
 LDAP_SLAPD_V (LDAP_CONST char *) style_strings[];
+LDAP_SLAPD_V (unsigned long) slap_acl_gen;
 
 LDAP_SLAPD_F (int) parse_acl LDAP_P(( Backend *be,
 	const char *fname, int lineno,
@@ -924,6 +925,25 @@ LDAP_SLAPD_V (SOCKET *) slapd_ws_sockets;
 #define	SLAP_SOCKNEW(s)	s
 #endif
 
+/*
+ * dncache.c
+ */
+LDAP_SLAPD_V (unsigned int) slap_dn_cache_max;
+
+LDAP_SLAPD_F (void) dn_cache_init LDAP_P(( void ));
+LDAP_SLAPD_F (void) dn_cache_destroy LDAP_P(( void ));
+LDAP_SLAPD_F (void) dn_cache_flush LDAP_P(( void ));
+LDAP_SLAPD_F (void) dn_cache_resize LDAP_P(( unsigned int max ));
+LDAP_SLAPD_F (int) dn_cache_get LDAP_P((
+	struct berval *val,
+	struct berval *pretty,
+	struct berval *normal,
+	void *ctx ));
+LDAP_SLAPD_F (void) dn_cache_put LDAP_P((
+	struct berval *val,
+	struct berval *pretty,
+	struct berval *normal ));
+
 /*
  * dn.c
  */
@@ -1105,6 +1125,9 @@ LDAP_SLAPD_F ( SLAP_CTRL_PARSE_FN ) txn_spec_ctrl;
 LDAP_SLAPD_F ( SLAP_EXTOP_MAIN_FN ) txn_start_extop;
 LDAP_SLAPD_F ( SLAP_EXTOP_MAIN_FN ) txn_end_extop;
 LDAP_SLAPD_F ( int ) txn_preop LDAP_P(( Operation *op, SlapReply *rs ));
+LDAP_SLAPD_F ( int ) slap_txn_batch LDAP_P(( Operation *op,
+	BackendInfo *bi, void **items, int nitems,
+	SLAP_TXN_APPLY_FN *apply, void *arg, const char *who ));
 #endif
 
 /*
@@ -1150,6 +1173,12 @@ LDAP_SLAPD_F (void) filter_destroy LDAP_P(( void ));
  */
 
 LDAP_SLAPD_F (int) test_filter LDAP_P(( Operation *op, Entry *e, Filter *f ));
+LDAP_SLAPD_F (FilterProgram *) filter_compile LDAP_P((
+	Operation *op, Filter *f ));
+LDAP_SLAPD_F (int) test_filter_program LDAP_P((
+	Operation *op, Entry *e, Filter *f, FilterProgram *fp ));
+LDAP_SLAPD_F (void) filter_program_free LDAP_P((
+	Operation *op, FilterProgram *fp ));
 
 /*
  * frontend.c
@@ -1168,6 +1197,38 @@ LDAP_SLAPD_V( struct slap_sync_cookie_s ) slap_sync_cookie;
 LDAP_SLAPD_V( void * ) slap_tls_ctx;
 LDAP_SLAPD_V( LDAP * ) slap_tls_ld;
 
+/*
+ * groupcache.c
+ */
+LDAP_SLAPD_V (unsigned int) slap_group_cache_max;
+
+LDAP_SLAPD_F (void) group_cache_init LDAP_P(( void ));
+LDAP_SLAPD_F (void) group_cache_destroy LDAP_P(( void ));
+LDAP_SLAPD_F (void) group_cache_flush LDAP_P(( void ));
+LDAP_SLAPD_F (void) group_cache_resize LDAP_P(( unsigned int max ));
+LDAP_SLAPD_F (unsigned long) group_cache_gen LDAP_P(( void ));
+LDAP_SLAPD_F (int) group_cache_get LDAP_P((
+	Backend *be,
+	struct berval *gr_ndn,
+	struct berval *op_ndn,
+	ObjectClass *group_oc,
+	AttributeDescription *group_at ));
+LDAP_SLAPD_F (void) group_cache_put LDAP_P((
+	Backend *be,
+	struct berval *gr_ndn,
+	struct berval *op_ndn,
+	ObjectClass *group_oc,
+	AttributeDescription *group_at,
+	int res,
+	unsigned long gen ));
+LDAP_SLAPD_F (void) group_cache_invalidate LDAP_P((
+	struct berval *ndn,
+	int subtree ));
+LDAP_SLAPD_F (void) group_cache_stats LDAP_P((
+	unsigned long *count,
+	unsigned long *hits,
+	unsigned long *misses ));
+
 /*
  * index.c
  */
@@ -1196,6 +1257,20 @@ LDAP_SLAPD_F (void) slap_sync_cookie_free LDAP_P((
 				struct sync_cookie *, int free_cookie ));
 LDAP_SLAPD_F (int) slap_parse_csn_sid LDAP_P((
 				struct berval * ));
+LDAP_SLAPD_F (void) slap_sync_digest_init LDAP_P((
+				sync_digest *sd, void *memctx ));
+LDAP_SLAPD_F (void) slap_sync_digest_free LDAP_P((
+				sync_digest *sd ));
+LDAP_SLAPD_F (int) slap_sync_digest_add LDAP_P((
+				sync_digest *sd, Entry *e ));
+LDAP_SLAPD_F (int) slap_sync_digest_request LDAP_P((
+				sync_digest *sd, struct berval *val ));
+LDAP_SLAPD_F (int) slap_sync_digest_parse_request LDAP_P((
+				struct berval *val, sync_digest *sd, void *memctx ));
+LDAP_SLAPD_F (int) slap_sync_digest_response LDAP_P((
+				sync_digest *sd, struct berval *val, void *memctx ));
+LDAP_SLAPD_F (int) slap_sync_digest_parse_response LDAP_P((
+				struct berval *val, sync_digest *sd ));
 LDAP_SLAPD_F (int *) slap_parse_csn_sids LDAP_P((
 				BerVarray, int, void *memctx ));
 LDAP_SLAPD_F (int) slap_sort_csn_sids LDAP_P((
@@ -1550,6 +1625,12 @@ LDAP_SLAPD_F (int) slap_passwd_parse(
 	const char		**text );
 
 LDAP_SLAPD_F (void) slap_passwd_init (void);
+LDAP_SLAPD_F (void) slap_passwd_destroy (void);
+
+LDAP_SLAPD_V (int) slap_pwverify_threads;
+LDAP_SLAPD_V (int) slap_pwverify_queue;
+LDAP_SLAPD_F (void) slap_pwverify_set( int threads, int queue );
+LDAP_SLAPD_F (void) slap_pwverify_query( slap_pwverify_stats *ps );
 
 /*
  * phonetic.c
@@ -2018,6 +2099,24 @@ LDAP_SLAPD_F (int) value_add_one LDAP_P((
 /* assumes (x) > (y) returns 1 if true, 0 otherwise */
 #define SLAP_PTRCMP(x, y) ((x) < (y) ? -1 : (x) > (y))
 
+/*
+ * writebehind.c
+ */
+LDAP_SLAPD_F (slap_wb *) slap_wb_new LDAP_P((
+	BackendDB *be,
+	time_t interval,
+	int max,
+	slap_wb_write_f *wr,
+	void *arg ));
+LDAP_SLAPD_F (void) slap_wb_free LDAP_P(( slap_wb *wb ));
+LDAP_SLAPD_F (void) slap_wb_queue LDAP_P((
+	slap_wb *wb,
+	Operation *op,
+	Modifications *ml ));
+LDAP_SLAPD_F (int) slap_wb_flush_dn LDAP_P(( slap_wb *wb, Operation *op ));
+LDAP_SLAPD_F (int) slap_wb_pending LDAP_P(( slap_wb *wb, struct berval *ndn ));
+LDAP_SLAPD_F (int) slap_wb_apply LDAP_P(( slap_wb *wb, Entry *e ));
+
 #ifdef SLAP_ZONE_ALLOC
 /*
  * zn_malloc.c
@@ -2097,6 +2196,7 @@ LDAP_SLAPD_V (ldap_pvt_thread_pool_t)	connection_pool;
 LDAP_SLAPD_V (int)			connection_pool_max;
 LDAP_SLAPD_V (int)			connection_pool_queues;
 LDAP_SLAPD_V (int)			slap_tool_thread_max;
+LDAP_SLAPD_V (ID)			slap_tool_checkpoint;
 
 LDAP_SLAPD_V (ldap_pvt_thread_mutex_t)	entry2str_mutex;
 
@@ -2228,6 +2328,24 @@ LDAP_SLAPD_F (int) fe_access_allowed LDAP_P((
 
 #define UI2BV(bv,ui)	UI2BVX(bv,ui,NULL)
 
+#ifdef HAVE_LONG_LONG
+# define SLAP_COUNTER_FORMAT	"%llu"
+#else
+# define SLAP_COUNTER_FORMAT	"%lu"
+#endif
+
+#define SLAP_COUNTER2BV(bv,n) \
+	do { \
+		char		buf[LDAP_PVT_INTTYPE_CHARS(slap_counter_t)]; \
+		ber_len_t	len; \
+		len = snprintf( buf, sizeof( buf ), SLAP_COUNTER_FORMAT, (n) ); \
+		if ( len > (bv)->bv_len ) { \
+			(bv)->bv_val = ber_memrealloc( (bv)->bv_val, len + 1 ); \
+		} \
+		(bv)->bv_len = len; \
+		AC_MEMCPY( (bv)->bv_val, buf, len + 1 ); \
+	} while ( 0 )
+
 LDAP_END_DECL
 
 #endif /* PROTO_SLAP_H */
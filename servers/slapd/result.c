@@ -763,10 +763,8 @@ send_ldap_response(
 		goto cleanup;
 	}
 
-	ldap_pvt_thread_mutex_lock( &op->o_counters->sc_mutex );
-	ldap_pvt_mp_add_ulong( op->o_counters->sc_pdu, 1 );
-	ldap_pvt_mp_add_ulong( op->o_counters->sc_bytes, (unsigned long)bytes );
-	ldap_pvt_thread_mutex_unlock( &op->o_counters->sc_mutex );
+	SLAP_COUNTER_ADD( op->o_counters, sc_pdu, 1 );
+	SLAP_COUNTER_ADD( op->o_counters, sc_bytes, bytes );
 
 cleanup:;
 	/* Tell caller that we did this for real, as opposed to being
@@ -1488,11 +1486,9 @@ slap_send_search_entry( Operation *op, SlapReply *rs )
 		}
 		rs->sr_nentries++;
 
-		ldap_pvt_thread_mutex_lock( &op->o_counters->sc_mutex );
-		ldap_pvt_mp_add_ulong( op->o_counters->sc_bytes, (unsigned long)bytes );
-		ldap_pvt_mp_add_ulong( op->o_counters->sc_entries, 1 );
-		ldap_pvt_mp_add_ulong( op->o_counters->sc_pdu, 1 );
-		ldap_pvt_thread_mutex_unlock( &op->o_counters->sc_mutex );
+		SLAP_COUNTER_ADD( op->o_counters, sc_bytes, bytes );
+		SLAP_COUNTER_ADD( op->o_counters, sc_entries, 1 );
+		SLAP_COUNTER_ADD( op->o_counters, sc_pdu, 1 );
 	}
 
 	Debug( LDAP_DEBUG_TRACE,
@@ -1647,11 +1643,9 @@ slap_send_search_reference( Operation *op, SlapReply *rs )
 	if ( bytes < 0 ) {
 		rc = LDAP_UNAVAILABLE;
 	} else {
-		ldap_pvt_thread_mutex_lock( &op->o_counters->sc_mutex );
-		ldap_pvt_mp_add_ulong( op->o_counters->sc_bytes, (unsigned long)bytes );
-		ldap_pvt_mp_add_ulong( op->o_counters->sc_refs, 1 );
-		ldap_pvt_mp_add_ulong( op->o_counters->sc_pdu, 1 );
-		ldap_pvt_thread_mutex_unlock( &op->o_counters->sc_mutex );
+		SLAP_COUNTER_ADD( op->o_counters, sc_bytes, bytes );
+		SLAP_COUNTER_ADD( op->o_counters, sc_refs, 1 );
+		SLAP_COUNTER_ADD( op->o_counters, sc_pdu, 1 );
 	}
 #ifdef LDAP_CONNECTIONLESS
 	}
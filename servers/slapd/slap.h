@@ -139,6 +139,7 @@ LDAP_BEGIN_DECL
 #define MAXREMATCHES (100)
 
 #define SLAP_MAX_WORKER_THREADS		(16)
+#define SLAP_PWVERIFY_QUEUE		(SLAP_MAX_WORKER_THREADS/2)
 
 #define SLAP_SB_MAX_INCOMING_DEFAULT ((1<<18) - 1)
 #define SLAP_SB_MAX_INCOMING_AUTH ((1<<24) - 1)
@@ -354,6 +355,7 @@ typedef struct ContentRule ContentRule;
 typedef struct AttributeAssertion AttributeAssertion;
 typedef struct SubstringsAssertion SubstringsAssertion;
 typedef struct Filter Filter;
+typedef struct FilterProgram FilterProgram;	/* private to filterentry.c */
 typedef struct ValuesReturnFilter ValuesReturnFilter;
 typedef struct Attribute Attribute;
 #ifdef LDAP_COMP_MATCH
@@ -1616,6 +1618,7 @@ LDAP_SLAPD_V (int) slapMode;
 #define	SLAP_TOOL_QUICK		0x0800
 #define SLAP_TOOL_NO_SCHEMA_CHECK	0x1000
 #define SLAP_TOOL_VALUE_CHECK	0x2000
+#define SLAP_TOOL_SORTED_INDEX	0x4000
 
 #define SLAP_SERVER_RUNNING	0x8000
 
@@ -1776,6 +1779,30 @@ struct sync_cookie {
 
 LDAP_STAILQ_HEAD( slap_sync_cookie_s, sync_cookie );
 
+/* Digests of the (entryUUID, entryCSN) pairs of a replicated subtree,
+ * kept per entryUUID byte following one of sd_prefixes. In list mode
+ * the entryUUIDs under the prefixes are collected instead.
+ */
+#define SLAP_SYNC_DIGEST_LEN	20
+#define SLAP_SYNC_DIGEST_MAXPREFIXES	256
+
+typedef struct sync_digest_bucket {
+	ber_int_t sdb_count;
+	unsigned char sdb_sum[SLAP_SYNC_DIGEST_LEN];
+} sync_digest_bucket;
+
+typedef struct sync_digest {
+	int sd_list;
+	int sd_plen;				/* length of every prefix */
+	int sd_nprefixes;
+	struct berval *sd_prefixes;	/* sorted */
+	sync_digest_bucket *sd_buckets;	/* 256 per prefix */
+	char *sd_uuids;				/* list mode, 16 bytes each */
+	int sd_nuuids;
+	int sd_maxuuids;
+	void *sd_memctx;
+} sync_digest;
+
 LDAP_TAILQ_HEAD( be_pcl, slap_csn_entry );
 
 #ifndef SLAP_MAX_CIDS
@@ -2204,6 +2231,10 @@ typedef int (BI_op_txn) LDAP_P(( Operation *op, int txnop, struct OpExtra **ptr
 #define SLAP_TXN_BEGIN	1
 #define SLAP_TXN_COMMIT	2
 #define SLAP_TXN_ABORT	3
+
+/* makes one update of a batch, within txn if it is not NULL */
+typedef int (SLAP_TXN_APPLY_FN) LDAP_P(( Operation *op, void *item,
+	struct OpExtra *txn, void *arg ));
 #endif
 
 typedef int (BI_conn_func) LDAP_P(( BackendDB *bd, Connection *c ));
@@ -2345,6 +2376,7 @@ struct BackendInfo {
 #define SLAP_BFLAG_SUBENTRIES		0x4000U
 #define SLAP_BFLAG_DYNAMIC			0x8000U
 #define SLAP_BFLAG_STANDALONE		0x10000U /* started up regardless of whether any databases use it */
+#define SLAP_BFLAG_GROUPCACHE		0x20000U /* invalidates the shared group cache on writes */
 
 /* overlay specific */
 #define	SLAPO_BFLAG_SINGLE		0x01000000U
@@ -2363,6 +2395,7 @@ struct BackendInfo {
 #define SLAP_SUBENTRIES(be)	(SLAP_BFLAGS(be) & SLAP_BFLAG_SUBENTRIES)
 #define SLAP_DYNAMIC(be)	((SLAP_BFLAGS(be) & SLAP_BFLAG_DYNAMIC) || (SLAP_DBFLAGS(be) & SLAP_DBFLAG_DYNAMIC))
 #define SLAP_NOLASTMODCMD(be)	(SLAP_BFLAGS(be) & SLAP_BFLAG_NOLASTMODCMD)
+#define SLAP_GROUPCACHE(be)	(SLAP_BFLAGS(be) & SLAP_BFLAG_GROUPCACHE)
 #define SLAP_LASTMODCMD(be)	(!SLAP_NOLASTMODCMD(be))
 
 /* overlay specific */
@@ -2543,22 +2576,65 @@ typedef enum {
 	SLAP_OP_LAST
 } slap_op_t;
 
+#ifdef HAVE_LONG_LONG
+typedef unsigned long long	slap_counter_t;
+#else
+typedef unsigned long		slap_counter_t;
+#endif
+
+#define SLAP_CACHELINE	64
+
+/* Operation statistics. Each pool thread owns an instance, linked
+ * off slap_counters.sc_next, that only it updates, without locking;
+ * readers add them up under slap_counters.sc_mutex, which guards the
+ * list. slap_counters itself holds the totals of exited threads and
+ * the counts of internal operations, which may come from any thread,
+ * so it is only updated under its mutex. An operation whose header was
+ * copied to another thread still points at its original thread's
+ * instance; updates from other threads go to slap_counters instead.
+ */
 typedef struct slap_counters_t {
 	struct slap_counters_t	*sc_next;
 	ldap_pvt_thread_mutex_t	sc_mutex;
-	ldap_pvt_mp_t		sc_bytes;
-	ldap_pvt_mp_t		sc_pdu;
-	ldap_pvt_mp_t		sc_entries;
-	ldap_pvt_mp_t		sc_refs;
-
-	ldap_pvt_mp_t		sc_ops_completed;
-	ldap_pvt_mp_t		sc_ops_initiated;
+	ldap_pvt_thread_t	sc_owner;
+	slap_counter_t		sc_bytes;
+	slap_counter_t		sc_pdu;
+	slap_counter_t		sc_entries;
+	slap_counter_t		sc_refs;
+
+	slap_counter_t		sc_ops_completed;
+	slap_counter_t		sc_ops_initiated;
 #ifdef SLAPD_MONITOR
-	ldap_pvt_mp_t		sc_ops_completed_[SLAP_OP_LAST];
-	ldap_pvt_mp_t		sc_ops_initiated_[SLAP_OP_LAST];
+	slap_counter_t		sc_ops_completed_[SLAP_OP_LAST];
+	slap_counter_t		sc_ops_initiated_[SLAP_OP_LAST];
 #endif /* SLAPD_MONITOR */
+	/* keep other threads' data off the last line of counters */
+	char			sc_pad[SLAP_CACHELINE];
 } slap_counters_t;
 
+/* Password verification pool statistics, see passwd.c */
+typedef struct slap_pwverify_stats {
+	int		ps_threads;	/* running verification threads */
+	int		ps_pending;	/* queued, not yet started */
+	int		ps_active;	/* being verified */
+	unsigned long	ps_verified;
+	unsigned long	ps_busy;	/* refused, queue full */
+	unsigned long	ps_usec;	/* total latency, queueing included */
+	unsigned long	ps_usec_max;
+} slap_pwverify_stats;
+
+#define SLAP_COUNTER_ADD(sc,ctr,n) \
+	do { \
+		if ( (sc) == &slap_counters || !ldap_pvt_thread_equal( \
+			(sc)->sc_owner, ldap_pvt_thread_self() )) { \
+			ldap_pvt_thread_mutex_lock( &slap_counters.sc_mutex ); \
+			slap_counters.ctr += (n); \
+			ldap_pvt_thread_mutex_unlock( &slap_counters.sc_mutex ); \
+		} else { \
+			(sc)->ctr += (n); \
+		} \
+	} while (0)
+
 /*
  * represents an operation pending from an ldap client
  */
@@ -2612,6 +2688,11 @@ typedef struct OpExtraDB {
 	BackendDB *oe_db;
 } OpExtraDB;
 
+/* Write-behind store for volatile operational attributes */
+typedef struct slap_wb slap_wb;
+typedef int (slap_wb_write_f) LDAP_P(( Operation *op, Modifications *ml,
+	void *arg ));
+
 struct Operation {
 	Opheader *o_hdr;
 
@@ -2704,6 +2785,7 @@ struct Operation {
 #define SLAP_CANCEL_DONE				0x03
 
 	GroupAssertion *o_groups;
+	unsigned long o_groupgen;	/* group cache generation at the start */
 	char o_do_not_cache;	/* don't cache groups from this op */
 	char o_is_auth_check;	/* authorization in progress */
 	char o_dont_replicate;
@@ -3036,6 +3118,7 @@ struct Listener {
  */
 #define SLAP_LDAPDN_PRETTY 0x1
 #define SLAP_LDAPDN_MAXLEN 8192
+#define SLAP_DN_CACHE_DEFAULT	4096	/* slots in the DN normalization cache */
 
 /* number of response controls supported */
 #define SLAP_MAX_RESPONSE_CONTROLS   6
@@ -30,6 +30,7 @@
 #include <ac/ctype.h>
 #include <ac/string.h>
 #include <ac/socket.h>
+#include <ac/time.h>
 #include <ac/unistd.h>
 
 #include <lber.h>
@@ -56,23 +57,47 @@
 
 extern int slap_DN_strict;	/* dn.c */
 
-static char csnbuf[ LDAP_PVT_CSNSTR_BUFSIZE ];
-
 typedef struct Erec {
 	Entry *e;
 	unsigned long lineno;
 	unsigned long nextline;
 } Erec;
 
-typedef struct Trec {
-	Entry *e;
-	unsigned long lineno;
-	unsigned long nextline;
+/*
+ * With tool-threads > 1 slapadd runs as a pipeline: one thread reads
+ * raw LDIF records, tool-threads - 1 threads parse and check them
+ * concurrently, and the main thread hands the results to the backend
+ * in the original input order, so parents are still added before
+ * their children.  Records travel through a ring of Prec slots.
+ */
+typedef struct Prec {
+	Erec erec;
+	char *buf;
+	int lmax;
 	int rc;
-	int ready;
-} Trec;
+	int state;
+#define PREC_FREE	0
+#define PREC_READ	1	/* raw LDIF, waiting to be parsed */
+#define PREC_DONE	2	/* parsed, or EOF/read failure */
+} Prec;
+
+#define PIPE_SLOTS_PER_THREAD	16
+
+static Prec *pipe_ring;
+static int pipe_slots;
+static unsigned long pipe_read, pipe_parse, pipe_write;
+static int pipe_eof;
+#define PIPE_SLOT(n)	(&pipe_ring[(n) % pipe_slots])
+
+/* per-stage statistics, printed in verbose mode */
+typedef struct Pstat {
+	unsigned long ps_records;
+	double ps_busy;		/* seconds spent doing work */
+	double ps_wait;		/* seconds spent waiting on other stages */
+} Pstat;
+
+static Pstat stat_read, stat_parse, stat_write;
 
-static Trec trec;
 static unsigned long sid = SLAP_SYNC_SID_MAX + 1;
 static int checkvals;
 static int enable_meter;
@@ -83,54 +108,75 @@ static char *buf;
 static int lmax;
 
 static ldap_pvt_thread_mutex_t add_mutex;
-static ldap_pvt_thread_cond_t add_cond;
+static ldap_pvt_thread_cond_t read_cond;	/* reader waits for a free slot */
+static ldap_pvt_thread_cond_t parse_cond;	/* parsers wait for raw records */
+static ldap_pvt_thread_cond_t add_cond;		/* writer waits for results */
 static int add_stop;
+static int ldif_threaded;
+
+static double
+pipe_now( void )
+{
+	struct timeval tv;
+
+	gettimeofday( &tv, NULL );
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
 
 /* returns:
  *	1: got a record
  *	0: EOF
  * -1: read failure
+ */
+static int
+getrec_read( Erec *erec, char **bufp, int *lmaxp )
+{
+	int ldifrc;
+
+	do {
+		erec->lineno = erec->nextline+1;
+		/* nextline is the line number of the end of the current entry */
+		ldifrc = ldif_read_record( ldiffp, &erec->nextline, bufp, lmaxp );
+		if (ldifrc < 1)
+			return ldifrc < 0 ? -1 : 0;
+	} while ( erec->lineno < jumpline );
+
+	if ( enable_meter )
+		lutil_meter_update( &meter,
+				 ftello( ldiffp->fp ),
+				 0);
+
+	return 1;
+}
+
+/* returns:
+ *	1: got a record
  * -2: parse failure
  */
 static int
-getrec0(Erec *erec)
+getrec_parse( Operation *op, Erec *erec, char *lbuf )
 {
 	const char *text;
-	int ldifrc;
 	char textbuf[SLAP_TEXT_BUFLEN] = { '\0' };
 	size_t textlen = sizeof textbuf;
 	struct berval csn;
-	Operation *op = &opbuf.ob_op;
-	op->o_hdr = &opbuf.ob_hdr;
+	char csnbuf[ LDAP_PVT_CSNSTR_BUFSIZE ];
 
-again:
-	erec->lineno = erec->nextline+1;
-	/* nextline is the line number of the end of the current entry */
-	ldifrc = ldif_read_record( ldiffp, &erec->nextline, &buf, &lmax );
-	if (ldifrc < 1)
-		return ldifrc < 0 ? -1 : 0;
 	{
 		BackendDB *bd;
 		Entry *e;
 		int prev_DN_strict;
 
-		if ( erec->lineno < jumpline )
-			goto again;
-
-		if ( !dbnum ) {
+		/* the pipeline relaxes DN checks once for all parsers */
+		if ( !dbnum && !ldif_threaded ) {
 			prev_DN_strict = slap_DN_strict;
 			slap_DN_strict = 0;
 		}
-		e = str2entry2( buf, checkvals );
-		if ( !dbnum ) {
+		e = str2entry2( lbuf, checkvals );
+		if ( !dbnum && !ldif_threaded ) {
 			slap_DN_strict = prev_DN_strict;
 		}
 
-		if ( enable_meter )
-			lutil_meter_update( &meter,
-					 ftello( ldiffp->fp ),
-					 0);
-
 		if( e == NULL ) {
 			fprintf( stderr, "%s: could not parse entry (line=%lu)\n",
 				progname, erec->lineno );
@@ -298,53 +344,172 @@ again:
 				      (!(got & GOT_CSN) ? slap_schema.si_ad_entryCSN->ad_cname.bv_val : ""),
 				      e->e_name.bv_val );
 			}
-
-			sid = slap_tool_update_ctxcsn_check( progname, e );
 		}
 		erec->e = e;
 	}
 	return 1;
 }
 
+/* returns:
+ *	1: got a record
+ *	0: EOF
+ * -1: read failure
+ * -2: parse failure
+ */
+static int
+getrec0(Erec *erec)
+{
+	Operation *op = &opbuf.ob_op;
+	double t0, t1;
+	int rc;
+
+	op->o_hdr = &opbuf.ob_hdr;
+
+	t0 = pipe_now();
+	rc = getrec_read( erec, &buf, &lmax );
+	t1 = pipe_now();
+	stat_read.ps_busy += t1 - t0;
+	if ( rc < 1 )
+		return rc;
+	stat_read.ps_records++;
+
+	rc = getrec_parse( op, erec, buf );
+	stat_parse.ps_busy += pipe_now() - t1;
+	stat_parse.ps_records++;
+	return rc;
+}
+
 static void *
-getrec_thr(void *ctx)
+getrec_read_thr(void *ctx)
 {
+	Erec erec;
+	Prec *p;
+	double t0, t1;
+	int rc;
+
+	erec.nextline = 0;
+	erec.e = NULL;
+
 	ldap_pvt_thread_mutex_lock( &add_mutex );
 	while (!add_stop) {
-		trec.rc = getrec0((Erec *)&trec);
-		trec.ready = 1;
-		while (trec.ready)
-			ldap_pvt_thread_cond_wait( &add_cond, &add_mutex );
-		/* eof or read failure */
-		if ( trec.rc == 0 || trec.rc == -1 )
+		t0 = pipe_now();
+		while ( pipe_read - pipe_write == pipe_slots && !add_stop )
+			ldap_pvt_thread_cond_wait( &read_cond, &add_mutex );
+		if ( add_stop )
+			break;
+		p = PIPE_SLOT( pipe_read );
+		ldap_pvt_thread_mutex_unlock( &add_mutex );
+
+		t1 = pipe_now();
+		stat_read.ps_wait += t1 - t0;
+		rc = getrec_read( &erec, &p->buf, &p->lmax );
+		stat_read.ps_busy += pipe_now() - t1;
+		p->erec = erec;
+		p->rc = rc;
+
+		ldap_pvt_thread_mutex_lock( &add_mutex );
+		pipe_read++;
+		if ( rc == 1 ) {
+			stat_read.ps_records++;
+			p->state = PREC_READ;
+			ldap_pvt_thread_cond_signal( &parse_cond );
+		} else {
+			/* eof or read failure */
+			p->state = PREC_DONE;
+			pipe_eof = 1;
+			ldap_pvt_thread_cond_broadcast( &parse_cond );
+			ldap_pvt_thread_cond_signal( &add_cond );
 			break;
+		}
 	}
 	ldap_pvt_thread_mutex_unlock( &add_mutex );
 	return NULL;
 }
 
-static int ldif_threaded;
+static void *
+getrec_parse_thr(void *ctx)
+{
+	OperationBuffer obuf = { 0 };
+	Operation *op = &obuf.ob_op;
+	Prec *p;
+	double t0, t1, busy = 0, wait = 0;
+	unsigned long records = 0;
+
+	op->o_hdr = &obuf.ob_hdr;
+
+	ldap_pvt_thread_mutex_lock( &add_mutex );
+	for (;;) {
+		t0 = pipe_now();
+		while ( pipe_parse == pipe_read && !pipe_eof && !add_stop )
+			ldap_pvt_thread_cond_wait( &parse_cond, &add_mutex );
+		if ( pipe_parse == pipe_read || add_stop )
+			break;
+		p = PIPE_SLOT( pipe_parse );
+		pipe_parse++;
+		if ( p->state != PREC_READ )
+			continue;
+		ldap_pvt_thread_mutex_unlock( &add_mutex );
+
+		t1 = pipe_now();
+		wait += t1 - t0;
+		p->rc = getrec_parse( op, &p->erec, p->buf );
+		busy += pipe_now() - t1;
+		records++;
+
+		ldap_pvt_thread_mutex_lock( &add_mutex );
+		p->state = PREC_DONE;
+		if ( p == PIPE_SLOT( pipe_write ))
+			ldap_pvt_thread_cond_signal( &add_cond );
+	}
+	stat_parse.ps_records += records;
+	stat_parse.ps_busy += busy;
+	stat_parse.ps_wait += wait;
+	ldap_pvt_thread_mutex_unlock( &add_mutex );
+	return NULL;
+}
 
 static int
 getrec(Erec *erec)
 {
+	Prec *p;
+	double t0;
 	int rc;
+
 	if ( !ldif_threaded )
 		return getrec0(erec);
 
-	while (!trec.ready)
-		ldap_pvt_thread_yield();
-	erec->e = trec.e;
-	erec->lineno = trec.lineno;
-	erec->nextline = trec.nextline;
-	trec.ready = 0;
-	rc = trec.rc;
+	t0 = pipe_now();
 	ldap_pvt_thread_mutex_lock( &add_mutex );
+	p = PIPE_SLOT( pipe_write );
+	while ( pipe_write == pipe_read || p->state != PREC_DONE )
+		ldap_pvt_thread_cond_wait( &add_cond, &add_mutex );
+	rc = p->rc;
+	if ( rc == 1 )
+		*erec = p->erec;
+	if ( rc != 0 && rc != -1 ) {
+		p->state = PREC_FREE;
+		pipe_write++;
+		ldap_pvt_thread_cond_signal( &read_cond );
+	}
 	ldap_pvt_thread_mutex_unlock( &add_mutex );
-	ldap_pvt_thread_cond_signal( &add_cond );
+	stat_write.ps_wait += pipe_now() - t0;
 	return rc;
 }
 
+static void
+pipe_stat_print( const char *stage, Pstat *ps, int nthreads )
+{
+	fprintf( stderr, "%s: %-6s %lu records, %d thread%s, %.2fs busy",
+		progname, stage, ps->ps_records, nthreads,
+		nthreads > 1 ? "s" : "", ps->ps_busy );
+	if ( ps->ps_busy > 0 )
+		fprintf( stderr, " (%.0f/s per thread)",
+			ps->ps_records / ps->ps_busy );
+	if ( ldif_threaded )
+		fprintf( stderr, ", %.2fs waiting", ps->ps_wait );
+	fprintf( stderr, "\n" );
+}
+
 int
 slapadd( int argc, char **argv )
 {
@@ -352,7 +517,9 @@ slapadd( int argc, char **argv )
 	size_t textlen = sizeof textbuf;
 	Erec erec;
 	struct berval bvtext;
-	ldap_pvt_thread_t thr;
+	ldap_pvt_thread_t thr, *parse_thr = NULL;
+	int i, nparse = 0, prev_DN_strict = 0;
+	double start, t0;
 	ID id;
 	Entry *prev = NULL;
 
@@ -424,11 +591,25 @@ slapadd( int argc, char **argv )
 		enable_meter = 0;
 	}
 
+	start = pipe_now();
+
 	if ( slap_tool_thread_max > 1 ) {
+		nparse = slap_tool_thread_max - 1;
+		pipe_slots = nparse * PIPE_SLOTS_PER_THREAD;
+		pipe_ring = ch_calloc( pipe_slots, sizeof( Prec ));
+		parse_thr = ch_malloc( nparse * sizeof( ldap_pvt_thread_t ));
 		ldap_pvt_thread_mutex_init( &add_mutex );
+		ldap_pvt_thread_cond_init( &read_cond );
+		ldap_pvt_thread_cond_init( &parse_cond );
 		ldap_pvt_thread_cond_init( &add_cond );
-		ldap_pvt_thread_create( &thr, 0, getrec_thr, NULL );
 		ldif_threaded = 1;
+		if ( !dbnum ) {
+			prev_DN_strict = slap_DN_strict;
+			slap_DN_strict = 0;
+		}
+		ldap_pvt_thread_create( &thr, 0, getrec_read_thr, NULL );
+		for ( i = 0; i < nparse; i++ )
+			ldap_pvt_thread_create( &parse_thr[i], 0, getrec_parse_thr, NULL );
 	}
 
 	erec.nextline = 0;
@@ -442,6 +623,12 @@ slapadd( int argc, char **argv )
 			break;
 		}
 
+		if ( SLAP_LASTMOD(be) ) {
+			sid = slap_tool_update_ctxcsn_check( progname, erec.e );
+		}
+
+		t0 = pipe_now();
+		stat_write.ps_records++;
 		if ( !dryrun ) {
 			/*
 			 * Initialize text buffer
@@ -451,6 +638,7 @@ slapadd( int argc, char **argv )
 			bvtext.bv_val[0] = '\0';
 
 			id = be->be_entry_put( be, erec.e, &bvtext );
+			stat_write.ps_busy += pipe_now() - t0;
 			if( id == NOID ) {
 				fprintf( stderr, "%s: could not add entry dn=\"%s\" "
 								 "(line=%lu): %s\n", progname, erec.e->e_dn,
@@ -477,15 +665,50 @@ slapadd( int argc, char **argv )
 	}
 
 	if ( ldif_threaded ) {
+		unsigned long n;
+
 		ldap_pvt_thread_mutex_lock( &add_mutex );
 		add_stop = 1;
-		trec.ready = 0;
-		ldap_pvt_thread_cond_signal( &add_cond );
+		ldap_pvt_thread_cond_broadcast( &read_cond );
+		ldap_pvt_thread_cond_broadcast( &parse_cond );
 		ldap_pvt_thread_mutex_unlock( &add_mutex );
 		ldap_pvt_thread_join( thr, NULL );
+		for ( i = 0; i < nparse; i++ )
+			ldap_pvt_thread_join( parse_thr[i], NULL );
+		ch_free( parse_thr );
+
+		/* entries parsed ahead of a failed write */
+		for ( n = pipe_write; n < pipe_read; n++ ) {
+			Prec *p = PIPE_SLOT( n );
+			if ( p->state == PREC_DONE && p->rc == 1 )
+				entry_free( p->erec.e );
+		}
+		for ( i = 0; i < pipe_slots; i++ )
+			ch_free( pipe_ring[i].buf );
+		ch_free( pipe_ring );
+
+		if ( !dbnum ) {
+			slap_DN_strict = prev_DN_strict;
+		}
+		ldap_pvt_thread_cond_destroy( &add_cond );
+		ldap_pvt_thread_cond_destroy( &parse_cond );
+		ldap_pvt_thread_cond_destroy( &read_cond );
+		ldap_pvt_thread_mutex_destroy( &add_mutex );
 	}
 	if ( erec.e ) entry_free( erec.e );
 
+	if ( verbose ) {
+		double elapsed = pipe_now() - start;
+
+		pipe_stat_print( "read", &stat_read, 1 );
+		pipe_stat_print( "parse", &stat_parse, nparse ? nparse : 1 );
+		pipe_stat_print( "write", &stat_write, 1 );
+		if ( elapsed > 0 )
+			fprintf( stderr, "%s: %lu entries in %.2fs (%.0f/s)\n",
+				progname, stat_write.ps_records, elapsed,
+				stat_write.ps_records / elapsed );
+	}
+
 	if ( ldifrc < 0 )
 		rc = EXIT_FAILURE;
 
@@ -0,0 +1,739 @@
+/* slapbench.c - time slapd internals in isolation */
+/* $OpenLDAP$ */
+/* This work is part of OpenLDAP Software <http://www.openldap.org/>.
+ *
+ * Copyright 1998-2020 The OpenLDAP Foundation.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted only as authorized by the OpenLDAP
+ * Public License.
+ *
+ * A copy of this license is available in the file LICENSE in the
+ * top-level directory of the distribution or, alternatively, at
+ * <http://www.OpenLDAP.org/license.html>.
+ */
+
+/*
+ * Usage: slapbench -f slapd.conf [-b suffix] [-e entries] [-n iterations]
+ *		[-r repeats] [-F filter ...] [bench ...]
+ *
+ * Links the server objects without main() and the tools, loads the
+ * schema from the given configuration (it must define inetOrgPerson),
+ * generates entries and reports the time per call of the functions
+ * named by each bench.  Not built by default; use "make slapbench".
+ *
+ * Every case is run the given number of times and the fastest run is
+ * reported, as one tab separated line of bench, case, calls and
+ * nanoseconds per call; lines starting with '#' are comments.  The
+ * output of two builds can thus be compared line by line.
+ *
+ *	filter	str2filter() and test_filter() against the compiled
+ *		test_filter_program() over each filter, checking that
+ *		both agree
+ *	dn	dnNormalize() of each entry's DN
+ *	ber	ber_printf() and ber_scanf() of each entry as a
+ *		SearchResultEntry
+ *	slmalloc
+ *		slap_sl_malloc() and slap_sl_free() in stack and heap
+ *		mode, against ch_malloc() and ch_free()
+ *	idl	mdb_idl_insert(), mdb_idl_sort(), mdb_idl_intersection()
+ *		and mdb_idl_union()
+ *	entry	mdb_id2entry_add() and mdb_entry_decode() in a transaction
+ *		that is aborted; needs -b naming a back-mdb database, which
+ *		is opened but not changed
+ *
+ * idl and entry are only available when back-mdb is built statically.
+ */
+
+#include "portable.h"
+
+#include <stdio.h>
+
+#include <ac/stdlib.h>
+#include <ac/string.h>
+#include <ac/time.h>
+#include <ac/unistd.h>
+
+#include "slap.h"
+#include "lutil.h"
+
+#if SLAPD_MDB == SLAPD_MOD_STATIC
+#define BENCH_MDB
+#include "back-mdb/back-mdb.h"
+#include "back-mdb/idl.h"
+#endif
+
+/* normally defined in main.c */
+void *slap_tls_ctx;
+LDAP *slap_tls_ld;
+
+static const char *default_filters[] = {
+	"(objectClass=*)",
+	"(uid=user42)",
+	"(&(objectClass=inetOrgPerson)(uid=user42))",
+	"(&(objectClass=person)(|(sn=Smith)(sn=Jones))(mail=*@example.com))",
+	"(|(cn=User 1*)(description=*manager*)(telephoneNumber=*))",
+	"(&(description=*engineer*)(!(ou=Sales))(employeeNumber>=500)"
+		"(objectClass=inetOrgPerson))",
+	NULL
+};
+
+static char *all_benches[] = {
+	"filter", "dn", "ber", "slmalloc",
+#ifdef BENCH_MDB
+	"idl", "entry",
+#endif
+};
+
+static int repeats = 3;
+
+static const char *surnames[] = { "Smith", "Jones", "Brown", "Lee", NULL };
+static const char *units[] = { "Sales", "Engineering", "Support", NULL };
+
+static double
+now( void )
+{
+	struct timeval tv;
+
+	gettimeofday( &tv, NULL );
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static void
+report( const char *bench, const char *what, int calls, double secs )
+{
+	printf( "%s\t%s\t%d\t%.1f\n",
+		bench, what, calls, secs * 1e9 / calls );
+}
+
+/* remember the fastest of the repeated runs */
+static void
+lap( double *best, double start )
+{
+	double secs = now() - start;
+
+	if ( secs < *best )
+		*best = secs;
+}
+
+static Entry **
+make_entries( int n )
+{
+	Entry **entries;
+	char buf[1024];
+	int i;
+
+	entries = ch_calloc( n, sizeof( Entry * ));
+	for ( i = 0; i < n; i++ ) {
+		const char *sn = surnames[i % 4], *ou = units[i % 3];
+
+		snprintf( buf, sizeof( buf ),
+			"dn: uid=user%d,ou=%s,dc=example,dc=com\n"
+			"objectClass: top\n"
+			"objectClass: person\n"
+			"objectClass: organizationalPerson\n"
+			"objectClass: inetOrgPerson\n"
+			"uid: user%d\n"
+			"cn: User %d %s\n"
+			"sn: %s\n"
+			"ou: %s\n"
+			"mail: user%d@%s\n"
+			"employeeNumber: %d\n"
+			"%s"
+			"description: %s in %s\n",
+			i, ou, i, i, sn, sn, ou,
+			i, i % 2 ? "example.com" : "example.org", i,
+			i % 5 ? "" : "telephoneNumber: +1 555 0100\n",
+			i % 7 ? "engineer" : "manager", ou );
+		entries[i] = str2entry( buf );
+		if ( entries[i] == NULL ) {
+			fprintf( stderr, "slapbench: bad entry %d\n", i );
+			exit( EXIT_FAILURE );
+		}
+	}
+	return entries;
+}
+
+static int
+bench_filter( Operation *op, Entry **entries, int n, int iterations,
+	const char **filters )
+{
+	int f, i, j, r;
+
+	for ( f = 0; filters[f]; f++ ) {
+		Filter *flt;
+		FilterProgram *fp;
+		int matched[2] = { 0, 0 };
+		double start, best[3] = { 1e30, 1e30, 1e30 };
+		char what[64];
+
+		flt = str2filter_x( op, filters[f] );
+		if ( flt == NULL ) {
+			fprintf( stderr, "slapbench: bad filter \"%s\"\n", filters[f] );
+			return 1;
+		}
+
+		printf( "# filter %d: %s\n", f, filters[f] );
+
+		for ( r = 0; r < repeats; r++ ) {
+			start = now();
+			for ( j = 0; j < iterations; j++ ) {
+				for ( i = 0; i < n; i++ )
+					filter_free_x( op, str2filter_x( op, filters[f] ), 1 );
+			}
+			lap( &best[0], start );
+
+			start = now();
+			for ( j = 0; j < iterations; j++ ) {
+				for ( i = 0; i < n; i++ ) {
+					if ( test_filter( op, entries[i], flt ) ==
+							LDAP_COMPARE_TRUE )
+						matched[0]++;
+				}
+			}
+			lap( &best[1], start );
+
+			/* compiled once per iteration, as a search would */
+			start = now();
+			for ( j = 0; j < iterations; j++ ) {
+				fp = filter_compile( op, flt );
+				for ( i = 0; i < n; i++ ) {
+					if ( test_filter_program( op, entries[i], flt, fp ) ==
+							LDAP_COMPARE_TRUE )
+						matched[1]++;
+				}
+				filter_program_free( op, fp );
+			}
+			lap( &best[2], start );
+		}
+
+		snprintf( what, sizeof( what ), "str2filter/%d", f );
+		report( "filter", what, n * iterations, best[0] );
+		snprintf( what, sizeof( what ), "test_filter/%d", f );
+		report( "filter", what, n * iterations, best[1] );
+		snprintf( what, sizeof( what ), "test_filter_program/%d", f );
+		report( "filter", what, n * iterations, best[2] );
+
+		filter_free_x( op, flt, 1 );
+
+		if ( matched[0] != matched[1] ) {
+			fprintf( stderr, "slapbench: \"%s\" matched %d entries, "
+				"compiled %d\n", filters[f], matched[0], matched[1] );
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int
+bench_dn( Operation *op, Entry **entries, int n, int iterations )
+{
+	struct berval *dns, ndn;
+	double start, best = 1e30;
+	int i, j, r, rc = 0;
+
+	/* the way clients send them, not the way they are stored */
+	dns = ch_calloc( n, sizeof( struct berval ));
+	for ( i = 0; i < n; i++ ) {
+		char buf[256];
+
+		snprintf( buf, sizeof( buf ), "UID=User%d, OU=%s, DC=Example, DC=Com",
+			i, units[i % 3] );
+		ber_str2bv( buf, 0, 1, &dns[i] );
+	}
+
+	for ( r = 0; rc == 0 && r < repeats; r++ ) {
+		start = now();
+		for ( j = 0; rc == 0 && j < iterations; j++ ) {
+			for ( i = 0; i < n; i++ ) {
+				rc = dnNormalize( 0, NULL, NULL, &dns[i], &ndn,
+					op->o_tmpmemctx );
+				if ( rc != LDAP_SUCCESS ) {
+					fprintf( stderr, "slapbench: bad DN \"%s\"\n",
+						dns[i].bv_val );
+					break;
+				}
+				op->o_tmpfree( ndn.bv_val, op->o_tmpmemctx );
+			}
+		}
+		lap( &best, start );
+	}
+	if ( rc == 0 )
+		report( "dn", "dnNormalize", n * iterations, best );
+
+	for ( i = 0; i < n; i++ )
+		ch_free( dns[i].bv_val );
+	ch_free( dns );
+	return rc;
+}
+
+static int
+bench_ber( Operation *op, Entry **entries, int n, int iterations )
+{
+	struct berval *pdus;
+	int *nattrs;
+	double start, best[2] = { 1e30, 1e30 };
+	int i, j, k, r, rc = 0;
+
+	pdus = ch_calloc( n, sizeof( struct berval ));
+	nattrs = ch_calloc( n, sizeof( int ));
+
+	for ( r = 0; rc == 0 && r < repeats; r++ ) {
+		start = now();
+		for ( j = 0; rc == 0 && j < iterations; j++ ) {
+			for ( i = 0; i < n; i++ ) {
+				BerElement *ber = ber_alloc_t( LBER_USE_DER );
+				Attribute *a;
+
+				rc = ber_printf( ber, "{it{O{", i + 1,
+					LDAP_RES_SEARCH_ENTRY, &entries[i]->e_name );
+				for ( a = entries[i]->e_attrs, k = 0;
+					rc != -1 && a; a = a->a_next, k++ )
+				{
+					rc = ber_printf( ber, "{O[W]N}",
+						&a->a_desc->ad_cname, a->a_vals );
+				}
+				if ( rc != -1 )
+					rc = ber_printf( ber, "}N}N}" );
+				if ( rc == -1 ) {
+					fprintf( stderr, "slapbench: ber_printf failed\n" );
+					ber_free( ber, 1 );
+					rc = 1;
+					break;
+				}
+				rc = 0;
+				/* keep the last round for the decoder */
+				if ( r == repeats - 1 && j == iterations - 1 ) {
+					ber_flatten2( ber, &pdus[i], 1 );
+					nattrs[i] = k;
+				}
+				ber_free( ber, 1 );
+			}
+		}
+		lap( &best[0], start );
+	}
+
+	for ( r = 0; rc == 0 && r < repeats; r++ ) {
+		start = now();
+		for ( j = 0; rc == 0 && j < iterations; j++ ) {
+			for ( i = 0; i < n; i++ ) {
+				BerElementBuffer berbuf;
+				BerElement *ber = (BerElement *)&berbuf;
+				struct berval dn, type;
+				BerVarray vals;
+				ber_int_t msgid;
+				ber_tag_t tag, rtag;
+
+				ber_init2( ber, &pdus[i], 0 );
+				tag = ber_scanf( ber, "{it{m{", &msgid, &rtag, &dn );
+				for ( k = 0; tag != LBER_ERROR && k < nattrs[i]; k++ ) {
+					vals = NULL;
+					tag = ber_scanf( ber, "{m[W]}", &type, &vals );
+					ber_bvarray_free( vals );
+				}
+				if ( tag == LBER_ERROR || msgid != i + 1 ) {
+					fprintf( stderr, "slapbench: ber_scanf failed\n" );
+					rc = 1;
+					break;
+				}
+			}
+		}
+		lap( &best[1], start );
+	}
+
+	if ( rc == 0 ) {
+		report( "ber", "ber_printf", n * iterations, best[0] );
+		report( "ber", "ber_scanf", n * iterations, best[1] );
+	}
+
+	for ( i = 0; i < n; i++ )
+		ber_memfree( pdus[i].bv_val );
+	ch_free( pdus );
+	ch_free( nattrs );
+	return rc;
+}
+
+/* the allocations of a typical operation, 8 to 1024 bytes each */
+#define SL_ALLOCS	64
+
+static int
+bench_slmalloc( Operation *op, int n, int iterations )
+{
+	void *thrctx = ldap_pvt_thread_pool_context();
+	void *ptrs[SL_ALLOCS], *memctx;
+	ber_len_t sizes[SL_ALLOCS];
+	double start, best[3] = { 1e30, 1e30, 1e30 };
+	int i, j, k, r;
+
+	for ( k = 0; k < SL_ALLOCS; k++ )
+		sizes[k] = 8 << ( k * 7 % 8 );
+
+	for ( r = 0; r < repeats; r++ ) {
+		start = now();
+		for ( j = 0; j < iterations; j++ ) {
+			for ( i = 0; i < n; i++ ) {
+				for ( k = 0; k < SL_ALLOCS; k++ )
+					ptrs[k] = ch_malloc( sizes[k] );
+				for ( k = 0; k < SL_ALLOCS; k++ )
+					ch_free( ptrs[k] );
+			}
+		}
+		lap( &best[0], start );
+
+		/* a fresh stack for every operation, as connection.c does */
+		start = now();
+		for ( j = 0; j < iterations; j++ ) {
+			for ( i = 0; i < n; i++ ) {
+				memctx = slap_sl_mem_create( SLAP_SLAB_SIZE,
+					SLAP_SLAB_STACK, thrctx, 1 );
+				for ( k = 0; k < SL_ALLOCS; k++ )
+					ptrs[k] = slap_sl_malloc( sizes[k], memctx );
+				for ( k = SL_ALLOCS - 1; k >= 0; k-- )
+					slap_sl_free( ptrs[k], memctx );
+			}
+		}
+		lap( &best[1], start );
+
+		/* heap mode, freed out of order */
+		start = now();
+		for ( j = 0; j < iterations; j++ ) {
+			for ( i = 0; i < n; i++ ) {
+				memctx = slap_sl_mem_create( SLAP_SLAB_SIZE,
+					0, thrctx, 1 );
+				for ( k = 0; k < SL_ALLOCS; k++ )
+					ptrs[k] = slap_sl_malloc( sizes[k], memctx );
+				for ( k = 0; k < SL_ALLOCS; k++ )
+					slap_sl_free( ptrs[k], memctx );
+			}
+		}
+		lap( &best[2], start );
+	}
+
+	/* put back the stack the fake operation was given */
+	op->o_tmpmemctx = slap_sl_mem_create( SLAP_SLAB_SIZE, SLAP_SLAB_STACK,
+		thrctx, 1 );
+
+	report( "slmalloc", "ch_malloc", n * iterations * SL_ALLOCS, best[0] );
+	report( "slmalloc", "slap_sl_malloc/stack", n * iterations * SL_ALLOCS,
+		best[1] );
+	report( "slmalloc", "slap_sl_malloc/heap", n * iterations * SL_ALLOCS,
+		best[2] );
+	return 0;
+}
+
+#ifdef BENCH_MDB
+#define IDL_LEN		16384
+#define IDL_INSERTS	1024
+
+static int
+bench_idl( int iterations )
+{
+	ID *a, *b, *ids, *tmp;
+	unsigned long seed = 1;
+	double start, best[4] = { 1e30, 1e30, 1e30, 1e30 };
+	int i, j, r;
+
+	a = ch_malloc( MDB_idl_um_size * sizeof( ID ));
+	b = ch_malloc( MDB_idl_um_size * sizeof( ID ));
+	ids = ch_malloc( MDB_idl_um_size * sizeof( ID ));
+	tmp = ch_malloc( MDB_idl_um_size * sizeof( ID ));
+
+	/* two overlapping candidate lists, as from an AND of two indices */
+	a[0] = b[0] = IDL_LEN;
+	for ( i = 1; i <= IDL_LEN; i++ ) {
+		a[i] = i * 2;
+		b[i] = i * 3;
+	}
+
+	for ( r = 0; r < repeats; r++ ) {
+		start = now();
+		for ( j = 0; j < iterations; j++ ) {
+			ids[0] = 0;
+			for ( i = 0; i < IDL_INSERTS; i++ ) {
+				seed = seed * 1103515245 + 12345;
+				mdb_idl_insert( ids, seed % ( IDL_LEN * 4 ) + 1 );
+			}
+		}
+		lap( &best[0], start );
+
+		start = now();
+		for ( j = 0; j < iterations; j++ ) {
+			ids[0] = IDL_LEN;
+			for ( i = 1; i <= IDL_LEN; i++ ) {
+				seed = seed * 1103515245 + 12345;
+				ids[i] = seed % ( IDL_LEN * 4 ) + 1;
+			}
+			mdb_idl_sort( ids, tmp );
+		}
+		lap( &best[1], start );
+
+		start = now();
+		for ( j = 0; j < iterations; j++ ) {
+			MDB_IDL_CPY( ids, a );
+			mdb_idl_intersection( ids, b );
+		}
+		lap( &best[2], start );
+
+		start = now();
+		for ( j = 0; j < iterations; j++ ) {
+			MDB_IDL_CPY( ids, a );
+			mdb_idl_union( ids, b );
+		}
+		lap( &best[3], start );
+	}
+
+	report( "idl", "mdb_idl_insert", iterations * IDL_INSERTS, best[0] );
+	report( "idl", "mdb_idl_sort/16384", iterations, best[1] );
+	report( "idl", "mdb_idl_intersection/16384", iterations, best[2] );
+	report( "idl", "mdb_idl_union/16384", iterations, best[3] );
+
+	ch_free( a );
+	ch_free( b );
+	ch_free( ids );
+	ch_free( tmp );
+	return 0;
+}
+
+static int
+bench_entry( Operation *op, BackendDB *be, Entry **entries, int n,
+	int iterations )
+{
+	struct mdb_info *mdb;
+	MDB_txn *txn;
+	MDB_cursor *mc;
+	MDB_val *data;
+	ID id, nextid;
+	double start, best[2] = { 1e30, 1e30 };
+	int i, j, r, rc = 0, prev_ads;
+
+	if ( be == NULL ) {
+		printf( "# entry: skipped, no -b\n" );
+		return 0;
+	}
+	if ( strcmp( be->bd_info->bi_type, "mdb" )) {
+		fprintf( stderr, "slapbench: -b must name a mdb database\n" );
+		return 1;
+	}
+	if ( slap_startup( be )) {
+		fprintf( stderr, "slapbench: slap_startup failed\n" );
+		return 1;
+	}
+	mdb = be->be_private;
+	op->o_bd = be;
+	data = ch_calloc( n, sizeof( MDB_val ));
+
+	for ( r = 0; rc == 0 && r < repeats; r++ ) {
+		rc = mdb_txn_begin( mdb->mi_dbenv, NULL, 0, &txn );
+		if ( rc ) {
+			fprintf( stderr, "slapbench: mdb_txn_begin failed: %s\n",
+				mdb_strerror( rc ));
+			break;
+		}
+		prev_ads = mdb->mi_numads;
+		nextid = mdb->mi_nextid;
+
+		rc = mdb_cursor_open( txn, mdb->mi_id2entry, &mc );
+		if ( rc == 0 )
+			rc = mdb_next_id( be, mc, &id );
+		if ( rc ) {
+			fprintf( stderr, "slapbench: no free ID: %s\n",
+				mdb_strerror( rc ));
+			mdb_txn_abort( txn );
+			break;
+		}
+
+		/* new IDs past the end, gone again when the txn aborts */
+		start = now();
+		for ( i = 0; i < n; i++ ) {
+			entries[i]->e_id = id + i;
+			rc = mdb_id2entry_add( op, txn, NULL, entries[i] );
+			if ( rc ) {
+				fprintf( stderr, "slapbench: mdb_id2entry_add failed: %d\n",
+					rc );
+				break;
+			}
+		}
+		lap( &best[0], start );
+
+		for ( i = 0; rc == 0 && i < n; i++ )
+			rc = mdb_id2edata( op, mc, entries[i]->e_id, &data[i] );
+
+		if ( rc == 0 ) {
+			start = now();
+			for ( j = 0; rc == 0 && j < iterations; j++ ) {
+				for ( i = 0; i < n; i++ ) {
+					Entry *e;
+
+					rc = mdb_entry_decode( op, txn, &data[i],
+						entries[i]->e_id, &e );
+					if ( rc ) {
+						fprintf( stderr, "slapbench: mdb_entry_decode "
+							"failed: %d\n", rc );
+						break;
+					}
+					/* no DN yet, as in mdb_id2entry() */
+					e->e_name.bv_val = NULL;
+					e->e_nname.bv_val = NULL;
+					mdb_entry_return( op, e );
+				}
+			}
+			lap( &best[1], start );
+		}
+
+		mdb_cursor_close( mc );
+		mdb_txn_abort( txn );
+		mdb_ad_unwind( mdb, prev_ads );
+		mdb->mi_nextid = nextid;
+	}
+
+	if ( rc == 0 ) {
+		report( "entry", "mdb_id2entry_add", n, best[0] );
+		report( "entry", "mdb_entry_decode", n * iterations, best[1] );
+	}
+
+	for ( i = 0; i < n; i++ )
+		entries[i]->e_id = NOID;
+	ch_free( data );
+	op->o_bd = frontendDB;
+	slap_shutdown( be );
+	return rc;
+}
+#endif /* BENCH_MDB */
+
+static void
+usage( void )
+{
+	fprintf( stderr, "usage: slapbench -f slapd.conf [-b suffix] "
+		"[-e entries] [-n iterations] [-r repeats] [-F filter ...] "
+		"[filter] [dn] [ber] [slmalloc]"
+#ifdef BENCH_MDB
+		" [idl] [entry]"
+#endif
+		"\n" );
+	exit( EXIT_FAILURE );
+}
+
+int
+main( int argc, char **argv )
+{
+	char *conffile = NULL;
+	const char **filters = default_filters;
+	int nfilters = 0;
+	int n = 1000, iterations = 100;
+	int i, rc = 0;
+	struct berval suffix = BER_BVNULL;
+	BackendDB *be = NULL;
+	Connection conn = { 0 };
+	OperationBuffer opbuf;
+	Operation *op;
+	Entry **entries;
+
+	while (( i = getopt( argc, argv, "b:e:f:F:n:r:" )) != EOF ) {
+		switch ( i ) {
+		case 'b':
+			ber_str2bv( optarg, 0, 0, &suffix );
+			break;
+		case 'e':
+			if ( lutil_atoi( &n, optarg ) || n < 1 )
+				usage();
+			break;
+		case 'f':
+			conffile = optarg;
+			break;
+		case 'F':
+			if ( filters == default_filters )
+				filters = NULL;
+			filters = ch_realloc( filters,
+				( nfilters + 2 ) * sizeof( char * ));
+			filters[nfilters++] = optarg;
+			filters[nfilters] = NULL;
+			break;
+		case 'n':
+			if ( lutil_atoi( &iterations, optarg ) || iterations < 1 )
+				usage();
+			break;
+		case 'r':
+			if ( lutil_atoi( &repeats, optarg ) || repeats < 1 )
+				usage();
+			break;
+		default:
+			usage();
+		}
+	}
+	if ( conffile == NULL )
+		usage();
+
+	/* as main() does, so that ctx arguments are honoured */
+	slap_sl_mem_init();
+	ldap_pvt_thread_initialize();
+
+	if ( slap_init( SLAP_TOOL_MODE, "slapbench" ) ||
+		read_config( conffile, NULL ) ||
+		slap_schema_check() )
+	{
+		fprintf( stderr, "slapbench: initialization failed\n" );
+		exit( EXIT_FAILURE );
+	}
+
+	if ( !BER_BVISNULL( &suffix )) {
+		struct berval nsuffix;
+
+		if ( dnNormalize( 0, NULL, NULL, &suffix, &nsuffix, NULL ) ||
+			( be = select_backend( &nsuffix, 0 )) == NULL )
+		{
+			fprintf( stderr, "slapbench: no database for \"%s\"\n",
+				suffix.bv_val );
+			exit( EXIT_FAILURE );
+		}
+		ch_free( nsuffix.bv_val );
+	}
+
+	connection_fake_init( &conn, &opbuf, ldap_pvt_thread_pool_context() );
+	op = &opbuf.ob_op;
+	/* anonymous, subject to the frontend's access controls */
+	op->o_bd = frontendDB;
+
+	entries = make_entries( n );
+
+	if ( optind == argc ) {
+		/* run them all */
+		argv = all_benches;
+		argc = sizeof( all_benches ) / sizeof( all_benches[0] );
+		optind = 0;
+	}
+
+	printf( "# bench\tcase\tcalls\tns/call\n" );
+	for ( i = optind; rc == 0 && i < argc; i++ ) {
+		const char *bench = argv[i];
+
+		if ( !strcmp( bench, "filter" )) {
+			rc = bench_filter( op, entries, n, iterations, filters );
+		} else if ( !strcmp( bench, "dn" )) {
+			rc = bench_dn( op, entries, n, iterations );
+		} else if ( !strcmp( bench, "ber" )) {
+			rc = bench_ber( op, entries, n, iterations );
+		} else if ( !strcmp( bench, "slmalloc" )) {
+			rc = bench_slmalloc( op, n, iterations );
+#ifdef BENCH_MDB
+		} else if ( !strcmp( bench, "idl" )) {
+			rc = bench_idl( iterations );
+		} else if ( !strcmp( bench, "entry" )) {
+			rc = bench_entry( op, be, entries, n, iterations );
+#endif
+		} else {
+			fprintf( stderr, "slapbench: unknown bench \"%s\"\n", bench );
+			rc = 1;
+		}
+	}
+
+	for ( i = 0; i < n; i++ )
+		entry_free( entries[i] );
+	ch_free( entries );
+	if ( filters != default_filters )
+		ch_free( filters );
+
+	slap_destroy();
+
+	return rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -228,6 +228,40 @@ parse_slapopt( int tool, int *mode )
 			break;
 		}
 
+	} else if ( strncasecmp( optarg, "index-sort", len ) == 0 ) {
+		switch ( tool ) {
+		case SLAPADD:
+		case SLAPINDEX:
+			if ( strcasecmp( p, "yes" ) == 0 ) {
+				*mode |= SLAP_TOOL_SORTED_INDEX;
+			} else if ( strcasecmp( p, "no" ) == 0 ) {
+				*mode &= ~SLAP_TOOL_SORTED_INDEX;
+			} else {
+				Debug( LDAP_DEBUG_ANY, "unable to parse index-sort=\"%s\".\n", p );
+				return -1;
+			}
+			break;
+
+		default:
+			Debug( LDAP_DEBUG_ANY, "index-sort meaningless for tool.\n" );
+			break;
+		}
+
+	} else if ( strncasecmp( optarg, "checkpoint", len ) == 0 ) {
+		switch ( tool ) {
+		case SLAPINDEX:
+			if ( p == NULL || *p == '\0' ) {
+				Debug( LDAP_DEBUG_ANY, "checkpoint needs a file name.\n" );
+				return -1;
+			}
+			ckptfile = ch_strdup( p );
+			break;
+
+		default:
+			Debug( LDAP_DEBUG_ANY, "checkpoint meaningless for tool.\n" );
+			break;
+		}
+
 	} else if ( ( strncasecmp( optarg, "ldif_wrap", len ) == 0 ) ||
 			( strncasecmp( optarg, "ldif-wrap", len ) == 0 ) ) {
 		switch ( tool ) {
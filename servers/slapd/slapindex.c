@@ -29,15 +29,79 @@
 #include <ac/socket.h>
 #include <ac/unistd.h>
 
+#include <lutil.h>
+
 #include "slapcommon.h"
 
+/*
+ * The checkpoint file records the highest ID whose reindexing the
+ * backend has committed, and the attributes being indexed, so that an
+ * interrupted run can be resumed with the same arguments.
+ */
+static int
+ckpt_read( const char *progname, const char *attrs, ID *idp )
+{
+	FILE *fp;
+	char buf[BUFSIZ], *p;
+	unsigned long id;
+	int rc = -1;
+
+	fp = fopen( ckptfile, "r" );
+	if ( fp == NULL ) {
+		/* no checkpoint, start from the beginning */
+		*idp = 0;
+		return 0;
+	}
+
+	if ( fgets( buf, sizeof( buf ), fp ) != NULL &&
+		sscanf( buf, "id=%lu", &id ) == 1 &&
+		fgets( buf, sizeof( buf ), fp ) != NULL &&
+		strncmp( buf, "attrs=", STRLENOF( "attrs=" )) == 0 )
+	{
+		p = buf + STRLENOF( "attrs=" );
+		p[strcspn( p, "\n" )] = '\0';
+		if ( strcmp( p, attrs ) == 0 ) {
+			*idp = id;
+			rc = 0;
+		} else {
+			fprintf( stderr, "%s: checkpoint file %s was written for "
+				"attributes \"%s\"\n", progname, ckptfile, p );
+		}
+	} else {
+		fprintf( stderr, "%s: unable to parse checkpoint file %s\n",
+			progname, ckptfile );
+	}
+	fclose( fp );
+	return rc;
+}
+
+static int
+ckpt_write( const char *attrs, ID id )
+{
+	FILE *fp;
+	char *tmp;
+	int rc = -1;
+
+	tmp = ch_malloc( strlen( ckptfile ) + STRLENOF( ".tmp" ) + 1 );
+	sprintf( tmp, "%s.tmp", ckptfile );
+	fp = fopen( tmp, "w" );
+	if ( fp != NULL ) {
+		fprintf( fp, "id=%lu\nattrs=%s\n", (unsigned long) id, attrs );
+		if ( fclose( fp ) == 0 && rename( tmp, ckptfile ) == 0 )
+			rc = 0;
+	}
+	ch_free( tmp );
+	return rc;
+}
+
 int
 slapindex( int argc, char **argv )
 {
-	ID id;
+	ID id, resume = 0, ckpt = 0;
 	int rc = EXIT_SUCCESS;
 	const char *progname = "slapindex";
 	AttributeDescription *ad, **adv = NULL;
+	struct berval attrs = BER_BVC( "" );
 
 	slap_tool_init( progname, SLAPINDEX, argc, argv );
 
@@ -53,6 +117,20 @@ slapindex( int argc, char **argv )
 	}
 
 	argc -= optind;
+	if ( ckptfile && argc > 0 ) {
+		int i;
+		char *ptr;
+
+		for ( i = 0; i < argc; i++ )
+			attrs.bv_len += strlen( argv[optind+i] ) + 1;
+		attrs.bv_val = ptr = ch_malloc( attrs.bv_len );
+		for ( i = 0; i < argc; i++ ) {
+			if ( i )
+				*ptr++ = ' ';
+			ptr = lutil_strcopy( ptr, argv[optind+i] );
+		}
+	}
+
 	if ( argc > 0 ) {
 		const char *text;
 		int i;
@@ -72,6 +150,25 @@ slapindex( int argc, char **argv )
 		}
 	}
 
+	if ( ckptfile ) {
+		if ( ckpt_read( progname, attrs.bv_val, &resume ))
+			exit( EXIT_FAILURE );
+		if ( resume ) {
+			/* the indexes already hold the keys up to here */
+			slapMode &= ~SLAP_TRUNCATE_MODE;
+			fprintf( stderr, "%s: resuming after id=%08lx\n",
+				progname, (long) resume );
+		}
+		ckpt = resume;
+		if (( slapMode & ( SLAP_TOOL_QUICK|SLAP_TOOL_SORTED_INDEX )) ==
+			( SLAP_TOOL_QUICK|SLAP_TOOL_SORTED_INDEX ))
+		{
+			/* sorted keys are only written at close */
+			fprintf( stderr, "%s: no checkpoints are recorded with "
+				"-q and index-sort=yes\n", progname );
+		}
+	}
+
 	if( be->be_entry_open( be, 0 ) != 0 ) {
 		fprintf( stderr, "%s: could not open database.\n",
 			progname );
@@ -89,6 +186,9 @@ slapindex( int argc, char **argv )
 	for ( ; id != NOID; id = be->be_entry_next( be ) ) {
 		int rtn;
 
+		if ( id <= resume )
+			continue;
+
 		if( verbose ) {
 			printf("indexing id=%08lx\n", (long) id );
 		}
@@ -100,9 +200,27 @@ slapindex( int argc, char **argv )
 			if( continuemode ) continue;
 			break;
 		}
+
+		if ( ckptfile && slap_tool_checkpoint > ckpt ) {
+			ckpt = slap_tool_checkpoint;
+			if ( ckpt_write( attrs.bv_val, ckpt )) {
+				fprintf( stderr, "%s: could not write checkpoint file %s\n",
+					progname, ckptfile );
+			}
+		}
 	}
 
-	(void) be->be_entry_close( be );
+	if ( be->be_entry_close( be ) != 0 )
+		rc = EXIT_FAILURE;
+
+	if ( ckptfile ) {
+		/* finished, the next run starts from scratch */
+		if ( rc == EXIT_SUCCESS )
+			unlink( ckptfile );
+		if ( attrs.bv_len )
+			ch_free( attrs.bv_val );
+		ch_free( ckptfile );
+	}
 
 	if ( slap_tool_destroy())
 		rc = EXIT_FAILURE;
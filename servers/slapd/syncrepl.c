@@ -93,6 +93,9 @@ typedef struct cookie_state {
 #define	SYNCLOG_LOGGING		0	/* doing a log-based update */
 #define	SYNCLOG_FALLBACK	1	/* doing a full refresh */
 
+/* Least number of seconds between two digest comparisons */
+#define SYNC_DIGEST_INTERVAL	60
+
 #define RETRYNUM_FOREVER	(-1)	/* retry forever */
 #define RETRYNUM_TAIL		(-2)	/* end of retrynum array */
 #define RETRYNUM_VALID(n)	((n) >= RETRYNUM_FOREVER)	/* valid retrynum */
@@ -143,9 +146,13 @@ typedef struct syncinfo_s {
 	int			si_lazyCommit;
 	int			si_got;
 	int			si_strict_refresh;	/* stop listening during fallback refresh */
+	int			si_syncdigest;	/* reconcile with digests, not a present phase */
+	int			si_digest_sent;
+	int			si_digest_off;	/* the provider could not answer */
+	time_t		si_digest_last;	/* when the last comparison started */
 	int			si_too_old;
 	ber_int_t	si_msgid;
-	Avlnode			*si_presentlist;
+	struct presentlist	*si_presentlist;
 	LDAP			*si_ld;
 	Connection		*si_conn;
 	LDAP_LIST_HEAD(np, nonpresent_entry)	si_nonpresentlist;
@@ -163,12 +170,11 @@ typedef struct syncinfo_s {
 	ldap_pvt_thread_mutex_t	si_mutex;
 } syncinfo_t;
 
-static int syncuuid_cmp( const void *, const void * );
 static int presentlist_insert( syncinfo_t* si, struct berval *syncUUID );
-static void presentlist_delete( Avlnode **av, struct berval *syncUUID );
-static char *presentlist_find( Avlnode *av, struct berval *syncUUID );
-static int presentlist_free( Avlnode *av );
+static int presentlist_find( struct presentlist *pl, struct berval *syncUUID );
+static int presentlist_free( struct presentlist *pl );
 static void syncrepl_del_nonpresent( Operation *, syncinfo_t *, BerVarray, struct sync_cookie *, int );
+static int syncrepl_digest_reconcile( Operation *, syncinfo_t *, struct sync_cookie *, int );
 static int syncrepl_message_to_op(
 					syncinfo_t *, Operation *, LDAPMessage * );
 static int syncrepl_message_to_entry(
@@ -490,8 +496,8 @@ ldap_sync_search(
 {
 	BerElementBuffer berbuf;
 	BerElement *ber = (BerElement *)&berbuf;
-	LDAPControl c[3], *ctrls[4];
-	int rc;
+	LDAPControl c[4], *ctrls[5];
+	int rc, i;
 	int rhint;
 	char *base;
 	char **attrs, *lattrs[9];
@@ -665,16 +671,30 @@ ldap_sync_search(
 		BER_BVZERO( &c[1].ldctl_value );
 		c[1].ldctl_iscritical = 1;
 		ctrls[1] = &c[1];
+		i = 2;
 
 		if ( !BER_BVISNULL( &si->si_bindconf.sb_authzId ) ) {
-			c[2].ldctl_oid = LDAP_CONTROL_PROXY_AUTHZ;
-			c[2].ldctl_value = si->si_bindconf.sb_authzId;
-			c[2].ldctl_iscritical = 1;
-			ctrls[2] = &c[2];
-			ctrls[3] = NULL;
-		} else {
-			ctrls[2] = NULL;
+			c[i].ldctl_oid = LDAP_CONTROL_PROXY_AUTHZ;
+			c[i].ldctl_value = si->si_bindconf.sb_authzId;
+			c[i].ldctl_iscritical = 1;
+			ctrls[i] = &c[i];
+			i++;
 		}
+
+		/* Ask to skip the present phase, we'll compare digests */
+		si->si_digest_sent = 0;
+		if ( si->si_syncdigest && !si->si_digest_off &&
+			slap_get_time() - si->si_digest_last >= SYNC_DIGEST_INTERVAL &&
+			!BER_BVISNULL( &si->si_syncCookie.octet_str ) &&
+			!( si->si_syncdata && si->si_logstate == SYNCLOG_LOGGING ) ) {
+			c[i].ldctl_oid = LDAP_CONTROL_X_SYNC_DIGEST;
+			BER_BVZERO( &c[i].ldctl_value );
+			c[i].ldctl_iscritical = 0;
+			ctrls[i] = &c[i];
+			i++;
+			si->si_digest_sent = 1;
+		}
+		ctrls[i] = NULL;
 	}
 
 	rc = ldap_search_ext( si->si_ld, base, scope, filter, attrs, attrsonly,
@@ -1481,7 +1501,16 @@ logerr:
 				{
 					syncrepl_del_nonpresent( op, si, NULL,
 						&syncCookie, m );
-				} else if ( si->si_presentlist ) {
+				} else if ( si->si_digest_sent && refreshDeletes &&
+					match < 0 && err == LDAP_SUCCESS &&
+					syncrepl_digest_reconcile( op, si, &syncCookie, m ) )
+				{
+					/* keep the old cookie, the next refresh will
+					 * have a present phase
+					 */
+					match = 1;
+				}
+				if ( si->si_presentlist ) {
 					presentlist_free( si->si_presentlist );
 					si->si_presentlist = NULL;
 				}
@@ -1661,9 +1690,19 @@ logerr:
 						syncCookie_req.numcsns == syncCookie.numcsns ) {
 						syncrepl_del_nonpresent( op, si, NULL,
 							&syncCookie, m );
+					} else if ( si->si_digest_sent && si->si_refreshDone &&
+						si_tag == LDAP_TAG_SYNC_REFRESH_DELETE ) {
+						si->si_digest_sent = 0;
+						/* as in refreshOnly, keep the old cookie and
+						 * stay in persist if the digests could not
+						 * be compared
+						 */
+						if ( syncrepl_digest_reconcile( op, si,
+							&syncCookie, m ) )
+							match = 1;
 					}
 
-					if ( syncCookie.ctxcsn )
+					if ( syncCookie.ctxcsn && match < 0 )
 					{
 						rc = syncrepl_updateCookie( si, op, &syncCookie, 1 );
 					}
@@ -3597,104 +3636,112 @@ typedef struct dninfo {
 	AttributeDescription *newDesc;	/* for renames */
 } dninfo;
 
-#define HASHUUID	1
+/*
+ * The present list holds the entryUUIDs received in a present phase,
+ * in buckets by their first two bytes.  Each bucket keeps the rest of
+ * its UUIDs packed back to back, appended as they arrive and sorted
+ * the first time the bucket is searched.  This costs 14 bytes per
+ * entry, instead of a tree node and a malloc'd UUID.
+ */
+#define PL_BUCKETS	65536
+#define PL_KEYLEN	(UUIDLEN-2)
 
-/* return 1 if inserted, 0 otherwise */
+typedef struct presentbucket {
+	char *pb_keys;
+	unsigned int pb_num;	/* room is the next power of 2 */
+	unsigned int pb_sorted;	/* the first pb_sorted keys are in order */
+} presentbucket;
+
+typedef struct presentlist {
+	presentbucket pl_buckets[PL_BUCKETS];
+	unsigned long pl_count;
+} presentlist;
+
+static int
+presentkey_cmp( const void *k1, const void *k2 )
+{
+	return memcmp( k1, k2, PL_KEYLEN );
+}
+
+/* return 1 if inserted */
 static int
 presentlist_insert(
 	syncinfo_t* si,
 	struct berval *syncUUID )
 {
-	char *val;
-
-#ifdef HASHUUID
-	Avlnode **av;
+	presentbucket *pb;
 	unsigned short s;
 
 	if ( !si->si_presentlist )
-		si->si_presentlist = ch_calloc(65536, sizeof( Avlnode * ));
-
-	av = (Avlnode **)si->si_presentlist;
-
-	val = ch_malloc(UUIDLEN-2);
-	memcpy(&s, syncUUID->bv_val, 2);
-	memcpy(val, syncUUID->bv_val+2, UUIDLEN-2);
-
-	if ( avl_insert( &av[s], val,
-		syncuuid_cmp, avl_dup_error ) )
-	{
-		ch_free( val );
-		return 0;
-	}
-#else
-	val = ch_malloc(UUIDLEN);
+		si->si_presentlist = ch_calloc( 1, sizeof( presentlist ));
 
-	AC_MEMCPY( val, syncUUID->bv_val, UUIDLEN );
+	memcpy( &s, syncUUID->bv_val, 2 );
+	pb = &si->si_presentlist->pl_buckets[s];
 
-	if ( avl_insert( &si->si_presentlist, val,
-		syncuuid_cmp, avl_dup_error ) )
-	{
-		ch_free( val );
-		return 0;
+	if ( !pb->pb_num ) {
+		pb->pb_keys = ch_malloc( 4 * PL_KEYLEN );
+	} else if ( pb->pb_num >= 4 && !( pb->pb_num & ( pb->pb_num - 1 ))) {
+		pb->pb_keys = ch_realloc( pb->pb_keys, 2 * pb->pb_num * PL_KEYLEN );
 	}
-#endif
+	AC_MEMCPY( pb->pb_keys + pb->pb_num * PL_KEYLEN,
+		syncUUID->bv_val + 2, PL_KEYLEN );
+	pb->pb_num++;
+	si->si_presentlist->pl_count++;
 
 	return 1;
 }
 
-static char *
+static int
 presentlist_find(
-	Avlnode *av,
+	presentlist *pl,
 	struct berval *val )
 {
-#ifdef HASHUUID
-	Avlnode **a2 = (Avlnode **)av;
+	presentbucket *pb;
 	unsigned short s;
+	unsigned int i, j;
 
-	if (!av)
-		return NULL;
+	if ( !pl )
+		return 0;
 
-	memcpy(&s, val->bv_val, 2);
-	return avl_find( a2[s], val->bv_val+2, syncuuid_cmp );
-#else
-	return avl_find( av, val->bv_val, syncuuid_cmp );
-#endif
+	memcpy( &s, val->bv_val, 2 );
+	pb = &pl->pl_buckets[s];
+	if ( !pb->pb_num )
+		return 0;
+
+	if ( pb->pb_sorted != pb->pb_num ) {
+		/* sort, and drop the UUIDs we were sent twice */
+		qsort( pb->pb_keys, pb->pb_num, PL_KEYLEN, presentkey_cmp );
+		for ( i = 1, j = 0; i < pb->pb_num; i++ ) {
+			if ( memcmp( pb->pb_keys + i * PL_KEYLEN,
+				pb->pb_keys + j * PL_KEYLEN, PL_KEYLEN )) {
+				j++;
+				if ( j != i )
+					AC_MEMCPY( pb->pb_keys + j * PL_KEYLEN,
+						pb->pb_keys + i * PL_KEYLEN, PL_KEYLEN );
+			}
+		}
+		pl->pl_count -= pb->pb_num - ( j + 1 );
+		pb->pb_num = pb->pb_sorted = j + 1;
+	}
+
+	return bsearch( val->bv_val + 2, pb->pb_keys, pb->pb_num,
+		PL_KEYLEN, presentkey_cmp ) != NULL;
 }
 
 static int
-presentlist_free( Avlnode *av )
+presentlist_free( presentlist *pl )
 {
-#ifdef HASHUUID
-	Avlnode **a2 = (Avlnode **)av;
 	int i, count = 0;
 
-	if ( av ) {
-		for (i=0; i<65536; i++) {
-			if (a2[i])
-				count += avl_free( a2[i], ch_free );
+	if ( pl ) {
+		count = pl->pl_count;
+		for ( i = 0; i < PL_BUCKETS; i++ ) {
+			if ( pl->pl_buckets[i].pb_keys )
+				ch_free( pl->pl_buckets[i].pb_keys );
 		}
-		ch_free( av );
+		ch_free( pl );
 	}
 	return count;
-#else
-	return avl_free( av, ch_free );
-#endif
-}
-
-static void
-presentlist_delete(
-	Avlnode **av,
-	struct berval *val )
-{
-#ifdef HASHUUID
-	Avlnode **a2 = *(Avlnode ***)av;
-	unsigned short s;
-
-	memcpy(&s, val->bv_val, 2);
-	avl_delete( &a2[s], val->bv_val+2, syncuuid_cmp );
-#else
-	avl_delete( av, val->bv_val, syncuuid_cmp );
-#endif
 }
 
 static int
@@ -4508,6 +4555,375 @@ syncrepl_del_nonpresent(
 	return;
 }
 
+/*
+ * Without a present phase, find the entries the provider no longer has
+ * by comparing digests of the entryUUID ranges with the provider's.
+ * Ranges are split by one more entryUUID byte at each level, and only
+ * ranges that differ and hold entries of ours are looked into, so the
+ * traffic follows how far apart the two sides are rather than their size.
+ * Small ranges are settled by comparing the entryUUIDs themselves.
+ */
+
+/* Largest range whose entryUUIDs are compared rather than split further */
+#define SYNC_DIGEST_LEAF	64
+
+typedef struct digest_prefixes {
+	char *dp_buf;		/* dp_num prefixes of dp_len bytes each */
+	int dp_len;
+	int dp_num;
+	int dp_max;
+} digest_prefixes;
+
+static void
+digest_prefix_add( digest_prefixes *dp, struct berval *parent, int byte )
+{
+	char *p;
+
+	if ( dp->dp_num == dp->dp_max ) {
+		dp->dp_max = dp->dp_max ? dp->dp_max * 2 : 256;
+		dp->dp_buf = ch_realloc( dp->dp_buf, dp->dp_max * dp->dp_len );
+	}
+	p = dp->dp_buf + dp->dp_num * dp->dp_len;
+	AC_MEMCPY( p, parent->bv_val, parent->bv_len );
+	p[ parent->bv_len ] = byte;
+	dp->dp_num++;
+}
+
+static int
+digest_uuid_cmp( const void *a, const void *b )
+{
+	return memcmp( a, b, UUIDLEN );
+}
+
+static int
+syncrepl_digest_cb(
+	Operation *op,
+	SlapReply *rs )
+{
+	if ( rs->sr_type == REP_SEARCH ) {
+		slap_sync_digest_add( op->o_callback->sc_private, rs->sr_entry );
+	}
+	return LDAP_SUCCESS;
+}
+
+/* Digest our own entries, as syncrepl_del_nonpresent() would see them */
+static int
+syncrepl_digest_local(
+	Operation *op,
+	syncinfo_t *si,
+	struct sync_cookie *sc,
+	sync_digest *sd )
+{
+	Backend *be = op->o_bd;
+	slap_callback cb = { NULL };
+	SlapReply rs_search = {REP_RESULT};
+	AttributeName an[3];
+	Filter mmf[2], *of;
+	AttributeAssertion mmaa;
+	int i;
+
+#ifdef ENABLE_REWRITE
+	if ( si->si_rewrite ) {
+		op->o_req_dn = si->si_suffixm;
+		op->o_req_ndn = si->si_suffixm;
+	} else
+#endif
+	{
+		op->o_req_dn = si->si_base;
+		op->o_req_ndn = si->si_base;
+	}
+
+	cb.sc_response = syncrepl_digest_cb;
+	cb.sc_private = sd;
+
+	memset( an, 0, sizeof( an ));
+	an[0].an_name = slap_schema.si_ad_entryUUID->ad_cname;
+	an[0].an_desc = slap_schema.si_ad_entryUUID;
+	an[1].an_name = slap_schema.si_ad_entryCSN->ad_cname;
+	an[1].an_desc = slap_schema.si_ad_entryCSN;
+
+	op->o_callback = &cb;
+	op->o_tag = LDAP_REQ_SEARCH;
+	op->ors_scope = si->si_scope;
+	op->ors_deref = LDAP_DEREF_NEVER;
+	op->o_time = slap_get_time();
+	op->ors_tlimit = SLAP_NO_LIMIT;
+	op->ors_slimit = SLAP_NO_LIMIT;
+	op->ors_limit = NULL;
+	op->ors_attrsonly = 0;
+	op->ors_attrs = an;
+	op->ors_filter = of = filter_dup( si->si_filter, op->o_tmpmemctx );
+
+	/* In multimaster, leave out what we got since our cookie, the
+	 * provider may not have it yet.
+	 */
+	if ( SLAP_MULTIMASTER( op->o_bd ) && sc->numcsns ) {
+		mmf[0].f_choice = LDAP_FILTER_AND;
+		mmf[0].f_and = &mmf[1];
+		mmf[0].f_next = NULL;
+		mmf[1].f_choice = LDAP_FILTER_LE;
+		mmf[1].f_ava = &mmaa;
+		mmf[1].f_av_desc = slap_schema.si_ad_entryCSN;
+		mmf[1].f_next = of;
+		BER_BVZERO( &mmf[1].f_av_value );
+		for ( i=0; i<sc->numcsns; i++ ) {
+			if ( ber_bvcmp( &sc->ctxcsn[i], &mmf[1].f_av_value ) > 0 )
+				mmf[1].f_av_value = sc->ctxcsn[i];
+		}
+		op->ors_filter = mmf;
+	}
+	filter2bv_x( op, op->ors_filter, &op->ors_filterstr );
+
+	op->o_nocaching = 1;
+	be->be_search( op, &rs_search );
+	op->o_nocaching = 0;
+
+	filter_free_x( op, of, 1 );
+	op->o_tmpfree( op->ors_filterstr.bv_val, op->o_tmpmemctx );
+	op->ors_filter = NULL;
+	BER_BVZERO( &op->ors_filterstr );
+
+	return rs_search.sr_err;
+}
+
+/*
+ * A persistent refresh keeps its search running on si_ld, so the
+ * digests are asked for over a connection of their own.
+ */
+static int
+syncrepl_digest_connect(
+	syncinfo_t *si,
+	LDAP **ldp )
+{
+	int rc;
+
+	rc = slap_client_connect( ldp, &si->si_bindconf );
+	if ( rc != LDAP_SUCCESS )
+		return rc;
+
+	ldap_set_option( *ldp, LDAP_OPT_TIMELIMIT, &si->si_tlimit );
+	rc = LDAP_DEREF_NEVER;
+	ldap_set_option( *ldp, LDAP_OPT_DEREF, &rc );
+	ldap_set_option( *ldp, LDAP_OPT_REFERRALS, LDAP_OPT_OFF );
+	return LDAP_SUCCESS;
+}
+
+/* Ask the provider for the same digest */
+static int
+syncrepl_digest_remote(
+	syncinfo_t *si,
+	LDAP *ld,
+	sync_digest *sd )
+{
+	LDAPControl c[2], *ctrls[3], **rctrls = NULL, *ctrl;
+	LDAPMessage *res = NULL;
+	char *attrs[] = { LDAP_NO_ATTRS, NULL };
+	int rc, err;
+
+	rc = slap_sync_digest_request( sd, &c[0].ldctl_value );
+	if ( rc != LDAP_SUCCESS )
+		return rc;
+
+	/* critical, or an old provider would send us all the entries */
+	c[0].ldctl_oid = LDAP_CONTROL_X_SYNC_DIGEST;
+	c[0].ldctl_iscritical = 1;
+	ctrls[0] = &c[0];
+	if ( !BER_BVISNULL( &si->si_bindconf.sb_authzId ) ) {
+		c[1].ldctl_oid = LDAP_CONTROL_PROXY_AUTHZ;
+		c[1].ldctl_value = si->si_bindconf.sb_authzId;
+		c[1].ldctl_iscritical = 1;
+		ctrls[1] = &c[1];
+		ctrls[2] = NULL;
+	} else {
+		ctrls[1] = NULL;
+	}
+
+	rc = ldap_search_ext_s( ld, si->si_base.bv_val, si->si_scope,
+		si->si_filterstr.bv_val, attrs, 0, ctrls, NULL, NULL,
+		LDAP_NO_LIMIT, &res );
+	ber_memfree( c[0].ldctl_value.bv_val );
+
+	if ( rc == LDAP_SUCCESS ) {
+		rc = ldap_parse_result( ld, res, &err, NULL, NULL, NULL,
+			&rctrls, 0 );
+		if ( rc == LDAP_SUCCESS )
+			rc = err;
+	}
+	if ( rc == LDAP_SUCCESS ) {
+		ctrl = ldap_control_find( LDAP_CONTROL_X_SYNC_DIGEST, rctrls, NULL );
+		if ( ctrl ) {
+			rc = slap_sync_digest_parse_response( &ctrl->ldctl_value, sd );
+		} else {
+			rc = LDAP_PROTOCOL_ERROR;
+		}
+	}
+
+	if ( rctrls )
+		ldap_controls_free( rctrls );
+	if ( res )
+		ldap_msgfree( res );
+	return rc;
+}
+
+static int
+syncrepl_digest_reconcile(
+	Operation *op,
+	syncinfo_t *si,
+	struct sync_cookie *sc,
+	int m )
+{
+	digest_prefixes cur = { 0 }, next = { 0 }, leaves = { 0 }, tmp;
+	struct berval pv[SLAP_SYNC_DIGEST_MAXPREFIXES];
+	sync_digest ours, theirs;
+	LDAP *ld = si->si_ld;
+	char *dels = NULL;
+	int ndel = 0, maxdel = 0, nranges = 0, level = 0;
+	int i, j, k, n, rc = LDAP_SUCCESS;
+
+	si->si_digest_last = slap_get_time();
+	if ( si->si_type == LDAP_SYNC_REFRESH_AND_PERSIST ) {
+		ld = NULL;
+		rc = syncrepl_digest_connect( si, &ld );
+		if ( rc != LDAP_SUCCESS ) {
+			/* not the provider's fault, try again on the next refresh */
+			Debug( LDAP_DEBUG_ANY, "syncrepl_digest_reconcile: %s "
+				"could not connect for the digests (%d)\n",
+				si->si_ridtxt, rc );
+			return rc;
+		}
+	}
+
+	/* start with the whole entryUUID space */
+	cur.dp_num = 1;
+
+	while ( cur.dp_num && rc == LDAP_SUCCESS ) {
+		next.dp_len = leaves.dp_len = cur.dp_len + 1;
+		next.dp_num = leaves.dp_num = 0;
+		level++;
+
+		for ( i = 0; i < cur.dp_num && rc == LDAP_SUCCESS; i += n ) {
+			n = cur.dp_num - i;
+			if ( n > SLAP_SYNC_DIGEST_MAXPREFIXES )
+				n = SLAP_SYNC_DIGEST_MAXPREFIXES;
+			for ( k = 0; k < n; k++ ) {
+				pv[k].bv_len = cur.dp_len;
+				pv[k].bv_val = cur.dp_len ?
+					cur.dp_buf + ( i + k ) * cur.dp_len : "";
+			}
+
+			memset( &ours, 0, sizeof( ours ));
+			ours.sd_plen = cur.dp_len;
+			ours.sd_nprefixes = n;
+			ours.sd_prefixes = pv;
+			theirs = ours;
+			slap_sync_digest_init( &ours, NULL );
+			slap_sync_digest_init( &theirs, NULL );
+
+			rc = syncrepl_digest_remote( si, ld, &theirs );
+			if ( rc == LDAP_SUCCESS )
+				rc = syncrepl_digest_local( op, si, sc, &ours );
+
+			for ( k = 0; k < n * 256 && rc == LDAP_SUCCESS; k++ ) {
+				sync_digest_bucket *b1 = &ours.sd_buckets[k],
+					*b2 = &theirs.sd_buckets[k];
+
+				nranges++;
+				/* nothing of ours to delete there */
+				if ( !b1->sdb_count )
+					continue;
+				if ( b1->sdb_count == b2->sdb_count &&
+					!memcmp( b1->sdb_sum, b2->sdb_sum, SLAP_SYNC_DIGEST_LEN ))
+					continue;
+				if ( next.dp_len == UUIDLEN || ( b1->sdb_count <= SYNC_DIGEST_LEAF
+					&& b2->sdb_count <= SYNC_DIGEST_LEAF ))
+					digest_prefix_add( &leaves, &pv[k / 256], k % 256 );
+				else
+					digest_prefix_add( &next, &pv[k / 256], k % 256 );
+			}
+			slap_sync_digest_free( &ours );
+			slap_sync_digest_free( &theirs );
+		}
+
+		for ( i = 0; i < leaves.dp_num && rc == LDAP_SUCCESS; i += n ) {
+			n = leaves.dp_num - i;
+			if ( n > SLAP_SYNC_DIGEST_MAXPREFIXES )
+				n = SLAP_SYNC_DIGEST_MAXPREFIXES;
+			for ( k = 0; k < n; k++ ) {
+				pv[k].bv_len = leaves.dp_len;
+				pv[k].bv_val = leaves.dp_buf + ( i + k ) * leaves.dp_len;
+			}
+
+			memset( &ours, 0, sizeof( ours ));
+			ours.sd_list = 1;
+			ours.sd_plen = leaves.dp_len;
+			ours.sd_nprefixes = n;
+			ours.sd_prefixes = pv;
+			theirs = ours;
+			slap_sync_digest_init( &ours, NULL );
+			slap_sync_digest_init( &theirs, NULL );
+
+			rc = syncrepl_digest_remote( si, ld, &theirs );
+			if ( rc == LDAP_SUCCESS )
+				rc = syncrepl_digest_local( op, si, sc, &ours );
+			if ( rc == LDAP_SUCCESS ) {
+				qsort( theirs.sd_uuids, theirs.sd_nuuids, UUIDLEN,
+					digest_uuid_cmp );
+				for ( j = 0; j < ours.sd_nuuids; j++ ) {
+					char *uuid = ours.sd_uuids + j * UUIDLEN;
+
+					if ( bsearch( uuid, theirs.sd_uuids, theirs.sd_nuuids,
+						UUIDLEN, digest_uuid_cmp ))
+						continue;
+					if ( ndel == maxdel ) {
+						maxdel = maxdel ? maxdel * 2 : 64;
+						dels = ch_realloc( dels, maxdel * UUIDLEN );
+					}
+					AC_MEMCPY( dels + ndel * UUIDLEN, uuid, UUIDLEN );
+					ndel++;
+				}
+			}
+			slap_sync_digest_free( &ours );
+			slap_sync_digest_free( &theirs );
+		}
+
+		tmp = cur;
+		cur = next;
+		next = tmp;
+	}
+
+	Debug( LDAP_DEBUG_SYNC, "syncrepl_digest_reconcile: %s "
+		"compared %d ranges in %d levels, %d entries to delete (%d)\n",
+		si->si_ridtxt, nranges, level, ndel, rc );
+
+	if ( rc == LDAP_SUCCESS && ndel ) {
+		BerVarray uuids = ch_malloc( ( ndel + 1 ) * sizeof( struct berval ));
+
+		for ( i = 0; i < ndel; i++ ) {
+			uuids[i].bv_val = dels + i * UUIDLEN;
+			uuids[i].bv_len = UUIDLEN;
+		}
+		BER_BVZERO( &uuids[ndel] );
+		syncrepl_del_nonpresent( op, si, uuids, sc, m );
+		ch_free( uuids );
+	}
+
+	if ( rc != LDAP_SUCCESS ) {
+		Debug( LDAP_DEBUG_ANY, "syncrepl_digest_reconcile: %s "
+			"digest comparison failed (%d), "
+			"falling back to present phases\n",
+			si->si_ridtxt, rc );
+		si->si_digest_off = 1;
+	}
+
+	if ( ld && ld != si->si_ld )
+		ldap_unbind_ext( ld, NULL, NULL );
+	ch_free( dels );
+	ch_free( cur.dp_buf );
+	ch_free( next.dp_buf );
+	ch_free( leaves.dp_buf );
+	return rc;
+}
+
 static int
 syncrepl_add_glue_ancestors(
 	Operation* op,
@@ -5324,7 +5740,7 @@ nonpresent_callback(
 	syncinfo_t *si = op->o_callback->sc_private;
 	Attribute *a;
 	int count = 0;
-	char *present_uuid = NULL;
+	int present_uuid = 0;
 	struct nonpresent_entry *np_entry;
 
 	if ( rs->sr_type == REP_RESULT ) {
@@ -5349,16 +5765,13 @@ nonpresent_callback(
 			if ( a == NULL ) return 0;
 		}
 
-		if ( present_uuid == NULL ) {
+		if ( !present_uuid ) {
 			np_entry = (struct nonpresent_entry *)
 				ch_calloc( 1, sizeof( struct nonpresent_entry ) );
 			np_entry->npe_name = ber_dupbv( NULL, &rs->sr_entry->e_name );
 			np_entry->npe_nname = ber_dupbv( NULL, &rs->sr_entry->e_nname );
 			LDAP_LIST_INSERT_HEAD( &si->si_nonpresentlist, np_entry, npe_link );
 
-		} else {
-			presentlist_delete( &si->si_presentlist, &a->a_nvals[0] );
-			ch_free( present_uuid );
 		}
 	}
 	return LDAP_SUCCESS;
@@ -5467,16 +5880,6 @@ done:;
 	return new;
 }
 
-static int
-syncuuid_cmp( const void* v_uuid1, const void* v_uuid2 )
-{
-#ifdef HASHUUID
-	return ( memcmp( v_uuid1, v_uuid2, UUIDLEN-2 ));
-#else
-	return ( memcmp( v_uuid1, v_uuid2, UUIDLEN ));
-#endif
-}
-
 void
 syncinfo_free( syncinfo_t *sie, int free_all )
 {
@@ -5683,6 +6086,7 @@ config_suffixm( ConfigArgs *c, syncinfo_t *si )
 #define SUFFIXMSTR		"suffixmassage"
 #define	STRICT_REFRESH	"strictrefresh"
 #define LAZY_COMMIT		"lazycommit"
+#define SYNCDIGESTSTR	"syncdigest"
 
 /* FIXME: undocumented */
 #define EXATTRSSTR		"exattrs"
@@ -6219,6 +6623,10 @@ parse_syncrepl_line(
 					STRLENOF( LAZY_COMMIT ) ) )
 		{
 			si->si_lazyCommit = 1;
+		} else if ( !strncasecmp( c->argv[ i ], SYNCDIGESTSTR,
+					STRLENOF( SYNCDIGESTSTR ) ) )
+		{
+			si->si_syncdigest = 1;
 		} else if ( !bindconf_parse( c->argv[i], &si->si_bindconf ) ) {
 			si->si_got |= GOT_BINDCONF;
 		} else {
@@ -6643,6 +7051,11 @@ syncrepl_unparse( syncinfo_t *si, struct berval *bv )
 		ptr = lutil_strcopy( ptr, " " LAZY_COMMIT );
 	}
 
+	if ( si->si_syncdigest ) {
+		if ( WHATSLEFT <= STRLENOF( " " SYNCDIGESTSTR ) ) return;
+		ptr = lutil_strcopy( ptr, " " SYNCDIGESTSTR );
+	}
+
 	bc.bv_len = ptr - buf;
 	bc.bv_val = buf;
 	ber_dupbv( bv, &bc );
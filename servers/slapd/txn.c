@@ -364,4 +364,71 @@ txnReturn:
 	return LDAP_SUCCESS;	/* proceed with operation */
 }
 
+
+/*
+ * Make a batch of internal updates in one backend transaction.
+ * apply() is called for each item with the transaction, or with NULL
+ * when the items are made one by one.  Failures the backend reports
+ * before changing anything (a missing entry, a value already there) are
+ * counted and skipped; LDAP_OTHER or LDAP_BUSY may have left the
+ * transaction half done, so it is aborted and the items are made one by
+ * one instead.  Without a transaction capable backend, or within a
+ * client transaction, the items are made one by one right away.
+ * Returns LDAP_SUCCESS if the batch was committed.
+ */
+int
+slap_txn_batch(
+	Operation *op,
+	BackendInfo *bi,
+	void **items,
+	int nitems,
+	SLAP_TXN_APPLY_FN *apply,
+	void *arg,
+	const char *who )
+{
+	OpExtra *txn = NULL;
+	int i, rc = LDAP_OTHER, nfailed = 0;
+
+	if ( nitems < 1 )
+		return LDAP_SUCCESS;
+
+	if ( bi && bi->bi_op_txn && !op->o_txnSpec ) {
+		Operation op2 = *op;
+
+		if ( bi->bi_op_txn( &op2, SLAP_TXN_BEGIN, &txn ) ) {
+			txn = NULL;
+		} else {
+			LDAP_SLIST_REMOVE( &op2.o_extra, txn, OpExtra, oe_next );
+		}
+	}
+
+	if ( txn ) {
+		Operation op2 = *op;
+
+		for ( i = 0; i < nitems; i++ ) {
+			rc = apply( op, items[i], txn, arg );
+			if ( rc == LDAP_OTHER || rc == LDAP_BUSY )
+				break;
+			if ( rc != LDAP_SUCCESS )
+				nfailed++;
+		}
+		if ( i == nitems ) {
+			rc = bi->bi_op_txn( &op2, SLAP_TXN_COMMIT, &txn );
+		} else {
+			bi->bi_op_txn( &op2, SLAP_TXN_ABORT, &txn );
+			rc = LDAP_OTHER;
+		}
+		Debug( LDAP_DEBUG_STATS, "%s %s: %d updates in one "
+			"transaction, %d failed%s\n",
+			op->o_log_prefix, who, nitems, nfailed,
+			rc ? ", rolled back" : "" );
+	}
+
+	if ( rc != LDAP_SUCCESS ) {
+		for ( i = 0; i < nitems; i++ )
+			(void)apply( op, items[i], NULL, arg );
+	}
+	return rc;
+}
+
 #endif /* LDAP_X_TXN */
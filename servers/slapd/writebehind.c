@@ -0,0 +1,469 @@
+/* writebehind.c - deferred writes of volatile operational attributes */
+/* $OpenLDAP$ */
+/* This work is part of OpenLDAP Software <http://www.openldap.org/>.
+ *
+ * Copyright 1998-2020 The OpenLDAP Foundation.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted only as authorized by the OpenLDAP
+ * Public License.
+ *
+ * A copy of this license is available in the file LICENSE in the
+ * top-level directory of the distribution or, alternatively, at
+ * <http://www.OpenLDAP.org/license.html>.
+ */
+
+/*
+ * Overlays such as ppolicy and lastbind record bind state (failure
+ * times, last bind time) with an internal modify for each bind.  A
+ * write-behind store lets them queue those modifications instead.
+ * Modifications are kept per entry, in order, and coalesced: a replace
+ * or a delete of a whole attribute drops what was queued for it before.
+ * Queued changes are written by a runqueue task every interval seconds,
+ * or as soon as more than the configured number of entries are pending,
+ * using a single backend transaction per batch when the backend
+ * supports it.  Either way the writes are made by the task, never by
+ * the operation that queued the change.
+ *
+ * While a batch is being written its changes stay visible to
+ * slap_wb_apply(), which replays the written batch and the newer pending
+ * changes on top of an entry.  Adds and deletes are queued as their
+ * SOFTADD/SOFTDEL variants, so replaying changes the entry already has
+ * is harmless.
+ *
+ * Anything still pending is lost if slapd terminates abnormally; at most
+ * one interval's worth of changes is at stake.
+ */
+
+#include "portable.h"
+
+#include <stdio.h>
+
+#include <ac/string.h>
+
+#include "slap.h"
+#include "ldap_rq.h"
+
+#define	WB_BATCH	256	/* entries per backend transaction */
+
+typedef struct wb_pend {
+	struct berval wp_dn;
+	struct berval wp_ndn;
+	Modifications *wp_mods;
+	Modifications **wp_tail;
+} wb_pend;
+
+struct slap_wb {
+	ldap_pvt_thread_mutex_t wb_mutex;
+	ldap_pvt_thread_cond_t wb_cond;
+	Avlnode *wb_pending;
+	Avlnode *wb_inflight;
+	int wb_npending;
+	int wb_max;
+	int wb_flushing;
+	time_t wb_interval;
+	BackendDB *wb_be;
+	BackendInfo *wb_bi;	/* wb_be's stack as of slap_wb_new() */
+	slap_wb_write_f *wb_write;
+	void *wb_arg;
+	struct re_s *wb_task;
+	OpExtra wb_oe;		/* marks the operations of a flush */
+};
+
+static int
+wb_pend_cmp( const void *v1, const void *v2 )
+{
+	const wb_pend *p1 = v1, *p2 = v2;
+
+	return ber_bvcmp( &p1->wp_ndn, &p2->wp_ndn );
+}
+
+static void
+wb_pend_free( void *v )
+{
+	wb_pend *wp = v;
+
+	if ( wp->wp_mods )
+		slap_mods_free( wp->wp_mods, 1 );
+	ch_free( wp->wp_dn.bv_val );
+	ch_free( wp->wp_ndn.bv_val );
+	ch_free( wp );
+}
+
+static wb_pend *
+wb_find( Avlnode *root, struct berval *ndn )
+{
+	wb_pend wp;
+
+	wp.wp_ndn = *ndn;
+	return avl_find( root, &wp, wb_pend_cmp );
+}
+
+/* Is op part of a flush of this store? */
+static int
+wb_is_flush( slap_wb *wb, Operation *op )
+{
+	OpExtra *oex;
+
+	LDAP_SLIST_FOREACH( oex, &op->o_extra, oe_next ) {
+		if ( oex->oe_key == wb )
+			return 1;
+	}
+	return 0;
+}
+
+static int
+wb_write_one( slap_wb *wb, Operation *op, wb_pend *wp )
+{
+	op->o_req_dn = wp->wp_dn;
+	op->o_req_ndn = wp->wp_ndn;
+	return wb->wb_write( op, wp->wp_mods, wb->wb_arg );
+}
+
+static int
+wb_write_item( Operation *op, void *item, OpExtra *txn, void *arg )
+{
+	slap_wb *wb = arg;
+	wb_pend *wp = item;
+	int rc;
+
+	if ( txn )
+		LDAP_SLIST_INSERT_HEAD( &op->o_extra, txn, oe_next );
+	rc = wb_write_one( wb, op, wp );
+	if ( txn )
+		LDAP_SLIST_REMOVE( &op->o_extra, txn, OpExtra, oe_next );
+	/* unless the transaction is aborted and this is retried */
+	if ( rc != LDAP_SUCCESS &&
+		( !txn || ( rc != LDAP_OTHER && rc != LDAP_BUSY ))) {
+		Debug( LDAP_DEBUG_ANY, "slap_wb_flush: "
+			"update of \"%s\" failed (%d), changes lost\n",
+			wp->wp_dn.bv_val, rc );
+	}
+	return rc;
+}
+
+static int
+wb_collect( void *v, void *arg )
+{
+	void ***wpp = arg;
+
+	*(*wpp)++ = v;
+	return 0;
+}
+
+/* Write everything that was pending. Only one flush runs at a time. */
+static void
+wb_flush( slap_wb *wb, Operation *op )
+{
+	void **list, **wpp;
+	BackendInfo *bi;
+	int i, n;
+
+	ldap_pvt_thread_mutex_lock( &wb->wb_mutex );
+	if ( wb->wb_flushing || !wb->wb_pending ) {
+		ldap_pvt_thread_mutex_unlock( &wb->wb_mutex );
+		return;
+	}
+	wb->wb_flushing = 1;
+	wb->wb_inflight = wb->wb_pending;
+	wb->wb_pending = NULL;
+	n = wb->wb_npending;
+	wb->wb_npending = 0;
+	ldap_pvt_thread_mutex_unlock( &wb->wb_mutex );
+
+	wpp = list = ch_malloc( n * sizeof(void *) );
+	avl_apply( wb->wb_inflight, wb_collect, &wpp, -1, AVL_INORDER );
+
+	wb->wb_oe.oe_key = wb;
+	LDAP_SLIST_INSERT_HEAD( &op->o_extra, &wb->wb_oe, oe_next );
+
+	/* shadows may route these writes elsewhere */
+	bi = SLAP_SHADOW( op->o_bd ) ? NULL : op->o_bd->bd_info;
+
+	for ( i = 0; i < n; i += WB_BATCH ) {
+		(void)slap_txn_batch( op, bi, list + i,
+			n - i < WB_BATCH ? n - i : WB_BATCH,
+			wb_write_item, wb, "slap_wb_flush" );
+	}
+
+	LDAP_SLIST_REMOVE( &op->o_extra, &wb->wb_oe, OpExtra, oe_next );
+	ch_free( list );
+
+	Debug( LDAP_DEBUG_STATS, "slap_wb_flush: %s: wrote %d entries\n",
+		op->o_bd->be_suffix[0].bv_val, n );
+
+	ldap_pvt_thread_mutex_lock( &wb->wb_mutex );
+	avl_free( wb->wb_inflight, wb_pend_free );
+	wb->wb_inflight = NULL;
+	wb->wb_flushing = 0;
+	ldap_pvt_thread_cond_broadcast( &wb->wb_cond );
+	ldap_pvt_thread_mutex_unlock( &wb->wb_mutex );
+}
+
+static void
+wb_op_init( slap_wb *wb, Operation *op, BackendDB *db )
+{
+	/* the database's bd_info is switched around while it is being
+	 * closed, so always enter through the full stack */
+	*db = *wb->wb_be;
+	db->bd_info = wb->wb_bi;
+
+	op->o_tag = LDAP_REQ_MODIFY;
+	op->o_bd = db;
+	op->o_dn = wb->wb_be->be_rootdn;
+	op->o_ndn = wb->wb_be->be_rootndn;
+	/* don't inherit the caller's backend state */
+	LDAP_SLIST_INIT( &op->o_extra );
+}
+
+static void *
+wb_flush_task( void *ctx, void *arg )
+{
+	struct re_s *rtask = arg;
+	slap_wb *wb = rtask->arg;
+	Connection conn = { 0 };
+	OperationBuffer opbuf;
+	Operation *op;
+	BackendDB db;
+
+	connection_fake_init( &conn, &opbuf, ctx );
+	op = &opbuf.ob_op;
+	wb_op_init( wb, op, &db );
+
+	wb_flush( wb, op );
+
+	ldap_pvt_thread_mutex_lock( &slapd_rq.rq_mutex );
+	ldap_pvt_runqueue_stoptask( &slapd_rq, rtask );
+	ldap_pvt_thread_mutex_unlock( &slapd_rq.rq_mutex );
+	return NULL;
+}
+
+/* Create a store for be, flushed every interval seconds and whenever
+ * more than max entries are pending (0 for no limit).
+ */
+slap_wb *
+slap_wb_new( BackendDB *be, time_t interval, int max,
+	slap_wb_write_f *wr, void *arg )
+{
+	slap_wb *wb;
+
+	wb = ch_calloc( 1, sizeof(slap_wb) );
+	ldap_pvt_thread_mutex_init( &wb->wb_mutex );
+	ldap_pvt_thread_cond_init( &wb->wb_cond );
+	wb->wb_interval = interval;
+	wb->wb_max = max;
+	wb->wb_be = be;
+	wb->wb_bi = be->bd_info;
+	wb->wb_write = wr;
+	wb->wb_arg = arg;
+
+	ldap_pvt_thread_mutex_lock( &slapd_rq.rq_mutex );
+	wb->wb_task = ldap_pvt_runqueue_insert( &slapd_rq, interval,
+		wb_flush_task, wb, "slap_wb_flush", be->be_suffix[0].bv_val );
+	ldap_pvt_thread_mutex_unlock( &slapd_rq.rq_mutex );
+
+	return wb;
+}
+
+/* Flush everything and release the store */
+void
+slap_wb_free( slap_wb *wb )
+{
+	Connection conn = { 0 };
+	OperationBuffer opbuf;
+	Operation *op;
+	BackendDB db;
+
+	ldap_pvt_thread_mutex_lock( &slapd_rq.rq_mutex );
+	if ( ldap_pvt_runqueue_isrunning( &slapd_rq, wb->wb_task ))
+		ldap_pvt_runqueue_stoptask( &slapd_rq, wb->wb_task );
+	ldap_pvt_runqueue_remove( &slapd_rq, wb->wb_task );
+	ldap_pvt_thread_mutex_unlock( &slapd_rq.rq_mutex );
+
+	/* wait for a flush started by another thread */
+	ldap_pvt_thread_mutex_lock( &wb->wb_mutex );
+	while ( wb->wb_flushing )
+		ldap_pvt_thread_cond_wait( &wb->wb_cond, &wb->wb_mutex );
+	ldap_pvt_thread_mutex_unlock( &wb->wb_mutex );
+
+	if ( wb->wb_pending ) {
+		connection_fake_init2( &conn, &opbuf,
+			ldap_pvt_thread_pool_context(), 0 );
+		op = &opbuf.ob_op;
+		wb_op_init( wb, op, &db );
+		wb_flush( wb, op );
+	}
+
+	ldap_pvt_thread_cond_destroy( &wb->wb_cond );
+	ldap_pvt_thread_mutex_destroy( &wb->wb_mutex );
+	ch_free( wb );
+}
+
+/* Queue ml for op->o_req_ndn. The store takes ownership of ml. */
+void
+slap_wb_queue( slap_wb *wb, Operation *op, Modifications *ml )
+{
+	wb_pend *wp, wpkey;
+	Modifications *m, **mp, *next;
+	int flush = 0;
+
+	for ( m = ml; m; m = m->sml_next ) {
+		if ( m->sml_op == LDAP_MOD_ADD )
+			m->sml_op = SLAP_MOD_SOFTADD;
+		else if ( m->sml_op == LDAP_MOD_DELETE )
+			m->sml_op = SLAP_MOD_SOFTDEL;
+	}
+
+	ldap_pvt_thread_mutex_lock( &wb->wb_mutex );
+	wpkey.wp_ndn = op->o_req_ndn;
+	wp = avl_find( wb->wb_pending, &wpkey, wb_pend_cmp );
+	if ( !wp ) {
+		wp = ch_calloc( 1, sizeof(wb_pend) );
+		ber_dupbv( &wp->wp_dn, &op->o_req_dn );
+		ber_dupbv( &wp->wp_ndn, &op->o_req_ndn );
+		wp->wp_tail = &wp->wp_mods;
+		avl_insert( &wb->wb_pending, wp, wb_pend_cmp, avl_dup_error );
+		if ( ++wb->wb_npending > wb->wb_max && wb->wb_max > 0 &&
+			!wb->wb_flushing )
+			flush = 1;
+	}
+
+	for ( ; ml; ml = next ) {
+		next = ml->sml_next;
+		ml->sml_next = NULL;
+
+		/* a replace or a full delete supersedes earlier changes */
+		if ( ml->sml_op == LDAP_MOD_REPLACE || !ml->sml_values ) {
+			for ( mp = &wp->wp_mods; *mp; ) {
+				m = *mp;
+				if ( m->sml_desc == ml->sml_desc ) {
+					*mp = m->sml_next;
+					m->sml_next = NULL;
+					slap_mods_free( m, 1 );
+				} else {
+					mp = &m->sml_next;
+				}
+			}
+			for ( wp->wp_tail = &wp->wp_mods; *wp->wp_tail;
+				wp->wp_tail = &(*wp->wp_tail)->sml_next )
+				;
+		}
+		*wp->wp_tail = ml;
+		wp->wp_tail = &ml->sml_next;
+	}
+	ldap_pvt_thread_mutex_unlock( &wb->wb_mutex );
+
+	/* leave the writing to the task, not to this operation's thread */
+	if ( flush ) {
+		ldap_pvt_thread_mutex_lock( &slapd_rq.rq_mutex );
+		if ( !ldap_pvt_runqueue_isrunning( &slapd_rq, wb->wb_task )) {
+			wb->wb_task->interval.tv_sec = 0;
+			ldap_pvt_runqueue_resched( &slapd_rq, wb->wb_task, 0 );
+			wb->wb_task->interval.tv_sec = wb->wb_interval;
+		} else {
+			flush = 0;
+		}
+		ldap_pvt_thread_mutex_unlock( &slapd_rq.rq_mutex );
+		if ( flush )
+			slap_wake_listener();
+	}
+}
+
+/* Write any changes queued for op->o_req_ndn now, in the caller's
+ * context. Waits for a running flush that holds older changes for
+ * the same entry, so that changes are applied in order.
+ */
+int
+slap_wb_flush_dn( slap_wb *wb, Operation *op )
+{
+	wb_pend *wp;
+	Operation op2;
+	BackendDB db;
+	int rc;
+
+	if ( wb_is_flush( wb, op ))
+		return LDAP_SUCCESS;
+
+	ldap_pvt_thread_mutex_lock( &wb->wb_mutex );
+	while ( wb->wb_inflight && wb_find( wb->wb_inflight, &op->o_req_ndn ))
+		ldap_pvt_thread_cond_wait( &wb->wb_cond, &wb->wb_mutex );
+	wp = wb_find( wb->wb_pending, &op->o_req_ndn );
+	if ( wp ) {
+		avl_delete( &wb->wb_pending, wp, wb_pend_cmp );
+		wb->wb_npending--;
+	}
+	ldap_pvt_thread_mutex_unlock( &wb->wb_mutex );
+
+	if ( !wp )
+		return LDAP_SUCCESS;
+
+	op2 = *op;
+	wb_op_init( wb, &op2, &db );
+	rc = wb_write_one( wb, &op2, wp );
+	wb_pend_free( wp );
+	return rc;
+}
+
+static int
+wb_apply_mods( Entry *e, Modifications *ml )
+{
+	Modification mod;
+	const char *text;
+	char textbuf[SLAP_TEXT_BUFLEN];
+	int rc = LDAP_SUCCESS;
+
+	/* the soft variants are applied as the plain ones, permissively */
+	for ( ; ml && rc == LDAP_SUCCESS; ml = ml->sml_next ) {
+		mod = ml->sml_mod;
+		switch ( mod.sm_op ) {
+		case LDAP_MOD_ADD:
+		case SLAP_MOD_SOFTADD:
+			mod.sm_op = LDAP_MOD_ADD;
+			rc = modify_add_values( e, &mod, 1,
+				&text, textbuf, sizeof( textbuf ));
+			break;
+		case LDAP_MOD_DELETE:
+		case SLAP_MOD_SOFTDEL:
+			mod.sm_op = LDAP_MOD_DELETE;
+			rc = modify_delete_values( e, &mod, 1,
+				&text, textbuf, sizeof( textbuf ));
+			break;
+		case LDAP_MOD_REPLACE:
+			rc = modify_replace_values( e, &mod, 1,
+				&text, textbuf, sizeof( textbuf ));
+			break;
+		}
+	}
+	return rc;
+}
+
+/* Does the store hold any change for ndn? */
+int
+slap_wb_pending( slap_wb *wb, struct berval *ndn )
+{
+	int rc;
+
+	ldap_pvt_thread_mutex_lock( &wb->wb_mutex );
+	rc = ( wb->wb_inflight && wb_find( wb->wb_inflight, ndn )) ||
+		( wb->wb_pending && wb_find( wb->wb_pending, ndn ));
+	ldap_pvt_thread_mutex_unlock( &wb->wb_mutex );
+	return rc;
+}
+
+/* Apply the changes held for e to it; e must be modifiable */
+int
+slap_wb_apply( slap_wb *wb, Entry *e )
+{
+	wb_pend *wp;
+	int rc = LDAP_SUCCESS;
+
+	ldap_pvt_thread_mutex_lock( &wb->wb_mutex );
+	if ( wb->wb_inflight && ( wp = wb_find( wb->wb_inflight, &e->e_nname )))
+		rc = wb_apply_mods( e, wp->wp_mods );
+	if ( rc == LDAP_SUCCESS && wb->wb_pending &&
+		( wp = wb_find( wb->wb_pending, &e->e_nname )))
+		rc = wb_apply_mods( e, wp->wp_mods );
+	ldap_pvt_thread_mutex_unlock( &wb->wb_mutex );
+	return rc;
+}
@@ -28,6 +28,7 @@ typedef enum {
 	TESTER_MODRDN,
 	TESTER_READ,
 	TESTER_SEARCH,
+	TESTER_LOAD,
 	TESTER_LAST
 } tester_t;
 
@@ -0,0 +1,715 @@
+/* $OpenLDAP$ */
+/* This work is part of OpenLDAP Software <http://www.openldap.org/>.
+ *
+ * Copyright 1999-2020 The OpenLDAP Foundation.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted only as authorized by the OpenLDAP
+ * Public License.
+ *
+ * A copy of this license is available in file LICENSE in the
+ * top-level directory of the distribution or, alternatively, at
+ * <http://www.OpenLDAP.org/license.html>.
+ */
+
+/*
+ * This tool is an open-loop load generator.  Unlike the other testers
+ * it does not wait for one operation before sending the next: each
+ * thread sends a mix of operations on its own connections at a fixed
+ * rate, with up to a given number outstanding per connection, for a
+ * given time, and reports the throughput and the latency distribution
+ * of each kind of operation.
+ *
+ * Latency is measured from the time an operation was due to be sent,
+ * so time spent waiting for a free slot when the server falls behind
+ * is included rather than hidden.  Without -q the operations are sent
+ * as fast as the pipelines allow and latency runs from the actual send.
+ *
+ * A "%d" in the filter or the entry DN is replaced by a random number
+ * below the -n range for each operation.
+ */
+
+#include "portable.h"
+
+#include <stdio.h>
+#include "ldap_pvt_thread.h"
+
+#include "ac/stdlib.h"
+
+#include "ac/ctype.h"
+#include "ac/param.h"
+#include "ac/socket.h"
+#include "ac/string.h"
+#include "ac/time.h"
+#include "ac/unistd.h"
+
+#include "ldap.h"
+#include "lutil.h"
+
+#include "ldap_pvt.h"
+
+#include "slapd-common.h"
+
+#define MAX_THREAD	256
+#define MAX_DEPTH	1024
+#define DEFAULT_SECONDS	10
+#define DEFAULT_MIX	"search"
+#define LOAD_LATE_US	1000
+
+enum {
+	LOAD_SEARCH,
+	LOAD_READ,
+	LOAD_MODIFY,
+	LOAD_LAST
+};
+
+static const char *load_names[] = { "search", "read", "modify" };
+
+/*
+ * Latency histogram in microseconds: values below HIST_SUB have a
+ * bucket each, above that every power of 2 is split into HIST_SUB
+ * buckets, which keeps the error of a percentile below 1/HIST_SUB.
+ */
+#define HIST_SHIFT	4
+#define HIST_SUB	(1 << HIST_SHIFT)
+#define HIST_BUCKETS	(HIST_SUB * ( sizeof(unsigned long) * 8 - HIST_SHIFT + 1 ))
+
+typedef struct load_hist {
+	unsigned long	lh_count[HIST_BUCKETS];
+	unsigned long	lh_ops;
+	unsigned long	lh_errors;
+	unsigned long	lh_max;
+	double		lh_sum;
+} load_hist;
+
+typedef struct load_slot {
+	int		ls_msgid;	/* -1 if free */
+	int		ls_type;
+	struct timeval	ls_due;
+} load_slot;
+
+typedef struct load_conn {
+	LDAP		*lc_ld;
+	int		lc_outstanding;
+	load_slot	*lc_slots;
+} load_conn;
+
+typedef struct load_thread {
+	ldap_pvt_thread_t	lt_tid;
+	int		lt_idx;
+	int		lt_nconns;
+	load_conn	*lt_conns;
+	unsigned long	lt_rand;
+	unsigned long	lt_late;	/* operations sent behind schedule */
+	load_hist	lt_hist[LOAD_LAST];
+} load_thread;
+
+/*
+ * Shared globals (command line args)
+ */
+static struct tester_conn_args	*config;
+static char		*base = NULL;
+static char		*entry = NULL;
+static char		*filter = NULL;
+static char		*srchattrs[] = { "1.1", NULL };
+static char		**attrs = srchattrs;
+static int		range = 0;
+static int		threads = 1;
+static int		noconns = 1;
+static int		depth = 1;
+static double		rate = 0;	/* total ops/sec, 0 = unthrottled */
+static int		seconds = DEFAULT_SECONDS;
+static int		mix[LOAD_LAST];
+static int		mixtotal;
+static struct timeval	start, stop;
+
+static void
+usage( char *name, char opt )
+{
+	if ( opt ) {
+		fprintf( stderr, "%s: unable to handle option \'%c\'\n\n",
+			name, opt );
+	}
+
+	fprintf( stderr, "usage: %s " TESTER_COMMON_HELP
+		"[-b <base>] "
+		"[-e <entry>] "
+		"[-f <filter>] "
+		"[-c <connections per thread>] "
+		"[-m <threads>] "
+		"[-P <outstanding per connection>] "
+		"[-q <ops per second>] "
+		"[-n <range>] "
+		"[-s <seconds>] "
+		"[-M <op>[:<weight>][,...]] "
+		"[-T <attrs>] "
+		"\n",
+		name );
+	fprintf( stderr, "\top is one of search, read, modify\n" );
+	exit( EXIT_FAILURE );
+}
+
+static int
+parse_mix( char *arg )
+{
+	char **ops, *p;
+	int i, j, w;
+
+	ops = ldap_str2charray( arg, "," );
+	if ( ops == NULL )
+		return -1;
+
+	memset( mix, 0, sizeof( mix ));
+	mixtotal = 0;
+	for ( i = 0; ops[i]; i++ ) {
+		w = 1;
+		p = strchr( ops[i], ':' );
+		if ( p ) {
+			*p++ = '\0';
+			if ( lutil_atoi( &w, p ) != 0 || w < 0 )
+				goto bad;
+		}
+		for ( j = 0; j < LOAD_LAST; j++ ) {
+			if ( strcasecmp( ops[i], load_names[j] ) == 0 )
+				break;
+		}
+		if ( j == LOAD_LAST )
+			goto bad;
+		mix[j] += w;
+		mixtotal += w;
+	}
+	ldap_charray_free( ops );
+	return mixtotal > 0 ? 0 : -1;
+
+bad:
+	ldap_charray_free( ops );
+	return -1;
+}
+
+static long
+tv_diff_us( struct timeval *a, struct timeval *b )
+{
+	return ( a->tv_sec - b->tv_sec ) * 1000000L +
+		( a->tv_usec - b->tv_usec );
+}
+
+static void
+tv_add_us( struct timeval *tv, long us )
+{
+	tv->tv_usec += us;
+	tv->tv_sec += tv->tv_usec / 1000000L;
+	tv->tv_usec %= 1000000L;
+}
+
+static unsigned long
+load_rand( load_thread *lt )
+{
+	/* xorshift, each thread has its own state */
+	lt->lt_rand ^= lt->lt_rand << 13;
+	lt->lt_rand ^= lt->lt_rand >> 7;
+	lt->lt_rand ^= lt->lt_rand << 17;
+	return lt->lt_rand;
+}
+
+static int
+hist_bucket( unsigned long v )
+{
+	int msb = 0;
+
+	if ( v < HIST_SUB )
+		return v;
+	while ( v >> ( msb + 1 ))
+		msb++;
+	return ( msb - HIST_SHIFT + 1 ) * HIST_SUB +
+		(( v >> ( msb - HIST_SHIFT )) & ( HIST_SUB - 1 ));
+}
+
+/* the largest value that falls in bucket b */
+static unsigned long
+hist_value( int b )
+{
+	int msb;
+
+	if ( b < HIST_SUB )
+		return b;
+	msb = b / HIST_SUB + HIST_SHIFT - 1;
+	return (( (unsigned long)( HIST_SUB + b % HIST_SUB ) + 1 )
+		<< ( msb - HIST_SHIFT )) - 1;
+}
+
+static void
+hist_add( load_hist *h, long us, int err )
+{
+	if ( us < 0 )
+		us = 0;
+	h->lh_count[hist_bucket( us )]++;
+	h->lh_ops++;
+	h->lh_sum += us;
+	if ( (unsigned long)us > h->lh_max )
+		h->lh_max = us;
+	if ( err )
+		h->lh_errors++;
+}
+
+static void
+hist_merge( load_hist *to, load_hist *from )
+{
+	int i;
+
+	for ( i = 0; i < HIST_BUCKETS; i++ )
+		to->lh_count[i] += from->lh_count[i];
+	to->lh_ops += from->lh_ops;
+	to->lh_errors += from->lh_errors;
+	to->lh_sum += from->lh_sum;
+	if ( from->lh_max > to->lh_max )
+		to->lh_max = from->lh_max;
+}
+
+static unsigned long
+hist_percentile( load_hist *h, double pct )
+{
+	unsigned long want, seen = 0;
+	int i;
+
+	if ( !h->lh_ops )
+		return 0;
+	want = h->lh_ops * pct / 100.0;
+	if ( want >= h->lh_ops )
+		want = h->lh_ops - 1;
+	for ( i = 0; i < HIST_BUCKETS; i++ ) {
+		seen += h->lh_count[i];
+		if ( seen > want )
+			break;
+	}
+	return hist_value( i ) < h->lh_max ? hist_value( i ) : h->lh_max;
+}
+
+/* copy tmpl into buf, with its first "%d" replaced by n */
+static char *
+fill_template( char *buf, size_t len, const char *tmpl, int n )
+{
+	const char *p = range ? strstr( tmpl, "%d" ) : NULL;
+
+	if ( p == NULL )
+		return (char *)tmpl;
+	snprintf( buf, len, "%.*s%d%s", (int)( p - tmpl ), tmpl, n, p + 2 );
+	return buf;
+}
+
+static int
+pick_type( load_thread *lt )
+{
+	int i, r = load_rand( lt ) % mixtotal;
+
+	for ( i = 0; i < LOAD_LAST; i++ ) {
+		r -= mix[i];
+		if ( r < 0 )
+			break;
+	}
+	return i;
+}
+
+static int
+send_op( load_thread *lt, load_conn *lc, int type, int *msgidp )
+{
+	char buf[BUFSIZ];
+	int n = range ? load_rand( lt ) % range : 0;
+
+	switch ( type ) {
+	case LOAD_SEARCH:
+		return ldap_search_ext( lc->lc_ld, base, LDAP_SCOPE_SUBTREE,
+			fill_template( buf, sizeof( buf ), filter, n ),
+			attrs, 0, NULL, NULL, NULL, LDAP_NO_LIMIT, msgidp );
+
+	case LOAD_READ:
+		return ldap_search_ext( lc->lc_ld,
+			fill_template( buf, sizeof( buf ), entry, n ),
+			LDAP_SCOPE_BASE, NULL,
+			attrs, 0, NULL, NULL, NULL, LDAP_NO_LIMIT, msgidp );
+
+	case LOAD_MODIFY: {
+		char val[64];
+		char *vals[2] = { val, NULL };
+		LDAPMod mod = { LDAP_MOD_REPLACE, "description", { vals } };
+		LDAPMod *mods[2] = { &mod, NULL };
+
+		snprintf( val, sizeof( val ), "slapd-load %d %lu",
+			lt->lt_idx, load_rand( lt ) % 1000000 );
+		return ldap_modify_ext( lc->lc_ld,
+			fill_template( buf, sizeof( buf ), entry, n ),
+			mods, NULL, NULL, msgidp );
+		}
+	}
+	return LDAP_PARAM_ERROR;
+}
+
+/* collect whatever results are ready on lc; returns how many operations
+ * completed, or -1 if the connection failed */
+static int
+reap( load_thread *lt, load_conn *lc )
+{
+	struct timeval zero = { 0, 0 }, now;
+	LDAPMessage *res;
+	int rc, i, done = 0;
+
+	while ( lc->lc_outstanding ) {
+		rc = ldap_result( lc->lc_ld, LDAP_RES_ANY, LDAP_MSG_ONE, &zero, &res );
+		if ( rc == 0 )
+			break;
+		if ( rc < 0 ) {
+			tester_ldap_error( lc->lc_ld, "ldap_result", NULL );
+			return -1;
+		}
+		if ( rc == LDAP_RES_SEARCH_ENTRY || rc == LDAP_RES_SEARCH_REFERENCE ||
+			rc == LDAP_RES_INTERMEDIATE ) {
+			ldap_msgfree( res );
+			continue;
+		}
+
+		gettimeofday( &now, NULL );
+		for ( i = 0; i < depth; i++ ) {
+			if ( lc->lc_slots[i].ls_msgid == ldap_msgid( res ))
+				break;
+		}
+		if ( i < depth ) {
+			load_slot *ls = &lc->lc_slots[i];
+			int err = LDAP_OTHER;
+
+			ldap_parse_result( lc->lc_ld, res, &err, NULL, NULL, NULL, NULL, 0 );
+			hist_add( &lt->lt_hist[ls->ls_type],
+				tv_diff_us( &now, &ls->ls_due ),
+				err != LDAP_SUCCESS && !tester_ignore_err( err ));
+			ls->ls_msgid = -1;
+			lc->lc_outstanding--;
+			done++;
+		}
+		ldap_msgfree( res );
+	}
+	return done;
+}
+
+static void *
+do_onethread( void *arg )
+{
+	load_thread *lt = arg;
+	struct timeval now, due;
+	long interval = 0;
+	int i, j, next = 0, failed = 0;
+
+	if ( rate > 0 )
+		interval = 1000000.0 * threads / rate;
+
+	/* spread the threads' schedules over one interval */
+	due = start;
+	tv_add_us( &due, interval * lt->lt_idx / threads );
+
+	for (;;) {
+		int busy = 0;
+
+		gettimeofday( &now, NULL );
+		if ( tv_diff_us( &now, &stop ) >= 0 )
+			break;
+
+		/* send everything that is due, while there is room */
+		while ( !interval || tv_diff_us( &now, &due ) >= 0 ) {
+			load_conn *lc = NULL;
+
+			for ( i = 0; i < lt->lt_nconns; i++ ) {
+				lc = &lt->lt_conns[( next + i ) % lt->lt_nconns];
+				if ( lc->lc_outstanding < depth )
+					break;
+			}
+			if ( i == lt->lt_nconns )
+				break;
+			next = ( next + i + 1 ) % lt->lt_nconns;
+
+			for ( j = 0; lc->lc_slots[j].ls_msgid != -1; j++ )
+				/* empty */ ;
+			lc->lc_slots[j].ls_type = pick_type( lt );
+			lc->lc_slots[j].ls_due = interval ? due : now;
+			if ( send_op( lt, lc, lc->lc_slots[j].ls_type,
+					&lc->lc_slots[j].ls_msgid ) != LDAP_SUCCESS ) {
+				tester_ldap_error( lc->lc_ld, "send", NULL );
+				lc->lc_slots[j].ls_msgid = -1;
+				failed = 1;
+				break;
+			}
+			lc->lc_outstanding++;
+			busy = 1;
+			if ( interval ) {
+				if ( tv_diff_us( &now, &due ) > LOAD_LATE_US )
+					lt->lt_late++;
+				tv_add_us( &due, interval );
+			}
+		}
+		if ( failed )
+			break;
+
+		for ( i = 0; i < lt->lt_nconns; i++ ) {
+			int rc = reap( lt, &lt->lt_conns[i] );
+			if ( rc < 0 ) {
+				failed = 1;
+				break;
+			}
+			if ( rc > 0 )
+				busy = 1;
+		}
+		if ( failed )
+			break;
+
+		if ( !busy ) {
+			/* nothing happened, wait a little, but not past
+			 * the next send */
+			struct timeval tv = { 0, 200 };
+
+			gettimeofday( &now, NULL );
+			if ( interval && tv_diff_us( &due, &now ) < tv.tv_usec )
+				tv.tv_usec = tv_diff_us( &due, &now ) > 0 ?
+					tv_diff_us( &due, &now ) : 0;
+			select( 0, NULL, NULL, NULL, &tv );
+		}
+	}
+
+	/* let the outstanding operations finish, but not forever */
+	gettimeofday( &due, NULL );
+	tv_add_us( &due, 5000000L );
+	for (;;) {
+		int left = 0;
+
+		for ( i = 0; i < lt->lt_nconns; i++ ) {
+			if ( !failed && reap( lt, &lt->lt_conns[i] ) < 0 )
+				failed = 1;
+			left += lt->lt_conns[i].lc_outstanding;
+		}
+		gettimeofday( &now, NULL );
+		if ( !left || failed || tv_diff_us( &now, &due ) >= 0 )
+			break;
+		{
+			struct timeval tv = { 0, 1000 };
+			select( 0, NULL, NULL, NULL, &tv );
+		}
+	}
+
+	return failed ? (void *)lt : NULL;
+}
+
+static void
+report( const char *name, load_hist *h, double secs )
+{
+	printf( "%-8s %10lu %8lu %10.1f %10.1f %9lu %9lu %9lu %9lu\n",
+		name, h->lh_ops, h->lh_errors, h->lh_ops / secs,
+		h->lh_ops ? h->lh_sum / h->lh_ops : 0.0,
+		hist_percentile( h, 50 ), hist_percentile( h, 99 ),
+		hist_percentile( h, 99.9 ), h->lh_max );
+}
+
+int
+main( int argc, char **argv )
+{
+	int		i, j;
+	load_thread	*lts;
+	load_hist	total[LOAD_LAST + 1];
+	unsigned long	late = 0;
+	char		outstr[BUFSIZ];
+	int		testfail = 0;
+	struct timeval	end;
+	double		secs;
+
+	config = tester_init( "slapd-load", TESTER_LOAD );
+
+	/* by default, tolerate referrals and no such object */
+	tester_ignore_str2errlist( "REFERRAL,NO_SUCH_OBJECT" );
+
+	(void)parse_mix( DEFAULT_MIX );
+
+	while ( (i = getopt( argc, argv, TESTER_COMMON_OPTS "b:c:e:f:M:m:n:P:q:s:T:" )) != EOF ) {
+		switch ( i ) {
+		case 'b':		/* search base */
+			base = strdup( optarg );
+			break;
+
+		case 'c':		/* connections per thread */
+			if ( lutil_atoi( &noconns, optarg ) != 0 || noconns < 1 ) {
+				usage( argv[0], i );
+			}
+			break;
+
+		case 'e':		/* DN to read or modify */
+			entry = strdup( optarg );
+			break;
+
+		case 'f':		/* the search filter */
+			filter = strdup( optarg );
+			break;
+
+		case 'M':		/* the operation mix */
+			if ( parse_mix( optarg ) != 0 ) {
+				usage( argv[0], i );
+			}
+			break;
+
+		case 'm':		/* the number of threads */
+			if ( lutil_atoi( &threads, optarg ) != 0 || threads < 1 ) {
+				usage( argv[0], i );
+			}
+			if ( threads > MAX_THREAD )
+				threads = MAX_THREAD;
+			break;
+
+		case 'P':		/* outstanding operations per connection */
+			if ( lutil_atoi( &depth, optarg ) != 0 || depth < 1 ) {
+				usage( argv[0], i );
+			}
+			if ( depth > MAX_DEPTH )
+				depth = MAX_DEPTH;
+			break;
+
+		case 'q': {		/* target rate */
+			char *next;
+
+			rate = strtod( optarg, &next );
+			if ( next == optarg || *next != '\0' || rate < 0 ) {
+				usage( argv[0], i );
+			}
+			} break;
+
+		case 'n':		/* range of the random "%d" */
+			if ( lutil_atoi( &range, optarg ) != 0 || range < 0 ) {
+				usage( argv[0], i );
+			}
+			break;
+
+		case 's':		/* duration */
+			if ( lutil_atoi( &seconds, optarg ) != 0 || seconds < 1 ) {
+				usage( argv[0], i );
+			}
+			break;
+
+		case 'T':
+			attrs = ldap_str2charray( optarg, "," );
+			if ( attrs == NULL ) {
+				usage( argv[0], i );
+			}
+			break;
+
+		default:
+			if ( tester_config_opt( config, i, optarg ) == LDAP_SUCCESS ) {
+				break;
+			}
+			usage( argv[0], i );
+			break;
+		}
+	}
+
+	if ( mix[LOAD_SEARCH] && ( base == NULL || filter == NULL )) {
+		fprintf( stderr, "%s: search needs -b and -f.\n", argv[0] );
+		usage( argv[0], 0 );
+	}
+	if (( mix[LOAD_READ] || mix[LOAD_MODIFY] ) && entry == NULL ) {
+		fprintf( stderr, "%s: read and modify need -e.\n", argv[0] );
+		usage( argv[0], 0 );
+	}
+
+	tester_config_finish( config );
+	ldap_pvt_thread_initialize();
+
+	lts = calloc( threads, sizeof( load_thread ));
+	if ( lts == NULL ) {
+		tester_error( "Memory error: calloc threads" );
+		exit( EXIT_FAILURE );
+	}
+	for ( i = 0; i < threads; i++ ) {
+		load_thread *lt = &lts[i];
+
+		lt->lt_idx = i;
+		lt->lt_rand = ( (unsigned long)pid << 16 ) + i + 1;
+		lt->lt_nconns = noconns;
+		lt->lt_conns = calloc( noconns, sizeof( load_conn ));
+		if ( lt->lt_conns == NULL ) {
+			tester_error( "Memory error: calloc connections" );
+			exit( EXIT_FAILURE );
+		}
+		for ( j = 0; j < noconns; j++ ) {
+			load_conn *lc = &lt->lt_conns[j];
+			int k;
+
+			tester_init_ld( &lc->lc_ld, config, 0 );
+			lc->lc_slots = calloc( depth, sizeof( load_slot ));
+			if ( lc->lc_slots == NULL ) {
+				tester_error( "Memory error: calloc slots" );
+				exit( EXIT_FAILURE );
+			}
+			for ( k = 0; k < depth; k++ )
+				lc->lc_slots[k].ls_msgid = -1;
+		}
+	}
+
+	snprintf( outstr, sizeof( outstr ), "Load Start: threads: %d "
+		"conns/thread: %d depth: %d rate: %.0f/s time: %ds",
+		threads, noconns, depth, rate, seconds );
+	tester_error( outstr );
+
+	gettimeofday( &start, NULL );
+	/* give every thread time to get going before the first send */
+	tv_add_us( &start, 10000L );
+	stop = start;
+	stop.tv_sec += seconds;
+
+	for ( i = 0; i < threads; i++ ) {
+		ldap_pvt_thread_create( &lts[i].lt_tid, 0, do_onethread, &lts[i] );
+	}
+
+	memset( total, 0, sizeof( total ));
+	for ( i = 0; i < threads; i++ ) {
+		void *failed = NULL;
+
+		ldap_pvt_thread_join( lts[i].lt_tid, &failed );
+		if ( failed ) {
+			snprintf( outstr, sizeof( outstr ), "FAIL thread %d", i );
+			tester_error( outstr );
+			testfail++;
+		}
+		for ( j = 0; j < LOAD_LAST; j++ ) {
+			hist_merge( &total[j], &lts[i].lt_hist[j] );
+			hist_merge( &total[LOAD_LAST], &lts[i].lt_hist[j] );
+		}
+		late += lts[i].lt_late;
+	}
+	gettimeofday( &end, NULL );
+	secs = tv_diff_us( &end, &start ) / 1000000.0;
+	if ( secs > seconds )
+		secs = seconds;
+
+	printf( "%-8s %10s %8s %10s %10s %9s %9s %9s %9s\n",
+		"op", "count", "errors", "ops/s", "avg(us)",
+		"p50(us)", "p99(us)", "p999(us)", "max(us)" );
+	for ( j = 0; j < LOAD_LAST; j++ ) {
+		if ( mix[j] )
+			report( load_names[j], &total[j], secs );
+	}
+	report( "total", &total[LOAD_LAST], secs );
+	if ( late ) {
+		printf( "# %lu operations were sent more than %dus "
+			"behind schedule\n", late, LOAD_LATE_US );
+	}
+
+	for ( i = 0; i < threads; i++ ) {
+		for ( j = 0; j < noconns; j++ ) {
+			ldap_unbind_ext( lts[i].lt_conns[j].lc_ld, NULL, NULL );
+			free( lts[i].lt_conns[j].lc_slots );
+		}
+		free( lts[i].lt_conns );
+	}
+	free( lts );
+
+	if ( total[LOAD_LAST].lh_errors )
+		testfail++;
+
+	snprintf( outstr, sizeof( outstr ), "Load Test complete" );
+	tester_error( outstr );
+
+	if ( testfail )
+		exit( EXIT_FAILURE );
+	exit( EXIT_SUCCESS );
+}